@@ -0,0 +1,229 @@
+/* ESP8266 "bare metal" interrupts without the bootrom dispatcher.
+ *
+ * rtc.c found that using ets_isr_attach() and the bootrom interrupt
+ *  handling we can get to 200 khz with a trivial ISR, and 400 khz
+ *  is on the hairy edge.  Most of that time is spent in the ROM
+ *  routine _xtos_l1int_handler, not in our ISR.
+ *
+ * Here we install our own level 1 dispatcher (see vector.S) in the
+ *  exception jump table the ROM set up, and keep our own table of
+ *  handlers, one 8 byte slot per interrupt source.
+ *
+ * Usage is just like the ROM routines:
+ *
+ *   fast_isr_init ();
+ *   fast_isr_attach ( TIMER_INUM, timer_isr, 0 );
+ *   ets_isr_unmask ( 1 << TIMER_INUM );
+ *
+ * We still use ets_isr_mask/unmask since they are not in the
+ *  hot path and they keep the ROM's idea of intenable in sync.
+ */
+
+/* Look, almost no include files!
+ * stdint.h comes with the compiler, for uintptr_t.
+ */
+#include <stdint.h>
+
+/* The clock really is running at 52 Mhz when we
+ * come out of the boot rom
+ */
+#define  CLK_FREQ       (52*1000000)
+#define TIMER_TICKER	325
+
+/* ----------------------------------------- */
+
+/* The ROM keeps a pointer to the exception jump table here.
+ * It points to 3fffc000, 64 entries, indexed by exccause.
+ * Cause 4 is a level 1 interrupt.
+ */
+/* test.c gives us a fake one */
+#ifndef EXC_TABLE_PTR
+#define EXC_TABLE_PTR	((unsigned int **) 0x3fffdaac)
+#endif
+#define EXC_CAUSE_LEVEL1	4
+
+#define NUM_SLOTS	32
+
+struct isr_slot {
+	void	(*func) ( void * );
+	void	*arg;
+};
+
+/* Offsets into this are hard coded in vector.S
+ * (8 bytes per slot, handler first)
+ */
+struct isr_slot fast_isr_slots[NUM_SLOTS];
+
+/* Sources that need the "full" path, see vector.S */
+unsigned int fast_isr_full;
+
+void fast_l1int ( void );
+
+/* Something enabled an interrupt without attaching
+ * a handler.  Shut it off rather than loop forever.
+ */
+static void
+unhandled_isr ( void *arg )
+{
+	int inum = (uintptr_t) arg;
+
+	ets_isr_mask ( 1 << inum );
+}
+
+/* We cannot rely on bss being cleared (nobody does it),
+ * so we fill in every slot here.
+ */
+void
+fast_isr_init ( void )
+{
+	unsigned int *table = *EXC_TABLE_PTR;
+	int i;
+
+	ets_isr_mask ( 0xffffffff );
+
+	for ( i=0; i<NUM_SLOTS; i++ ) {
+	    fast_isr_slots[i].func = unhandled_isr;
+	    fast_isr_slots[i].arg = (void *) (uintptr_t) i;
+	}
+	fast_isr_full = 0;
+
+	table[EXC_CAUSE_LEVEL1] = (uintptr_t) fast_l1int;
+}
+
+/* A leaf handler gets the fast path.
+ * Anything that might take an exception should
+ * use fast_isr_attach_full() instead.
+ */
+void
+fast_isr_attach ( int inum, void (*func)(void *), void *arg )
+{
+	if ( inum < 0 || inum >= NUM_SLOTS )
+	    return;
+
+	ets_isr_mask ( 1 << inum );
+	fast_isr_slots[inum].func = func;
+	fast_isr_slots[inum].arg = arg;
+	fast_isr_full &= ~(1 << inum);
+}
+
+void
+fast_isr_attach_full ( int inum, void (*func)(void *), void *arg )
+{
+	fast_isr_attach ( inum, func, arg );
+	if ( inum >= 0 && inum < NUM_SLOTS )
+	    fast_isr_full |= 1 << inum;
+}
+
+/* ----------------------------------------- */
+/* Everything from here on is just like rtc.c */
+
+#define RTC_BASE 0x60000700
+
+struct rtc_gpio {
+	volatile unsigned int	out;		/* 68 */
+	int		_pad0[2];
+	volatile unsigned int	enable;		/* 74 */
+	int		_pad1[5];
+	volatile unsigned int	in;		/* 8C */
+	volatile unsigned int	conf;		/* 90 */
+	volatile unsigned int	config[6];	/* 94 */
+};
+
+#define	dcdc_conf	config[3]		/* A0 */
+
+#define RTC_GPIO_BASE (struct rtc_gpio *) (RTC_BASE + 0x68 )
+
+struct timer {
+	volatile unsigned int	load;
+	volatile unsigned int	count;
+	volatile unsigned int	ctrl;
+	volatile unsigned int	intack;
+};
+
+#define TIMER_BASE (struct timer *) 0x60000600;
+
+#define TIMER_INUM 9
+
+/* bits in the timer control register */
+#define	TC_ENABLE	0x80
+#define	TC_AUTO_LOAD	0x40
+#define	TC_DIV_1	0x00
+#define	TC_DIV_16	0x04
+#define	TC_DIV_256	0x08
+#define TC_LEVEL	0x01
+#define TC_EDGE		0x00
+
+struct dport {
+	volatile unsigned int	_unk1;
+	volatile unsigned int	edge;
+};
+
+#define DPORT_BASE (struct dport *) 0x3ff00000;
+
+void
+rtc_gpio_output ( void )
+{
+	struct rtc_gpio *rg = RTC_GPIO_BASE;
+	int mux;
+
+	/* set mux for rtc_gpio0 */
+	mux = rg->dcdc_conf;
+	rg->dcdc_conf = (mux & 0xffffffbc) | 1;
+	rg->conf &= ~1;
+
+	/* enable output */
+	rg->enable |= 1;
+}
+
+/* A true leaf, no state in memory, just flip the pin */
+void
+timer_isr ( void *arg )
+{
+	struct rtc_gpio *rg = RTC_GPIO_BASE;
+
+	rg->out ^= 1;
+}
+
+/* Call with rate in units of CLK.
+ *  (we set to prescaler to divide by 1).
+ */
+void
+timer_load ( int val )
+{
+	struct timer *tp = TIMER_BASE;
+	struct dport *dp = DPORT_BASE;
+
+	tp->ctrl = TC_ENABLE | TC_AUTO_LOAD | TC_DIV_1 | TC_EDGE;
+	fast_isr_attach ( TIMER_INUM, timer_isr, 0 );
+
+	dp->edge |= 0x02;
+	ets_isr_unmask ( 1 << TIMER_INUM );
+
+	tp->load = val;
+}
+
+void
+call_user_start ( void )
+{
+    uart_div_modify(0, CLK_FREQ / 115200);
+    ets_delay_us ( 1000 * 500 );
+
+    fast_isr_init ();
+
+    rtc_gpio_output ();
+
+    /* With the ROM dispatcher this gave 200 khz with rare jitter.
+     * Interrupting every 2.5 microseconds (130 clocks).
+     */
+    timer_load ( 130 );
+
+    /* This is 400 khz out (interrupting every 1.25 microseconds),
+     * which the ROM dispatcher could not do.
+     */
+    // timer_load ( 65 );
+
+    ets_printf("\n");
+    ets_printf("Starting\n");
+}
+
+/* THE END */
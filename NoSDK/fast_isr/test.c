@@ -0,0 +1,344 @@
+/* test.c
+ * Host tests for the fast_isr dispatcher
+ *
+ *   make test
+ *
+ * We build fast_isr.c as it is, with the ROM calls it makes and
+ * the INTERRUPT and INTENABLE registers played by plain words.
+ * fast_l1int here is vector.S in C, a line here for each step
+ * there (nsau, intclear, the slot, the full path), so if you
+ * change one, change the other.
+ *
+ * That means this tests fast_isr.c and the dispatch as vector.S
+ * is meant to do it, not vector.S itself.  A slip in the assembly
+ * (the nsau pick, the intclear write, saving and restoring epc1
+ * and ps) would pass here.  vector.S has only been checked by
+ * reading it against this and the ROM code in boot.txt.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* ----------------------------------------- */
+/* The hardware and the ROM */
+
+static unsigned int interrupt;		/* rsr interrupt */
+static unsigned int intenable;		/* rsr intenable */
+static unsigned int level;		/* sources intclear can't clear */
+static unsigned int ps;
+
+#define PS_EXCM		0x10
+
+/* The ROM's exception table, and the pointer to it at 3fffdaac */
+static unsigned int exc_table[64];
+static unsigned int *exc_table_ptr = exc_table;
+
+#define EXC_TABLE_PTR	(&exc_table_ptr)
+
+/* What the ROM does to intenable, less the virtual priority */
+void
+ets_isr_mask ( unsigned int mask )
+{
+	intenable &= ~mask;
+}
+
+void
+ets_isr_unmask ( unsigned int mask )
+{
+	intenable |= mask;
+}
+
+/* Only call_user_start uses these, we never call it */
+void uart_div_modify ( int uart, int div ) { }
+void ets_delay_us ( int us ) { }
+int ets_printf ( const char *fmt, ... ) { return 0; }
+
+#include "fast_isr.c"
+
+/* ----------------------------------------- */
+/* vector.S */
+
+#define PS_INTLEVEL1_UM	0x21
+
+/* Every handler call, so a source that won't go away can't hang us */
+#define MAX_CALLS	100
+
+static int ncalls;
+
+void
+fast_l1int ( void )
+{
+	unsigned int pending;
+	unsigned int save_ps;
+	struct isr_slot *sp;
+	int inum;
+
+	for ( ;; ) {
+	    /* .Lscan */
+	    pending = interrupt & intenable;
+	    if ( ! pending )
+		break;
+
+	    /* nsau gives 31 - source number */
+	    inum = 31 - __builtin_clz ( pending );
+
+	    /* wsr intclear, a level source stays until it is acked */
+	    interrupt &= ~(1 << inum) | level;
+
+	    sp = &fast_isr_slots[inum];
+	    if ( ++ncalls > MAX_CALLS )
+		return;
+
+	    if ( fast_isr_full & (1 << inum) ) {
+		/* .Lfull */
+		save_ps = ps;
+		ps = PS_INTLEVEL1_UM;
+		sp->func ( sp->arg );
+		ps = save_ps;
+	    } else
+		sp->func ( sp->arg );
+	}
+}
+
+/* ----------------------------------------- */
+
+static int ntest;
+static int nfail;
+
+#define CHECK(x)	check ( x, #x, __LINE__ )
+
+static void
+check ( int ok, char *what, int line )
+{
+	ntest++;
+	if ( ! ok ) {
+	    printf ( "FAIL line %d: %s\n", line, what );
+	    nfail++;
+	}
+}
+
+/* What the handlers saw */
+static int order[MAX_CALLS];
+static unsigned int order_ps[MAX_CALLS];
+static int norder;
+
+/* arg is the source number */
+static void
+record_isr ( void *arg )
+{
+	int inum = (uintptr_t) arg;
+
+	if ( norder < MAX_CALLS ) {
+	    order_ps[norder] = ps;
+	    order[norder++] = inum;
+	}
+
+	/* acking the device drops a level source */
+	if ( level & (1 << inum) ) {
+	    level &= ~(1 << inum);
+	    interrupt &= ~(1 << inum);
+	}
+}
+
+/* Raises source 7 the first time, like a timer ISR kicking a soft one */
+static void
+raise_isr ( void *arg )
+{
+	static int raised;
+
+	record_isr ( arg );
+	if ( ! raised++ )
+	    interrupt |= 1 << 7;
+}
+
+static void
+setup ( void )
+{
+	interrupt = 0;
+	intenable = 0xffffffff;
+	level = 0;
+	memset ( exc_table, 0, sizeof(exc_table) );
+	memset ( fast_isr_slots, 0x55, sizeof(fast_isr_slots) );
+	fast_isr_full = 0x55555555;
+
+	fast_isr_init ();
+
+	norder = 0;
+	ncalls = 0;
+	ps = PS_EXCM | 0x20;
+}
+
+static void
+dispatch ( void )
+{
+	norder = 0;
+	ncalls = 0;
+	fast_l1int ();
+}
+
+static int
+same_order ( int n, int *want )
+{
+	return norder == n && memcmp ( order, want, n * sizeof(int) ) == 0;
+}
+
+static void
+test_init ( void )
+{
+	int i, ok = 1;
+
+	setup ();
+	CHECK ( exc_table[EXC_CAUSE_LEVEL1] != 0 );
+	CHECK ( exc_table[EXC_CAUSE_LEVEL1 - 1] == 0 );
+	CHECK ( intenable == 0 );
+	CHECK ( fast_isr_full == 0 );
+	for ( i=0; i<NUM_SLOTS; i++ )
+	    if ( fast_isr_slots[i].func != unhandled_isr || (uintptr_t) fast_isr_slots[i].arg != i )
+		ok = 0;
+	CHECK ( ok );
+}
+
+/* Highest numbered source first, every bit cleared */
+static void
+test_priority ( void )
+{
+	int want[] = { 31, 9, 7, 0 };
+	int i;
+
+	setup ();
+	for ( i=0; i<4; i++ )
+	    fast_isr_attach ( want[i], record_isr, (void *) (uintptr_t) want[i] );
+	ets_isr_unmask ( 0x80000281 );
+
+	interrupt = 0x80000281;
+	dispatch ();
+	CHECK ( same_order ( 4, want ) );
+	CHECK ( interrupt == 0 );
+	CHECK ( intenable == 0x80000281 );
+}
+
+/* Pending but not enabled stays pending and isn't called */
+static void
+test_masked ( void )
+{
+	int want[] = { 9 };
+
+	setup ();
+	fast_isr_attach ( 9, record_isr, (void *) 9 );
+	fast_isr_attach ( 3, record_isr, (void *) 3 );
+	ets_isr_unmask ( 1 << 9 );
+
+	interrupt = (1 << 9) | (1 << 3);
+	dispatch ();
+	CHECK ( same_order ( 1, want ) );
+	CHECK ( interrupt == 1 << 3 );
+
+	/* and nothing at all */
+	interrupt = 0;
+	dispatch ();
+	CHECK ( norder == 0 );
+}
+
+/* Something raised while we are in there gets picked up before we leave */
+static void
+test_rescan ( void )
+{
+	int want[] = { 9, 7 };
+
+	setup ();
+	fast_isr_attach ( 9, raise_isr, (void *) 9 );
+	fast_isr_attach ( 7, record_isr, (void *) 7 );
+	ets_isr_unmask ( (1 << 9) | (1 << 7) );
+
+	interrupt = 1 << 9;
+	dispatch ();
+	CHECK ( same_order ( 2, want ) );
+	CHECK ( interrupt == 0 );
+}
+
+/* A level source with no handler gets masked, not called forever */
+static void
+test_unhandled ( void )
+{
+	int want[] = { 6 };
+
+	setup ();
+	fast_isr_attach ( 6, record_isr, (void *) 6 );
+	ets_isr_unmask ( (1 << 5) | (1 << 6) );
+
+	level = 1 << 5;
+	interrupt = (1 << 5) | (1 << 6);
+	dispatch ();
+	CHECK ( ncalls <= 2 );
+	CHECK ( same_order ( 1, want ) );
+	CHECK ( intenable == 1 << 6 );
+	CHECK ( interrupt == 1 << 5 );
+
+	/* a level source we do handle is called until its handler acks it */
+	setup ();
+	fast_isr_attach ( 4, record_isr, (void *) 4 );
+	ets_isr_unmask ( 1 << 4 );
+	level = 1 << 4;
+	interrupt = 1 << 4;
+	dispatch ();
+	CHECK ( norder == 1 && interrupt == 0 );
+}
+
+/* Only the full path drops EXCM, and ps comes back */
+static void
+test_full ( void )
+{
+	int want[] = { 8, 2 };
+
+	setup ();
+	fast_isr_attach_full ( 8, record_isr, (void *) 8 );
+	fast_isr_attach ( 2, record_isr, (void *) 2 );
+	ets_isr_unmask ( (1 << 8) | (1 << 2) );
+	CHECK ( fast_isr_full == 1 << 8 );
+
+	interrupt = (1 << 8) | (1 << 2);
+	dispatch ();
+	CHECK ( same_order ( 2, want ) );
+	CHECK ( order_ps[0] == PS_INTLEVEL1_UM );
+	CHECK ( order_ps[1] & PS_EXCM );
+	CHECK ( ps == (PS_EXCM | 0x20) );
+
+	/* attached again the fast way, it goes back to the fast path */
+	fast_isr_attach ( 8, record_isr, (void *) 8 );
+	CHECK ( fast_isr_full == 0 );
+	CHECK ( ! (intenable & (1 << 8)) );
+}
+
+/* Out of range does nothing */
+static void
+test_range ( void )
+{
+	struct isr_slot before[NUM_SLOTS];
+
+	setup ();
+	memcpy ( before, fast_isr_slots, sizeof(before) );
+	fast_isr_attach ( -1, record_isr, 0 );
+	fast_isr_attach ( NUM_SLOTS, record_isr, 0 );
+	fast_isr_attach_full ( NUM_SLOTS, record_isr, 0 );
+	CHECK ( memcmp ( before, fast_isr_slots, sizeof(before) ) == 0 );
+	CHECK ( fast_isr_full == 0 );
+}
+
+int
+main ( int argc, char **argv )
+{
+	test_init ();
+	test_priority ();
+	test_masked ();
+	test_rescan ();
+	test_unhandled ();
+	test_full ();
+	test_range ();
+
+	printf ( "%d checks, %d failed\n", ntest, nfail );
+	return nfail ? 1 : 0;
+}
+
+/* THE END */
@@ -0,0 +1,493 @@
+/* ESP8266 sdk experiments
+ *
+ * Continuous ADC capture, streamed over TCP.
+ *
+ * The hardware timer (FRC1) paces the sampler, just like
+ *  the adc demo, but rather than printing each value we
+ *  drop 10 bit samples into one of two RAM buffers.
+ * When a buffer fills, the ISR switches to the other one
+ *  and posts a task to ship the full one over a single
+ *  persistent TCP connection as a packed binary block.
+ *
+ * The idea is to be able to watch things like battery sag
+ *  while the radio is transmitting, at kHz rates.
+ *
+ * If the network can't keep up, the ISR finds both buffers
+ *  busy and just counts the samples it throws away.  When it
+ *  moves on to the next buffer, that count is tied to it and
+ *  goes out in its header, so the receiver knows where the
+ *  holes are.  Blocks we can't send are counted the same way,
+ *  against the buffer after them.
+ *
+ * The SDK owns the packed block from espconn_send until it calls
+ *  our sent callback.  A buffer that fills before then waits for
+ *  it, and the ISR drops (and counts) samples meanwhile.
+ *
+ * On the wire, each block is:
+ *
+ *   struct block_header (20 bytes, little endian)
+ *   BUF_SAMPLES * 10 / 8 bytes of samples,
+ *	4 samples packed into 5 bytes (low bits first).
+ *
+ * The host side is "adc_recv" in this directory.
+ *
+ * Setting CIC_SHIFT samples the ADC 2^CIC_SHIFT times faster
+ *  and runs a CIC decimator (dsp.c) in the ISR, so we send
+ *  the same number of samples, but with the noise averaged down.
+ */
+
+/* test.c brings its own SDK */
+#ifndef HOST_TEST
+#include "ets_sys.h"
+#include "osapi.h"
+#include "os_type.h"
+#include "gpio.h"
+
+#include "user_interface.h"
+#include "espconn.h"
+#include "mem.h"
+
+/* My ssid and password are in here */
+#include "secret.h"
+#endif
+
+#include "dsp.h"
+
+#define DATA_PORT	2002	/* on trona */
+
+/* Sample interval in microseconds.
+ * 500 gives 2 kHz.
+ */
+#define SAMPLE_US	500
+
+/* 0 means no decimation.
+ * 2 means we read the ADC 4 times per sample.
+ */
+#define CIC_SHIFT	0
+#define CIC_ORDER	2
+
+#define ADC_US		(SAMPLE_US >> CIC_SHIFT)
+
+/* Must be a multiple of 4 for the packing */
+#define BUF_SAMPLES	512
+#define PACKED_SIZE	(BUF_SAMPLES * 10 / 8)
+
+#define BLOCK_MAGIC	0x32434441	/* "ADC2" */
+
+struct block_header {
+	unsigned int	magic;
+	unsigned int	seq;
+	unsigned int	count;
+	unsigned int	lost;		/* dropped just before this block */
+	unsigned int	interval;	/* microseconds per sample */
+};
+
+/* Timer clock */
+#define DIV_BY_1     0
+#define DIV_BY_16    4
+#define DIV_BY_256   8
+
+#define TM_LEVEL_INT  1   // level interrupt
+#define TM_EDGE_INT   0   // edge interrupt
+
+#define SEND_TASK_PRIO	USER_TASK_PRIO_0
+#define SEND_QUEUE_LEN	4
+
+#define SIG_FULL	1
+
+void show_ip ( void );
+void start_client ( void );
+
+/* ------------------------------- */
+/* The sampler (all of this must live in IRAM) */
+/* ------------------------------- */
+
+/* The ISR fills buffer "fill", the send task owns the other one
+ * while "busy" is set.
+ * "lost" counts drops since the last switch, buf_lost[] is
+ * what was dropped just before each buffer.
+ */
+static unsigned short samples[2][BUF_SAMPLES];
+static volatile int fill;
+static volatile int fill_count;
+static volatile int busy;
+static volatile unsigned int lost;
+static volatile unsigned int buf_lost[2];
+
+#if CIC_SHIFT > 0
+static struct dsp_cic cic;
+#endif
+
+void
+hw_timer_isr ( void )
+{
+    int n = fill_count;
+    int val;
+
+#if CIC_SHIFT > 0
+    if ( ! dsp_cic ( &cic, system_adc_read (), &val ) )
+	return;
+#else
+    val = system_adc_read ();
+#endif
+
+    if ( n >= BUF_SAMPLES ) {
+	/* Both buffers are spoken for, we just have to drop this one */
+	lost++;
+	return;
+    }
+
+    samples[fill][n++] = val;
+
+    if ( n < BUF_SAMPLES ) {
+	fill_count = n;
+	return;
+    }
+
+    /* This buffer is full */
+    if ( busy ) {
+	/* Leave fill_count at the limit, the send task
+	 * will swap us when it is done with the other buffer.
+	 */
+	fill_count = n;
+	return;
+    }
+
+    busy = 1;
+    system_os_post ( SEND_TASK_PRIO, SIG_FULL, fill );
+    fill = 1 - fill;
+    fill_count = 0;
+    buf_lost[fill] = lost;
+    lost = 0;
+}
+
+#define US_TO_RTC_TIMER_TICKS(t)          \
+    ((t) ?                                   \
+     (((t) > 0x35A) ?                   \
+      (((t)>>2) * ((APB_CLK_FREQ>>4)/250000) + ((t)&0x3) * ((APB_CLK_FREQ>>4)/1000000))  :    \
+      (((t) *(APB_CLK_FREQ>>4)) / 1000000)) :    \
+     0)
+
+#define FRC1_ENABLE_TIMER  BIT7
+#define FRC1_AUTO_LOAD  BIT6
+
+/* Argument is interval in microseconds !! */
+static void
+hw_timer_setup ( unsigned int val )
+{
+    RTC_REG_WRITE(FRC1_CTRL_ADDRESS, FRC1_AUTO_LOAD | DIV_BY_16 | FRC1_ENABLE_TIMER | TM_EDGE_INT);
+
+    ETS_FRC_TIMER1_INTR_ATTACH(hw_timer_isr, NULL);
+
+    TM1_EDGE_INT_ENABLE();
+    ETS_FRC1_INTR_ENABLE();
+
+    RTC_REG_WRITE(FRC1_LOAD_ADDRESS, US_TO_RTC_TIMER_TICKS(val));
+}
+
+/* ------------------------------- */
+/* Shipping the data */
+/* ------------------------------- */
+
+static struct espconn client_conn;
+static esp_tcp client_tcp;
+static int connected;
+static unsigned int seq;
+
+/* The SDK has block[] while "sending" is set.
+ * A buffer that comes along meanwhile waits in "pending".
+ */
+static unsigned char block[sizeof(struct block_header) + PACKED_SIZE];
+static int sending;
+static int pending = -1;
+
+/* 4 samples of 10 bits go into 5 bytes */
+static void ICACHE_FLASH_ATTR
+pack_samples ( unsigned char *out, unsigned short *in, int count )
+{
+    int i;
+    unsigned int a, b, c, d;
+
+    for ( i=0; i<count; i += 4 ) {
+	a = in[0] & 0x3ff;
+	b = in[1] & 0x3ff;
+	c = in[2] & 0x3ff;
+	d = in[3] & 0x3ff;
+	out[0] = a;
+	out[1] = (a >> 8) | (b << 2);
+	out[2] = (b >> 6) | (c << 4);
+	out[3] = (c >> 4) | (d << 6);
+	out[4] = d >> 2;
+	in += 4;
+	out += 5;
+    }
+}
+
+/* Samples that go missing before this buffer.
+ * The ISR sets these when it switches buffers.
+ */
+static void
+add_lost ( int which, unsigned int n )
+{
+    ETS_FRC1_INTR_DISABLE();
+    buf_lost[which] += n;
+    ETS_FRC1_INTR_ENABLE();
+}
+
+/* Called when the other buffer is done with.
+ * If the ISR is stalled on a full buffer, this
+ * is where we let it go again.
+ */
+static void
+release_buffer ( void )
+{
+    ETS_FRC1_INTR_DISABLE();
+    busy = 0;
+    if ( fill_count >= BUF_SAMPLES ) {
+	busy = 1;
+	system_os_post ( SEND_TASK_PRIO, SIG_FULL, fill );
+	fill = 1 - fill;
+	fill_count = 0;
+	buf_lost[fill] = lost;
+	lost = 0;
+    }
+    ETS_FRC1_INTR_ENABLE();
+}
+
+static void ICACHE_FLASH_ATTR
+send_block ( int which )
+{
+    struct block_header *hp = (struct block_header *) block;
+    unsigned int nlost;
+
+    if ( connected && sending ) {
+	/* block[] isn't ours yet, the sent callback brings us back */
+	pending = which;
+	return;
+    }
+
+    /* The ISR won't touch this one until we release it */
+    nlost = buf_lost[which];
+    buf_lost[which] = 0;
+
+    if ( ! connected ) {
+	/* Nobody to send to, all of it is lost before the next one */
+	add_lost ( 1 - which, nlost + BUF_SAMPLES );
+	release_buffer ();
+	return;
+    }
+
+    hp->magic = BLOCK_MAGIC;
+    hp->seq = seq++;
+    hp->count = BUF_SAMPLES;
+    hp->lost = nlost;
+    hp->interval = SAMPLE_US;
+
+    pack_samples ( &block[sizeof(struct block_header)], samples[which], BUF_SAMPLES );
+
+    /* The packed copy is in block[], so the sample buffer is free */
+    release_buffer ();
+
+    if ( espconn_send ( &client_conn, block, sizeof(block) ) != 0 ) {
+	/* The header didn't go either, so its count moves on too */
+	add_lost ( 1 - which, nlost + BUF_SAMPLES );
+	return;
+    }
+    sending = 1;
+}
+
+/* block[] is ours again, send whatever was waiting for it */
+static void ICACHE_FLASH_ATTR
+send_done ( void )
+{
+    sending = 0;
+    if ( pending >= 0 ) {
+	system_os_post ( SEND_TASK_PRIO, SIG_FULL, pending );
+	pending = -1;
+    }
+}
+
+static os_event_t send_queue[SEND_QUEUE_LEN];
+
+static void ICACHE_FLASH_ATTR
+send_task ( os_event_t *e )
+{
+    if ( e->sig == SIG_FULL )
+	send_block ( e->par );
+}
+
+/* ------------------------------- */
+/* The TCP connection */
+/* ------------------------------- */
+
+/* 192.168.0.5 is trona */
+void
+load_ip ( unsigned char *ip )
+{
+    ip[0] = 192;
+    ip[1] = 168;
+    ip[2] = 0;
+    ip[3] = 5;
+}
+
+/* Could require up to 16 bytes */
+char *
+ip2str ( char *buf, unsigned char *p )
+{
+    os_sprintf ( buf, "%d.%d.%d.%d", p[0], p[1], p[2], p[3] );
+    return buf;
+}
+
+void
+show_ip ( void )
+{
+    struct ip_info info;
+    char buf[16];
+
+    wifi_get_ip_info ( STATION_IF, &info );
+    os_printf ( "IP: %s\n", ip2str ( buf, (char *) &info.ip.addr ) );
+}
+
+#define RETRY_DELAY	2000
+
+static os_timer_t retry_timer;
+
+static void ICACHE_FLASH_ATTR
+retry ( void *arg )
+{
+    espconn_connect ( &client_conn );
+}
+
+static void ICACHE_FLASH_ATTR
+schedule_retry ( void )
+{
+    os_timer_disarm ( &retry_timer );
+    os_timer_setfn ( &retry_timer, retry, NULL );
+    os_timer_arm ( &retry_timer, RETRY_DELAY, 0 );
+}
+
+void ICACHE_FLASH_ATTR
+tcp_connect_cb ( void *arg )
+{
+    os_printf ( "TCP connect\n" );
+    connected = 1;
+    seq = 0;
+    /* whatever the last connection had in flight is gone */
+    send_done ();
+}
+
+void ICACHE_FLASH_ATTR
+tcp_sent_cb ( void *arg )
+{
+    send_done ();
+}
+
+/* Once the connection is gone, the SDK is done with block[] too */
+void ICACHE_FLASH_ATTR
+tcp_disconnect_cb ( void *arg )
+{
+    os_printf ( "TCP disconnect\n" );
+    connected = 0;
+    send_done ();
+    schedule_retry ();
+}
+
+void ICACHE_FLASH_ATTR
+tcp_reconnect_cb ( void *arg, sint8 err )
+{
+    os_printf ( "TCP reconnect (%d)\n", err );
+    connected = 0;
+    send_done ();
+    schedule_retry ();
+}
+
+void
+start_client ( void )
+{
+    esp_tcp *tp;
+    struct espconn *c;
+    char buf[16];
+
+    c = &client_conn;
+    os_bzero ( c, sizeof(struct espconn) );
+
+    c->type = ESPCONN_TCP;
+    c->state = ESPCONN_NONE;
+
+    /* We get here every time we get an IP, so no allocating */
+    tp = &client_tcp;
+    os_bzero ( tp, sizeof(esp_tcp) );
+    c->proto.tcp = tp;
+
+    tp->local_port = espconn_port();
+    tp->remote_port = DATA_PORT;
+    load_ip ( tp->remote_ip );
+
+    espconn_regist_connectcb ( c, tcp_connect_cb );
+    espconn_regist_disconcb ( c, tcp_disconnect_cb);
+    espconn_regist_reconcb ( c, tcp_reconnect_cb );
+    espconn_regist_sentcb ( c, tcp_sent_cb );
+
+    os_printf ( "Connecting to port %d ", tp->remote_port );
+    os_printf ( "at %s\n", ip2str ( buf, (char *) tp->remote_ip ) );
+
+    espconn_connect ( c );
+}
+
+void
+wifi_event ( System_Event_t *e )
+{
+    int event = e->event;
+
+    if ( event == EVENT_STAMODE_GOT_IP ) {
+	os_printf ( "WIFI Event, got IP\n" );
+	show_ip ();
+	start_client ();
+    } else if ( event == EVENT_STAMODE_CONNECTED ) {
+	os_printf ( "WIFI Event, connected\n" );
+    } else if ( event == EVENT_STAMODE_DISCONNECTED ) {
+	os_printf ( "WIFI Event, disconnected\n" );
+	connected = 0;
+    } else {
+	os_printf ( "Unknown event %d !\n", event );
+    }
+}
+
+void
+user_init ( void )
+{
+    struct station_config conf;
+
+    uart_div_modify(0, UART_CLK_FREQ / 115200);
+
+    os_printf("\n");
+    os_printf("SDK version:%s\n", system_get_sdk_version());
+
+    fill = 0;
+    fill_count = 0;
+    busy = 0;
+    lost = 0;
+    buf_lost[0] = 0;
+    buf_lost[1] = 0;
+    connected = 0;
+    sending = 0;
+    pending = -1;
+#if CIC_SHIFT > 0
+    dsp_cic_init ( &cic, CIC_ORDER, CIC_SHIFT );
+#endif
+
+    system_os_task ( send_task, SEND_TASK_PRIO, send_queue, SEND_QUEUE_LEN );
+
+    wifi_set_opmode(STATION_MODE);
+
+    os_memset ( &conf, 0, sizeof(struct station_config) );
+    os_memcpy (&conf.ssid, ssid, 32);
+    os_memcpy (&conf.password, pass, 64 );
+    wifi_station_set_config (&conf);
+
+    wifi_set_event_handler_cb ( wifi_event );
+
+    hw_timer_setup ( ADC_US );
+}
+
+/* THE END */
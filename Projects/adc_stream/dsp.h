@@ -0,0 +1,74 @@
+/* dsp.h
+ *
+ * Small fixed point filters for ADC and sensor data.
+ * Integer only, and no division anywhere since
+ * the lx106 has no divide instruction (gcc would
+ * call __divsi3 in the bootrom).  All the scale
+ * factors are powers of 2.
+ */
+
+#ifndef _DSP_H_
+#define _DSP_H_
+
+/* Moving average, the window is 1 << shift samples */
+#define DSP_AVG_MAX_SHIFT	6
+#define DSP_AVG_MAX		(1 << DSP_AVG_MAX_SHIFT)
+
+struct dsp_avg {
+	int		shift;
+	int		pos;
+	int		sum;
+	int		hist[DSP_AVG_MAX];
+};
+
+void dsp_avg_init ( struct dsp_avg *, int );
+int dsp_avg ( struct dsp_avg *, int );
+
+/* CIC decimator.
+ * Order 1 to 3, decimate by 1 << rate_shift.
+ * The gain is (1 << rate_shift) ** order, which we remove
+ * with a shift, so the output has the same scale as the input.
+ * Everything is done modulo 2^32 which is fine for a CIC
+ * as long as input bits + order * rate_shift <= 32.
+ */
+#define DSP_CIC_MAX_ORDER	3
+
+struct dsp_cic {
+	int		order;
+	int		rate_shift;
+	int		count;
+	unsigned int	integ[DSP_CIC_MAX_ORDER];
+	unsigned int	comb[DSP_CIC_MAX_ORDER];
+};
+
+void dsp_cic_init ( struct dsp_cic *, int, int );
+int dsp_cic ( struct dsp_cic *, int, int * );
+
+/* Running median of the last n samples (n odd, up to 9) */
+#define DSP_MEDIAN_MAX	9
+
+struct dsp_median {
+	int		n;
+	int		pos;
+	int		fill;
+	int		hist[DSP_MEDIAN_MAX];
+};
+
+void dsp_median_init ( struct dsp_median *, int );
+int dsp_median ( struct dsp_median *, int );
+int dsp_median_n ( int *, int );
+
+/* Exponential smoother, y += (x - y) / 2^shift
+ * We keep y scaled up by 2^shift so nothing is lost
+ * to truncation along the way.
+ */
+struct dsp_ema {
+	int		shift;
+	int		primed;
+	int		acc;
+};
+
+void dsp_ema_init ( struct dsp_ema *, int );
+int dsp_ema ( struct dsp_ema *, int );
+
+#endif /* _DSP_H_ */
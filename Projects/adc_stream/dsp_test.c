@@ -0,0 +1,383 @@
+/* dsp_test.c
+ * Host test for the dsp.c filters
+ *
+ *   make test
+ *
+ * Each filter gets the same few inputs: a full scale 10 bit
+ * ADC ramp, full scale 16 bit steps both ways, a square wave
+ * swinging between the two 16 bit limits, and random 16 bit
+ * noise.  We run a double precision version of the same filter
+ * alongside and check that the fixed point one never strays
+ * further than its rounding allows.
+ *
+ * Then we time each one.  On x86 that is TSC cycles per input
+ * sample on this machine, not the lx106, but it shows which
+ * filters are cheap and which are not.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "dsp.h"
+
+static int ntest;
+static int nfail;
+
+#define CHECK(x)	check ( x, #x, __LINE__ )
+
+static void
+check ( int ok, char *what, int line )
+{
+	ntest++;
+	if ( ! ok ) {
+	    printf ( "FAIL line %d: %s\n", line, what );
+	    nfail++;
+	}
+}
+
+/* ----------------------------------------- */
+/* Inputs */
+
+#define NSAMP		4096
+
+#define S16_MIN		-32768
+#define S16_MAX		32767
+
+enum { RAMP, STEP_UP, STEP_DOWN, SQUARE, NOISE, NUM_INPUTS };
+
+static char *input_name[] = { "ramp", "step up", "step down", "square", "noise" };
+
+static int input[NUM_INPUTS][NSAMP];
+
+static unsigned int seed = 1;
+
+/* Our own, so every run and every box gets the same numbers */
+static int
+noise16 ( void )
+{
+	seed = seed * 1103515245 + 12345;
+	return (int) (seed >> 16 & 0xffff) + S16_MIN;
+}
+
+static void
+make_inputs ( void )
+{
+	int i;
+
+	for ( i=0; i<NSAMP; i++ ) {
+	    input[RAMP][i] = i & 0x3ff;
+	    input[STEP_UP][i] = i < NSAMP/2 ? S16_MIN : S16_MAX;
+	    input[STEP_DOWN][i] = i < NSAMP/2 ? S16_MAX : S16_MIN;
+	    input[SQUARE][i] = (i / 37) & 1 ? S16_MAX : S16_MIN;
+	    input[NOISE][i] = noise16 ();
+	}
+}
+
+static double
+absd ( double x )
+{
+	return x < 0.0 ? -x : x;
+}
+
+/* ----------------------------------------- */
+/* Moving average */
+
+/* Rounds to nearest, so within a half */
+static void
+test_avg ( int shift )
+{
+	struct dsp_avg avg;
+	double err, worst = 0.0;
+	double sum;
+	int n = 1 << shift;
+	int *x;
+	int i, j, k;
+	int y;
+
+	for ( k=0; k<NUM_INPUTS; k++ ) {
+	    x = input[k];
+	    dsp_avg_init ( &avg, shift );
+	    for ( i=0; i<NSAMP; i++ ) {
+		y = dsp_avg ( &avg, x[i] );
+		sum = 0.0;
+		for ( j=0; j<n && j<=i; j++ )
+		    sum += x[i-j];
+		err = absd ( y - sum / n );
+		if ( err > worst )
+		    worst = err;
+		if ( err > 0.5 ) {
+		    printf ( "avg %d, %s: sample %d is %d, not %.2f\n", n, input_name[k], i, y, sum / n );
+		    break;
+		}
+	    }
+	    CHECK ( i == NSAMP );
+	}
+	printf ( "avg of %d: worst error %.2f\n", n, worst );
+}
+
+/* ----------------------------------------- */
+/* CIC */
+
+/* The CIC is a boxcar of 1 << rate_shift, order times over,
+ * so that is the reference, sampled where the CIC gives output.
+ * The fixed point one shifts the gain out, which rounds down,
+ * so it is always within one below.
+ */
+static void
+test_cic ( int order, int rate_shift )
+{
+	struct dsp_cic cic;
+	double h[DSP_CIC_MAX_ORDER * 64 + 1];
+	double t[DSP_CIC_MAX_ORDER * 64 + 1];
+	double ref, gain, err, worst = 0.0;
+	int r = 1 << rate_shift;
+	int nh;
+	int *x;
+	int i, j, k, n;
+	int y;
+
+	/* h = boxcar convolved with itself order times */
+	nh = 1;
+	h[0] = 1.0;
+	for ( n=0; n<order; n++ ) {
+	    for ( i=0; i<nh + r - 1; i++ ) {
+		t[i] = 0.0;
+		for ( j=0; j<r; j++ )
+		    if ( i-j >= 0 && i-j < nh )
+			t[i] += h[i-j];
+	    }
+	    nh += r - 1;
+	    memcpy ( h, t, nh * sizeof(double) );
+	}
+
+	gain = 1.0;
+	for ( n=0; n<order; n++ )
+	    gain *= r;
+
+	for ( k=0; k<NUM_INPUTS; k++ ) {
+	    x = input[k];
+	    dsp_cic_init ( &cic, order, rate_shift );
+	    n = 0;
+	    for ( i=0; i<NSAMP; i++ ) {
+		if ( ! dsp_cic ( &cic, x[i], &y ) )
+		    continue;
+		n++;
+		ref = 0.0;
+		for ( j=0; j<nh && j<=i; j++ )
+		    ref += h[j] * x[i-j];
+		ref /= gain;
+		err = ref - y;
+		if ( absd ( err ) > worst )
+		    worst = absd ( err );
+		if ( err < 0.0 || err >= 1.0 ) {
+		    printf ( "cic %d/%d, %s: sample %d is %d, not %.2f\n", order, r, input_name[k], i, y, ref );
+		    break;
+		}
+	    }
+	    CHECK ( n == NSAMP / r );
+	}
+	printf ( "cic order %d by %d: worst error %.2f\n", order, r, worst );
+}
+
+/* ----------------------------------------- */
+/* Median */
+
+static int
+cmp_double ( const void *a, const void *b )
+{
+	double x = *(double *) a;
+	double y = *(double *) b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* Nothing to round, so it has to be exact.
+ * While it fills, it is the upper median of what it has.
+ */
+static void
+test_median ( int n )
+{
+	struct dsp_median med;
+	double w[DSP_MEDIAN_MAX];
+	int *x;
+	int i, j, k, m;
+	int y;
+
+	for ( k=0; k<NUM_INPUTS; k++ ) {
+	    x = input[k];
+	    dsp_median_init ( &med, n );
+	    for ( i=0; i<NSAMP; i++ ) {
+		y = dsp_median ( &med, x[i] );
+		m = i + 1 < n ? i + 1 : n;
+		for ( j=0; j<m; j++ )
+		    w[j] = x[i-j];
+		qsort ( w, m, sizeof(double), cmp_double );
+		if ( y != w[m/2] ) {
+		    printf ( "median %d, %s: sample %d is %d, not %.0f\n", n, input_name[k], i, y, w[m/2] );
+		    break;
+		}
+	    }
+	    CHECK ( i == NSAMP );
+	}
+	printf ( "median of %d: exact\n", n );
+}
+
+/* ----------------------------------------- */
+/* EMA */
+
+/* We keep the state scaled up by 2^shift, so the only
+ * loss is the rounding on the way out, within a half,
+ * plus what that rounding feeds back, which stays under 1.
+ */
+static void
+test_ema ( int shift )
+{
+	struct dsp_ema ema;
+	double ref = 0.0;
+	double err, worst = 0.0;
+	int *x;
+	int i, k;
+	int y;
+
+	for ( k=0; k<NUM_INPUTS; k++ ) {
+	    x = input[k];
+	    dsp_ema_init ( &ema, shift );
+	    for ( i=0; i<NSAMP; i++ ) {
+		y = dsp_ema ( &ema, x[i] );
+		if ( i == 0 )
+		    ref = x[0];
+		else
+		    ref += (x[i] - ref) / (1 << shift);
+		err = absd ( y - ref );
+		if ( err > worst )
+		    worst = err;
+		if ( err > 1.0 ) {
+		    printf ( "ema %d, %s: sample %d is %d, not %.2f\n", shift, input_name[k], i, y, ref );
+		    break;
+		}
+	    }
+	    CHECK ( i == NSAMP );
+	}
+	printf ( "ema shift %d: worst error %.2f\n", shift, worst );
+}
+
+/* ----------------------------------------- */
+/* Timing */
+
+#define NTIME		(1 << 20)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define UNITS	"cycles"
+
+static unsigned long long
+now ( void )
+{
+	return __rdtsc ();
+}
+#else
+#define UNITS	"ns"
+
+static unsigned long long
+now ( void )
+{
+	struct timespec ts;
+
+	clock_gettime ( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+/* So the compiler can't throw the filter away */
+static volatile int sink;
+
+static void
+show_time ( char *what, unsigned long long t )
+{
+	printf ( "%-16s %6.1f %s/sample\n", what, (double) t / NTIME, UNITS );
+}
+
+static void
+time_filters ( void )
+{
+	struct dsp_avg avg;
+	struct dsp_cic cic;
+	struct dsp_median med;
+	struct dsp_ema ema;
+	unsigned long long t;
+	int *x = input[NOISE];
+	int i, y;
+
+	dsp_avg_init ( &avg, 4 );
+	t = now ();
+	for ( i=0; i<NTIME; i++ )
+	    sink = dsp_avg ( &avg, x[i & (NSAMP-1)] );
+	show_time ( "avg of 16", now () - t );
+
+	dsp_cic_init ( &cic, 2, 2 );
+	t = now ();
+	for ( i=0; i<NTIME; i++ )
+	    if ( dsp_cic ( &cic, x[i & (NSAMP-1)], &y ) )
+		sink = y;
+	show_time ( "cic 2 by 4", now () - t );
+
+	dsp_cic_init ( &cic, 3, 4 );
+	t = now ();
+	for ( i=0; i<NTIME; i++ )
+	    if ( dsp_cic ( &cic, x[i & (NSAMP-1)], &y ) )
+		sink = y;
+	show_time ( "cic 3 by 16", now () - t );
+
+	dsp_median_init ( &med, 5 );
+	t = now ();
+	for ( i=0; i<NTIME; i++ )
+	    sink = dsp_median ( &med, x[i & (NSAMP-1)] );
+	show_time ( "median of 5", now () - t );
+
+	dsp_median_init ( &med, 9 );
+	t = now ();
+	for ( i=0; i<NTIME; i++ )
+	    sink = dsp_median ( &med, x[i & (NSAMP-1)] );
+	show_time ( "median of 9", now () - t );
+
+	dsp_ema_init ( &ema, 4 );
+	t = now ();
+	for ( i=0; i<NTIME; i++ )
+	    sink = dsp_ema ( &ema, x[i & (NSAMP-1)] );
+	show_time ( "ema shift 4", now () - t );
+}
+
+int
+main ( int argc, char **argv )
+{
+	make_inputs ();
+
+	test_avg ( 0 );
+	test_avg ( 3 );
+	test_avg ( DSP_AVG_MAX_SHIFT );
+
+	test_cic ( 1, 2 );
+	test_cic ( 2, 2 );
+	test_cic ( 3, 4 );
+	test_cic ( DSP_CIC_MAX_ORDER, 5 );
+
+	test_median ( 1 );
+	test_median ( 5 );
+	test_median ( DSP_MEDIAN_MAX );
+
+	test_ema ( 1 );
+	test_ema ( 4 );
+	test_ema ( 8 );
+
+	time_filters ();
+
+	printf ( "%d checks, %d failed\n", ntest, nfail );
+	return nfail ? 1 : 0;
+}
+
+/* THE END */
@@ -0,0 +1,615 @@
+/* test.c
+ * Loopback test for adc_stream and adc_recv
+ *
+ *   make test
+ *
+ * We build adc_stream.c on the host with just enough of the SDK
+ * to run it.  The ADC gives the tick number (10 bits of it), so
+ * every sample says where it belongs.  We call the timer ISR once
+ * per tick and run the send task now and then, and espconn_send
+ * writes to a real socket, with adc_recv on the other end.
+ *
+ * espconn_send hangs onto the block like the SDK does, and only
+ * writes it to the socket (and calls the sent callback) some
+ * ticks later, so we see it if adc_stream touches the block
+ * before then.
+ *
+ * Along the way we are not connected for a while, stall the send
+ * task so the ISR has to drop samples, fail the send that carries
+ * that drop count, have one send take longer than a buffer takes
+ * to fill, and stall long enough that the lost count won't fit
+ * in 16 bits.  Then what adc_recv wrote has to have each sample
+ * we sent at the index of the tick it was taken on, 0xffff
+ * everywhere else, and one entry per sample interval.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#define HOST_TEST
+
+/* ----------------------------------------- */
+/* The SDK, what adc_stream.c uses of it */
+
+#define ICACHE_FLASH_ATTR
+
+typedef signed char sint8;
+
+#define BIT6		0x40
+#define BIT7		0x80
+
+#define APB_CLK_FREQ	80000000
+#define UART_CLK_FREQ	APB_CLK_FREQ
+
+#define FRC1_LOAD_ADDRESS	0x600
+#define FRC1_CTRL_ADDRESS	0x608
+#define RTC_REG_WRITE(a, v)	(void) (v)
+
+/* The ISR only runs when we call it, but this tells us
+ * if the timer was ever left masked.
+ */
+static int frc1_masked;
+
+#define ETS_FRC_TIMER1_INTR_ATTACH(f, a)
+#define TM1_EDGE_INT_ENABLE()
+#define ETS_FRC1_INTR_DISABLE()	frc1_masked = 1
+#define ETS_FRC1_INTR_ENABLE()	frc1_masked = 0
+
+#define USER_TASK_PRIO_0	0
+
+typedef struct {
+	unsigned int	sig;
+	unsigned int	par;
+} os_event_t;
+
+typedef void (*os_task_t) ( os_event_t * );
+
+typedef struct {
+	int		dummy;
+} os_timer_t;
+
+typedef struct {
+	int		local_port;
+	int		remote_port;
+	unsigned char	remote_ip[4];
+} esp_tcp;
+
+#define ESPCONN_TCP	0x10
+#define ESPCONN_NONE	0
+#define ESPCONN_ISCONN	-15
+
+struct espconn {
+	int		type;
+	int		state;
+	union {
+	    esp_tcp	*tcp;
+	} proto;
+};
+
+typedef void (*espconn_connect_callback) ( void * );
+typedef void (*espconn_reconnect_callback) ( void *, sint8 );
+typedef void (*espconn_sent_callback) ( void * );
+
+#define STATION_IF	0
+#define STATION_MODE	1
+
+#define EVENT_STAMODE_CONNECTED		0
+#define EVENT_STAMODE_DISCONNECTED	1
+#define EVENT_STAMODE_GOT_IP		3
+
+typedef struct {
+	int		event;
+} System_Event_t;
+
+struct ip_info {
+	struct {
+	    unsigned int	addr;
+	} ip;
+};
+
+struct station_config {
+	unsigned char	ssid[32];
+	unsigned char	password[64];
+};
+
+static char ssid[32] = "test";
+static char pass[64] = "test";
+
+#define os_sprintf	sprintf
+#define os_memset	memset
+#define os_memcpy	memcpy
+#define os_bzero(p, n)	memset ( p, 0, n )
+
+static int
+os_printf ( const char *fmt, ... )
+{
+	return 0;
+}
+
+static void uart_div_modify ( int uart, int div ) { }
+static char * system_get_sdk_version ( void ) { return "host"; }
+
+static void wifi_set_opmode ( int mode ) { }
+static void wifi_station_set_config ( struct station_config *c ) { }
+static void wifi_set_event_handler_cb ( void (*f) ( System_Event_t * ) ) { }
+
+static void
+wifi_get_ip_info ( int which, struct ip_info *ip )
+{
+	ip->ip.addr = 0x0100007f;
+}
+
+static void os_timer_disarm ( os_timer_t *t ) { }
+static void os_timer_setfn ( os_timer_t *t, void (*f) ( void * ), void *a ) { }
+static void os_timer_arm ( os_timer_t *t, int ms, int repeat ) { }
+
+/* The ADC reads the tick */
+static unsigned int tick;
+
+static unsigned int
+system_adc_read ( void )
+{
+	return tick & 0x3ff;
+}
+
+/* The task queue */
+#define QUEUE_MAX	16
+
+static os_task_t task_func;
+static os_event_t queue[QUEUE_MAX];
+static int q_head;
+static int q_tail;
+static int q_over;
+
+static void
+system_os_task ( os_task_t f, int prio, os_event_t *q, int len )
+{
+	task_func = f;
+}
+
+static int
+system_os_post ( int prio, unsigned int sig, unsigned int par )
+{
+	if ( q_tail - q_head >= QUEUE_MAX ) {
+	    q_over++;
+	    return 0;
+	}
+	queue[q_tail % QUEUE_MAX].sig = sig;
+	queue[q_tail % QUEUE_MAX].par = par;
+	q_tail++;
+	return 1;
+}
+
+/* The network, espconn_send is below */
+static espconn_connect_callback connect_cb;
+static espconn_sent_callback sent_cb;
+static int sock = -1;
+static int port;
+
+static int espconn_port ( void ) { return 4000; }
+
+static void
+espconn_regist_connectcb ( struct espconn *c, espconn_connect_callback f )
+{
+	connect_cb = f;
+}
+
+static void espconn_regist_disconcb ( struct espconn *c, espconn_connect_callback f ) { }
+static void espconn_regist_reconcb ( struct espconn *c, espconn_reconnect_callback f ) { }
+
+static void
+espconn_regist_sentcb ( struct espconn *c, espconn_sent_callback f )
+{
+	sent_cb = f;
+}
+
+/* We go to localhost, whatever the code asks for */
+static int
+espconn_connect ( struct espconn *c )
+{
+	struct sockaddr_in addr;
+
+	if ( sock >= 0 )
+	    return ESPCONN_ISCONN;
+
+	sock = socket ( AF_INET, SOCK_STREAM, 0 );
+	memset ( &addr, 0, sizeof(addr) );
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons ( port );
+	addr.sin_addr.s_addr = htonl ( INADDR_LOOPBACK );
+	if ( connect ( sock, (struct sockaddr *) &addr, sizeof(addr) ) < 0 ) {
+	    perror ( "connect" );
+	    exit ( 1 );
+	}
+
+	connect_cb ( c );
+	return 0;
+}
+
+static int espconn_send ( struct espconn *, unsigned char *, int );
+
+#include "adc_stream.c"
+
+/* ----------------------------------------- */
+
+static int ntest;
+static int nfail;
+
+#define CHECK(x)	check ( x, #x, __LINE__ )
+
+static void
+check ( int ok, char *what, int line )
+{
+	ntest++;
+	if ( ! ok ) {
+	    printf ( "FAIL line %d: %s\n", line, what );
+	    nfail++;
+	}
+}
+
+#define NUM_TICKS	105000
+
+/* The schedule, in ticks */
+#define T_GOT_IP	1300
+#define T_STALL		6000
+#define T_RESUME	8000
+#define T_FAIL		T_RESUME
+#define T_SLOW		12000
+#define T_BIG_STALL	20000
+#define T_BIG_RESUME	100000
+
+/* Run the send task this often */
+#define TASK_TICKS	8
+
+/* How long the SDK has a block, the slow one is longer
+ * than it takes to fill a buffer.
+ */
+#define SEND_TICKS	40
+#define SLOW_SEND_TICKS	1500
+
+/* Ticks of the samples in each buffer */
+static unsigned int buf_ticks[2][BUF_SAMPLES];
+static int nkept;
+
+/* The buffer the send task is working on */
+static unsigned int *cur_ticks;
+
+/* The block the SDK has */
+static unsigned char *flight_buf;
+static int flight_len;
+static unsigned char flight_copy[sizeof(block)];
+static unsigned int flight_ticks[BUF_SAMPLES];
+static unsigned int sent_at;
+static int slow_next;
+static int overlap;
+static int clobbered;
+
+static char delivered[NUM_TICKS];
+static int last_delivered = -1;
+
+static int nsent;
+static int nfailed;
+static int fail_next;
+static int bad_block;
+static int bad_header;
+static unsigned int last_seq;
+
+/* Unpack 4 samples from 5 bytes, the same as adc_recv */
+static void
+unpack ( unsigned char *b, unsigned int *v, int count )
+{
+	int i;
+
+	for ( i=0; i<count; i += 4 ) {
+	    v[i] = b[0] | ((b[1] & 0x03) << 8);
+	    v[i+1] = (b[1] >> 2) | ((b[2] & 0x0f) << 6);
+	    v[i+2] = (b[2] >> 4) | ((b[3] & 0x3f) << 4);
+	    v[i+3] = (b[3] >> 6) | (b[4] << 2);
+	    b += 5;
+	}
+}
+
+static int
+espconn_send ( struct espconn *c, unsigned char *buf, int len )
+{
+	struct block_header *hp = (struct block_header *) buf;
+	unsigned int v[BUF_SAMPLES];
+	int i;
+
+	if ( hp->magic != BLOCK_MAGIC || hp->count != BUF_SAMPLES || hp->interval != SAMPLE_US )
+	    bad_header++;
+	if ( nsent + nfailed && hp->seq != last_seq + 1 )
+	    bad_header++;
+	last_seq = hp->seq;
+
+	unpack ( buf + sizeof(struct block_header), v, BUF_SAMPLES );
+	for ( i=0; i<BUF_SAMPLES; i++ )
+	    if ( v[i] != (cur_ticks[i] & 0x3ff) )
+		bad_block++;
+
+	if ( fail_next ) {
+	    fail_next = 0;
+	    nfailed++;
+	    return -1;
+	}
+
+	/* The SDK says no to a second one before the sent callback */
+	if ( flight_buf ) {
+	    overlap++;
+	    return -1;
+	}
+
+	flight_buf = buf;
+	flight_len = len;
+	memcpy ( flight_copy, buf, len );
+	memcpy ( flight_ticks, cur_ticks, sizeof(flight_ticks) );
+	sent_at = tick + (slow_next ? SLOW_SEND_TICKS : SEND_TICKS);
+	slow_next = 0;
+	return 0;
+}
+
+/* The SDK is done with the block */
+static void
+sent ( void )
+{
+	int i;
+
+	if ( memcmp ( flight_buf, flight_copy, flight_len ) != 0 )
+	    clobbered++;
+
+	if ( write ( sock, flight_buf, flight_len ) != flight_len ) {
+	    perror ( "write" );
+	    exit ( 1 );
+	}
+
+	for ( i=0; i<BUF_SAMPLES; i++ )
+	    delivered[flight_ticks[i]] = 1;
+	last_delivered = flight_ticks[BUF_SAMPLES-1];
+	nsent++;
+
+	flight_buf = 0;
+	sent_cb ( &client_conn );
+}
+
+/* One queued event, and the next block of kept samples with it */
+static void
+run_task ( void )
+{
+	os_event_t e;
+
+	if ( q_head == q_tail )
+	    return;
+	e = queue[q_head % QUEUE_MAX];
+	q_head++;
+
+	cur_ticks = buf_ticks[e.par];
+	task_func ( &e );
+}
+
+static void
+got_ip ( void )
+{
+	System_Event_t e;
+
+	e.event = EVENT_STAMODE_GOT_IP;
+	wifi_event ( &e );
+}
+
+static void
+run ( void )
+{
+	int stalled;
+	esp_tcp *tp;
+
+	user_init ();
+
+	for ( tick=0; tick<NUM_TICKS; tick++ ) {
+	    if ( tick == T_GOT_IP ) {
+		got_ip ();
+		tp = client_conn.proto.tcp;
+		/* and again, as when the AP comes back */
+		got_ip ();
+		CHECK ( client_conn.proto.tcp == tp );
+		CHECK ( tp == &client_tcp );
+		CHECK ( connected );
+	    }
+	    if ( tick == T_FAIL )
+		fail_next = 1;
+	    if ( tick == T_SLOW )
+		slow_next = 1;
+	    if ( flight_buf && tick >= sent_at )
+		sent ();
+
+	    /* The ISR keeps this one unless it has nowhere to put it */
+	    if ( fill_count < BUF_SAMPLES ) {
+		buf_ticks[fill][fill_count] = tick;
+		nkept++;
+	    }
+	    hw_timer_isr ();
+
+	    stalled = (tick >= T_STALL && tick < T_RESUME) ||
+		(tick >= T_BIG_STALL && tick < T_BIG_RESUME);
+	    if ( ! stalled && tick % TASK_TICKS == 0 )
+		run_task ();
+	}
+
+	while ( q_head != q_tail || flight_buf ) {
+	    if ( flight_buf )
+		sent ();
+	    run_task ();
+	}
+}
+
+/* ----------------------------------------- */
+/* adc_recv */
+
+static int recv_pid;
+static FILE *recv_out;
+
+/* Wait for adc_recv to say something starting with this */
+static int
+recv_wait ( char *what )
+{
+	char line[200];
+
+	while ( fgets ( line, sizeof(line), recv_out ) )
+	    if ( strncmp ( line, what, strlen(what) ) == 0 )
+		return 1;
+	return 0;
+}
+
+static void
+recv_start ( char *file )
+{
+	char portbuf[16];
+	int fd[2];
+
+	port = 20000 + getpid () % 10000;
+	sprintf ( portbuf, "%d", port );
+	unlink ( file );
+
+	if ( pipe ( fd ) < 0 ) {
+	    perror ( "pipe" );
+	    exit ( 1 );
+	}
+
+	recv_pid = fork ();
+	if ( recv_pid == 0 ) {
+	    close ( fd[0] );
+	    dup2 ( fd[1], 1 );
+	    execlp ( "ruby", "ruby", "adc_recv", file, portbuf, (char *) 0 );
+	    perror ( "adc_recv" );
+	    exit ( 1 );
+	}
+	close ( fd[1] );
+	recv_out = fdopen ( fd[0], "r" );
+
+	if ( ! recv_wait ( "Listening" ) ) {
+	    printf ( "adc_recv did not start\n" );
+	    exit ( 1 );
+	}
+}
+
+static void
+recv_stop ( void )
+{
+	close ( sock );
+	CHECK ( recv_wait ( "Connection closed" ) );
+	kill ( recv_pid, SIGTERM );
+	waitpid ( recv_pid, NULL, 0 );
+	fclose ( recv_out );
+}
+
+/* ----------------------------------------- */
+
+static unsigned short got[NUM_TICKS + 1];
+
+static void
+check_file ( char *file )
+{
+	FILE *f;
+	int ngot;
+	int i, t;
+	int run, best;
+	int nlost, wrong;
+	unsigned int want;
+
+	f = fopen ( file, "r" );
+	if ( ! f ) {
+	    perror ( file );
+	    nfail++;
+	    return;
+	}
+	ngot = fread ( got, sizeof(got[0]), NUM_TICKS + 1, f );
+	fclose ( f );
+
+	/* One entry per sample interval, from tick 0 to the last one sent */
+	CHECK ( ngot == last_delivered + 1 );
+
+	/* The big stall is a gap that needs more than 16 bits */
+	best = run = 0;
+	for ( t=0; t<=last_delivered; t++ ) {
+	    if ( ! delivered[t] ) {
+		run++;
+		continue;
+	    }
+	    if ( run > best )
+		best = run;
+	    run = 0;
+	}
+	CHECK ( best > 0xffff );
+
+	/* Every sample at the index of its tick */
+	nlost = wrong = 0;
+	for ( i=0; i<ngot; i++ ) {
+	    want = delivered[i] ? i & 0x3ff : 0xffff;
+	    if ( got[i] != want ) {
+		if ( ! wrong )
+		    printf ( "sample %d is %04x, not %04x\n", i, got[i], want );
+		wrong++;
+	    }
+	    if ( got[i] == 0xffff )
+		nlost++;
+	}
+	CHECK ( wrong == 0 );
+	CHECK ( nlost + nsent * BUF_SAMPLES == ngot );
+
+	printf ( "%d samples in %d blocks, %d lost, %d in one gap\n",
+	    ngot, nsent, nlost, best );
+}
+
+int
+main ( int argc, char **argv )
+{
+	char file[64];
+	int i;
+
+	sprintf ( file, "/tmp/adc_test.%d", getpid () );
+
+	/* rather than hang if adc_recv goes quiet */
+	alarm ( 60 );
+
+	recv_start ( file );
+	run ();
+	recv_stop ();
+
+	CHECK ( frc1_masked == 0 );
+	CHECK ( q_over == 0 );
+	CHECK ( bad_block == 0 );
+	CHECK ( bad_header == 0 );
+	CHECK ( nfailed == 1 );
+	CHECK ( overlap == 0 );
+	CHECK ( clobbered == 0 );
+	CHECK ( ! sending && pending < 0 );
+
+	/* all but what is in the ISR's buffer went somewhere */
+	CHECK ( nkept == (nsent + nfailed + 2) * BUF_SAMPLES + fill_count );
+
+	/* the first two blocks went out before we had a connection */
+	CHECK ( ! delivered[0] && ! delivered[2 * BUF_SAMPLES - 1] );
+	CHECK ( delivered[2 * BUF_SAMPLES] );
+
+	/* the stall made the ISR drop some */
+	CHECK ( ! delivered[T_RESUME - 1] );
+
+	/* and so did the slow send */
+	for ( i=T_SLOW; i<T_SLOW + SLOW_SEND_TICKS && delivered[i]; i++ )
+	    ;
+	CHECK ( i < T_SLOW + SLOW_SEND_TICKS );
+
+	check_file ( file );
+	unlink ( file );
+
+	printf ( "%d checks, %d failed\n", ntest, nfail );
+	return nfail ? 1 : 0;
+}
+
+/* THE END */
@@ -0,0 +1,414 @@
+/* bench.c
+ * Host benchmark for the easygpio mask calls
+ *
+ *   make bench
+ *
+ * We build easygpio.c on the host against a fake register file.
+ * The GPIO, RTC and IO_MUX registers are an array here, and the
+ * set and clear registers do to GPIO_OUT and GPIO_ENABLE what the
+ * chip does.  GPIO_IN reads back GPIO_OUT, as if every pin were
+ * wired to itself.
+ *
+ * First we check that the mask calls leave the registers just as
+ * the one pin calls do.  Then we time both ways of doing the same
+ * job, in TSC cycles per operation on this machine (not the lx106),
+ * and count the register reads and writes per operation, which is
+ * what costs on the chip.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#define HOST_TEST
+
+/* ----------------------------------------- */
+/* The register file */
+
+#define REG_BASE	0x60000000
+#define NUM_REGS	0x400
+
+static uint32_t regs[NUM_REGS];
+static unsigned long nread;
+static unsigned long nwrite;
+
+#define PERIPHS_GPIO_BASEADDR		0x60000300
+#define GPIO_OUT_ADDRESS		0x00
+#define GPIO_OUT_W1TS_ADDRESS		0x04
+#define GPIO_OUT_W1TC_ADDRESS		0x08
+#define GPIO_ENABLE_ADDRESS		0x0c
+#define GPIO_ENABLE_W1TS_ADDRESS	0x10
+#define GPIO_ENABLE_W1TC_ADDRESS	0x14
+#define GPIO_IN_ADDRESS			0x18
+#define GPIO_STATUS_W1TC_ADDRESS	0x24
+
+#define RTC_GPIO_OUT		0x60000768
+#define RTC_GPIO_ENABLE		0x60000774
+#define RTC_GPIO_IN_DATA	0x6000078c
+#define RTC_GPIO_CONF		0x60000790
+#define PAD_XPD_DCDC_CONF	0x600007a0
+
+#define REG(a)	regs[((a) - REG_BASE) >> 2]
+
+static uint32_t
+reg_read ( uint32_t addr )
+{
+	nread++;
+	if ( addr == PERIPHS_GPIO_BASEADDR + GPIO_IN_ADDRESS )
+	    return REG(PERIPHS_GPIO_BASEADDR + GPIO_OUT_ADDRESS);
+	if ( addr == RTC_GPIO_IN_DATA )
+	    return REG(RTC_GPIO_OUT) & 1;
+	return REG(addr);
+}
+
+static void
+reg_write ( uint32_t addr, uint32_t val )
+{
+	nwrite++;
+	switch ( addr - PERIPHS_GPIO_BASEADDR ) {
+	    case GPIO_OUT_W1TS_ADDRESS:
+		REG(PERIPHS_GPIO_BASEADDR + GPIO_OUT_ADDRESS) |= val;
+		return;
+	    case GPIO_OUT_W1TC_ADDRESS:
+		REG(PERIPHS_GPIO_BASEADDR + GPIO_OUT_ADDRESS) &= ~val;
+		return;
+	    case GPIO_ENABLE_W1TS_ADDRESS:
+		REG(PERIPHS_GPIO_BASEADDR + GPIO_ENABLE_ADDRESS) |= val;
+		return;
+	    case GPIO_ENABLE_W1TC_ADDRESS:
+		REG(PERIPHS_GPIO_BASEADDR + GPIO_ENABLE_ADDRESS) &= ~val;
+		return;
+	}
+	REG(addr) = val;
+}
+
+/* ----------------------------------------- */
+/* The SDK, what easygpio.c uses of it */
+
+#define ICACHE_FLASH_ATTR
+
+#define BIT(n)		(1UL << (n))
+#define BIT16		0x10000
+
+#define READ_PERI_REG(a)	reg_read ( a )
+#define WRITE_PERI_REG(a, v)	reg_write ( a, v )
+#define SET_PERI_REG_MASK(a, m)		WRITE_PERI_REG ( a, READ_PERI_REG ( a ) | (m) )
+#define CLEAR_PERI_REG_MASK(a, m)	WRITE_PERI_REG ( a, READ_PERI_REG ( a ) & ~(m) )
+
+#define GPIO_REG_READ(r)	READ_PERI_REG ( PERIPHS_GPIO_BASEADDR + (r) )
+#define GPIO_REG_WRITE(r, v)	WRITE_PERI_REG ( PERIPHS_GPIO_BASEADDR + (r), v )
+
+#define PERIPHS_IO_MUX_MTDI_U		0x60000804
+#define PERIPHS_IO_MUX_MTCK_U		0x60000808
+#define PERIPHS_IO_MUX_MTMS_U		0x6000080c
+#define PERIPHS_IO_MUX_MTDO_U		0x60000810
+#define PERIPHS_IO_MUX_U0RXD_U		0x60000814
+#define PERIPHS_IO_MUX_U0TXD_U		0x60000818
+#define PERIPHS_IO_MUX_SD_DATA2_U	0x60000828
+#define PERIPHS_IO_MUX_SD_DATA3_U	0x6000082c
+#define PERIPHS_IO_MUX_GPIO0_U		0x60000834
+#define PERIPHS_IO_MUX_GPIO2_U		0x60000838
+#define PERIPHS_IO_MUX_GPIO4_U		0x6000083c
+#define PERIPHS_IO_MUX_GPIO5_U		0x60000840
+
+#define FUNC_GPIO0	0
+#define FUNC_GPIO1	3
+#define FUNC_GPIO2	0
+#define FUNC_GPIO3	3
+#define FUNC_GPIO4	0
+#define FUNC_GPIO5	0
+#define FUNC_GPIO9	3
+#define FUNC_GPIO10	3
+#define FUNC_GPIO12	3
+#define FUNC_GPIO13	3
+#define FUNC_GPIO14	3
+#define FUNC_GPIO15	3
+
+#define PERIPHS_IO_MUX_FUNC	0x13
+#define PERIPHS_IO_MUX_FUNC_S	4
+#define PERIPHS_IO_MUX_PULLUP	BIT7
+#define BIT7			0x80
+#define BIT6			0x40
+
+#define PIN_FUNC_SELECT(p, f)	WRITE_PERI_REG ( p, (READ_PERI_REG ( p ) & \
+	~(PERIPHS_IO_MUX_FUNC << PERIPHS_IO_MUX_FUNC_S)) | \
+	((((f) & 4) << 2) | ((f) & 3)) << PERIPHS_IO_MUX_FUNC_S )
+#define PIN_PULLUP_DIS(p)	CLEAR_PERI_REG_MASK ( p, PERIPHS_IO_MUX_PULLUP )
+#define PIN_PULLUP_EN(p)	SET_PERI_REG_MASK ( p, PERIPHS_IO_MUX_PULLUP )
+
+/* The ROM routine behind GPIO_OUTPUT_SET and friends */
+static void
+gpio_output_set ( uint32_t set, uint32_t clr, uint32_t en, uint32_t dis )
+{
+	GPIO_REG_WRITE ( GPIO_OUT_W1TS_ADDRESS, set );
+	GPIO_REG_WRITE ( GPIO_OUT_W1TC_ADDRESS, clr );
+	GPIO_REG_WRITE ( GPIO_ENABLE_W1TS_ADDRESS, en );
+	GPIO_REG_WRITE ( GPIO_ENABLE_W1TC_ADDRESS, dis );
+}
+
+static uint32_t
+gpio_input_get ( void )
+{
+	return GPIO_REG_READ ( GPIO_IN_ADDRESS );
+}
+
+#define GPIO_ID_PIN(n)		(n)
+#define GPIO_OUTPUT_SET(n, v)	gpio_output_set ( (v) << (n), ((~(v)) & 1) << (n), 1 << (n), 0 )
+#define GPIO_DIS_OUTPUT(n)	gpio_output_set ( 0, 0, 0, 1 << (n) )
+#define GPIO_INPUT_GET(n)	((gpio_input_get () >> (n)) & 1)
+
+/* Only the interrupt calls use these, we don't */
+#define GPIO_PIN_ADDR(n)		(0x28 + (n) * 4)
+#define GPIO_PIN_INT_TYPE_SET(x)	((x) << 7)
+#define GPIO_PIN_PAD_DRIVER_SET(x)	((x) << 2)
+#define GPIO_PIN_SOURCE_SET(x)		(x)
+#define GPIO_PIN_INTR_DISABLE		0
+#define GPIO_PAD_DRIVER_DISABLE		0
+#define GPIO_AS_PIN_SOURCE		0
+#define ETS_GPIO_INTR_ATTACH(f, a)
+#define ETS_GPIO_INTR_DISABLE()
+#define ETS_GPIO_INTR_ENABLE()
+
+static void gpio_register_set ( uint32_t reg, uint32_t val ) { }
+static void gpio_pin_intr_state_set ( uint32_t pin, int state ) { }
+
+static int
+os_printf ( const char *fmt, ... )
+{
+	return 0;
+}
+
+#include "easygpio.c"
+
+/* ----------------------------------------- */
+
+static int ntest;
+static int nfail;
+
+#define CHECK(x)	check ( x, #x, __LINE__ )
+
+static void
+check ( int ok, char *what, int line )
+{
+	ntest++;
+	if ( ! ok ) {
+	    printf ( "FAIL line %d: %s\n", line, what );
+	    nfail++;
+	}
+}
+
+/* The pins of an imaginary parallel bus, GPIO16 on the end */
+static int pins[] = { 4, 5, 12, 13, 14, 16 };
+
+#define NPINS		(sizeof(pins) / sizeof(pins[0]))
+#define PINS_MASK	(BIT(4) | BIT(5) | BIT(12) | BIT(13) | BIT(14) | BIT16)
+
+static uint32_t
+gpio_out ( void )
+{
+	return REG(PERIPHS_GPIO_BASEADDR + GPIO_OUT_ADDRESS) | (REG(RTC_GPIO_OUT) & 1) << 16;
+}
+
+/* Junk in every register, and the same junk every time */
+static void
+scramble ( void )
+{
+	int i;
+
+	for ( i=0; i<NUM_REGS; i++ )
+	    regs[i] = 0x9e3779b9 * (i + 1);
+}
+
+/* The same result both ways, one pin at a time or all at once */
+static void
+test_same ( void )
+{
+	uint32_t saved[NUM_REGS];
+	uint32_t value;
+	uint32_t want;
+	int i, k;
+
+	/* Setup */
+	scramble ();
+	for ( i=0; i<NPINS; i++ )
+	    easygpio_pinMode ( pins[i], EASYGPIO_PULLUP, EASYGPIO_OUTPUT );
+	memcpy ( saved, regs, sizeof(regs) );
+
+	scramble ();
+	CHECK ( easygpio_configMask ( PINS_MASK, EASYGPIO_PULLUP, EASYGPIO_OUTPUT ) );
+	CHECK ( memcmp ( saved, regs, sizeof(regs) ) == 0 );
+
+	scramble ();
+	for ( i=0; i<NPINS; i++ )
+	    easygpio_pinMode ( pins[i], EASYGPIO_NOPULL, EASYGPIO_INPUT );
+	memcpy ( saved, regs, sizeof(regs) );
+
+	scramble ();
+	CHECK ( easygpio_configMask ( PINS_MASK, EASYGPIO_NOPULL, EASYGPIO_INPUT ) );
+	CHECK ( memcmp ( saved, regs, sizeof(regs) ) == 0 );
+
+	/* Not a GPIO, nothing touched */
+	scramble ();
+	memcpy ( saved, regs, sizeof(regs) );
+	CHECK ( ! easygpio_configMask ( BIT(4) | BIT(7), EASYGPIO_NOPULL, EASYGPIO_OUTPUT ) );
+	CHECK ( memcmp ( saved, regs, sizeof(regs) ) == 0 );
+
+	/* Writing and reading, every value on the bus */
+	for ( k=0; k < 1 << NPINS; k++ ) {
+	    value = 0;
+	    for ( i=0; i<NPINS; i++ )
+		if ( k & (1 << i) )
+		    value |= BIT(pins[i]);
+
+	    scramble ();
+	    for ( i=0; i<NPINS; i++ )
+		easygpio_outputSet ( pins[i], (value >> pins[i]) & 1 );
+	    want = gpio_out ();
+
+	    scramble ();
+	    easygpio_writeMask ( PINS_MASK, value );
+	    if ( gpio_out () != want )
+		break;
+
+	    /* pins not in the mask stay put */
+	    if ( ((gpio_out () ^ (0x9e3779b9 * 0xc1)) & ~PINS_MASK & 0xffff) != 0 )
+		break;
+
+	    scramble ();
+	    easygpio_setClearMask ( value, PINS_MASK & ~value );
+	    if ( gpio_out () != want )
+		break;
+
+	    want = 0;
+	    for ( i=0; i<NPINS; i++ )
+		want |= easygpio_inputGet ( pins[i] ) << pins[i];
+	    if ( easygpio_readMask ( PINS_MASK ) != want )
+		break;
+	}
+	CHECK ( k == 1 << NPINS );
+
+	/* GPIO 0-15 never read GPIO_OUT back, so an ISR can't be undone */
+	nread = 0;
+	easygpio_writeMask ( PINS_MASK & ~BIT16, 0x1234 );
+	easygpio_setClearMask ( BIT(4), BIT(5) );
+	CHECK ( nread == 0 );
+}
+
+/* ----------------------------------------- */
+/* Timing */
+
+#define NTIME		(1 << 20)
+
+#if defined(__x86_64__) || defined(__i386__)
+#define UNITS	"cycles"
+
+static unsigned long long
+now ( void )
+{
+	return __rdtsc ();
+}
+#else
+#define UNITS	"ns"
+
+static unsigned long long
+now ( void )
+{
+	struct timespec ts;
+
+	clock_gettime ( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+static unsigned long long t0;
+
+static void
+start ( void )
+{
+	nread = nwrite = 0;
+	t0 = now ();
+}
+
+static void
+show ( char *what, int n )
+{
+	unsigned long long t = now () - t0;
+
+	printf ( "%-24s %7.1f %s/op %5.1f reads %5.1f writes\n", what,
+	    (double) t / n, UNITS, (double) nread / n, (double) nwrite / n );
+}
+
+static volatile uint32_t sink;
+
+static void
+bench ( void )
+{
+	uint32_t value;
+	int i, n;
+
+	printf ( "%d pins, GPIO16 among them\n", (int) NPINS );
+
+	start ();
+	for ( n=0; n<NTIME; n++ ) {
+	    value = n * 0x2f;
+	    for ( i=0; i<NPINS; i++ )
+		easygpio_outputSet ( pins[i], (value >> i) & 1 );
+	}
+	show ( "outputSet per pin", NTIME );
+
+	start ();
+	for ( n=0; n<NTIME; n++ )
+	    easygpio_writeMask ( PINS_MASK, n * 0x2f );
+	show ( "writeMask", NTIME );
+
+	start ();
+	for ( n=0; n<NTIME; n++ ) {
+	    value = n * 0x2f;
+	    easygpio_setClearMask ( value & PINS_MASK, ~value & PINS_MASK );
+	}
+	show ( "setClearMask", NTIME );
+
+	start ();
+	for ( n=0; n<NTIME; n++ ) {
+	    value = 0;
+	    for ( i=0; i<NPINS; i++ )
+		value |= easygpio_inputGet ( pins[i] ) << i;
+	    sink = value;
+	}
+	show ( "inputGet per pin", NTIME );
+
+	start ();
+	for ( n=0; n<NTIME; n++ )
+	    sink = easygpio_readMask ( PINS_MASK );
+	show ( "readMask", NTIME );
+
+	start ();
+	for ( n=0; n<NTIME/16; n++ )
+	    for ( i=0; i<NPINS; i++ )
+		easygpio_pinMode ( pins[i], EASYGPIO_PULLUP, EASYGPIO_OUTPUT );
+	show ( "pinMode per pin", NTIME/16 );
+
+	start ();
+	for ( n=0; n<NTIME/16; n++ )
+	    easygpio_configMask ( PINS_MASK, EASYGPIO_PULLUP, EASYGPIO_OUTPUT );
+	show ( "configMask", NTIME/16 );
+}
+
+int
+main ( int argc, char **argv )
+{
+	test_same ();
+	bench ();
+
+	printf ( "%d checks, %d failed\n", ntest, nfail );
+	return nfail ? 1 : 0;
+}
+
+/* THE END */
@@ -30,9 +30,12 @@
 */
 
 #include "easygpio.h"
+/* bench.c brings its own */
+#ifndef HOST_TEST
 #include "gpio.h"
 #include "osapi.h"
 #include "ets_sys.h"
+#endif
 
 #define TJT
 #ifdef TJT
@@ -369,3 +372,120 @@ void easygpio_outputEnable(uint8_t gpio_pin, uint8_t value) {
     GPIO_OUTPUT_SET(GPIO_ID_PIN(gpio_pin), value);
   }
 }
+
+/*
+ * Mask based versions of the above.
+ * The per pin switch in easygpio_getGPIONameFunc() is fine for setup,
+ * but these are meant for drivers that change several pins at once.
+ */
+
+#define EASYGPIO_NOPIN  0
+
+/* Pins that actually exist as GPIO (no 6, 7, 8 or 11, those are the flash) */
+#define EASYGPIO_VALID_MASK 0x1f63fUL
+
+static const uint32_t easygpio_mux[16] = {
+  PERIPHS_IO_MUX_GPIO0_U,
+  PERIPHS_IO_MUX_U0TXD_U,
+  PERIPHS_IO_MUX_GPIO2_U,
+  PERIPHS_IO_MUX_U0RXD_U,
+  PERIPHS_IO_MUX_GPIO4_U,
+  PERIPHS_IO_MUX_GPIO5_U,
+  EASYGPIO_NOPIN,
+  EASYGPIO_NOPIN,
+  EASYGPIO_NOPIN,
+  PERIPHS_IO_MUX_SD_DATA2_U,
+  PERIPHS_IO_MUX_SD_DATA3_U,
+  EASYGPIO_NOPIN,
+  PERIPHS_IO_MUX_MTDI_U,
+  PERIPHS_IO_MUX_MTCK_U,
+  PERIPHS_IO_MUX_MTMS_U,
+  PERIPHS_IO_MUX_MTDO_U
+};
+
+static const uint8_t easygpio_func[16] = {
+  FUNC_GPIO0, FUNC_GPIO1, FUNC_GPIO2, FUNC_GPIO3,
+  FUNC_GPIO4, FUNC_GPIO5, 0, 0,
+  0, FUNC_GPIO9, FUNC_GPIO10, 0,
+  FUNC_GPIO12, FUNC_GPIO13, FUNC_GPIO14, FUNC_GPIO15
+};
+
+/**
+ * Configures every pin in 'gpioMask' at once.
+ */
+bool ICACHE_FLASH_ATTR
+easygpio_configMask(uint32_t gpioMask, EasyGPIO_PullStatus pullStatus, EasyGPIO_PinMode pinMode) {
+  uint32_t lowMask = gpioMask & 0xffffUL;
+  uint8_t i;
+
+  if (gpioMask & ~EASYGPIO_VALID_MASK) {
+    os_printf("easygpio_configMask Error: mask 0x%x holds pins that are not GPIO\n", gpioMask);
+    return false;
+  }
+
+  for (i=0; i<16; i++) {
+    if (lowMask & BIT(i)) {
+      PIN_FUNC_SELECT(easygpio_mux[i], easygpio_func[i]);
+      easygpio_setupPullsByName(easygpio_mux[i], pullStatus);
+    }
+  }
+
+  if (EASYGPIO_OUTPUT == pinMode) {
+    GPIO_REG_WRITE(GPIO_ENABLE_W1TS_ADDRESS, lowMask);
+  } else {
+    GPIO_REG_WRITE(GPIO_ENABLE_W1TC_ADDRESS, lowMask);
+  }
+
+  if (gpioMask & BIT16) {
+    if (EASYGPIO_OUTPUT == pinMode) {
+      gpio16_output_conf();
+    } else {
+      gpio16_input_conf();
+    }
+  }
+  return true;
+}
+
+/**
+ * Sets the pins in 'gpioMask' to the matching bits of 'value'.
+ */
+void
+easygpio_writeMask(uint32_t gpioMask, uint32_t value) {
+  uint32_t lowMask = gpioMask & 0xffffUL;
+
+  if (lowMask) {
+    GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, value & lowMask);
+    GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, ~value & lowMask);
+  }
+  if (gpioMask & BIT16) {
+    WRITE_PERI_REG(RTC_GPIO_OUT,
+                   (READ_PERI_REG(RTC_GPIO_OUT) & 0xfffffffeUL) | ((value >> 16) & 0x1UL));
+  }
+}
+
+/**
+ * Drives 'setMask' high and 'clearMask' low.
+ */
+void
+easygpio_setClearMask(uint32_t setMask, uint32_t clearMask) {
+  GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, setMask & 0xffffUL);
+  GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, clearMask & 0xffffUL);
+
+  if ((setMask | clearMask) & BIT16) {
+    WRITE_PERI_REG(RTC_GPIO_OUT,
+                   (READ_PERI_REG(RTC_GPIO_OUT) & 0xfffffffeUL) | ((setMask >> 16) & 0x1UL));
+  }
+}
+
+/**
+ * Returns the input value of all pins in 'gpioMask'.
+ */
+uint32_t
+easygpio_readMask(uint32_t gpioMask) {
+  uint32_t value = GPIO_REG_READ(GPIO_IN_ADDRESS) & gpioMask & 0xffffUL;
+
+  if (gpioMask & BIT16) {
+    value |= (READ_PERI_REG(RTC_GPIO_IN_DATA) & 1UL) << 16;
+  }
+  return value;
+}
@@ -32,7 +32,9 @@
 #ifndef EASYGPIO_INCLUDE_EASYGPIO_EASYGPIO_H_
 #define EASYGPIO_INCLUDE_EASYGPIO_EASYGPIO_H_
 
+#ifndef HOST_TEST
 #include "c_types.h"
+#endif
 
 typedef enum {
   EASYGPIO_INPUT=0,
@@ -116,4 +118,33 @@ void easygpio_outputDisable(uint8_t gpio_pin);
  */
 void easygpio_outputEnable(uint8_t gpio_pin, uint8_t value);
 
+/**
+ * Configures every pin in 'gpioMask' (BIT0..BIT16) at once.
+ * Pin mux and function come from precomputed tables, and the output
+ * enables for GPIO 0-15 are changed with a single register write.
+ * Returns false (and touches nothing) if the mask holds a pin that is not a GPIO.
+ */
+bool easygpio_configMask(uint32_t gpioMask, EasyGPIO_PullStatus pullStatus, EasyGPIO_PinMode pinMode);
+
+/**
+ * Sets the pins in 'gpioMask' to the matching bits of 'value'. Handles GPIO 0-16.
+ * GPIO 0-15 go through the write-one-to-set and write-one-to-clear
+ * registers, so there is no read-modify-write to race against an ISR.
+ * GPIO16 is done through the RTC register in the same call.
+ */
+void easygpio_writeMask(uint32_t gpioMask, uint32_t value);
+
+/**
+ * Drives the pins in 'setMask' high and those in 'clearMask' low, using the
+ * write-one-to-set and write-one-to-clear registers. Handles GPIO 0-16.
+ * No read-modify-write, so this is safe to mix with ISRs.
+ */
+void easygpio_setClearMask(uint32_t setMask, uint32_t clearMask);
+
+/**
+ * Returns the input value of all pins in 'gpioMask' in one read
+ * (plus one more for GPIO16, if it is in the mask).
+ */
+uint32_t easygpio_readMask(uint32_t gpioMask);
+
 #endif /* EASYGPIO_INCLUDE_EASYGPIO_EASYGPIO_H_ */
@@ -0,0 +1,169 @@
+/* Try out timers on the ESP8266
+ * crank out a waveform to try my new dso Nano
+ *
+ * This does the same burst of pulses as pulse2.c,
+ *  but from a table (see wave.c) played by the
+ *  hardware timer, so we get microsecond edges
+ *  rather than os_timer milliseconds.
+ *
+ * After a while we switch to a different table
+ *  that drives two pins at once, to show that
+ *  the switch happens cleanly at the end of a burst.
+ */
+#include "ets_sys.h"
+#include "osapi.h"
+#include "os_type.h"
+#include "gpio.h"
+
+#include "user_interface.h"
+
+#include "wave.h"
+
+#define PIN	5	/* D1 */
+#define PIN2	4	/* D2 */
+
+#define PIN_BIT		(1<<PIN)
+#define PIN2_BIT	(1<<PIN2)
+
+/* Timer clock */
+#define DIV_BY_1     0
+#define DIV_BY_16    4
+#define DIV_BY_256   8
+
+#define TM_LEVEL_INT  1   // level interrupt
+#define TM_EDGE_INT   0   // edge interrupt
+
+#define FRC1_ENABLE_TIMER  BIT7
+#define FRC1_AUTO_LOAD  BIT6
+
+/* 80 Mhz / 16 */
+#define TICKS_PER_US	5
+
+/* Just like pulse2 (HIGH_COUNT 1, LOW_COUNT 2, IDLE_COUNT 20)
+ * but in microseconds rather than milliseconds.
+ */
+static struct wave_seg burst[] = {
+    { PIN_BIT,	10 },
+    { 0,	20 },
+    { PIN_BIT,	10 },
+    { 0,	20 },
+    { 0,	200 },
+};
+
+/* A clock on one pin and a strobe on the other */
+static struct wave_seg clock_strobe[] = {
+    { PIN_BIT | PIN2_BIT,	5 },
+    { 0,			5 },
+    { PIN_BIT,			5 },
+    { 0,			5 },
+    { PIN_BIT,			5 },
+    { 0,			5 },
+    { PIN_BIT,			5 },
+    { 0,			50 },
+};
+
+#define MAX_STEPS	16
+
+static struct wave_step burst_steps[MAX_STEPS];
+static struct wave_step cs_steps[MAX_STEPS];
+
+static struct wave_prog burst_prog;
+static struct wave_prog cs_prog;
+
+static struct wave_player player;
+
+/* All the ISR does is ask wave_next() what to do,
+ * reload the timer first (so the time it takes us
+ * to poke the pins doesn't add up), then poke the pins.
+ */
+void
+hw_timer_isr ( void )
+{
+    unsigned int set, clr;
+    unsigned int ticks;
+
+    ticks = wave_next ( &player, &set, &clr );
+    if ( ticks )
+	RTC_REG_WRITE(FRC1_LOAD_ADDRESS, ticks);
+    else
+	RTC_REG_WRITE(FRC1_CTRL_ADDRESS, DIV_BY_16 | TM_EDGE_INT);
+
+    GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, set);
+    GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, clr);
+}
+
+static void
+hw_timer_setup ( void )
+{
+    /* No auto load, every step has its own count */
+    RTC_REG_WRITE(FRC1_CTRL_ADDRESS, DIV_BY_16 | TM_EDGE_INT);
+
+    ETS_FRC_TIMER1_INTR_ATTACH(hw_timer_isr, NULL);
+
+    TM1_EDGE_INT_ENABLE();
+    ETS_FRC1_INTR_ENABLE();
+}
+
+/* Hand a new program to the player.
+ * If it is running, the ISR picks it up at the end
+ * of the current pass.  If not, we get it going.
+ */
+void
+wave_play ( struct wave_prog *pp )
+{
+    ETS_FRC1_INTR_DISABLE();
+
+    player.pending = pp;
+    if ( ! player.running ) {
+	player.running = 1;
+	/* fire almost right away */
+	RTC_REG_WRITE(FRC1_CTRL_ADDRESS, DIV_BY_16 | FRC1_ENABLE_TIMER | TM_EDGE_INT);
+	RTC_REG_WRITE(FRC1_LOAD_ADDRESS, WAVE_MIN_TICKS);
+    }
+
+    ETS_FRC1_INTR_ENABLE();
+}
+
+static os_timer_t timer1;
+
+#define SWITCH_DELAY	5000
+
+void
+timer_func1 ( void *arg )
+{
+    os_printf ( "switching waveforms\n" );
+    wave_play ( &cs_prog );
+}
+
+void user_init()
+{
+    uart_div_modify(0, UART_CLK_FREQ / 115200);
+
+    wifi_set_opmode(NULL_MODE);
+
+    os_printf("\n");
+
+    pin_output ( PIN );
+    pin_output ( PIN2 );
+    pin_low ( PIN );
+    pin_low ( PIN2 );
+
+    if ( wave_compile ( &burst_prog, burst_steps, MAX_STEPS, burst,
+	    sizeof(burst) / sizeof(struct wave_seg), PIN_BIT, TICKS_PER_US, 1 ) < 0 )
+	os_printf ( "burst does not fit\n" );
+    if ( wave_compile ( &cs_prog, cs_steps, MAX_STEPS, clock_strobe,
+	    sizeof(clock_strobe) / sizeof(struct wave_seg), PIN_BIT | PIN2_BIT, TICKS_PER_US, 1 ) < 0 )
+	os_printf ( "clock_strobe does not fit\n" );
+
+    wave_player_init ( &player );
+    hw_timer_setup ();
+    wave_play ( &burst_prog );
+
+    os_timer_disarm ( &timer1 );
+    os_timer_setfn ( &timer1, timer_func1, NULL );
+    os_timer_arm ( &timer1, SWITCH_DELAY, 0 );
+
+    os_printf("running !!\n" );
+}
+
+/* THE END */
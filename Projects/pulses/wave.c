@@ -0,0 +1,142 @@
+/* wave.c
+ *
+ * Table driven waveform generator.
+ *
+ * pulse1.c and pulse2.c crank out pulses by counting
+ *  os_timer ticks with hand written state machines.
+ * Here you describe the waveform as a table of
+ *  (pins high, duration) segments, "compile" it once
+ *  into set and clear masks plus timer loads, and
+ *  then the FRC1 ISR just plays it back, one segment
+ *  per interrupt, with direct writes to the GPIO set
+ *  and clear registers (no read back of GPIO_OUT).
+ *
+ * Any number of pins (GPIO 0-15) can change on the same edge.
+ *
+ * A new table handed to the player while it is running
+ *  is picked up at the end of the current pass through
+ *  the old one, so there is never a partial waveform.
+ *
+ * Nothing in here touches the hardware, which is the
+ *  job of the ISR (see pulse3.c), so all of this can
+ *  be run on a linux box against a fake clock.
+ */
+
+#include "wave.h"
+
+/* Turn a table of segments into steps.
+ *
+ * pins is the set of pins this waveform drives.
+ * ticks_per_us is 5 for FRC1 with an 80 Mhz APB clock
+ *  divided by 16.
+ *
+ * Adjacent segments with the same pins high are merged,
+ *  segments too long for the timer are split, and zero
+ *  length segments are dropped.
+ *
+ * Returns the number of steps, or -1 if they won't fit.
+ */
+int
+wave_compile ( struct wave_prog *pp, struct wave_step *step, int max,
+	struct wave_seg *seg, int nseg, unsigned int pins,
+	unsigned int ticks_per_us, int loop )
+{
+	int n = 0;
+	int i;
+	unsigned int high;
+	unsigned int ticks;
+	unsigned int chunk;
+
+	for ( i=0; i<nseg; i++ ) {
+	    high = seg[i].high & pins;
+	    ticks = seg[i].us * ticks_per_us;
+	    if ( ticks == 0 )
+		continue;
+
+	    /* Same pins as the last step, just make it longer */
+	    if ( n > 0 && step[n-1].set == high &&
+		    step[n-1].ticks + ticks <= WAVE_MAX_TICKS ) {
+		step[n-1].ticks += ticks;
+		continue;
+	    }
+
+	    while ( ticks ) {
+		chunk = ticks;
+		if ( chunk > WAVE_MAX_TICKS )
+		    chunk = WAVE_MAX_TICKS;
+		/* don't leave a runt we can't time */
+		if ( ticks - chunk > 0 && ticks - chunk < WAVE_MIN_TICKS )
+		    chunk -= WAVE_MIN_TICKS;
+		if ( chunk < WAVE_MIN_TICKS )
+		    chunk = WAVE_MIN_TICKS;
+
+		if ( n >= max )
+		    return -1;
+		step[n].set = high;
+		step[n].clr = pins & ~high;
+		step[n].ticks = chunk;
+		n++;
+
+		if ( chunk >= ticks )
+		    break;
+		ticks -= chunk;
+	    }
+	}
+
+	pp->step = step;
+	pp->nstep = n;
+	pp->loop = loop;
+
+	return n;
+}
+
+void
+wave_player_init ( struct wave_player *wp )
+{
+	wp->cur = 0;
+	wp->pending = 0;
+	wp->index = 0;
+	wp->running = 0;
+}
+
+/* Called from the timer ISR (and once to get things going).
+ * Gives the pins to set and clear right now, and returns
+ *  the number of ticks until we should be called again.
+ * Zero means we are done and the timer can stop.
+ */
+unsigned int
+wave_next ( struct wave_player *wp, unsigned int *set, unsigned int *clr )
+{
+	struct wave_step *sp;
+
+	if ( wp->cur == 0 || wp->index >= wp->cur->nstep ) {
+	    /* End of a pass, this is the only place we switch tables */
+	    if ( wp->pending ) {
+		wp->cur = wp->pending;
+		wp->pending = 0;
+		wp->index = 0;
+	    } else if ( wp->cur && wp->cur->loop ) {
+		wp->index = 0;
+	    } else {
+		wp->running = 0;
+		*set = 0;
+		*clr = 0;
+		return 0;
+	    }
+	    if ( wp->cur->nstep < 1 ) {
+		wp->running = 0;
+		*set = 0;
+		*clr = 0;
+		return 0;
+	    }
+	}
+
+	sp = &wp->cur->step[wp->index++];
+	*set = sp->set;
+	*clr = sp->clr;
+	wp->running = 1;
+
+	return sp->ticks;
+}
+
+/* THE END */
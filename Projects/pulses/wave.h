@@ -0,0 +1,53 @@
+/* wave.h
+ *
+ * Table driven waveform generator.
+ * See wave.c
+ */
+
+#ifndef _WAVE_H_
+#define _WAVE_H_
+
+/* What the user gives us.
+ * "high" is the set of pins (as a bit mask) that should
+ *  be high for this segment, any other pin in the
+ *  table's pin set is low.
+ */
+struct wave_seg {
+	unsigned int	high;
+	unsigned int	us;
+};
+
+/* What we actually play from the ISR */
+struct wave_step {
+	unsigned int	set;
+	unsigned int	clr;
+	unsigned int	ticks;
+};
+
+struct wave_prog {
+	struct wave_step	*step;
+	int			nstep;
+	int			loop;
+};
+
+/* Playback state, owned by the ISR once started */
+struct wave_player {
+	struct wave_prog	*cur;
+	struct wave_prog	* volatile pending;
+	int			index;
+	volatile int		running;
+};
+
+/* FRC1 has a 23 bit load register */
+#define WAVE_MAX_TICKS	0x7fffff
+
+/* We can't get in and out of the ISR faster than this */
+#define WAVE_MIN_TICKS	10
+
+int wave_compile ( struct wave_prog *, struct wave_step *, int,
+		struct wave_seg *, int, unsigned int, unsigned int, int );
+
+void wave_player_init ( struct wave_player * );
+unsigned int wave_next ( struct wave_player *, unsigned int *, unsigned int * );
+
+#endif /* _WAVE_H_ */
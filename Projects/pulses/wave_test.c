@@ -0,0 +1,335 @@
+/* wave_test.c
+ * Host test for the wave.c scheduler
+ *
+ *   make test
+ *
+ * We play the part of pulse3.c's ISR against a virtual clock.
+ * Each call to wave_next() happens at "now", its set and clear
+ * go to a fake GPIO_OUT right then, and the ticks it returns
+ * move the clock to the next call.  We write down every edge
+ * on every pin and check them against where the table says
+ * they belong.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "wave.h"
+
+static int ntest;
+static int nfail;
+
+#define CHECK(x)	check ( x, #x, __LINE__ )
+
+static void
+check ( int ok, char *what, int line )
+{
+	ntest++;
+	if ( ! ok ) {
+	    printf ( "FAIL line %d: %s\n", line, what );
+	    nfail++;
+	}
+}
+
+/* FRC1 at 80 Mhz / 16, like pulse3.c */
+#define TICKS_PER_US	5
+
+#define PIN	5
+#define PIN2	4
+
+#define PIN_BIT		(1<<PIN)
+#define PIN2_BIT	(1<<PIN2)
+
+#define MAX_STEPS	16
+
+struct edge {
+	unsigned long long	t;	/* ticks */
+	int			pin;
+	int			level;
+};
+
+#define MAX_EDGES	256
+
+static struct edge edges[MAX_EDGES];
+static int nedge;
+
+static unsigned long long now;
+static unsigned int gpio_out;
+static int ncalls;
+
+/* The ISR, then the clock moves on */
+static unsigned int
+tick ( struct wave_player *wp )
+{
+	unsigned int set, clr;
+	unsigned int old;
+	unsigned int ticks;
+	int pin;
+
+	ticks = wave_next ( wp, &set, &clr );
+	ncalls++;
+
+	old = gpio_out;
+	gpio_out |= set;
+	gpio_out &= ~clr;
+
+	for ( pin=0; pin<16; pin++ ) {
+	    if ( ((old ^ gpio_out) >> pin & 1) && nedge < MAX_EDGES ) {
+		edges[nedge].t = now;
+		edges[nedge].pin = pin;
+		edges[nedge].level = gpio_out >> pin & 1;
+		nedge++;
+	    }
+	}
+
+	now += ticks;
+	return ticks;
+}
+
+static void
+reset ( struct wave_player *wp )
+{
+	wave_player_init ( wp );
+	now = 0;
+	gpio_out = 0;
+	nedge = 0;
+	ncalls = 0;
+}
+
+/* Run until the clock gets to "until" (in us) or the player stops */
+static void
+play_until ( struct wave_player *wp, unsigned long long until )
+{
+	until *= TICKS_PER_US;
+	while ( now < until )
+	    if ( tick ( wp ) == 0 )
+		break;
+}
+
+/* Is edge i on this pin, going this way, at this many us ? */
+static int
+edge_is ( int i, int pin, int level, unsigned long long us )
+{
+	if ( i >= nedge )
+	    return 0;
+	if ( edges[i].pin == pin && edges[i].level == level && edges[i].t == us * TICKS_PER_US )
+	    return 1;
+	printf ( "edge %d: pin %d -> %d at %llu us, wanted pin %d -> %d at %llu us\n",
+	    i, edges[i].pin, edges[i].level, edges[i].t / TICKS_PER_US, pin, level, us );
+	return 0;
+}
+
+#define NUM(x)	(sizeof(x) / sizeof(x[0]))
+
+/* pulse3.c's burst, the last two segments merge */
+static struct wave_seg burst[] = {
+    { PIN_BIT,	10 },
+    { 0,	20 },
+    { PIN_BIT,	10 },
+    { 0,	20 },
+    { 0,	200 },
+};
+
+#define BURST_US	260
+
+static struct wave_seg clock_strobe[] = {
+    { PIN_BIT | PIN2_BIT,	5 },
+    { 0,			5 },
+    { PIN_BIT,			5 },
+    { 0,			5 },
+    { PIN_BIT,			5 },
+    { 0,			5 },
+    { PIN_BIT,			5 },
+    { 0,			50 },
+};
+
+#define CS_US		85
+
+static struct wave_step steps[MAX_STEPS];
+static struct wave_step steps2[MAX_STEPS];
+
+static struct wave_prog prog;
+static struct wave_prog prog2;
+
+static struct wave_player player;
+
+/* Edge times for the burst, pass after pass */
+static void
+test_burst ( void )
+{
+	unsigned long long base;
+	int pass;
+	int n;
+
+	n = wave_compile ( &prog, steps, MAX_STEPS, burst, NUM(burst), PIN_BIT, TICKS_PER_US, 1 );
+	CHECK ( n == 4 );
+	CHECK ( steps[3].ticks == 220 * TICKS_PER_US );
+
+	reset ( &player );
+	player.pending = &prog;
+	play_until ( &player, 3 * BURST_US );
+
+	CHECK ( nedge == 12 );
+	for ( pass=0; pass<3; pass++ ) {
+	    base = pass * BURST_US;
+	    CHECK ( edge_is ( pass*4 + 0, PIN, 1, base ) );
+	    CHECK ( edge_is ( pass*4 + 1, PIN, 0, base + 10 ) );
+	    CHECK ( edge_is ( pass*4 + 2, PIN, 1, base + 30 ) );
+	    CHECK ( edge_is ( pass*4 + 3, PIN, 0, base + 40 ) );
+	}
+	CHECK ( player.running );
+}
+
+/* Two pins on the same edge */
+static void
+test_two_pins ( void )
+{
+	CHECK ( wave_compile ( &prog, steps, MAX_STEPS, clock_strobe, NUM(clock_strobe),
+	    PIN_BIT | PIN2_BIT, TICKS_PER_US, 1 ) == 8 );
+
+	reset ( &player );
+	player.pending = &prog;
+	play_until ( &player, CS_US );
+
+	/* pin 4 comes first in our scan, but the time is what matters */
+	CHECK ( nedge == 10 );
+	CHECK ( edge_is ( 0, PIN2, 1, 0 ) );
+	CHECK ( edge_is ( 1, PIN, 1, 0 ) );
+	CHECK ( edge_is ( 2, PIN2, 0, 5 ) );
+	CHECK ( edge_is ( 3, PIN, 0, 5 ) );
+	CHECK ( edge_is ( 4, PIN, 1, 10 ) );
+	CHECK ( edge_is ( 5, PIN, 0, 15 ) );
+	CHECK ( edge_is ( 6, PIN, 1, 20 ) );
+	CHECK ( edge_is ( 7, PIN, 0, 25 ) );
+	CHECK ( edge_is ( 8, PIN, 1, 30 ) );
+	CHECK ( edge_is ( 9, PIN, 0, 35 ) );
+}
+
+/* A new table handed over mid pass waits for the end of the pass */
+static void
+test_switch ( void )
+{
+	unsigned long long base = 2 * BURST_US;
+
+	wave_compile ( &prog, steps, MAX_STEPS, burst, NUM(burst), PIN_BIT, TICKS_PER_US, 1 );
+	wave_compile ( &prog2, steps2, MAX_STEPS, clock_strobe, NUM(clock_strobe),
+	    PIN_BIT | PIN2_BIT, TICKS_PER_US, 1 );
+
+	reset ( &player );
+	player.pending = &prog;
+
+	/* into the second pass, just after its first edge */
+	play_until ( &player, BURST_US + 20 );
+	CHECK ( nedge == 6 );
+	player.pending = &prog2;
+
+	play_until ( &player, base + CS_US );
+
+	/* the rest of the second burst, untouched */
+	CHECK ( edge_is ( 6, PIN, 1, BURST_US + 30 ) );
+	CHECK ( edge_is ( 7, PIN, 0, BURST_US + 40 ) );
+
+	/* and the new one starts right where the burst would have */
+	CHECK ( edge_is ( 8, PIN2, 1, base ) );
+	CHECK ( edge_is ( 9, PIN, 1, base ) );
+	CHECK ( edge_is ( 10, PIN2, 0, base + 5 ) );
+	CHECK ( player.cur == &prog2 );
+	CHECK ( player.pending == 0 );
+}
+
+/* One pass and done */
+static void
+test_once ( void )
+{
+	wave_compile ( &prog, steps, MAX_STEPS, burst, NUM(burst), PIN_BIT, TICKS_PER_US, 0 );
+
+	reset ( &player );
+	player.pending = &prog;
+	play_until ( &player, 10 * BURST_US );
+
+	CHECK ( nedge == 4 );
+	CHECK ( now == BURST_US * TICKS_PER_US );
+	CHECK ( ! player.running );
+	CHECK ( ncalls == 5 );
+}
+
+/* Longer than FRC1 can count gets split, with no edge at the split,
+ * and no piece too short for the ISR.
+ */
+static void
+test_long ( void )
+{
+	struct wave_seg seg[3];
+	unsigned int total;
+	int n, i;
+	int ok;
+
+	/* 2 seconds high, then 1 us low */
+	seg[0].high = PIN_BIT;
+	seg[0].us = 2000000;
+	seg[1].high = 0;
+	seg[1].us = 1;
+	n = wave_compile ( &prog, steps, MAX_STEPS, seg, 2, PIN_BIT, TICKS_PER_US, 0 );
+	CHECK ( n == 3 );
+
+	ok = 1;
+	total = 0;
+	for ( i=0; i<n-1; i++ ) {
+	    if ( steps[i].ticks > WAVE_MAX_TICKS || steps[i].ticks < WAVE_MIN_TICKS )
+		ok = 0;
+	    total += steps[i].ticks;
+	}
+	CHECK ( ok );
+	CHECK ( total == 2000000 * TICKS_PER_US );
+
+	reset ( &player );
+	player.pending = &prog;
+	play_until ( &player, 3000000 );
+	CHECK ( nedge == 2 );
+	CHECK ( edge_is ( 0, PIN, 1, 0 ) );
+	CHECK ( edge_is ( 1, PIN, 0, 2000000 ) );
+
+	/* just over the limit would leave a runt, so the split moves */
+	seg[0].us = 0;
+	seg[1].high = PIN_BIT;
+	seg[1].us = 0;
+	seg[2].high = PIN_BIT;
+	seg[2].us = (WAVE_MAX_TICKS + 5) / TICKS_PER_US;
+	total = seg[2].us * TICKS_PER_US;
+	n = wave_compile ( &prog, steps, MAX_STEPS, seg, 3, PIN_BIT, TICKS_PER_US, 0 );
+	CHECK ( n == 2 );
+	CHECK ( steps[1].ticks >= WAVE_MIN_TICKS );
+	CHECK ( steps[0].ticks + steps[1].ticks == total );
+}
+
+/* Too many steps for the space */
+static void
+test_full ( void )
+{
+	struct wave_seg seg[MAX_STEPS + 1];
+	int i;
+
+	for ( i=0; i<MAX_STEPS + 1; i++ ) {
+	    seg[i].high = i & 1 ? PIN_BIT : 0;
+	    seg[i].us = 10;
+	}
+	CHECK ( wave_compile ( &prog, steps, MAX_STEPS, seg, MAX_STEPS, PIN_BIT, TICKS_PER_US, 1 ) == MAX_STEPS );
+	CHECK ( wave_compile ( &prog, steps, MAX_STEPS, seg, MAX_STEPS + 1, PIN_BIT, TICKS_PER_US, 1 ) == -1 );
+}
+
+int
+main ( int argc, char **argv )
+{
+	test_burst ();
+	test_two_pins ();
+	test_switch ();
+	test_once ();
+	test_long ();
+	test_full ();
+
+	printf ( "%d checks, %d failed\n", ntest, nfail );
+	return nfail ? 1 : 0;
+}
+
+/* THE END */
@@ -0,0 +1,189 @@
+/* dsp.c
+ *
+ * Small fixed point filters to sit between the ADC
+ *  samplers and the uplink, so we send fewer and
+ *  better values.  See dsp.h
+ *
+ * None of this uses anything from the SDK, so it
+ *  compiles just as well with cc on a linux box,
+ *  which is handy for checking it against floating point.
+ *
+ * These are not marked ICACHE_FLASH_ATTR, so they end
+ *  up in IRAM and can be called from an ISR.
+ *
+ * This is a copy of the one in adc_stream, keep them the same.
+ */
+
+#include "dsp.h"
+
+/* ------------------------------------- */
+/* Moving average */
+
+void
+dsp_avg_init ( struct dsp_avg *ap, int shift )
+{
+	int i;
+
+	if ( shift > DSP_AVG_MAX_SHIFT )
+	    shift = DSP_AVG_MAX_SHIFT;
+	if ( shift < 0 )
+	    shift = 0;
+
+	ap->shift = shift;
+	ap->pos = 0;
+	ap->sum = 0;
+	for ( i=0; i< (1<<shift); i++ )
+	    ap->hist[i] = 0;
+}
+
+/* Until the window fills, this reads low
+ * (we are averaging in the initial zeros).
+ */
+int
+dsp_avg ( struct dsp_avg *ap, int x )
+{
+	ap->sum += x - ap->hist[ap->pos];
+	ap->hist[ap->pos] = x;
+	ap->pos = (ap->pos + 1) & ((1 << ap->shift) - 1);
+
+	/* round to nearest */
+	return (ap->sum + ((1 << ap->shift) >> 1)) >> ap->shift;
+}
+
+/* ------------------------------------- */
+/* CIC decimator */
+
+void
+dsp_cic_init ( struct dsp_cic *cp, int order, int rate_shift )
+{
+	int i;
+
+	if ( order < 1 )
+	    order = 1;
+	if ( order > DSP_CIC_MAX_ORDER )
+	    order = DSP_CIC_MAX_ORDER;
+
+	cp->order = order;
+	cp->rate_shift = rate_shift;
+	cp->count = 0;
+	for ( i=0; i<DSP_CIC_MAX_ORDER; i++ ) {
+	    cp->integ[i] = 0;
+	    cp->comb[i] = 0;
+	}
+}
+
+/* Feed one sample in.
+ * Returns 1 (and sets *out) once every 1 << rate_shift samples.
+ */
+int
+dsp_cic ( struct dsp_cic *cp, int x, int *out )
+{
+	unsigned int v;
+	unsigned int t;
+	int i;
+
+	v = x;
+	for ( i=0; i<cp->order; i++ ) {
+	    cp->integ[i] += v;
+	    v = cp->integ[i];
+	}
+
+	if ( ++cp->count < (1 << cp->rate_shift) )
+	    return 0;
+	cp->count = 0;
+
+	for ( i=0; i<cp->order; i++ ) {
+	    t = v;
+	    v -= cp->comb[i];
+	    cp->comb[i] = t;
+	}
+
+	*out = (int) v >> (cp->order * cp->rate_shift);
+	return 1;
+}
+
+/* ------------------------------------- */
+/* Median */
+
+/* Insertion sort is the thing for 9 or fewer.
+ * Leaves buf sorted.
+ */
+int
+dsp_median_n ( int *buf, int n )
+{
+	int i, j;
+	int x;
+
+	for ( i=1; i<n; i++ ) {
+	    x = buf[i];
+	    for ( j=i; j > 0 && buf[j-1] > x; j-- )
+		buf[j] = buf[j-1];
+	    buf[j] = x;
+	}
+
+	return buf[n>>1];
+}
+
+void
+dsp_median_init ( struct dsp_median *mp, int n )
+{
+	if ( n > DSP_MEDIAN_MAX )
+	    n = DSP_MEDIAN_MAX;
+	if ( n < 1 )
+	    n = 1;
+
+	mp->n = n;
+	mp->pos = 0;
+	mp->fill = 0;
+}
+
+/* Until we have n samples, we give the
+ * median of what we have.
+ */
+int
+dsp_median ( struct dsp_median *mp, int x )
+{
+	int tmp[DSP_MEDIAN_MAX];
+	int i;
+
+	mp->hist[mp->pos] = x;
+	if ( ++mp->pos >= mp->n )
+	    mp->pos = 0;
+	if ( mp->fill < mp->n )
+	    mp->fill++;
+
+	for ( i=0; i<mp->fill; i++ )
+	    tmp[i] = mp->hist[i];
+
+	return dsp_median_n ( tmp, mp->fill );
+}
+
+/* ------------------------------------- */
+/* Exponential smoother */
+
+void
+dsp_ema_init ( struct dsp_ema *ep, int shift )
+{
+	ep->shift = shift;
+	ep->primed = 0;
+	ep->acc = 0;
+}
+
+/* The first sample primes the filter so we
+ * don't spend a long time climbing up from zero.
+ */
+int
+dsp_ema ( struct dsp_ema *ep, int x )
+{
+	if ( ! ep->primed ) {
+	    ep->acc = x << ep->shift;
+	    ep->primed = 1;
+	    return x;
+	}
+
+	ep->acc += x - ((ep->acc + ((1 << ep->shift) >> 1)) >> ep->shift);
+
+	return (ep->acc + ((1 << ep->shift) >> 1)) >> ep->shift;
+}
+
+/* THE END */
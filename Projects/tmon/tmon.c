@@ -21,6 +21,8 @@
 #include "espconn.h"
 #include "mem.h"
 
+#include "dsp.h"
+
 #define TEST_PORT 13	/* daytime */
 #define DATA_PORT 2001	/* on trona */
 
@@ -438,10 +440,14 @@ start_timer ( void )
 // #define DHT_GPIO	4	/* D2 */	
 #define DHT_GPIO	12	/* D6 */	
 
+#define BATTERY_READS	5
+
 void
 harvest_data ( void )
 {
     unsigned short adc;
+    int reads[BATTERY_READS];
+    int i;
 
 #ifdef notdef
     /* I have since learned that you cannot read v33
@@ -466,7 +472,12 @@ harvest_data ( void )
      */
 
 #define BATTERY_SCALE	418
-    adc = system_adc_read ();
+
+    /* A single reading is noisy, take the median of a handful */
+    for ( i=0; i<BATTERY_READS; i++ )
+	reads[i] = system_adc_read ();
+    adc = dsp_median_n ( reads, BATTERY_READS );
+
     os_printf ( "ADC = %d\n", adc );
     battery = adc * BATTERY_SCALE;
     battery /= 1023;
@@ -0,0 +1,127 @@
+/* bench.c
+ * How fast is the libesprom framing?
+ *
+ *   make bench
+ *
+ * We frame 64M of data as 4K frames (what the stub sends) and find
+ * and unescape them again, first with random data (an escape every
+ * 128 bytes or so), then with nothing but bytes that need escapes,
+ * which is as bad as it gets.  For comparison, the same decode done
+ * a byte at a time, the way ESPROM.read() in esptool did it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "esprom.h"
+
+#define TOTAL		(64 * 1024 * 1024)
+#define FRAME		4096
+#define NFRAME		(TOTAL / FRAME)
+
+static double
+now ( void )
+{
+	struct timespec ts;
+
+	clock_gettime ( CLOCK_MONOTONIC, &ts );
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* A byte at a time, into a separate buffer */
+static int
+slow_decode ( unsigned char *in, int len, unsigned char *out )
+{
+	int i;
+	int n = 0;
+	int esc = 0;
+	int frames = 0;
+
+	for ( i=0; i<len; i++ ) {
+	    if ( in[i] == SLIP_END ) {
+		if ( n )
+		    frames++;
+		n = 0;
+	    } else if ( esc ) {
+		out[n++] = in[i] == SLIP_ESC_END ? SLIP_END : SLIP_ESC;
+		esc = 0;
+	    } else if ( in[i] == SLIP_ESC )
+		esc = 1;
+	    else
+		out[n++] = in[i];
+	}
+	return frames;
+}
+
+static void
+run ( char *what, unsigned char *data, unsigned char *enc, unsigned char *work )
+{
+	unsigned char *p;
+	unsigned char *end;
+	unsigned char *f;
+	unsigned char out[FRAME];
+	double t;
+	int elen;
+	int len;
+	int frames;
+	int i;
+
+	t = now ();
+	elen = 0;
+	for ( i=0; i<NFRAME; i++ )
+	    elen += slip_encode ( &enc[elen], &data[i * FRAME], FRAME );
+	t = now () - t;
+	printf ( "%s: encode %8.1f MB/s, %d bytes framed\n", what, TOTAL / t / 1e6, elen );
+
+	memcpy ( work, enc, elen );
+	t = now ();
+	p = work;
+	end = work + elen;
+	frames = 0;
+	while ( (f = slip_frame ( &p, end, &len )) ) {
+	    if ( len != FRAME || memcmp ( f, &data[frames * FRAME], FRAME ) != 0 ) {
+		printf ( "%s: frame %d is wrong\n", what, frames );
+		exit ( 1 );
+	    }
+	    frames++;
+	}
+	t = now () - t;
+	printf ( "%s: decode %8.1f MB/s (with a memcmp), %d frames\n", what, TOTAL / t / 1e6, frames );
+
+	t = now ();
+	frames = slow_decode ( enc, elen, out );
+	t = now () - t;
+	printf ( "%s: a byte at a time %8.1f MB/s, %d frames\n", what, TOTAL / t / 1e6, frames );
+}
+
+int
+main ( int argc, char **argv )
+{
+	unsigned char *data;
+	unsigned char *enc;
+	unsigned char *work;
+	int i;
+
+	data = malloc ( TOTAL );
+	enc = malloc ( NFRAME * SLIP_MAX(FRAME) );
+	work = malloc ( NFRAME * SLIP_MAX(FRAME) );
+	if ( ! data || ! enc || ! work ) {
+	    fprintf ( stderr, "bench: out of memory\n" );
+	    return 1;
+	}
+
+	srand ( 1 );
+	for ( i=0; i<TOTAL; i++ )
+	    data[i] = rand ();
+	run ( "random", data, enc, work );
+
+	for ( i=0; i<TOTAL; i++ )
+	    data[i] = i & 1 ? SLIP_END : SLIP_ESC;
+	run ( "worst ", data, enc, work );
+
+	return 0;
+}
+
+/* THE END */
@@ -0,0 +1,199 @@
+/* esprom.c
+ * A thin command line tool on top of libesprom.
+ *
+ *   esprom [-p port] [-b baud] sync
+ *   esprom [-p port] [-b baud] read_mac
+ *   esprom [-p port] [-b baud] read_reg addr
+ *   esprom [-p port] [-b baud] write_reg addr value [mask]
+ *   esprom encode <data >frame
+ *   esprom decode <frames >data
+ *
+ * The chip has to be in its bootloader already (or be espemu),
+ * we don't reset it.  encode and decode are just the framing,
+ * stdin to stdout, handy for trying things.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "esprom.h"
+
+#define SYNC_TRIES	4
+
+static char *port = "/dev/ttyUSB0";
+static int baud = 115200;
+
+static void
+usage ( void )
+{
+	fprintf ( stderr, "Usage: esprom [-p port] [-b baud] sync|read_mac|read_reg addr|write_reg addr value [mask]\n" );
+	fprintf ( stderr, "       esprom encode|decode\n" );
+	exit ( 1 );
+}
+
+static void
+fail ( char *what, int rv )
+{
+	fprintf ( stderr, "esprom: %s: %s\n", what, esprom_error ( rv ) );
+	exit ( 1 );
+}
+
+static unsigned char *
+read_all ( int *len )
+{
+	unsigned char *buf = 0;
+	int size = 0;
+	int n;
+
+	*len = 0;
+	for ( ;; ) {
+	    if ( *len == size ) {
+		size = size ? size * 2 : 65536;
+		buf = realloc ( buf, size );
+		if ( ! buf ) {
+		    fprintf ( stderr, "esprom: out of memory\n" );
+		    exit ( 1 );
+		}
+	    }
+	    n = read ( 0, &buf[*len], size - *len );
+	    if ( n <= 0 )
+		return buf;
+	    *len += n;
+	}
+}
+
+static void
+encode ( void )
+{
+	unsigned char *in;
+	unsigned char *out;
+	int len;
+
+	in = read_all ( &len );
+	out = malloc ( SLIP_MAX(len) );
+	fwrite ( out, 1, slip_encode ( out, in, len ), stdout );
+}
+
+/* All the frames, one after the other */
+static void
+decode ( void )
+{
+	unsigned char *buf;
+	unsigned char *p;
+	unsigned char *frame;
+	int len;
+	int n;
+
+	buf = read_all ( &len );
+	p = buf;
+	while ( (frame = slip_frame ( &p, buf + len, &n )) ) {
+	    if ( n < 0 )
+		fail ( "decode", n );
+	    fwrite ( frame, 1, n, stdout );
+	}
+}
+
+static struct esprom *
+connect ( void )
+{
+	struct esprom *ep;
+	int rv = ESPROM_TIMEOUT;
+	int i;
+
+	ep = esprom_open ( port, baud );
+	if ( ! ep ) {
+	    perror ( port );
+	    exit ( 1 );
+	}
+
+	esprom_timeout ( ep, 300 );
+	for ( i=0; i<SYNC_TRIES; i++ ) {
+	    rv = esprom_sync ( ep );
+	    if ( rv == ESPROM_OK )
+		break;
+	}
+	if ( rv )
+	    fail ( "sync", rv );
+	esprom_timeout ( ep, 3000 );
+	return ep;
+}
+
+static unsigned int
+num ( char *s )
+{
+	return strtoul ( s, 0, 0 );
+}
+
+int
+main ( int argc, char **argv )
+{
+	struct esprom *ep;
+	unsigned int mac0, mac1;
+	unsigned int val;
+	int rv;
+
+	argc--;
+	argv++;
+	while ( argc > 1 && argv[0][0] == '-' ) {
+	    if ( strcmp ( argv[0], "-p" ) == 0 )
+		port = argv[1];
+	    else if ( strcmp ( argv[0], "-b" ) == 0 )
+		baud = num ( argv[1] );
+	    else
+		usage ();
+	    argc -= 2;
+	    argv += 2;
+	}
+	if ( argc < 1 )
+	    usage ();
+
+	if ( strcmp ( argv[0], "encode" ) == 0 ) {
+	    encode ();
+	    return 0;
+	}
+	if ( strcmp ( argv[0], "decode" ) == 0 ) {
+	    decode ();
+	    return 0;
+	}
+
+	if ( strcmp ( argv[0], "sync" ) == 0 ) {
+	    ep = connect ();
+	    printf ( "In sync\n" );
+	} else if ( strcmp ( argv[0], "read_mac" ) == 0 ) {
+	    ep = connect ();
+	    rv = esprom_read_reg ( ep, ESP_OTP_MAC0, &mac0 );
+	    if ( rv == ESPROM_OK )
+		rv = esprom_read_reg ( ep, ESP_OTP_MAC1, &mac1 );
+	    if ( rv )
+		fail ( "read_reg", rv );
+	    /* same as esptool */
+	    if ( ((mac1 >> 16) & 0xff) == 0 )
+		printf ( "MAC: 18:fe:34" );
+	    else if ( ((mac1 >> 16) & 0xff) == 1 )
+		printf ( "MAC: ac:d0:74" );
+	    else {
+		fprintf ( stderr, "esprom: unknown OUI\n" );
+		exit ( 1 );
+	    }
+	    printf ( ":%02x:%02x:%02x\n", (mac1 >> 8) & 0xff, mac1 & 0xff, (mac0 >> 24) & 0xff );
+	} else if ( strcmp ( argv[0], "read_reg" ) == 0 && argc == 2 ) {
+	    ep = connect ();
+	    rv = esprom_read_reg ( ep, num ( argv[1] ), &val );
+	    if ( rv )
+		fail ( "read_reg", rv );
+	    printf ( "0x%08x = 0x%08x\n", num ( argv[1] ), val );
+	} else if ( strcmp ( argv[0], "write_reg" ) == 0 && (argc == 3 || argc == 4) ) {
+	    ep = connect ();
+	    rv = esprom_write_reg ( ep, num ( argv[1] ), num ( argv[2] ), argc == 4 ? num ( argv[3] ) : 0xffffffff, 0 );
+	    if ( rv )
+		fail ( "write_reg", rv );
+	} else
+	    usage ();
+
+	esprom_close ( ep );
+	return 0;
+}
+
+/* THE END */
@@ -0,0 +1,94 @@
+/* esprom.h
+ * libesprom, the ESP8266 ROM loader protocol in C
+ *
+ * Everything here talks SLIP frames:
+ *
+ *	command:  00 op len(2) chk(4) data ...
+ *	response: 01 op len(2) val(4) body ... status error
+ *
+ * slip.c is just the framing, no I/O, so it can be tested and
+ * used from python (esprom.py) on buffers it already has.
+ * port.c is a serial port with commands and responses on top.
+ */
+
+/* Commands the ROM loader knows */
+#define ESP_FLASH_BEGIN		0x02
+#define ESP_FLASH_DATA		0x03
+#define ESP_FLASH_END		0x04
+#define ESP_MEM_BEGIN		0x05
+#define ESP_MEM_END		0x06
+#define ESP_MEM_DATA		0x07
+#define ESP_SYNC		0x08
+#define ESP_WRITE_REG		0x09
+#define ESP_READ_REG		0x0a
+
+/* and what our flasher stub adds (see ../stub/stub.h) */
+#define ESP_CHANGE_BAUD		0x0f
+#define ESP_FLASH_DEFL_BEGIN	0x10
+#define ESP_FLASH_DEFL_DATA	0x11
+#define ESP_FLASH_DEFL_END	0x12
+#define ESP_FLASH_CRC		0x13
+#define ESP_READ		0x14
+
+#define ESP_CHECKSUM_MAGIC	0xef
+
+/* OTP words with the MAC address */
+#define ESP_OTP_MAC0		0x3ff00050
+#define ESP_OTP_MAC1		0x3ff00054
+
+#define SLIP_END		0xc0
+#define SLIP_ESC		0xdb
+#define SLIP_ESC_END		0xdc
+#define SLIP_ESC_ESC		0xdd
+
+/* Biggest a frame can get once escaped */
+#define SLIP_MAX(n)		(2 * (n) + 2)
+
+/* The biggest data we send in a command (ESP_RAM_BLOCK in esptool,
+ * plus the 16 byte block header) and take in a response.
+ */
+#define ESP_MAX_DATA		(0x1800 + 16)
+
+/* Return codes, < 0 is trouble */
+#define ESPROM_OK		0
+#define ESPROM_TIMEOUT		-1
+#define ESPROM_BAD_FRAME	-2
+#define ESPROM_MISMATCH		-3
+#define ESPROM_IO		-4
+#define ESPROM_FAILED		-5
+
+/* A response, body points into the frame it came from */
+struct esp_resp {
+	int op;
+	unsigned int val;
+	unsigned char *body;
+	int len;
+	int status;
+	int error;
+};
+
+/* slip.c */
+int slip_encode ( unsigned char *, const unsigned char *, int );
+int slip_unescape ( unsigned char *, int );
+unsigned char *slip_frame ( unsigned char **, unsigned char *, int * );
+int esp_checksum ( const unsigned char *, int );
+int esp_command_frame ( unsigned char *, int, const unsigned char *, int, unsigned int );
+int esp_response ( unsigned char *, int, struct esp_resp * );
+const char *esprom_error ( int );
+
+/* port.c */
+struct esprom;
+
+struct esprom *esprom_open ( const char *, int );
+void esprom_close ( struct esprom * );
+int esprom_baud ( struct esprom *, int );
+void esprom_timeout ( struct esprom *, int );
+int esprom_send ( struct esprom *, int, const unsigned char *, int, unsigned int );
+int esprom_frame ( struct esprom *, unsigned char ** );
+int esprom_recv ( struct esprom *, struct esp_resp * );
+int esprom_command ( struct esprom *, int, const unsigned char *, int, unsigned int, struct esp_resp * );
+int esprom_sync ( struct esprom * );
+int esprom_read_reg ( struct esprom *, unsigned int, unsigned int * );
+int esprom_write_reg ( struct esprom *, unsigned int, unsigned int, unsigned int, unsigned int );
+
+/* THE END */
@@ -0,0 +1,98 @@
+# esprom.py
+#
+# Python bindings for libesprom (the framing part, slip.c),
+#  so esptool can hand the byte pushing to C.
+#  Needs libesprom.so next to this file ("make" here builds it),
+#  importing this raises OSError if it isn't there.
+#
+#  encode(packet)      -- a whole SLIP frame, ready to send
+#  checksum(data)      -- same as the ROM
+#  Decoder().feed(buf) -- the whole frames so far, unescaped
+#
+# The Decoder keeps one bytearray that C looks at directly,
+#  what comes in is copied there once, and each frame is
+#  unescaped in place and copied out once as bytes.
+
+import os
+from ctypes import CDLL, c_int, c_size_t, c_char_p, c_ubyte
+from ctypes import POINTER, byref, addressof, create_string_buffer
+
+_lib = CDLL ( os.path.join ( os.path.dirname ( os.path.abspath ( __file__ ) ), 'libesprom.so' ) )
+
+# pointers go back and forth as plain integers
+_lib.slip_encode.argtypes = [ c_char_p, c_char_p, c_int ]
+_lib.slip_encode.restype = c_int
+_lib.slip_frame.argtypes = [ POINTER(c_size_t), c_size_t, POINTER(c_int) ]
+_lib.slip_frame.restype = c_size_t
+_lib.esp_checksum.argtypes = [ c_char_p, c_int ]
+_lib.esp_checksum.restype = c_int
+
+ESP_CHECKSUM_MAGIC = 0xef
+
+def encode(packet):
+    packet = bytes(packet)
+    out = create_string_buffer(2 * len(packet) + 2)
+    n = _lib.slip_encode(out, packet, len(packet))
+    return out.raw[:n]
+
+def checksum(data, state = ESP_CHECKSUM_MAGIC):
+    return _lib.esp_checksum(bytes(data), len(data)) ^ ESP_CHECKSUM_MAGIC ^ state
+
+class Decoder:
+    def __init__(self, size = 65536):
+        self._buf = None
+        self._cbuf = None
+        self._view = None
+        self._grow(size)
+        self.start = 0
+        self.end = 0
+
+    # a bytearray can't change size while C has a view of it
+    def _grow(self, size):
+        old = self._buf
+        self._cbuf = None
+        self._view = None
+        self._buf = bytearray(size)
+        if old is not None:
+            self._buf[0:self.end - self.start] = old[self.start:self.end]
+            self.end -= self.start
+            self.start = 0
+        self._cbuf = (c_ubyte * size).from_buffer(self._buf)
+        self._base = addressof(self._cbuf)
+        self._view = memoryview(self._buf)
+
+    """ Forget anything partial, after a flush """
+    def reset(self):
+        self.start = 0
+        self.end = 0
+
+    """ Add what came in, give back a list of the whole frames.
+        A frame with a bad escape comes back empty.
+    """
+    def feed(self, data):
+        n = self.end - self.start
+        if n + len(data) > len(self._buf):
+            self._grow(2 * (n + len(data)))
+        elif self.start:
+            self._buf[0:n] = self._buf[self.start:self.end]
+        self.start = 0
+        self._buf[n:n + len(data)] = data
+        self.end = n + len(data)
+
+        p = c_size_t(self._base)
+        end = self._base + self.end
+        length = c_int()
+        frames = []
+        while True:
+            f = _lib.slip_frame(byref(p), end, byref(length))
+            if not f:
+                break
+            if length.value < 0:
+                frames.append(b'')
+            else:
+                f -= self._base
+                frames.append(bytes(self._view[f:f + length.value]))
+        self.start = p.value - self._base
+        return frames
+
+# THE END
@@ -0,0 +1,262 @@
+/* port.c
+ * Part of libesprom, commands and responses over a serial port.
+ *
+ * The port is set up raw with termios2 so any baud rate works,
+ * the same trick as NoSDK/linux-baud/baud.c.  Reads go into rbuf
+ * as big as they come, and slip_frame() finds the frames in there,
+ * so a response is never copied: esp_resp.body points into rbuf,
+ * good until the next read.
+ *
+ * There are no DTR/RTS games here to reset the chip into the
+ * bootloader, this is for talking to one that is already there
+ * (or to our stub, or to espemu).
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+
+#include "esprom.h"
+
+/* room for the biggest frame, and then some */
+#define RBUF_SIZE	(SLIP_MAX(8 + ESP_MAX_DATA) + 4096)
+
+/* Same as esptool */
+#define RESPONSE_TRIES	100
+#define SYNC_EXTRA	7
+
+struct esprom {
+	int fd;
+	int timeout;		/* ms */
+	unsigned char *rpos;	/* what we haven't looked at yet */
+	unsigned char *rend;
+	unsigned char rbuf[RBUF_SIZE];
+	unsigned char tbuf[SLIP_MAX(8 + ESP_MAX_DATA)];
+};
+
+static void
+put32 ( unsigned char *p, unsigned int val )
+{
+	p[0] = val;
+	p[1] = val >> 8;
+	p[2] = val >> 16;
+	p[3] = val >> 24;
+}
+
+int
+esprom_baud ( struct esprom *ep, int baud )
+{
+	struct termios2 tio;
+
+	if ( ioctl ( ep->fd, TCGETS2, &tio ) < 0 )
+	    return ESPROM_IO;
+
+	/* raw, 8N1 */
+	tio.c_iflag = 0;
+	tio.c_oflag = 0;
+	tio.c_lflag = 0;
+	tio.c_cflag = CS8 | CREAD | CLOCAL | BOTHER;
+	tio.c_ispeed = baud;
+	tio.c_ospeed = baud;
+	tio.c_cc[VMIN] = 1;
+	tio.c_cc[VTIME] = 0;
+
+	if ( ioctl ( ep->fd, TCSETS2, &tio ) < 0 )
+	    return ESPROM_IO;
+	return ESPROM_OK;
+}
+
+struct esprom *
+esprom_open ( const char *dev, int baud )
+{
+	struct esprom *ep;
+
+	ep = malloc ( sizeof(struct esprom) );
+	if ( ! ep )
+	    return 0;
+
+	ep->fd = open ( dev, O_RDWR | O_NOCTTY );
+	if ( ep->fd < 0 ) {
+	    free ( ep );
+	    return 0;
+	}
+	if ( esprom_baud ( ep, baud ) ) {
+	    close ( ep->fd );
+	    free ( ep );
+	    return 0;
+	}
+	ioctl ( ep->fd, TCFLSH, TCIOFLUSH );
+
+	ep->timeout = 3000;
+	ep->rpos = ep->rend = ep->rbuf;
+	return ep;
+}
+
+void
+esprom_close ( struct esprom *ep )
+{
+	close ( ep->fd );
+	free ( ep );
+}
+
+/* How long to wait for each read, in ms */
+void
+esprom_timeout ( struct esprom *ep, int ms )
+{
+	ep->timeout = ms;
+}
+
+int
+esprom_send ( struct esprom *ep, int op, const unsigned char *data, int len, unsigned int chk )
+{
+	int n;
+	int done = 0;
+	int rv;
+
+	if ( len > ESP_MAX_DATA )
+	    return ESPROM_BAD_FRAME;
+
+	n = esp_command_frame ( ep->tbuf, op, data, len, chk );
+	while ( done < n ) {
+	    rv = write ( ep->fd, &ep->tbuf[done], n - done );
+	    if ( rv <= 0 )
+		return ESPROM_IO;
+	    done += rv;
+	}
+	return ESPROM_OK;
+}
+
+/* The next frame, frame points to it in rbuf.
+ * Gives back the length, or < 0 for trouble.
+ */
+int
+esprom_frame ( struct esprom *ep, unsigned char **frame )
+{
+	struct pollfd pfd;
+	int len;
+	int n;
+
+	for ( ;; ) {
+	    *frame = slip_frame ( &ep->rpos, ep->rend, &len );
+	    if ( *frame )
+		return len;
+
+	    /* keep the partial one, at the front */
+	    n = ep->rend - ep->rpos;
+	    if ( n == RBUF_SIZE ) {
+		ep->rpos = ep->rend = ep->rbuf;
+		return ESPROM_BAD_FRAME;
+	    }
+	    memmove ( ep->rbuf, ep->rpos, n );
+	    ep->rpos = ep->rbuf;
+	    ep->rend = ep->rbuf + n;
+
+	    pfd.fd = ep->fd;
+	    pfd.events = POLLIN;
+	    if ( poll ( &pfd, 1, ep->timeout ) <= 0 )
+		return ESPROM_TIMEOUT;
+	    n = read ( ep->fd, ep->rend, RBUF_SIZE - n );
+	    if ( n <= 0 )
+		return ESPROM_IO;
+	    ep->rend += n;
+	}
+}
+
+int
+esprom_recv ( struct esprom *ep, struct esp_resp *rp )
+{
+	unsigned char *frame;
+	int len;
+
+	len = esprom_frame ( ep, &frame );
+	if ( len < 0 )
+	    return len;
+	return esp_response ( frame, len, rp );
+}
+
+/* Send a command (unless op is 0) and wait for its response.
+ * Like esptool, we let up to RESPONSE_TRIES others go by,
+ * the ROM sends extra responses to SYNC.
+ */
+int
+esprom_command ( struct esprom *ep, int op, const unsigned char *data, int len, unsigned int chk, struct esp_resp *rp )
+{
+	int rv;
+	int i;
+
+	if ( op ) {
+	    rv = esprom_send ( ep, op, data, len, chk );
+	    if ( rv )
+		return rv;
+	}
+
+	for ( i=0; i<RESPONSE_TRIES; i++ ) {
+	    rv = esprom_recv ( ep, rp );
+	    if ( rv )
+		return rv;
+	    if ( op == 0 || rp->op == op )
+		return rp->status ? ESPROM_FAILED : ESPROM_OK;
+	}
+	return ESPROM_MISMATCH;
+}
+
+int
+esprom_sync ( struct esprom *ep )
+{
+	unsigned char data[36];
+	struct esp_resp resp;
+	int rv;
+	int i;
+
+	data[0] = 0x07;
+	data[1] = 0x07;
+	data[2] = 0x12;
+	data[3] = 0x20;
+	memset ( &data[4], 0x55, 32 );
+
+	ioctl ( ep->fd, TCFLSH, TCIOFLUSH );
+	ep->rpos = ep->rend = ep->rbuf;
+
+	rv = esprom_command ( ep, ESP_SYNC, data, sizeof(data), 0, &resp );
+	if ( rv )
+	    return rv;
+	for ( i=0; i<SYNC_EXTRA; i++ ) {
+	    rv = esprom_command ( ep, 0, 0, 0, 0, &resp );
+	    if ( rv )
+		return rv;
+	}
+	return ESPROM_OK;
+}
+
+int
+esprom_read_reg ( struct esprom *ep, unsigned int addr, unsigned int *val )
+{
+	unsigned char data[4];
+	struct esp_resp resp;
+	int rv;
+
+	put32 ( data, addr );
+	rv = esprom_command ( ep, ESP_READ_REG, data, 4, 0, &resp );
+	if ( rv == ESPROM_OK )
+	    *val = resp.val;
+	return rv;
+}
+
+int
+esprom_write_reg ( struct esprom *ep, unsigned int addr, unsigned int val, unsigned int mask, unsigned int delay )
+{
+	unsigned char data[16];
+	struct esp_resp resp;
+
+	put32 ( &data[0], addr );
+	put32 ( &data[4], val );
+	put32 ( &data[8], mask );
+	put32 ( &data[12], delay );
+	return esprom_command ( ep, ESP_WRITE_REG, data, 16, 0, &resp );
+}
+
+/* THE END */
@@ -0,0 +1,220 @@
+/* slip.c
+ * Part of libesprom, SLIP framing and the packets inside it.
+ *
+ * No I/O here, only buffers.  Nothing gets copied that doesn't
+ * have to be: we escape straight into the caller's output buffer,
+ * and a received frame gets unescaped right where it sits in the
+ * read buffer.  Runs of ordinary bytes are found with memchr() or
+ * a lookup table and moved with memcpy(), which is a lot faster
+ * than looking at one byte at a time (see bench.c).
+ */
+
+#include <string.h>
+
+#include "esprom.h"
+
+/* 1 for the bytes that need an escape */
+static const unsigned char special[256] = {
+	[SLIP_END] = 1,
+	[SLIP_ESC] = 1,
+};
+
+/* Escape len bytes into out, no END on either side */
+static int
+slip_escape ( unsigned char *out, const unsigned char *in, int len )
+{
+	const unsigned char *end = in + len;
+	const unsigned char *p;
+	unsigned char *op = out;
+
+	while ( in < end ) {
+	    for ( p = in; p < end && ! special[*p]; p++ )
+		;
+	    memcpy ( op, in, p - in );
+	    op += p - in;
+	    if ( p == end )
+		break;
+	    *op++ = SLIP_ESC;
+	    *op++ = *p == SLIP_END ? SLIP_ESC_END : SLIP_ESC_ESC;
+	    in = p + 1;
+	}
+	return op - out;
+}
+
+/* A whole frame, out needs SLIP_MAX(len) bytes.
+ * Gives back how many it used.
+ */
+int
+slip_encode ( unsigned char *out, const unsigned char *in, int len )
+{
+	int n;
+
+	out[0] = SLIP_END;
+	n = 1 + slip_escape ( &out[1], in, len );
+	out[n++] = SLIP_END;
+	return n;
+}
+
+/* Undo the escapes in place, gives back the new length.
+ * Most frames have none and we only look.
+ */
+int
+slip_unescape ( unsigned char *buf, int len )
+{
+	unsigned char *end = buf + len;
+	unsigned char *in;
+	unsigned char *out;
+	unsigned char *p;
+
+	in = memchr ( buf, SLIP_ESC, len );
+	if ( ! in )
+	    return len;
+
+	out = in;
+	while ( in < end ) {
+	    /* in is at an escape */
+	    if ( in + 1 >= end )
+		return ESPROM_BAD_FRAME;
+	    if ( in[1] == SLIP_ESC_END )
+		*out++ = SLIP_END;
+	    else if ( in[1] == SLIP_ESC_ESC )
+		*out++ = SLIP_ESC;
+	    else
+		return ESPROM_BAD_FRAME;
+	    in += 2;
+
+	    /* escapes back to back, skip the memchr */
+	    if ( in < end && *in == SLIP_ESC )
+		continue;
+	    p = memchr ( in, SLIP_ESC, end - in );
+	    if ( ! p )
+		p = end;
+	    memmove ( out, in, p - in );
+	    out += p - in;
+	    in = p;
+	}
+	return out - buf;
+}
+
+/* The next whole frame between *pp and end, unescaped where it
+ * sits.  *pp moves past it.  Without a whole frame we give back 0
+ * and leave *pp where the partial one starts, for the caller to
+ * keep until more comes in.  A frame with a bad escape comes back
+ * with len set to ESPROM_BAD_FRAME.
+ */
+unsigned char *
+slip_frame ( unsigned char **pp, unsigned char *end, int *len )
+{
+	unsigned char *p = *pp;
+	unsigned char *e;
+
+	while ( p < end && *p == SLIP_END )
+	    p++;
+
+	e = memchr ( p, SLIP_END, end - p );
+	if ( ! e ) {
+	    *pp = p;
+	    return 0;
+	}
+
+	*len = slip_unescape ( p, e - p );
+	*pp = e + 1;
+	return p;
+}
+
+/* Same as the ROM, but a word at a time.
+ * The xor of all the words, folded down to a byte,
+ * is the xor of all the bytes.
+ */
+int
+esp_checksum ( const unsigned char *buf, int len )
+{
+	unsigned long sum = 0;
+	unsigned long w;
+	int sum8 = ESP_CHECKSUM_MAGIC;
+
+	while ( len && ((unsigned long) buf & (sizeof(long) - 1)) ) {
+	    sum8 ^= *buf++;
+	    len--;
+	}
+	while ( len >= (int) sizeof(long) ) {
+	    memcpy ( &w, buf, sizeof(long) );
+	    sum ^= w;
+	    buf += sizeof(long);
+	    len -= sizeof(long);
+	}
+	while ( len-- )
+	    sum8 ^= *buf++;
+
+	for ( w = 0; sum; sum >>= 8 )
+	    w ^= sum & 0xff;
+	return sum8 ^ w;
+}
+
+/* A command, ready to send.  out needs SLIP_MAX(8 + len) */
+int
+esp_command_frame ( unsigned char *out, int op, const unsigned char *data, int len, unsigned int chk )
+{
+	unsigned char hdr[8];
+	int n;
+
+	hdr[0] = 0;
+	hdr[1] = op;
+	hdr[2] = len;
+	hdr[3] = len >> 8;
+	hdr[4] = chk;
+	hdr[5] = chk >> 8;
+	hdr[6] = chk >> 16;
+	hdr[7] = chk >> 24;
+
+	out[0] = SLIP_END;
+	n = 1 + slip_escape ( &out[1], hdr, 8 );
+	n += slip_escape ( &out[n], data, len );
+	out[n++] = SLIP_END;
+	return n;
+}
+
+/* Pick apart a response frame (already unescaped).
+ * The body is what comes before the two status bytes.
+ */
+int
+esp_response ( unsigned char *frame, int len, struct esp_resp *rp )
+{
+	int size;
+
+	if ( len < 10 || frame[0] != 1 )
+	    return ESPROM_BAD_FRAME;
+	size = frame[2] | frame[3] << 8;
+	if ( size != len - 8 )
+	    return ESPROM_BAD_FRAME;
+
+	rp->op = frame[1];
+	rp->val = frame[4] | frame[5] << 8 | frame[6] << 16 | (unsigned int) frame[7] << 24;
+	rp->body = &frame[8];
+	rp->len = size - 2;
+	rp->status = frame[len-2];
+	rp->error = frame[len-1];
+	return ESPROM_OK;
+}
+
+const char *
+esprom_error ( int rv )
+{
+	switch ( rv ) {
+	    case ESPROM_OK:
+		return "ok";
+	    case ESPROM_TIMEOUT:
+		return "timed out";
+	    case ESPROM_BAD_FRAME:
+		return "bad frame";
+	    case ESPROM_MISMATCH:
+		return "response doesn't match request";
+	    case ESPROM_IO:
+		return "i/o error";
+	    case ESPROM_FAILED:
+		return "target says it failed";
+	}
+	return "unknown error";
+}
+
+/* THE END */
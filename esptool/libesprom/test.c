@@ -0,0 +1,300 @@
+/* test.c
+ * Unit tests for libesprom
+ *
+ *   make test
+ *
+ * The framing gets known answers, then a lot of random round trips,
+ * some of them nothing but bytes that need escapes.  The port part
+ * gets a pty, and we play the chip on the other end of it.
+ */
+
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+#include "esprom.h"
+
+static int ntest;
+static int nfail;
+
+#define CHECK(x)	check ( x, #x, __LINE__ )
+
+static void
+check ( int ok, char *what, int line )
+{
+	ntest++;
+	if ( ! ok ) {
+	    printf ( "FAIL line %d: %s\n", line, what );
+	    nfail++;
+	}
+}
+
+static int
+same ( unsigned char *a, int alen, char *b, int blen )
+{
+	return alen == blen && memcmp ( a, b, alen ) == 0;
+}
+
+static void
+test_known ( void )
+{
+	unsigned char out[64];
+	unsigned char buf[64];
+	int n;
+
+	n = slip_encode ( out, (unsigned char *) "", 0 );
+	CHECK ( same ( out, n, "\xc0\xc0", 2 ) );
+
+	n = slip_encode ( out, (unsigned char *) "a\xc0" "b\xdb" "c", 5 );
+	CHECK ( same ( out, n, "\xc0" "a\xdb\xdc" "b\xdb\xdd" "c\xc0", 9 ) );
+
+	/* an escaped ESC followed by a plain ESC_END byte */
+	memcpy ( buf, "\xdb\xdd\xdc", 3 );
+	n = slip_unescape ( buf, 3 );
+	CHECK ( same ( buf, n, "\xdb\xdc", 2 ) );
+
+	memcpy ( buf, "xyz", 3 );
+	CHECK ( slip_unescape ( buf, 3 ) == 3 );
+
+	memcpy ( buf, "ab\xdb", 3 );
+	CHECK ( slip_unescape ( buf, 3 ) == ESPROM_BAD_FRAME );
+	memcpy ( buf, "\xdb\x01", 2 );
+	CHECK ( slip_unescape ( buf, 2 ) == ESPROM_BAD_FRAME );
+
+	CHECK ( esp_checksum ( (unsigned char *) "", 0 ) == 0xef );
+	CHECK ( esp_checksum ( (unsigned char *) "\x01\x02\x04", 3 ) == (0xef ^ 7) );
+}
+
+/* Several frames in one buffer, and part of another */
+static void
+test_frames ( void )
+{
+	unsigned char buf[64];
+	unsigned char *p;
+	unsigned char *f;
+	int len;
+
+	memcpy ( buf, "\xc0one\xc0\xc0\xc0t\xdb\xdcwo\xc0\xc0" "bad\xdb\xc0\xc0par", 23 );
+	p = buf;
+
+	f = slip_frame ( &p, buf + 23, &len );
+	CHECK ( f && same ( f, len, "one", 3 ) );
+	f = slip_frame ( &p, buf + 23, &len );
+	CHECK ( f && same ( f, len, "t\xc0wo", 4 ) );
+	f = slip_frame ( &p, buf + 23, &len );
+	CHECK ( f && len == ESPROM_BAD_FRAME );
+	f = slip_frame ( &p, buf + 23, &len );
+	CHECK ( f == 0 && same ( p, buf + 23 - p, "par", 3 ) );
+
+	/* nothing at all */
+	p = buf;
+	CHECK ( slip_frame ( &p, buf, &len ) == 0 && p == buf );
+}
+
+static void
+fill ( unsigned char *buf, int len, int kind )
+{
+	static const unsigned char nasty[] = { 0xc0, 0xdb, 0xdc, 0xdd };
+	int i;
+
+	for ( i=0; i<len; i++ )
+	    buf[i] = kind ? nasty[rand () & 3] : rand ();
+}
+
+static void
+test_random ( void )
+{
+	static unsigned char in[8192];
+	static unsigned char out[SLIP_MAX(8192)];
+	unsigned char *p;
+	unsigned char *f;
+	int len;
+	int bad = 0;
+	int i, n;
+
+	for ( i=0; i<2000; i++ ) {
+	    len = rand () % sizeof(in);
+	    fill ( in, len, i & 1 );
+	    n = slip_encode ( out, in, len );
+
+	    /* no END inside, and no bigger than it can be */
+	    if ( n > SLIP_MAX(len) || memchr ( &out[1], SLIP_END, n - 2 ) )
+		bad++;
+
+	    p = out;
+	    f = slip_frame ( &p, out + n, &n );
+	    if ( len == 0 ) {
+		if ( f )
+		    bad++;
+		continue;
+	    }
+	    if ( ! f || n != len || memcmp ( f, in, len ) != 0 )
+		bad++;
+	}
+	CHECK ( bad == 0 );
+}
+
+/* The word at a time checksum, any alignment, any length */
+static void
+test_checksum ( void )
+{
+	unsigned char buf[128];
+	int off, len, i;
+	int sum;
+	int bad = 0;
+
+	fill ( buf, sizeof(buf), 0 );
+	for ( off=0; off<8; off++ )
+	    for ( len=0; len + off <= (int) sizeof(buf); len++ ) {
+		sum = ESP_CHECKSUM_MAGIC;
+		for ( i=0; i<len; i++ )
+		    sum ^= buf[off+i];
+		if ( esp_checksum ( &buf[off], len ) != sum )
+		    bad++;
+	    }
+	CHECK ( bad == 0 );
+}
+
+static void
+test_packets ( void )
+{
+	unsigned char out[SLIP_MAX(8 + 16)];
+	unsigned char frame[16];
+	struct esp_resp resp;
+	unsigned char *p;
+	unsigned char *f;
+	int len;
+	int n;
+
+	/* the checksum has a 0xc0 in it */
+	n = esp_command_frame ( out, ESP_MEM_DATA, (unsigned char *) "\xc0\x01", 2, 0xc0 );
+	p = out;
+	f = slip_frame ( &p, out + n, &len );
+	CHECK ( f && same ( f, len, "\x00\x07\x02\x00\xc0\x00\x00\x00\xc0\x01", 10 ) );
+
+	memcpy ( frame, "\x01\x0a\x02\x00\x78\x56\x34\x12\x00\x00", 10 );
+	CHECK ( esp_response ( frame, 10, &resp ) == ESPROM_OK );
+	CHECK ( resp.op == ESP_READ_REG && resp.val == 0x12345678 && resp.len == 0 );
+	CHECK ( resp.status == 0 && resp.error == 0 );
+
+	/* a body ahead of the status */
+	memcpy ( frame, "\x01\x13\x06\x00\x00\x00\x00\x00\xaa\xbb\xcc\xdd\x01\xc8", 14 );
+	CHECK ( esp_response ( frame, 14, &resp ) == ESPROM_OK );
+	CHECK ( resp.len == 4 && resp.body[0] == 0xaa && resp.status == 1 && resp.error == 0xc8 );
+
+	/* wrong length, or not a response */
+	CHECK ( esp_response ( frame, 13, &resp ) == ESPROM_BAD_FRAME );
+	frame[0] = 0;
+	CHECK ( esp_response ( frame, 14, &resp ) == ESPROM_BAD_FRAME );
+	CHECK ( esp_response ( frame, 4, &resp ) == ESPROM_BAD_FRAME );
+}
+
+/* ---- the port, with us as the chip on a pty */
+
+static void
+chip_says ( int fd, int op, unsigned int val, int status )
+{
+	unsigned char pkt[10];
+	unsigned char out[SLIP_MAX(10)];
+
+	pkt[0] = 1;
+	pkt[1] = op;
+	pkt[2] = 2;
+	pkt[3] = 0;
+	pkt[4] = val;
+	pkt[5] = val >> 8;
+	pkt[6] = val >> 16;
+	pkt[7] = val >> 24;
+	pkt[8] = status;
+	pkt[9] = status ? 0xc1 : 0;
+	write ( fd, out, slip_encode ( out, pkt, 10 ) );
+}
+
+static void
+test_port ( void )
+{
+	struct esprom *ep;
+	struct esp_resp resp;
+	unsigned char buf[256];
+	unsigned char out[SLIP_MAX(10)];
+	unsigned char *p;
+	unsigned char *f;
+	unsigned int val;
+	int master;
+	int len;
+	int n;
+	pid_t pid;
+
+	master = posix_openpt ( O_RDWR | O_NOCTTY );
+	CHECK ( master >= 0 && grantpt ( master ) == 0 && unlockpt ( master ) == 0 );
+	ep = esprom_open ( ptsname ( master ), 921600 );
+	CHECK ( ep != 0 );
+	if ( ! ep )
+	    return;
+	esprom_timeout ( ep, 100 );
+
+	/* What we send comes out right on the other end */
+	CHECK ( esprom_send ( ep, ESP_READ_REG, (unsigned char *) "\x50\x00\xf0\x3f", 4, 0 ) == ESPROM_OK );
+	usleep ( 10000 );
+	n = read ( master, buf, sizeof(buf) );
+	p = buf;
+	f = slip_frame ( &p, buf + n, &len );
+	CHECK ( f && same ( f, len, "\x00\x0a\x04\x00\x00\x00\x00\x00\x50\x00\xf0\x3f", 12 ) );
+
+	/* Other responses go by until ours shows up */
+	chip_says ( master, ESP_SYNC, 0, 0 );
+	chip_says ( master, ESP_SYNC, 0, 0 );
+	chip_says ( master, ESP_READ_REG, 0xdeadbeef, 0 );
+	CHECK ( esprom_read_reg ( ep, ESP_OTP_MAC0, &val ) == ESPROM_OK && val == 0xdeadbeef );
+	n = read ( master, buf, sizeof(buf) );
+
+	/* status says no */
+	chip_says ( master, ESP_WRITE_REG, 0, 1 );
+	CHECK ( esprom_write_reg ( ep, 0x60000200, 1, 1, 0 ) == ESPROM_FAILED );
+	n = read ( master, buf, sizeof(buf) );
+
+	/* nothing comes */
+	CHECK ( esprom_read_reg ( ep, ESP_OTP_MAC0, &val ) == ESPROM_TIMEOUT );
+	n = read ( master, buf, sizeof(buf) );
+
+	/* a response in pieces, a while apart */
+	pid = fork ();
+	if ( pid == 0 ) {
+	    memcpy ( buf, "\x01\x0a\x02\x00\xc0\xc0\xc0\xc0\x00\x00", 10 );
+	    n = slip_encode ( out, buf, 10 );
+	    usleep ( 20000 );
+	    write ( master, out, 5 );
+	    usleep ( 20000 );
+	    write ( master, &out[5], n - 5 );
+	    _exit ( 0 );
+	}
+	CHECK ( esprom_command ( ep, ESP_READ_REG, (unsigned char *) "\0\0\0\0", 4, 0, &resp ) == ESPROM_OK );
+	CHECK ( resp.val == 0xc0c0c0c0 );
+	waitpid ( pid, 0, 0 );
+
+	esprom_close ( ep );
+	close ( master );
+}
+
+int
+main ( int argc, char **argv )
+{
+	srand ( 1234 );
+
+	test_known ();
+	test_frames ();
+	test_random ();
+	test_checksum ();
+	test_packets ();
+	test_port ();
+
+	printf ( "libesprom: %d tests, %d failed\n", ntest, nfail );
+	return nfail ? 1 : 0;
+}
+
+/* THE END */
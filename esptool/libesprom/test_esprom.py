@@ -0,0 +1,68 @@
+# test_esprom.py
+#
+# Check the python bindings against the plain python way
+#  esptool does it without them.  "make test" runs this.
+
+import sys
+import random
+import esprom
+
+def py_encode(packet):
+    return b'\xc0' + packet.replace(b'\xdb', b'\xdb\xdd').replace(b'\xc0', b'\xdb\xdc') + b'\xc0'
+
+def py_checksum(data, state = 0xef):
+    for b in data:
+        state ^= b
+    return state
+
+tests = 0
+failed = 0
+
+def check(ok, what):
+    global tests, failed
+    tests += 1
+    if not ok:
+        print ( 'FAIL: %s' % what )
+        failed += 1
+
+random.seed(1234)
+nasty = b'\xc0\xdb\xdc\xdd'
+
+packets = []
+for i in range(500):
+    n = random.randrange(6000)
+    if i & 1:
+        pkt = bytes(random.choice(nasty) for _ in range(n))
+    else:
+        pkt = bytes(random.getrandbits(8) for _ in range(n))
+    packets.append(pkt)
+
+check(all(esprom.encode(p) == py_encode(p) for p in packets), 'encode')
+check(all(esprom.checksum(p) == py_checksum(p) for p in packets), 'checksum')
+check(esprom.checksum(b'\x01\x02', 0x10) == py_checksum(b'\x01\x02', 0x10), 'checksum with a state')
+
+# all of it in odd sized pieces, frames have to come out whole
+# (the empty packet makes no frame)
+stream = b''.join(py_encode(p) for p in packets)
+d = esprom.Decoder(1024)
+got = []
+pos = 0
+while pos < len(stream):
+    n = random.randrange(1, 9000)
+    got += d.feed(stream[pos:pos + n])
+    pos += n
+check(got == [ p for p in packets if p ], 'decode in pieces')
+check(d.feed(b'') == [], 'nothing left over')
+
+# a bad escape comes back empty, and the next frame is fine
+check(d.feed(b'\xc0ab\xdb\x01\xc0\xc0ok\xc0') == [ b'', b'ok' ], 'bad escape')
+
+# reset drops a partial frame
+d.feed(b'\xc0part')
+d.reset()
+check(d.feed(b'\xc0new\xc0') == [ b'new' ], 'reset')
+
+print ( 'esprom.py: %d tests, %d failed' % (tests, failed) )
+sys.exit(1 if failed else 0)
+
+# THE END
@@ -0,0 +1,229 @@
+/* hal_esp.c
+ * Part of the flasher stub, the parts that touch the hardware.
+ *
+ * The uart is from NoSDK/uart/esp_uart.c, the flash
+ * is done by calling the routines in the bootrom.
+ *
+ * Received bytes are moved from the uart fifo (128 bytes) into
+ * a big ring buffer by an interrupt routine.  esptool sends the
+ * next block while we are busy inflating and writing the last one,
+ * and it has to go somewhere.  Writing a sector takes a while,
+ * erasing one takes 30-50 ms, and a 4K block at 921600 baud
+ * comes in over 45 ms, so we have room for a few blocks.
+ * esptool keeps no more than WINDOW blocks in flight, but if the
+ * ring does fill up anyway, we drop what comes in and the checksum
+ * or the frame check catches it.
+ *
+ * The ROM set the uart clock divisor when it did its autobaud
+ * business, so divisor times the old rate gives us the clock
+ * (52 Mhz for a 26 Mhz crystal), whatever crystal this board has.
+ */
+
+#include "stub.h"
+
+#define UART_BASE	0x60000000
+
+/* ETS_UART_INUM in the SDK */
+#define UART_INUM	5
+
+struct uart {
+	volatile unsigned long fifo;		/* 00 */
+	volatile unsigned long int_raw;		/* 04 */
+	volatile unsigned long int_status;	/* 08 */
+	volatile unsigned long int_ena;		/* 0c */
+	volatile unsigned long int_clear;	/* 10 */
+	volatile unsigned long clkdiv;		/* 14 */
+	volatile unsigned long autobaud;	/* 18 */
+	volatile unsigned long status;		/* 1c */
+	volatile unsigned long conf0;		/* 20 */
+	volatile unsigned long conf1;		/* 24 */
+};
+
+#define CLKDIV_MASK	0x000fffff
+
+#define ST_TX_MASK	0x00ff0000
+#define ST_RX_MASK	0x000000ff
+#define ST_TX_SHIFT	16
+
+/* bits in conf1 register */
+#define C1_RX_TOUT	0x80000000	/* Rx timeout enable */
+#define C1_RX_THR_SHIFT	24
+#define C1_RX_FULL	0x0000007f	/* Rx full threshold */
+
+/* bits in the interrupt registers */
+#define INT_RX_FULL	0x001
+#define INT_RX_TOUT	0x100
+
+#define TX_FIFO_SIZE	128
+
+/* In the bootrom */
+int SPIEraseSector ( int );
+int SPIWrite ( unsigned int, void *, int );
+int SPIRead ( unsigned int, void *, int );
+void ets_isr_attach ( int, void (*) ( void * ), void * );
+void ets_isr_unmask ( unsigned int );
+void software_reset ( void );
+void ets_delay_us ( int );
+
+/* From the linker script */
+extern char _bss_start[];
+extern char _bss_end[];
+
+#define RING_SIZE	16384
+
+static unsigned char ring[RING_SIZE];
+static volatile int ring_in;
+static volatile int ring_out;
+
+static unsigned int old_div;
+
+static void
+uart_isr ( void *arg )
+{
+	struct uart *up = (struct uart *) UART_BASE;
+	int next;
+	int c;
+
+	while ( up->status & ST_RX_MASK ) {
+	    c = up->fifo;
+	    next = (ring_in + 1) & (RING_SIZE - 1);
+	    if ( next == ring_out )
+		continue;
+	    ring[ring_in] = c;
+	    ring_in = next;
+	}
+	up->int_clear = INT_RX_FULL | INT_RX_TOUT;
+}
+
+void
+hal_init ( void )
+{
+	struct uart *up = (struct uart *) UART_BASE;
+	char *p;
+
+	/* we get here from the ROM, nobody else does this */
+	for ( p = _bss_start; p < _bss_end; p++ )
+	    *p = 0;
+
+	up->int_ena = 0;
+	up->int_clear = 0xffff;
+
+	/* interrupt when the fifo is half full, or after
+	 * a couple of character times with nothing new.
+	 */
+	up->conf1 = C1_RX_TOUT | (2 << C1_RX_THR_SHIFT) | 64;
+
+	ets_isr_attach ( UART_INUM, uart_isr, 0 );
+	up->int_ena = INT_RX_FULL | INT_RX_TOUT;
+	ets_isr_unmask ( 1 << UART_INUM );
+}
+
+int
+hal_getc ( void )
+{
+	int c;
+
+	while ( ring_out == ring_in )
+	    ;
+	c = ring[ring_out];
+	ring_out = (ring_out + 1) & (RING_SIZE - 1);
+	return c;
+}
+
+void
+hal_putc ( int c )
+{
+	struct uart *up = (struct uart *) UART_BASE;
+
+	while ( ((up->status & ST_TX_MASK) >> ST_TX_SHIFT) >= TX_FIFO_SIZE - 1 )
+	    ;
+	up->fifo = c;
+}
+
+int
+hal_getc_timeout ( int ms )
+{
+	int n = ms * 100;
+
+	while ( ring_out == ring_in ) {
+	    if ( n-- <= 0 )
+		return -1;
+	    ets_delay_us ( 10 );
+	}
+	return hal_getc ();
+}
+
+/* Wait for the fifo to drain */
+void
+hal_flush ( void )
+{
+	struct uart *up = (struct uart *) UART_BASE;
+
+	while ( up->status & ST_TX_MASK )
+	    ;
+}
+
+void
+hal_set_baud ( unsigned int new, unsigned int old )
+{
+	struct uart *up = (struct uart *) UART_BASE;
+	unsigned int clock;
+
+	/* the fifo is empty, let the last character get out */
+	hal_flush ();
+	ets_delay_us ( 12 * 1000000 / old + 1 );
+
+	old_div = up->clkdiv & CLKDIV_MASK;
+	clock = old_div * old;
+	up->clkdiv = (clock + new / 2) / new;
+}
+
+/* It didn't work, back to what we had */
+void
+hal_restore_baud ( void )
+{
+	struct uart *up = (struct uart *) UART_BASE;
+
+	up->clkdiv = old_div;
+}
+
+unsigned int
+hal_read_reg ( unsigned int addr )
+{
+	return *(volatile unsigned int *) addr;
+}
+
+void
+hal_write_reg ( unsigned int addr, unsigned int val, unsigned int mask )
+{
+	volatile unsigned int *p = (volatile unsigned int *) addr;
+
+	*p = (*p & ~mask) | (val & mask);
+}
+
+void
+hal_reboot ( void )
+{
+	hal_flush ();
+	software_reset ();
+}
+
+int
+flash_erase ( unsigned int addr )
+{
+	return SPIEraseSector ( addr / SECTOR_SIZE );
+}
+
+int
+flash_write ( unsigned int addr, unsigned char *buf, int len )
+{
+	return SPIWrite ( addr, buf, len );
+}
+
+int
+flash_read ( unsigned int addr, unsigned char *buf, int len )
+{
+	return SPIRead ( addr, buf, len );
+}
+
+/* THE END */
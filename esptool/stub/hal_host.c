@@ -0,0 +1,228 @@
+/* hal_host.c
+ * Part of the flasher stub, the hardware parts for running it
+ * on linux.  This is how espemu runs the stub when esptool loads it.
+ *
+ *   stub_host [-c fd] flash.bin
+ *
+ * The "uart" is stdin and stdout, the flash is a file which we
+ * map and treat like NOR flash: erase sets a sector to 0xff and
+ * a write can only clear bits.  So if we forget to erase, it shows.
+ * When we exit, a summary of what we did goes to stderr.
+ *
+ * There is no uart clock, but we keep a divisor like the real one
+ * so a baud rate change comes out the same odd numbers it would on
+ * the chip, and we tell espemu about it on the -c file descriptor.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "stub.h"
+
+static unsigned char *flash;
+static unsigned int flash_size;
+
+static unsigned char ibuf[4096];
+static int icount;
+static int inext;
+
+static unsigned char obuf[4096];
+static int ocount;
+
+/* what the ROM runs the uart with */
+#define UART_CLOCK	52000000
+
+static int ctl_fd = -1;
+static unsigned int clkdiv;
+static unsigned int old_div;
+
+static int nerase;
+static unsigned int nwrite;
+
+static void
+summary ( void )
+{
+	fprintf ( stderr, "stub_host: %d sectors erased, %u bytes written\n", nerase, nwrite );
+}
+
+void
+hal_init ( void )
+{
+}
+
+int
+hal_getc ( void )
+{
+	if ( inext >= icount ) {
+	    hal_flush ();
+	    icount = read ( 0, ibuf, sizeof(ibuf) );
+	    if ( icount <= 0 ) {
+		summary ();
+		exit ( 0 );
+	    }
+	    inext = 0;
+	}
+	return ibuf[inext++];
+}
+
+int
+hal_getc_timeout ( int ms )
+{
+	struct pollfd pfd;
+
+	if ( inext >= icount ) {
+	    hal_flush ();
+	    pfd.fd = 0;
+	    pfd.events = POLLIN;
+	    if ( poll ( &pfd, 1, ms ) <= 0 )
+		return -1;
+	}
+	return hal_getc ();
+}
+
+void
+hal_putc ( int c )
+{
+	if ( ocount >= sizeof(obuf) )
+	    hal_flush ();
+	obuf[ocount++] = c;
+}
+
+void
+hal_flush ( void )
+{
+	int n;
+	int done = 0;
+
+	while ( done < ocount ) {
+	    n = write ( 1, &obuf[done], ocount - done );
+	    if ( n <= 0 ) {
+		summary ();
+		exit ( 1 );
+	    }
+	    done += n;
+	}
+	ocount = 0;
+}
+
+static void
+tell_baud ( void )
+{
+	char buf[32];
+
+	if ( ctl_fd >= 0 ) {
+	    sprintf ( buf, "baud %d\n", UART_CLOCK / clkdiv );
+	    write ( ctl_fd, buf, strlen ( buf ) );
+	}
+}
+
+void
+hal_set_baud ( unsigned int new, unsigned int old )
+{
+	hal_flush ();
+
+	/* The ROM autobaud gets about this */
+	if ( ! clkdiv )
+	    clkdiv = (UART_CLOCK + old / 2) / old;
+	old_div = clkdiv;
+	clkdiv = (clkdiv * old + new / 2) / new;
+	tell_baud ();
+}
+
+void
+hal_restore_baud ( void )
+{
+	clkdiv = old_div;
+	tell_baud ();
+}
+
+unsigned int
+hal_read_reg ( unsigned int addr )
+{
+	return 0;
+}
+
+void
+hal_write_reg ( unsigned int addr, unsigned int val, unsigned int mask )
+{
+}
+
+void
+hal_reboot ( void )
+{
+	hal_flush ();
+	summary ();
+	exit ( 0 );
+}
+
+int
+flash_erase ( unsigned int addr )
+{
+	if ( addr + SECTOR_SIZE > flash_size )
+	    return 1;
+	memset ( &flash[addr], 0xff, SECTOR_SIZE );
+	nerase++;
+	return 0;
+}
+
+int
+flash_write ( unsigned int addr, unsigned char *buf, int len )
+{
+	int i;
+
+	if ( (addr & 3) || (len & 3) || addr + len > flash_size )
+	    return 1;
+	for ( i=0; i<len; i++ )
+	    flash[addr+i] &= buf[i];
+	nwrite += len;
+	return 0;
+}
+
+int
+flash_read ( unsigned int addr, unsigned char *buf, int len )
+{
+	if ( addr + len > flash_size )
+	    return 1;
+	memcpy ( buf, &flash[addr], len );
+	return 0;
+}
+
+int
+main ( int argc, char **argv )
+{
+	struct stat st;
+	int fd;
+
+	if ( argc == 4 && strcmp ( argv[1], "-c" ) == 0 ) {
+	    ctl_fd = atoi ( argv[2] );
+	    argc -= 2;
+	    argv += 2;
+	}
+	if ( argc != 2 ) {
+	    fprintf ( stderr, "Usage: stub_host [-c fd] flash.bin\n" );
+	    exit ( 1 );
+	}
+
+	fd = open ( argv[1], O_RDWR );
+	if ( fd < 0 || fstat ( fd, &st ) < 0 ) {
+	    fprintf ( stderr, "Cannot open %s\n", argv[1] );
+	    exit ( 1 );
+	}
+	flash_size = st.st_size;
+	flash = mmap ( NULL, flash_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+	if ( flash == MAP_FAILED ) {
+	    fprintf ( stderr, "Cannot map %s\n", argv[1] );
+	    exit ( 1 );
+	}
+
+	stub_main ();
+	return 0;
+}
+
+/* THE END */
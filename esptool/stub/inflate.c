@@ -0,0 +1,410 @@
+/* inflate.c
+ * Part of the flasher stub
+ *
+ * A small streaming inflater (raw deflate, RFC 1951).
+ * This follows Mark Adler's "puff", but takes its input a byte at a
+ * time from a routine we are handed (which goes off and gets the next
+ * packet when it needs to), and hands its output back 4K at a time,
+ * a flash sector, from the 32K window it needs for back references.
+ *
+ * Size matters more than speed here (it lives in IRAM along with
+ * everything else), so the huffman decode goes a bit at a time
+ * just like puff does.  It is still much faster than the uart.
+ */
+
+#include "stub.h"
+
+#define WSIZE		32768
+#define FLUSH_SIZE	SECTOR_SIZE
+
+#define MAXBITS		15
+#define MAXLCODES	286
+#define MAXDCODES	30
+#define FIXLCODES	288
+
+/* Reasons to give up */
+#define INF_INPUT	1
+#define INF_OUTPUT	2
+#define INF_BAD_TYPE	3
+#define INF_BAD_STORED	4
+#define INF_BAD_CODE	5
+#define INF_BAD_DIST	6
+#define INF_BAD_TABLE	7
+
+struct huff {
+	short count[MAXBITS+1];
+	short symbol[FIXLCODES];
+};
+
+static unsigned char window[WSIZE] __attribute__ ((aligned(4)));
+static int wpos;
+static unsigned int total;
+
+static unsigned int bitbuf;
+static int bitcnt;
+static int error;
+
+static int (*get_byte) ( void );
+static int (*put_block) ( unsigned char *, int );
+
+static struct huff lencode;
+static struct huff distcode;
+
+static struct huff fixlen;
+static struct huff fixdist;
+static int fixed_built;
+
+static const short len_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const short len_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const short dist_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577 };
+static const short dist_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+/* The order code length code lengths come in */
+static const short order[19] = {
+	16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+static unsigned int
+bits ( int need )
+{
+	unsigned int val;
+	int c;
+
+	while ( bitcnt < need ) {
+	    c = (*get_byte) ();
+	    if ( c < 0 ) {
+		error = INF_INPUT;
+		return 0;
+	    }
+	    bitbuf |= (unsigned int) c << bitcnt;
+	    bitcnt += 8;
+	}
+
+	val = bitbuf & ((1 << need) - 1);
+	bitbuf >>= need;
+	bitcnt -= need;
+	return val;
+}
+
+/* Hand back a sector when we have one, wrapping the window */
+static void
+out_byte ( int c )
+{
+	window[wpos++] = c;
+	total++;
+
+	if ( (wpos & (FLUSH_SIZE - 1)) == 0 ) {
+	    if ( (*put_block) ( &window[wpos - FLUSH_SIZE], FLUSH_SIZE ) )
+		error = INF_OUTPUT;
+	    wpos &= WSIZE - 1;
+	}
+}
+
+static int
+decode ( struct huff *h )
+{
+	int code = 0;
+	int first = 0;
+	int index = 0;
+	int len;
+	int count;
+
+	for ( len = 1; len <= MAXBITS; len++ ) {
+	    code |= bits ( 1 );
+	    if ( error )
+		return -1;
+	    count = h->count[len];
+	    if ( code - count < first )
+		return h->symbol[index + (code - first)];
+	    index += count;
+	    first += count;
+	    first <<= 1;
+	    code <<= 1;
+	}
+
+	error = INF_BAD_CODE;
+	return -1;
+}
+
+/* Canonical huffman tables from a list of code lengths.
+ * Zero means the code is complete, negative is over-subscribed,
+ * positive is incomplete (which is only OK for a single code).
+ */
+static int
+construct ( struct huff *h, short *length, int n )
+{
+	short offs[MAXBITS+1];
+	int sym;
+	int len;
+	int left;
+
+	for ( len = 0; len <= MAXBITS; len++ )
+	    h->count[len] = 0;
+	for ( sym = 0; sym < n; sym++ )
+	    h->count[length[sym]]++;
+	if ( h->count[0] == n )
+	    return 0;
+
+	left = 1;
+	for ( len = 1; len <= MAXBITS; len++ ) {
+	    left <<= 1;
+	    left -= h->count[len];
+	    if ( left < 0 )
+		return left;
+	}
+
+	offs[1] = 0;
+	for ( len = 1; len < MAXBITS; len++ )
+	    offs[len + 1] = offs[len] + h->count[len];
+
+	for ( sym = 0; sym < n; sym++ )
+	    if ( length[sym] != 0 )
+		h->symbol[offs[length[sym]]++] = sym;
+
+	return left;
+}
+
+static void
+stored ( void )
+{
+	unsigned int len;
+	int c;
+
+	bitbuf = 0;
+	bitcnt = 0;
+
+	len = bits ( 16 );
+	if ( (bits ( 16 ) ^ 0xffff) != len ) {
+	    if ( ! error )
+		error = INF_BAD_STORED;
+	    return;
+	}
+
+	while ( len-- && ! error ) {
+	    c = (*get_byte) ();
+	    if ( c < 0 ) {
+		error = INF_INPUT;
+		return;
+	    }
+	    out_byte ( c );
+	}
+}
+
+static void
+codes ( struct huff *lc, struct huff *dc )
+{
+	int sym;
+	int len;
+	unsigned int dist;
+	int from;
+
+	for ( ;; ) {
+	    sym = decode ( lc );
+	    if ( error )
+		return;
+
+	    if ( sym < 256 ) {
+		out_byte ( sym );
+		if ( error )
+		    return;
+		continue;
+	    }
+	    if ( sym == 256 )
+		return;
+
+	    sym -= 257;
+	    if ( sym >= 29 ) {
+		error = INF_BAD_CODE;
+		return;
+	    }
+	    len = len_base[sym] + bits ( len_extra[sym] );
+
+	    sym = decode ( dc );
+	    if ( error )
+		return;
+	    if ( sym >= 30 ) {
+		error = INF_BAD_CODE;
+		return;
+	    }
+	    dist = dist_base[sym] + bits ( dist_extra[sym] );
+	    if ( error )
+		return;
+	    if ( dist > total || dist > WSIZE ) {
+		error = INF_BAD_DIST;
+		return;
+	    }
+
+	    from = (wpos - dist) & (WSIZE - 1);
+	    while ( len-- && ! error ) {
+		out_byte ( window[from] );
+		from = (from + 1) & (WSIZE - 1);
+	    }
+	    if ( error )
+		return;
+	}
+}
+
+static void
+fixed ( void )
+{
+	short lengths[FIXLCODES];
+	int sym;
+
+	if ( ! fixed_built ) {
+	    for ( sym = 0; sym < 144; sym++ )
+		lengths[sym] = 8;
+	    for ( ; sym < 256; sym++ )
+		lengths[sym] = 9;
+	    for ( ; sym < 280; sym++ )
+		lengths[sym] = 7;
+	    for ( ; sym < FIXLCODES; sym++ )
+		lengths[sym] = 8;
+	    construct ( &fixlen, lengths, FIXLCODES );
+
+	    for ( sym = 0; sym < MAXDCODES; sym++ )
+		lengths[sym] = 5;
+	    construct ( &fixdist, lengths, MAXDCODES );
+	    fixed_built = 1;
+	}
+
+	codes ( &fixlen, &fixdist );
+}
+
+static void
+dynamic ( void )
+{
+	short lengths[MAXLCODES + MAXDCODES];
+	int nlen, ndist, ncode;
+	int index;
+	int len;
+	int sym;
+	int err;
+
+	nlen = bits ( 5 ) + 257;
+	ndist = bits ( 5 ) + 1;
+	ncode = bits ( 4 ) + 4;
+	if ( error )
+	    return;
+	if ( nlen > MAXLCODES || ndist > MAXDCODES ) {
+	    error = INF_BAD_TABLE;
+	    return;
+	}
+
+	for ( index = 0; index < ncode; index++ )
+	    lengths[order[index]] = bits ( 3 );
+	for ( ; index < 19; index++ )
+	    lengths[order[index]] = 0;
+	if ( error )
+	    return;
+
+	if ( construct ( &lencode, lengths, 19 ) != 0 ) {
+	    error = INF_BAD_TABLE;
+	    return;
+	}
+
+	index = 0;
+	while ( index < nlen + ndist ) {
+	    sym = decode ( &lencode );
+	    if ( error )
+		return;
+	    if ( sym < 16 ) {
+		lengths[index++] = sym;
+		continue;
+	    }
+
+	    len = 0;
+	    if ( sym == 16 ) {
+		if ( index == 0 ) {
+		    error = INF_BAD_TABLE;
+		    return;
+		}
+		len = lengths[index - 1];
+		sym = 3 + bits ( 2 );
+	    } else if ( sym == 17 )
+		sym = 3 + bits ( 3 );
+	    else
+		sym = 11 + bits ( 7 );
+
+	    if ( error )
+		return;
+	    if ( index + sym > nlen + ndist ) {
+		error = INF_BAD_TABLE;
+		return;
+	    }
+	    while ( sym-- )
+		lengths[index++] = len;
+	}
+
+	/* there has to be an end of block code */
+	if ( lengths[256] == 0 ) {
+	    error = INF_BAD_TABLE;
+	    return;
+	}
+
+	err = construct ( &lencode, lengths, nlen );
+	if ( err && (err < 0 || nlen != lencode.count[0] + lencode.count[1]) ) {
+	    error = INF_BAD_TABLE;
+	    return;
+	}
+	err = construct ( &distcode, lengths + nlen, ndist );
+	if ( err && (err < 0 || ndist != distcode.count[0] + distcode.count[1]) ) {
+	    error = INF_BAD_TABLE;
+	    return;
+	}
+
+	codes ( &lencode, &distcode );
+}
+
+/* Inflate one raw deflate stream.
+ * Returns 0 if all went well, or the reason we gave up.
+ * Whatever is left in the window at the end (less than a sector)
+ * gets handed back too.
+ */
+int
+inflate ( int (*get) ( void ), int (*put) ( unsigned char *, int ) )
+{
+	int last;
+	int type;
+
+	get_byte = get;
+	put_block = put;
+
+	wpos = 0;
+	total = 0;
+	bitbuf = 0;
+	bitcnt = 0;
+	error = 0;
+
+	do {
+	    last = bits ( 1 );
+	    type = bits ( 2 );
+	    if ( error )
+		break;
+
+	    if ( type == 0 )
+		stored ();
+	    else if ( type == 1 )
+		fixed ();
+	    else if ( type == 2 )
+		dynamic ();
+	    else
+		error = INF_BAD_TYPE;
+	} while ( ! last && ! error );
+
+	if ( ! error && (wpos & (FLUSH_SIZE - 1)) ) {
+	    if ( (*put_block) ( &window[wpos & ~(FLUSH_SIZE - 1)], wpos & (FLUSH_SIZE - 1) ) )
+		error = INF_OUTPUT;
+	}
+
+	return error;
+}
+
+/* THE END */
@@ -0,0 +1,663 @@
+/* stub.c
+ * The flasher stub
+ *
+ * esptool loads this into IRAM with mem_begin/mem_block/mem_finish
+ * (just like SFLASH_STUB for read_flash) and jumps to stub_main.
+ * We say "OHAI" and then talk the same protocol as the ROM loader,
+ * a SLIP frame for each command and each response:
+ *
+ *	command:  00 op len(2) chk(4) data ...
+ *	response: 01 op len(2) val(4) status error
+ *
+ * What we add is ESP_FLASH_DEFL_BEGIN/DATA/END, which take
+ * the image as raw deflate data (zlib with no header) in blocks
+ * of up to MAX_BLOCK.  A typical image is code followed by a lot
+ * of 0xff padding, and that squeezes down a lot.
+ *
+ * The inflater pulls bytes as it needs them.  When it runs off the
+ * end of a packet, we read the next DATA packet and ACK it right
+ * away, before we inflate it and write flash.  A problem inflating
+ * or writing shows up in the response to the next DATA packet, or
+ * to END, which is not sent until the last sector is in the flash.
+ *
+ * esptool doesn't wait for each ACK, it keeps up to WINDOW blocks
+ * in flight (we tell it WINDOW in the BEGIN response), so the line
+ * stays busy no matter how slow the usb serial gizmo is to turn
+ * around.  Each DATA has a sequence number, and the ACK value is how
+ * many blocks we have with no gaps, so a lost ACK doesn't matter.
+ * The checksum on a DATA packet is not the ROM's xor, but a CRC32
+ * of the block header and data, so a bit error in the sequence number
+ * can't put good data in the wrong place, and two errors can't cancel.
+ * A block with a bad checksum gets an error response with its
+ * sequence number, and esptool sends just that one again.  Blocks
+ * that come in after it are kept in hold[] until it shows up.
+ *
+ * Flash is erased a sector at a time as we get to it.
+ *
+ * ESP_FLASH_CRC (address, count) gives back the CRC32 of each 4K
+ * sector, the same CRC as zlib.crc32.  esptool works out the same
+ * thing for the image it has, and only sends the sectors that differ,
+ * then asks again to check what it wrote.
+ *
+ * ESP_READ (address, size, what) reads flash (READ_FLASH) or memory
+ * (READ_MEM, a word at a time, so IRAM and the ROM work) and sends
+ * it all without waiting to be asked again.  After the response come
+ * frames of up to a sector of data, each followed by its CRC32, so
+ * esptool can tell if one got hurt and ask for the rest again.  If
+ * we can't read the flash, the frame is just the two status bytes.
+ *
+ * ESP_CHANGE_BAUD (new rate, old rate) gets answered at the old rate,
+ * then we switch.  If esptool doesn't send us a good frame at the new
+ * rate within BAUD_TIMEOUT, we figure it didn't work out (the usb
+ * serial gizmo can't do it, or the wires are too long) and go back.
+ */
+
+#include "stub.h"
+
+/* a header, some block header words and a block */
+#define MAX_PKT		(8 + 16 + MAX_BLOCK)
+
+static unsigned char pkt[MAX_PKT] __attribute__ ((aligned(4)));
+static int pkt_len;
+static int pkt_held;
+
+/* The deflate transfer */
+static int defl_active;
+static int defl_error;
+static unsigned int defl_addr;
+static unsigned int defl_end;
+static int defl_seq;
+static int defl_blocks;
+static unsigned char *defl_ptr;
+static int defl_count;
+
+/* DATA blocks that came before the one we want */
+#define NHOLD	(WINDOW - 1)
+
+static unsigned char hold[NHOLD][MAX_BLOCK] __attribute__ ((aligned(4)));
+static int hold_seq[NHOLD];
+static int hold_size[NHOLD];
+
+/* For reading flash, a sector at a time */
+static unsigned char fbuf[SECTOR_SIZE] __attribute__ ((aligned(4)));
+
+static unsigned int crc_table[256];
+static unsigned int crcs[MAX_CRC];
+
+static unsigned int
+get32 ( unsigned char *p )
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | p[3] << 24;
+}
+
+static void
+slip_putc ( int c )
+{
+	if ( c == 0xc0 ) {
+	    hal_putc ( 0xdb );
+	    hal_putc ( 0xdc );
+	} else if ( c == 0xdb ) {
+	    hal_putc ( 0xdb );
+	    hal_putc ( 0xdd );
+	} else
+	    hal_putc ( c );
+}
+
+static void
+send_frame ( unsigned char *buf, int len )
+{
+	hal_putc ( 0xc0 );
+	while ( len-- )
+	    slip_putc ( *buf++ );
+	hal_putc ( 0xc0 );
+	hal_flush ();
+}
+
+static void
+respond ( int op, unsigned int val, int err )
+{
+	unsigned char buf[10];
+
+	buf[0] = 1;
+	buf[1] = op;
+	buf[2] = 2;
+	buf[3] = 0;
+	buf[4] = val;
+	buf[5] = val >> 8;
+	buf[6] = val >> 16;
+	buf[7] = val >> 24;
+	buf[8] = err ? 1 : 0;
+	buf[9] = err;
+	send_frame ( buf, 10 );
+}
+
+static int
+next_c ( int ms )
+{
+	if ( ms )
+	    return hal_getc_timeout ( ms );
+	return hal_getc ();
+}
+
+/* Read the next SLIP frame into pkt.
+ * Anything before the first 0xc0 is noise and gets tossed.
+ * A frame too big for us comes back as length -1.
+ * With ms, give up (return -1) if nothing comes for that long.
+ */
+static int
+read_frame ( int ms )
+{
+	int c;
+	int n = 0;
+	int bad = 0;
+
+	do {
+	    c = next_c ( ms );
+	    if ( c < 0 )
+		return -1;
+	} while ( c != 0xc0 );
+
+	for ( ;; ) {
+	    c = next_c ( ms );
+	    if ( c < 0 )
+		return -1;
+	    if ( c == 0xc0 ) {
+		if ( n == 0 && ! bad )
+		    continue;
+		break;
+	    }
+	    if ( c == 0xdb ) {
+		c = next_c ( ms );
+		if ( c < 0 )
+		    return -1;
+		if ( c == 0xdc )
+		    c = 0xc0;
+		else if ( c == 0xdd )
+		    c = 0xdb;
+		else
+		    bad = 1;
+	    }
+	    if ( n < MAX_PKT )
+		pkt[n++] = c;
+	    else
+		bad = 1;
+	}
+
+	pkt_len = bad ? -1 : n;
+	return 0;
+}
+
+static void
+get_frame ( void )
+{
+	if ( pkt_held ) {
+	    pkt_held = 0;
+	    return;
+	}
+	read_frame ( 0 );
+}
+
+/* Check the header, hands back the error code */
+static int
+check_frame ( void )
+{
+	if ( pkt_len < 8 || pkt[0] != 0 )
+	    return ERR_BAD_FRAME;
+	if ( (pkt[2] | pkt[3] << 8) != pkt_len - 8 )
+	    return ERR_BAD_FRAME;
+	return 0;
+}
+
+/* A response with some data ahead of the status bytes */
+static void
+respond_data ( int op, unsigned char *buf, int len, int err )
+{
+	unsigned char hdr[8];
+	int i;
+
+	hdr[0] = 1;
+	hdr[1] = op;
+	hdr[2] = len + 2;
+	hdr[3] = (len + 2) >> 8;
+	hdr[4] = hdr[5] = hdr[6] = hdr[7] = 0;
+
+	hal_putc ( 0xc0 );
+	for ( i=0; i<8; i++ )
+	    slip_putc ( hdr[i] );
+	for ( i=0; i<len; i++ )
+	    slip_putc ( buf[i] );
+	slip_putc ( err ? 1 : 0 );
+	slip_putc ( err );
+	hal_putc ( 0xc0 );
+	hal_flush ();
+}
+
+/* CRC32 as zlib does it (and ethernet, and png) */
+static void
+crc_init ( void )
+{
+	unsigned int c;
+	int i, k;
+
+	for ( i=0; i<256; i++ ) {
+	    c = i;
+	    for ( k=0; k<8; k++ )
+		c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+	    crc_table[i] = c;
+	}
+}
+
+static unsigned int
+crc32 ( unsigned char *buf, int len )
+{
+	unsigned int crc = 0xffffffff;
+
+	while ( len-- )
+	    crc = crc_table[(crc ^ *buf++) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+/* ------------------------------------------------------------ */
+
+static int
+find_held ( int seq )
+{
+	int i;
+
+	for ( i=0; i<NHOLD; i++ )
+	    if ( hold_seq[i] == seq )
+		return i;
+	return -1;
+}
+
+/* What we ACK, every block up to here is in hand */
+static int
+defl_acked ( void )
+{
+	int seq = defl_seq;
+
+	while ( find_held ( seq ) >= 0 )
+	    seq++;
+	return seq;
+}
+
+/* Keep a block that came early.
+ * Since it is inside the window, there is always a free slot.
+ */
+static void
+hold_block ( int seq, unsigned char *buf, int size )
+{
+	int i = find_held ( -1 );
+	int n;
+
+	if ( i < 0 )
+	    return;
+	for ( n=0; n<size; n++ )
+	    hold[i][n] = buf[n];
+	hold_seq[i] = seq;
+	hold_size[i] = size;
+}
+
+/* The inflater wants a byte.
+ * If this packet is used up, get the next one, which might
+ * be waiting in hold[].  Only then do we read another frame,
+ * so a block we are working on never gets overwritten.
+ */
+static int
+defl_getc ( void )
+{
+	unsigned char *data;
+	int size;
+	int seq;
+	int err;
+	int i;
+
+	while ( defl_count == 0 ) {
+	    i = find_held ( defl_seq );
+	    if ( i >= 0 ) {
+		/* already ACKed when it came in */
+		hold_seq[i] = -1;
+		defl_seq++;
+		defl_ptr = hold[i];
+		defl_count = hold_size[i];
+		break;
+	    }
+
+	    get_frame ();
+	    err = check_frame ();
+	    if ( err ) {
+		respond ( pkt_len >= 2 ? pkt[1] : 0, defl_seq, err );
+		continue;
+	    }
+
+	    /* Anything else, END for one, ends the transfer */
+	    if ( pkt[1] != ESP_FLASH_DEFL_DATA ) {
+		pkt_held = 1;
+		return -1;
+	    }
+
+	    data = &pkt[8];
+	    size = get32 ( &data[0] );
+	    seq = get32 ( &data[4] );
+
+	    if ( pkt_len < 24 || size != pkt_len - 24 ) {
+		respond ( ESP_FLASH_DEFL_DATA, defl_seq, ERR_BAD_FRAME );
+		continue;
+	    }
+	    /* send me that one again */
+	    if ( crc32 ( data, 16 + size ) != get32 ( &pkt[4] ) ) {
+		respond ( ESP_FLASH_DEFL_DATA, seq, ERR_CHECKSUM );
+		continue;
+	    }
+
+	    /* our ACK got lost, or it was sent again anyway */
+	    if ( seq < defl_seq || find_held ( seq ) >= 0 ) {
+		respond ( ESP_FLASH_DEFL_DATA, defl_acked (), 0 );
+		continue;
+	    }
+	    if ( seq >= defl_blocks || seq >= defl_seq + WINDOW ) {
+		respond ( ESP_FLASH_DEFL_DATA, defl_seq, ERR_BAD_FRAME );
+		continue;
+	    }
+
+	    if ( seq != defl_seq ) {
+		hold_block ( seq, &data[16], size );
+		respond ( ESP_FLASH_DEFL_DATA, defl_acked (), 0 );
+		continue;
+	    }
+
+	    /* Here is the ACK before we use it */
+	    defl_seq++;
+	    respond ( ESP_FLASH_DEFL_DATA, defl_acked (), 0 );
+	    defl_ptr = &data[16];
+	    defl_count = size;
+	}
+
+	defl_count--;
+	return *defl_ptr++;
+}
+
+/* The inflater has some output for us, a sector
+ * unless this is the end.
+ */
+static int
+defl_put ( unsigned char *buf, int len )
+{
+	unsigned int tail[1];
+	int n;
+
+	if ( defl_addr + len > defl_end ) {
+	    defl_error = ERR_TOO_MUCH;
+	    return 1;
+	}
+
+	if ( (defl_addr & (SECTOR_SIZE - 1)) == 0 ) {
+	    if ( flash_erase ( defl_addr ) ) {
+		defl_error = ERR_FLASH;
+		return 1;
+	    }
+	}
+
+	/* The SPI routines want whole words */
+	n = len & ~3;
+	if ( n && flash_write ( defl_addr, buf, n ) ) {
+	    defl_error = ERR_FLASH;
+	    return 1;
+	}
+	if ( n < len ) {
+	    tail[0] = 0xffffffff;
+	    for ( ; n < len; n++ )
+		((unsigned char *) tail)[n & 3] = buf[n];
+	    if ( flash_write ( defl_addr + (len & ~3), (unsigned char *) tail, 4 ) ) {
+		defl_error = ERR_FLASH;
+		return 1;
+	    }
+	}
+
+	defl_addr += len;
+	return 0;
+}
+
+/* size, blocks, block size, offset (like FLASH_BEGIN) */
+static void
+defl_begin ( unsigned char *data )
+{
+	unsigned int size = get32 ( &data[0] );
+	unsigned int offset = get32 ( &data[12] );
+	int i;
+
+	if ( pkt_len < 8 + 16 ) {
+	    respond ( ESP_FLASH_DEFL_BEGIN, 0, ERR_BAD_FRAME );
+	    return;
+	}
+	if ( offset & (SECTOR_SIZE - 1) ) {
+	    respond ( ESP_FLASH_DEFL_BEGIN, 0, ERR_ALIGN );
+	    return;
+	}
+
+	defl_addr = offset;
+	defl_end = offset + size;
+	defl_blocks = get32 ( &data[4] );
+	defl_seq = 0;
+	defl_count = 0;
+	defl_error = 0;
+	defl_active = 1;
+	for ( i=0; i<NHOLD; i++ )
+	    hold_seq[i] = -1;
+	respond ( ESP_FLASH_DEFL_BEGIN, WINDOW, 0 );
+
+	if ( inflate ( defl_getc, defl_put ) && ! defl_error )
+	    defl_error = ERR_INFLATE;
+	if ( ! defl_error && defl_addr != defl_end )
+	    defl_error = ERR_TOO_LITTLE;
+}
+
+/* DATA packets after inflate finished.
+ * If it gave up, this is how they find out.
+ * Otherwise it is one sent again that we already have.
+ */
+static void
+defl_data ( unsigned char *data )
+{
+	if ( ! defl_active )
+	    respond ( ESP_FLASH_DEFL_DATA, 0, ERR_NOT_BEGUN );
+	else if ( defl_error )
+	    respond ( ESP_FLASH_DEFL_DATA, 0, defl_error );
+	else if ( pkt_len >= 24 && get32 ( &data[4] ) < defl_seq )
+	    respond ( ESP_FLASH_DEFL_DATA, defl_seq, 0 );
+	else
+	    respond ( ESP_FLASH_DEFL_DATA, 0, ERR_TOO_MUCH );
+}
+
+/* A zero says reboot, like FLASH_END */
+static void
+defl_finish ( unsigned char *data )
+{
+	int err = defl_error;
+
+	if ( defl_active && ! err && defl_addr != defl_end )
+	    err = ERR_TOO_LITTLE;
+	defl_active = 0;
+	respond ( ESP_FLASH_DEFL_END, 0, err );
+
+	if ( pkt_len >= 12 && get32 ( data ) == 0 )
+	    hal_reboot ();
+}
+
+/* address, count of sectors */
+static void
+flash_crc ( unsigned char *data )
+{
+	unsigned int addr = get32 ( &data[0] );
+	unsigned int count = get32 ( &data[4] );
+	int i;
+
+	if ( pkt_len < 8 + 8 || count > MAX_CRC ) {
+	    respond ( ESP_FLASH_CRC, 0, ERR_BAD_FRAME );
+	    return;
+	}
+	if ( addr & (SECTOR_SIZE - 1) ) {
+	    respond ( ESP_FLASH_CRC, 0, ERR_ALIGN );
+	    return;
+	}
+
+	for ( i=0; i<count; i++ ) {
+	    if ( flash_read ( addr, fbuf, SECTOR_SIZE ) ) {
+		respond ( ESP_FLASH_CRC, 0, ERR_FLASH );
+		return;
+	    }
+	    crcs[i] = crc32 ( fbuf, SECTOR_SIZE );
+	    addr += SECTOR_SIZE;
+	}
+
+	/* little endian, like everything else */
+	respond_data ( ESP_FLASH_CRC, (unsigned char *) crcs, count * 4, 0 );
+}
+
+/* Data and its CRC as one frame, no hal_flush
+ * so the uart stays busy while we read the next one.
+ */
+static void
+send_chunk ( unsigned char *buf, int len, unsigned int crc )
+{
+	hal_putc ( 0xc0 );
+	while ( len-- )
+	    slip_putc ( *buf++ );
+	slip_putc ( crc & 0xff );
+	slip_putc ( (crc >> 8) & 0xff );
+	slip_putc ( (crc >> 16) & 0xff );
+	slip_putc ( crc >> 24 );
+	hal_putc ( 0xc0 );
+}
+
+/* address, size, READ_FLASH or READ_MEM */
+static void
+read_stream ( unsigned char *data )
+{
+	unsigned int addr = get32 ( &data[0] );
+	unsigned int size = get32 ( &data[4] );
+	unsigned int what = get32 ( &data[8] );
+	unsigned int *wp;
+	int n;
+	int i;
+
+	if ( pkt_len < 8 + 12 || what > READ_MEM ) {
+	    respond ( ESP_READ, 0, ERR_BAD_FRAME );
+	    return;
+	}
+	if ( addr & 3 ) {
+	    respond ( ESP_READ, 0, ERR_ALIGN );
+	    return;
+	}
+	respond ( ESP_READ, 0, 0 );
+
+	while ( size ) {
+	    n = size < SECTOR_SIZE ? size : SECTOR_SIZE;
+	    if ( what == READ_MEM ) {
+		wp = (unsigned int *) fbuf;
+		for ( i=0; i<n; i+=4 )
+		    *wp++ = hal_read_reg ( addr + i );
+	    } else if ( flash_read ( addr, fbuf, (n + 3) & ~3 ) ) {
+		fbuf[0] = 1;
+		fbuf[1] = ERR_FLASH;
+		send_frame ( fbuf, 2 );
+		return;
+	    }
+	    send_chunk ( fbuf, n, crc32 ( fbuf, n ) );
+	    addr += n;
+	    size -= n;
+	}
+	hal_flush ();
+}
+
+/* new rate, old rate */
+static void
+change_baud ( unsigned char *data )
+{
+	unsigned int new = get32 ( &data[0] );
+	unsigned int old = get32 ( &data[4] );
+
+	if ( pkt_len < 8 + 8 || new == 0 || old == 0 ) {
+	    respond ( ESP_CHANGE_BAUD, 0, ERR_BAD_FRAME );
+	    return;
+	}
+	respond ( ESP_CHANGE_BAUD, 0, 0 );
+	hal_set_baud ( new, old );
+
+	/* Garbage doesn't count, a good frame gets held for command() */
+	for ( ;; ) {
+	    if ( read_frame ( BAUD_TIMEOUT ) < 0 ) {
+		hal_restore_baud ();
+		return;
+	    }
+	    if ( check_frame () == 0 ) {
+		pkt_held = 1;
+		return;
+	    }
+	}
+}
+
+static void
+command ( void )
+{
+	unsigned char *data = &pkt[8];
+	int op;
+	int err;
+
+	err = check_frame ();
+	op = pkt_len >= 2 ? pkt[1] : 0;
+	if ( err ) {
+	    respond ( op, 0, err );
+	    return;
+	}
+
+	switch ( op ) {
+	    case ESP_SYNC:
+		respond ( op, 0, 0 );
+		break;
+	    case ESP_READ_REG:
+		respond ( op, hal_read_reg ( get32 ( data ) ), 0 );
+		break;
+	    case ESP_WRITE_REG:
+		hal_write_reg ( get32 ( data ), get32 ( &data[4] ), get32 ( &data[8] ) );
+		respond ( op, 0, 0 );
+		break;
+	    case ESP_FLASH_DEFL_BEGIN:
+		defl_begin ( data );
+		break;
+	    case ESP_FLASH_DEFL_DATA:
+		defl_data ( data );
+		break;
+	    case ESP_FLASH_DEFL_END:
+		defl_finish ( data );
+		break;
+	    case ESP_FLASH_CRC:
+		flash_crc ( data );
+		break;
+	    case ESP_READ:
+		read_stream ( data );
+		break;
+	    case ESP_CHANGE_BAUD:
+		change_baud ( data );
+		break;
+	    default:
+		respond ( op, 0, ERR_BAD_CMD );
+		break;
+	}
+}
+
+void
+stub_main ( void )
+{
+	hal_init ();
+	crc_init ();
+
+	send_frame ( (unsigned char *) "OHAI", 4 );
+
+	for ( ;; ) {
+	    get_frame ();
+	    command ();
+	}
+}
+
+/* THE END */
@@ -0,0 +1,79 @@
+/* stub.h
+ * Things shared by the pieces of the flasher stub
+ */
+
+/* Commands, the first ones are just what the ROM loader uses */
+#define ESP_FLASH_BEGIN		0x02
+#define ESP_FLASH_DATA		0x03
+#define ESP_FLASH_END		0x04
+#define ESP_MEM_BEGIN		0x05
+#define ESP_MEM_END		0x06
+#define ESP_MEM_DATA		0x07
+#define ESP_SYNC		0x08
+#define ESP_WRITE_REG		0x09
+#define ESP_READ_REG		0x0a
+
+/* and these are ours */
+#define ESP_CHANGE_BAUD		0x0f
+#define ESP_FLASH_DEFL_BEGIN	0x10
+#define ESP_FLASH_DEFL_DATA	0x11
+#define ESP_FLASH_DEFL_END	0x12
+#define ESP_FLASH_CRC		0x13
+#define ESP_READ		0x14
+
+/* What ESP_READ reads */
+#define READ_FLASH		0
+#define READ_MEM		1
+
+/* Error codes, in the second status byte of a response */
+#define ERR_BAD_FRAME		0xc0
+#define ERR_BAD_CMD		0xc1
+#define ERR_CHECKSUM		0xc2
+#define ERR_NOT_BEGUN		0xc3
+#define ERR_ALIGN		0xc4
+#define ERR_INFLATE		0xc5
+#define ERR_TOO_MUCH		0xc6
+#define ERR_TOO_LITTLE		0xc7
+#define ERR_FLASH		0xc8
+
+#define SECTOR_SIZE		4096
+
+/* The most compressed data we take in one packet */
+#define MAX_BLOCK		0x1000
+
+/* How many DATA blocks esptool may have in flight.  We tell it in
+ * the response to FLASH_DEFL_BEGIN.  They all have to fit in the ring
+ * buffer in hal_esp.c, and we keep WINDOW-1 that come early.
+ */
+#define WINDOW			3
+
+/* Most sectors we give CRCs for in one FLASH_CRC */
+#define MAX_CRC			256
+
+/* After a baud rate change, esptool has this long (ms) to
+ * say something we can understand, or we go back.
+ */
+#define BAUD_TIMEOUT		1000
+
+/* stub.c */
+void stub_main ( void );
+
+/* inflate.c */
+int inflate ( int (*) ( void ), int (*) ( unsigned char *, int ) );
+
+/* hal_esp.c or hal_host.c */
+void hal_init ( void );
+int hal_getc ( void );
+int hal_getc_timeout ( int );
+void hal_putc ( int );
+void hal_flush ( void );
+void hal_set_baud ( unsigned int, unsigned int );
+void hal_restore_baud ( void );
+unsigned int hal_read_reg ( unsigned int );
+void hal_write_reg ( unsigned int, unsigned int, unsigned int );
+void hal_reboot ( void );
+int flash_erase ( unsigned int );
+int flash_write ( unsigned int, unsigned char *, int );
+int flash_read ( unsigned int, unsigned char *, int );
+
+/* THE END */
@@ -10,33 +10,18 @@
  * First of all, it is less than handy to grub around in odx dumps.
  * On top of that, 32 bits values in there are byte swapped.
  * Finally, this gets called from various scripts.
+ *
+ * The image handling now lives in image.c
  */
 #include <stdio.h>
 #include <stdlib.h>
-#include <unistd.h>
-#include <sys/types.h>
-#include <sys/stat.h>
-#include <fcntl.h>
 #include <string.h>
 
+#include "image.h"
+
 #define ROM_BINFILE	"bootrom.bin"
 #define TEXT_BINFILE	"prod-0x00000.bin"
 
-#define ROM_BASE  0x40000000
-#define TEXT_BASE 0x40100000
-#define FLASH_BASE 0x40240000
-
-struct image {
-	char *filename;
-	unsigned int base;
-	int size;
-	int skip;
-};
-
-struct image rom_image;
-struct image text_image;
-struct image flash_image;
-
 /* XXX - tacky */
 char tname[64];
 char fname[64];
@@ -45,16 +30,20 @@ int vopt;
 int is_rom;
 int is_string;
 
-void init_image ( struct image *, char *, unsigned int, int );
-void dumpit ( struct image *, unsigned int, int );
+#define BATCH	1
+#define PIPE	2
+
+void dumpit ( unsigned int, int );
+void query ( unsigned int, int );
+void run_batch ( int );
 
 int main ( int argc, char **argv )
 {
 	unsigned int addr;
-	unsigned int start;
 	char *ap;
 	char *prefix;
 	int count;
+	int batch;
 
 	argc--;
 	++argv;
@@ -73,9 +62,15 @@ int main ( int argc, char **argv )
 	 * When it is non-zero, we figure we have a pair of application images.
 	 */
 	is_rom = 1;
+	prefix = NULL;
 
 	is_string = 0;
 
+	/* -b reads queries from stdin, -p does the same
+	 * but for a script talking to us over a pipe.
+	 */
+	batch = 0;
+
 	while ( argc && **argv == '-' ) {
 	    ap = *argv;
 	    if ( ap[1] == 'v' )
@@ -88,216 +83,180 @@ int main ( int argc, char **argv )
 	    if ( ap[1] == 's' ) {
 		is_string = 1;
 	    }
+	    if ( ap[1] == 'b' )
+		batch = BATCH;
+	    if ( ap[1] == 'p' )
+		batch = PIPE;
 	    argc--;
 	    ++argv;
 	}
 
-	if ( argc < 1 ) {
-	    printf ( "Usage: dumper [-v -aapp] addr [count]\n" );
+	if ( argc < 1 && ! batch ) {
+	    printf ( "Usage: dumper [-v -s -aapp] addr [count]\n" );
+	    printf ( "       dumper [-v -aapp] -b|-p   (queries on stdin)\n" );
 	    exit ( 100 );
 	}
 
+	if ( is_rom ) {
+	    image_raw ( ROM_BINFILE, ROM_BASE );
+	} else {
+	    /* Dumping from an application image */
+	    /* hello-0x40000.bin */
+
+	    strcpy ( tname, prefix );
+	    strcat ( tname, "-0x00000.bin" );
+	    image_app ( tname );
+
+	    strcpy ( fname, prefix );
+	    strcat ( fname, "-0x40000.bin" );
+	    image_raw ( fname, FLASH_BASE );
+	}
+
+	image_finish ();
+
+	if ( batch ) {
+	    run_batch ( batch );
+	    exit ( 0 );
+	}
+
 	/* The argument is a base 16 offset into the image.
 	 * This works out for the ROM, but for an application
 	 * image we have two images, so we expect a hard address
 	 * when working with an application.
 	 */
-	// printf ( "argc = %d\n", argc );
-	// printf ( "argv = %s\n", *argv );
-	// offset = atoi ( *argv );
 	addr = strtol ( *argv, NULL, 16 );
-	// printf ( "addr = 0x%08x\n", offset );
 
 	count = 1;
 	if ( argc > 1 ) {
 	    count = atoi ( argv[1] );
 	}
 
-	if ( is_rom ) {
-	    init_image ( &rom_image, ROM_BINFILE, ROM_BASE,  0 );
+	query ( addr, count );
+	exit ( 0 );
+}
 
+void
+query ( unsigned int addr, int count )
+{
+	if ( is_rom ) {
 	    if ( addr < ROM_BASE ) addr += ROM_BASE;
-
-	    dumpit ( &rom_image, addr, count );
-	    exit ( 0 );
+	    dumpit ( addr, count );
+	    return;
 	}
 
-	/* Not a rom, dumping from an application image */
-	/* hello-0x40000.bin */
-
-	strcpy ( tname, prefix );
-	strcat ( tname, "-0x00000.bin" );
-	init_image ( &text_image, tname, TEXT_BASE,  1 );
-
-	strcpy ( fname, prefix );
-	strcat ( fname, "-0x40000.bin" );
-	init_image ( &flash_image, fname, FLASH_BASE,  0 );
-
-	start = addr >> 20;
-	if ( start == 0x401 )
-	    dumpit ( &text_image, addr, count );
-	else if ( start == 0x402 )
-	    dumpit ( &flash_image, addr, count );
+	/* Any segment from either file will do now,
+	 * not just the text image and the flash.
+	 */
+	if ( image_lookup ( addr ) )
+	    dumpit ( addr, count );
 	else {
 	    // printf ( "Cannot dump address: %08x\n", addr );
 	    printf ( "-----\n" );
 	}
 }
 
-int
-get_size ( char *filename )
-{
-	struct stat sbuf;
-
-	if ( stat ( filename, &sbuf ) < 0 ) {
-	    printf ( "Cannot stat file: %s\n", filename );
-	    exit ( 100 );
-	}
-
-	return sbuf.st_size;
-}
-
-/* Actually just the first 5 entries in the following are really the
- * header, but the first control block follows immediately, so we
- * read it all at once.
+/* Batch mode, so scripts don't need to run us once
+ * for every word they want.  Each line on stdin is
+ * a query just like the command line:
+ *
+ *	addr [count] [-s]
+ *
+ * and gets exactly the output the same command line
+ * would give.  In pipe mode (-p) we also follow each
+ * answer with a line holding just "." and flush, so
+ * a script can keep us around as a coprocess:
+ *
+ *	$dumper = IO.popen ( "dumper -p -v", "r+" )
+ *	$dumper.puts addr
+ *	val = $dumper.gets.chomp
+ *	$dumper.gets	# the "."
  */
-
-struct header {
-	unsigned char magic;
-	unsigned char count;
-	unsigned char flags1;
-	unsigned char flags2;
-	unsigned int entry;
-	unsigned int target;
-	unsigned int size;
-};
-
 void
-init_image ( struct image *ip, char *filename, unsigned int base, int has_header )
+run_batch ( int mode )
 {
-	int fd;
-	struct header fheader;
-
-	ip->filename = filename;
-	ip->base = base;
-	ip->size = get_size ( ip->filename );
-	ip->skip = 0;
-
-	if ( ! has_header )
-	    return;
+	char line[128];
+	char *wp;
+	char *word[4];
+	int nw;
+	int i;
+	unsigned int addr;
+	int count;
+	int default_string;
 
-	ip->skip = 16;
+	default_string = is_string;
 
-	/* The first part of an application image has some headers we need to deal with.
-	 */
-	fd = open ( ip->filename, O_RDONLY );
-	if ( fd < 0 ) {
-	    printf ( "Cannot open to read header: %s\n", ip->filename );
-	    exit ( 100 );
-	}
-	if ( read ( fd, &fheader, sizeof(struct header) ) != sizeof(struct header) ) {
-	    printf ( "error reading header:  %s\n", ip->filename );
-	    exit ( 100 );
-	}
-	close ( fd );
+	while ( fgets ( line, sizeof(line), stdin ) ) {
+	    nw = 0;
+	    wp = strtok ( line, " \t\r\n" );
+	    while ( wp && nw < 4 ) {
+		word[nw++] = wp;
+		wp = strtok ( NULL, " \t\r\n" );
+	    }
 
-	/*
-	printf ( "Magic: %02x\n", fheader.magic );
-	printf ( "Base: %08x\n", fheader.target );
-	printf ( "Size: %d\n", fheader.size );
-	*/
+	    if ( nw < 1 || word[0][0] == '#' )
+		continue;
+
+	    is_string = default_string;
+	    addr = strtol ( word[0], NULL, 16 );
+	    count = 1;
+	    for ( i=1; i<nw; i++ ) {
+		if ( strcmp ( word[i], "-s" ) == 0 )
+		    is_string = 1;
+		else
+		    count = atoi ( word[i] );
+	    }
 
-	if ( fheader.magic != 0xe9 ) {
-	    printf ( "invalid header from: %s", ip->filename );
-	    exit ( 100 );
-	}
+	    query ( addr, count );
 
-	if ( fheader.target != base ) {
-	    printf ( "unexpected base: 0x%08x", fheader.target );
-	    exit ( 100 );
+	    if ( mode == PIPE ) {
+		printf ( ".\n" );
+		fflush ( stdout );
+	    }
 	}
-
-	/* First block had better be the text image */
-	ip->size = fheader.size;
 }
 
-/* We used to read the entire image into memory, but this will be
- * much faster !!
+/* These used to open, seek, read and close the image file
+ * for every word, which added up when the scripts call us
+ * thousands of times.  Now the files are mapped once
+ * (see image.c).
  */
 char *
-get_val ( struct image *ip, unsigned int off )
+get_val ( unsigned int addr )
 {
-	int fd;
-	char buf[4];
-	unsigned int *p;
+	unsigned int val;
 	static char bogus[] = "----";
 	static char vbuf[16];
 
-	if ( off < 0 )
+	if ( ! image_word ( addr, &val ) )
 	    return bogus;
 
-	if ( off > ip->size - sizeof(unsigned int) ) {
-	    // printf ("offset beyond end of image: 0x%08x\n", off );
-	    // exit ( 100 );
-	    return bogus;
-	}
-
-	// printf ( "dump from %s at offset %08x\n", ip->filename, off );
-
-	fd = open ( ip->filename, O_RDONLY );
-	if ( fd < 0 ) {
-	    printf ( "Cannot open %s\n", ip->filename );
-	    exit ( 100 );
-	}
-
-	lseek ( fd, ip->skip + off, SEEK_SET );
-	if ( read ( fd, buf, 4 ) != 4 ) {
-	    printf ( "Read error:  %s\n", ip->filename );
-	    exit ( 100 );
-	}
-	close ( fd );
-
-	p = (unsigned int *) buf;
-	sprintf ( vbuf, "%08x", *p );
+	sprintf ( vbuf, "%08x", val );
 	return vbuf;
 }
 
 char *
-get_str ( struct image *ip, unsigned int off )
+get_str ( unsigned int addr )
 {
-	int fd;
 	static char buf[256];
-	unsigned int *p;
 	static char bogus[] = "?";
+	struct segment *sp;
+	unsigned int off;
 	int n;
 
-	if ( off < 0 )
+	sp = image_lookup ( addr );
+	if ( ! sp )
 	    return bogus;
 
-	if ( off > ip->size - sizeof(unsigned int) ) {
-	    // printf ("offset beyond end of image: 0x%08x\n", off );
-	    // exit ( 100 );
+	off = addr - sp->addr;
+	if ( sp->size - off < sizeof(unsigned int) )
 	    return bogus;
-	}
 
 	/* 256 bytes is a wild guess */
 	n = 256;
-	if ( ip->size - off < 256 )
-	    n = ip->size - off;
-
-	fd = open ( ip->filename, O_RDONLY );
-	if ( fd < 0 ) {
-	    printf ( "Cannot open %s\n", ip->filename );
-	    exit ( 100 );
-	}
-
-	lseek ( fd, ip->skip + off, SEEK_SET );
+	if ( sp->size - off < 256 )
+	    n = sp->size - off;
 
-	if ( read ( fd, buf, n ) != n ) {
-	    printf ( "Read error:  %s\n", ip->filename );
-	    exit ( 100 );
-	}
-	close ( fd );
+	memcpy ( buf, &sp->data[off], n );
 
 	/* guarantee termination */
 	buf[n-1] = '\0';
@@ -306,16 +265,13 @@ get_str ( struct image *ip, unsigned int off )
 }
 
 void
-dumpstr ( struct image *ip, unsigned int addr )
+dumpstr ( unsigned int addr )
 {
-	unsigned int off;
 	char *str;
 	char cc;
 
-	off = addr - ip->base;
-
-	str = get_str ( ip, off );
-	while ( cc = *str++ ) {
+	str = get_str ( addr );
+	while ( (cc = *str++) ) {
 	    if ( cc == '\n' )
 		printf ( "\\n" );
 	    else
@@ -325,38 +281,28 @@ dumpstr ( struct image *ip, unsigned int addr )
 }
 
 void
-dump32 ( struct image *ip, unsigned int addr, int count )
+dump32 ( unsigned int addr, int count )
 {
 	int i;
-	unsigned int *p;
 	char *val;
-	unsigned int off;
-
-	// This runs on a 64 bit x86
-	// happily an unsigned int is a 4 byte object
-	// Also the x86 is little endian like the Xtensa lx106
-	// printf ( "uint is %d bytes\n", sizeof(unsigned int) );
-
-	off = addr - ip->base;
 
 	for ( i=0; i<count; i++ ) {
-	    val = get_val ( ip, off );
-	    // printf ( "image address %08x (offset %x) contains: %08x\n", addr, off, val );
+	    val = get_val ( addr );
 	    if ( vopt ) {
 		printf ( "%s\n", val );
 	    } else 
 		printf ( "%08x:\t\t\t.long 0x%s\n", addr, val );
-	    off += 4;
+	    addr += 4;
 	}
 }
 
 void
-dumpit ( struct image *ip, unsigned int addr, int count )
+dumpit ( unsigned int addr, int count )
 {
 	if ( is_string )
-	    dumpstr ( ip, addr );
+	    dumpstr ( addr );
 	else
-	    dump32 ( ip, addr, count );
+	    dump32 ( addr, count );
 }
 
 /* THE END */
@@ -0,0 +1,618 @@
+/* findbin.c
+ * One of my ESP8266 reverse engineering tools
+ *
+ * Look for things in a binary image.
+ * This started life as find32.c in reverse/call_user, which
+ * looked for one hardcoded 32 bit value (in both byte orders)
+ * in the first 256K of a file.  Now we take any number of
+ * patterns, memory map the file (so a 4M flash dump is no
+ * trouble) and check 16 or 32 bytes at a time with SSE2 or AVX2
+ * when the processor has them.
+ *
+ *  findbin image pattern ...
+ *
+ * A pattern is:
+ *  40101224		- 32 bit value (8 hex digits or fewer than 8, but more than 4)
+ *  1224		- 16 bit value (3 or 4 hex digits)
+ *  e9			- 8 bit value (1 or 2 hex digits)
+ *  32:1224		- force the size (8:, 16:, 32:)
+ *  x:e9020000		- a string of bytes, in hex
+ *  s:hello		- a string of bytes, as text
+ * Values are little endian, just like the ESP8266.
+ *
+ * Options:
+ *  -f file		- more patterns, one per line
+ *  -r			- also look for values byte swapped (like find32 did)
+ *  -b base		- address of the start of the image (hex)
+ *  -s file		- symbols (.sy "addr name" lines) to report
+ *			  addresses as name+offset
+ *  -k kernel		- scalar, sse2 or avx2 (default is the best we have)
+ *  -q			- just count matches
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define HAVE_X86
+#include <immintrin.h>
+#endif
+
+#define MAX_PAT		64	/* longest pattern */
+#define MAX_VEC		64	/* most patterns the SIMD kernels take */
+
+struct pattern {
+	unsigned char bytes[MAX_PAT];
+	int len;
+	char *text;		/* what the user gave us */
+};
+
+struct pattern *pats;
+int npats;
+int max_pats;
+
+struct match {
+	unsigned int off;
+	int pat;
+};
+
+struct match *matches;
+int nmatches;
+int max_matches;
+
+struct sym {
+	unsigned int addr;
+	char *name;
+};
+
+struct sym *syms;
+int nsyms;
+
+static void *
+xrealloc ( void *p, int size )
+{
+	p = realloc ( p, size );
+	if ( ! p ) {
+	    printf ( "Out of memory\n" );
+	    exit ( 1 );
+	}
+	return p;
+}
+
+/* ------------------------------------------------------------ */
+/* Patterns */
+
+static struct pattern *
+new_pat ( char *text )
+{
+	struct pattern *pp;
+
+	if ( npats >= max_pats ) {
+	    max_pats = max_pats ? max_pats * 2 : 16;
+	    pats = xrealloc ( pats, max_pats * sizeof(struct pattern) );
+	}
+	pp = &pats[npats++];
+	memset ( pp->bytes, 0, MAX_PAT );
+	pp->len = 0;
+	pp->text = strdup ( text );
+	return pp;
+}
+
+static void
+add_value ( char *text, unsigned int val, int size )
+{
+	struct pattern *pp;
+	int i;
+
+	pp = new_pat ( text );
+	for ( i=0; i<size; i++ )
+	    pp->bytes[pp->len++] = val >> (i*8);
+}
+
+static int
+all_hex ( char *p )
+{
+	return *p && strspn ( p, "0123456789abcdefABCDEF" ) == strlen ( p );
+}
+
+static void
+bad_pattern ( char *text )
+{
+	printf ( "Bad pattern: %s\n", text );
+	exit ( 1 );
+}
+
+static void
+add_pattern ( char *text, int swap )
+{
+	struct pattern *pp;
+	unsigned int val;
+	char buf[128];
+	int size = 0;
+	char *p = text;
+	int len;
+	int i;
+
+	if ( strncmp ( p, "s:", 2 ) == 0 ) {
+	    len = strlen ( p + 2 );
+	    if ( len < 1 || len > MAX_PAT )
+		bad_pattern ( text );
+	    pp = new_pat ( text );
+	    memcpy ( pp->bytes, p + 2, len );
+	    pp->len = len;
+	    return;
+	}
+
+	if ( strncmp ( p, "x:", 2 ) == 0 ) {
+	    p += 2;
+	    len = strlen ( p );
+	    if ( ! all_hex ( p ) || len % 2 || len / 2 > MAX_PAT )
+		bad_pattern ( text );
+	    pp = new_pat ( text );
+	    for ( i=0; i<len/2; i++ )
+		sscanf ( &p[i*2], "%2hhx", &pp->bytes[i] );
+	    pp->len = len / 2;
+	    return;
+	}
+
+	if ( strncmp ( p, "8:", 2 ) == 0 ) {
+	    size = 1;
+	    p += 2;
+	} else if ( strncmp ( p, "16:", 3 ) == 0 ) {
+	    size = 2;
+	    p += 3;
+	} else if ( strncmp ( p, "32:", 3 ) == 0 ) {
+	    size = 4;
+	    p += 3;
+	}
+
+	if ( strncmp ( p, "0x", 2 ) == 0 )
+	    p += 2;
+	len = strlen ( p );
+	if ( ! all_hex ( p ) || len > 8 )
+	    bad_pattern ( text );
+	val = strtoul ( p, NULL, 16 );
+
+	if ( ! size )
+	    size = len <= 2 ? 1 : len <= 4 ? 2 : 4;
+	if ( size < 4 && val >> (size*8) )
+	    bad_pattern ( text );
+
+	add_value ( text, val, size );
+
+	if ( swap && size > 1 ) {
+	    if ( size == 2 )
+		val = ((val & 0xff) << 8) | (val >> 8);
+	    else
+		val = __builtin_bswap32 ( val );
+	    snprintf ( buf, sizeof(buf), "%s(swapped)", text );
+	    add_value ( buf, val, size );
+	}
+}
+
+static void
+load_patterns ( char *file, int swap )
+{
+	FILE *fp;
+	char line[256];
+	char word[256];
+
+	fp = fopen ( file, "r" );
+	if ( ! fp ) {
+	    printf ( "Cannot open %s\n", file );
+	    exit ( 1 );
+	}
+	while ( fgets ( line, sizeof(line), fp ) ) {
+	    if ( line[0] == '#' )
+		continue;
+	    if ( sscanf ( line, "%255s", word ) != 1 )
+		continue;
+	    add_pattern ( word, swap );
+	}
+	fclose ( fp );
+}
+
+/* ------------------------------------------------------------ */
+/* Symbols */
+
+static int
+sym_compare ( const void *a, const void *b )
+{
+	const struct sym *sa = a;
+	const struct sym *sb = b;
+
+	return sa->addr < sb->addr ? -1 : sa->addr > sb->addr;
+}
+
+static void
+load_syms ( char *file )
+{
+	FILE *fp;
+	char line[256];
+	char name[128];
+	unsigned int addr;
+	int max = 0;
+
+	fp = fopen ( file, "r" );
+	if ( ! fp ) {
+	    printf ( "Cannot open %s\n", file );
+	    exit ( 1 );
+	}
+	while ( fgets ( line, sizeof(line), fp ) ) {
+	    if ( line[0] == '#' || line[0] == ';' )
+		continue;
+	    if ( sscanf ( line, "%x %127s", &addr, name ) != 2 )
+		continue;
+	    if ( nsyms >= max ) {
+		max = max ? max * 2 : 1024;
+		syms = xrealloc ( syms, max * sizeof(struct sym) );
+	    }
+	    syms[nsyms].addr = addr;
+	    syms[nsyms].name = strdup ( name );
+	    nsyms++;
+	}
+	fclose ( fp );
+
+	qsort ( syms, nsyms, sizeof(struct sym), sym_compare );
+}
+
+/* The symbol at or below addr */
+static struct sym *
+sym_below ( unsigned int addr )
+{
+	int lo, hi, mid;
+
+	if ( ! nsyms || addr < syms[0].addr )
+	    return NULL;
+
+	lo = 0;
+	hi = nsyms - 1;
+	while ( lo < hi ) {
+	    mid = (lo + hi + 1) / 2;
+	    if ( syms[mid].addr <= addr )
+		lo = mid;
+	    else
+		hi = mid - 1;
+	}
+	return &syms[lo];
+}
+
+/* ------------------------------------------------------------ */
+/* The search */
+
+static void
+add_match ( unsigned int off, int pat )
+{
+	if ( nmatches >= max_matches ) {
+	    max_matches = max_matches ? max_matches * 2 : 1024;
+	    matches = xrealloc ( matches, max_matches * sizeof(struct match) );
+	}
+	matches[nmatches].off = off;
+	matches[nmatches].pat = pat;
+	nmatches++;
+}
+
+/* Check the rest of the pattern once the first two bytes match */
+static inline void
+verify ( unsigned char *image, unsigned int size, unsigned int off, int p )
+{
+	struct pattern *pp = &pats[p];
+
+	if ( off + pp->len > size )
+	    return;
+	if ( pp->len <= 2 || memcmp ( &image[off+2], &pp->bytes[2], pp->len - 2 ) == 0 )
+	    add_match ( off, p );
+}
+
+/* Byte by byte.
+ * Patterns are chained on their first byte, and a table on
+ * the first two bytes lets us skip most offsets quickly.
+ */
+static void
+search_scalar ( unsigned char *image, unsigned int size, unsigned int start )
+{
+	static unsigned char pair[65536];
+	int first[256];
+	int *next;
+	unsigned int off;
+	unsigned char b0, b1;
+	int p;
+
+	next = xrealloc ( NULL, npats * sizeof(int) );
+	for ( p=0; p<256; p++ )
+	    first[p] = -1;
+	memset ( pair, 0, sizeof(pair) );
+
+	for ( p=npats-1; p>=0; p-- ) {
+	    b0 = pats[p].bytes[0];
+	    next[p] = first[b0];
+	    first[b0] = p;
+	    if ( pats[p].len == 1 ) {
+		for ( b1=0; ; b1++ ) {
+		    pair[b0 | b1 << 8] = 1;
+		    if ( b1 == 255 )
+			break;
+		}
+	    } else
+		pair[b0 | pats[p].bytes[1] << 8] = 1;
+	}
+
+	for ( off = start; off < size; off++ ) {
+	    b0 = image[off];
+	    b1 = off + 1 < size ? image[off+1] : 0;
+	    if ( ! pair[b0 | b1 << 8] )
+		continue;
+	    for ( p = first[b0]; p >= 0; p = next[p] ) {
+		if ( pats[p].len > 1 && pats[p].bytes[1] != b1 )
+		    continue;
+		verify ( image, size, off, p );
+	    }
+	}
+
+	free ( next );
+}
+
+#ifdef HAVE_X86
+
+/* 16 bytes at a time.
+ * For each pattern we compare 16 offsets against its first
+ * byte and (with a load one byte further on) its second byte,
+ * and only look closer where both match.
+ */
+static unsigned int
+search_sse2 ( unsigned char *image, unsigned int size )
+{
+	__m128i c0[MAX_VEC], c1[MAX_VEC];
+	__m128i d0, d1;
+	unsigned int off;
+	unsigned int mask;
+	int p, n;
+
+	n = npats;
+	for ( p=0; p<n; p++ ) {
+	    c0[p] = _mm_set1_epi8 ( pats[p].bytes[0] );
+	    c1[p] = _mm_set1_epi8 ( pats[p].bytes[1] );
+	}
+
+	for ( off = 0; off + 17 <= size; off += 16 ) {
+	    d0 = _mm_loadu_si128 ( (__m128i *) &image[off] );
+	    d1 = _mm_loadu_si128 ( (__m128i *) &image[off+1] );
+	    for ( p=0; p<n; p++ ) {
+		if ( pats[p].len > 1 )
+		    mask = _mm_movemask_epi8 ( _mm_and_si128 (
+			_mm_cmpeq_epi8 ( d0, c0[p] ), _mm_cmpeq_epi8 ( d1, c1[p] ) ) );
+		else
+		    mask = _mm_movemask_epi8 ( _mm_cmpeq_epi8 ( d0, c0[p] ) );
+		while ( mask ) {
+		    verify ( image, size, off + __builtin_ctz ( mask ), p );
+		    mask &= mask - 1;
+		}
+	    }
+	}
+
+	return off;
+}
+
+/* Same again, 32 bytes at a time */
+__attribute__((target("avx2")))
+static unsigned int
+search_avx2 ( unsigned char *image, unsigned int size )
+{
+	__m256i c0[MAX_VEC], c1[MAX_VEC];
+	__m256i d0, d1;
+	unsigned int off;
+	unsigned int mask;
+	int p, n;
+
+	n = npats;
+	for ( p=0; p<n; p++ ) {
+	    c0[p] = _mm256_set1_epi8 ( pats[p].bytes[0] );
+	    c1[p] = _mm256_set1_epi8 ( pats[p].bytes[1] );
+	}
+
+	for ( off = 0; off + 33 <= size; off += 32 ) {
+	    d0 = _mm256_loadu_si256 ( (__m256i *) &image[off] );
+	    d1 = _mm256_loadu_si256 ( (__m256i *) &image[off+1] );
+	    for ( p=0; p<n; p++ ) {
+		if ( pats[p].len > 1 )
+		    mask = _mm256_movemask_epi8 ( _mm256_and_si256 (
+			_mm256_cmpeq_epi8 ( d0, c0[p] ), _mm256_cmpeq_epi8 ( d1, c1[p] ) ) );
+		else
+		    mask = _mm256_movemask_epi8 ( _mm256_cmpeq_epi8 ( d0, c0[p] ) );
+		while ( mask ) {
+		    verify ( image, size, off + __builtin_ctz ( mask ), p );
+		    mask &= mask - 1;
+		}
+	    }
+	}
+
+	return off;
+}
+#endif
+
+#define K_SCALAR	0
+#define K_SSE2		1
+#define K_AVX2		2
+
+char *kernel_names[] = { "scalar", "sse2", "avx2" };
+
+static int
+best_kernel ( void )
+{
+#ifdef HAVE_X86
+	__builtin_cpu_init ();
+	if ( __builtin_cpu_supports ( "avx2" ) )
+	    return K_AVX2;
+	if ( __builtin_cpu_supports ( "sse2" ) )
+	    return K_SSE2;
+#endif
+	return K_SCALAR;
+}
+
+static int
+match_compare ( const void *a, const void *b )
+{
+	const struct match *ma = a;
+	const struct match *mb = b;
+
+	if ( ma->off != mb->off )
+	    return ma->off < mb->off ? -1 : 1;
+	return ma->pat - mb->pat;
+}
+
+/* The SIMD kernels hold all the patterns in registers,
+ * past MAX_VEC of them we just go byte by byte.
+ * The tail end of the image (less than one vector) is
+ * also done byte by byte.
+ */
+static int
+search ( unsigned char *image, unsigned int size, int kernel )
+{
+	unsigned int done = 0;
+
+	if ( npats > MAX_VEC )
+	    kernel = K_SCALAR;
+
+#ifdef HAVE_X86
+	if ( kernel == K_AVX2 )
+	    done = search_avx2 ( image, size );
+	if ( kernel == K_SSE2 )
+	    done = search_sse2 ( image, size );
+#endif
+
+	search_scalar ( image, size, done );
+
+	qsort ( matches, nmatches, sizeof(struct match), match_compare );
+	return kernel;
+}
+
+/* ------------------------------------------------------------ */
+
+static unsigned char *
+map_file ( char *filename, unsigned int *sizep )
+{
+	int fd;
+	struct stat sbuf;
+	void *map;
+
+	fd = open ( filename, O_RDONLY );
+	if ( fd < 0 ) {
+	    printf ( "Cannot open %s\n", filename );
+	    exit ( 1 );
+	}
+	if ( fstat ( fd, &sbuf ) < 0 || sbuf.st_size == 0 ) {
+	    printf ( "Cannot use %s\n", filename );
+	    exit ( 1 );
+	}
+	map = mmap ( NULL, sbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	if ( map == MAP_FAILED ) {
+	    printf ( "Cannot map %s\n", filename );
+	    exit ( 1 );
+	}
+	close ( fd );
+
+	*sizep = sbuf.st_size;
+	return map;
+}
+
+static void
+usage ( void )
+{
+	printf ( "Usage: findbin [-r] [-q] [-b base] [-s symfile] [-f patfile] [-k kernel] image pattern ...\n" );
+	exit ( 1 );
+}
+
+int
+main ( int argc, char **argv )
+{
+	char *pat_file = NULL;
+	char *sym_file = NULL;
+	unsigned int base = 0;
+	int swap = 0;
+	int quiet = 0;
+	int kernel;
+	unsigned char *image;
+	unsigned int size;
+	unsigned int addr;
+	struct sym *sp;
+	int i;
+
+	kernel = best_kernel ();
+
+	argc--;
+	++argv;
+	while ( argc > 0 && argv[0][0] == '-' ) {
+	    if ( argv[0][1] == 'r' )
+		swap = 1;
+	    else if ( argv[0][1] == 'q' )
+		quiet = 1;
+	    else if ( argc < 2 )
+		usage ();
+	    else {
+		if ( argv[0][1] == 'b' )
+		    base = strtoul ( argv[1], NULL, 16 );
+		else if ( argv[0][1] == 's' )
+		    sym_file = argv[1];
+		else if ( argv[0][1] == 'f' )
+		    pat_file = argv[1];
+		else if ( argv[0][1] == 'k' ) {
+		    for ( kernel=0; kernel<3; kernel++ )
+			if ( strcmp ( argv[1], kernel_names[kernel] ) == 0 )
+			    break;
+		    if ( kernel == 3 )
+			usage ();
+		} else
+		    usage ();
+		argc--;
+		++argv;
+	    }
+	    argc--;
+	    ++argv;
+	}
+
+	if ( argc < 1 )
+	    usage ();
+
+	for ( i=1; i<argc; i++ )
+	    add_pattern ( argv[i], swap );
+	if ( pat_file )
+	    load_patterns ( pat_file, swap );
+	if ( npats < 1 )
+	    usage ();
+	if ( sym_file )
+	    load_syms ( sym_file );
+
+#ifndef HAVE_X86
+	kernel = K_SCALAR;
+#endif
+
+	image = map_file ( argv[0], &size );
+	kernel = search ( image, size, kernel );
+
+	if ( quiet ) {
+	    printf ( "%d matches (%s)\n", nmatches, kernel_names[kernel] );
+	    return 0;
+	}
+
+	for ( i=0; i<nmatches; i++ ) {
+	    addr = base + matches[i].off;
+	    printf ( "Found %s at %08x", pats[matches[i].pat].text, addr );
+	    sp = sym_below ( addr );
+	    if ( sp ) {
+		if ( sp->addr == addr )
+		    printf ( "  %s", sp->name );
+		else
+		    printf ( "  %s+0x%x", sp->name, addr - sp->addr );
+	    }
+	    printf ( "\n" );
+	}
+
+	return 0;
+}
+
+/* THE END */
@@ -0,0 +1,335 @@
+/* image.c
+ * One of my ESP8266 reverse engineering tools
+ *
+ * This is the image handling that used to live in dumper.c
+ * pulled out so other tools can use it.
+ *
+ * dumper used to open, seek, read and close the image
+ * file for every 4 byte word it printed.  Now we mmap
+ * each file once and keep a table of segments (address,
+ * size, pointer into the mapping) covering everything
+ * we have loaded.  Looking up an address is a search
+ * through that table.
+ *
+ * We can load a raw image (like bootrom.bin or the
+ * -0x40000.bin flash image) at a given base, or an
+ * application image with the 0xE9 header, in which case
+ * we pick up every segment it describes, not just the first.
+ * Or an ELF file, straight from the linker: every section
+ * that gets loaded is a segment, and we hand back the symbols.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <string.h>
+#include <elf.h>
+
+#include "image.h"
+
+struct segtab segments;
+
+static unsigned char *
+map_file ( char *filename, unsigned int *sizep )
+{
+	int fd;
+	struct stat sbuf;
+	void *map;
+
+	fd = open ( filename, O_RDONLY );
+	if ( fd < 0 ) {
+	    printf ( "Cannot open %s\n", filename );
+	    exit ( 100 );
+	}
+
+	if ( fstat ( fd, &sbuf ) < 0 ) {
+	    printf ( "Cannot stat file: %s\n", filename );
+	    exit ( 100 );
+	}
+
+	if ( sbuf.st_size == 0 ) {
+	    printf ( "Empty file: %s\n", filename );
+	    exit ( 100 );
+	}
+
+	map = mmap ( NULL, sbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	if ( map == MAP_FAILED ) {
+	    printf ( "Cannot map %s\n", filename );
+	    exit ( 100 );
+	}
+	close ( fd );
+
+	*sizep = sbuf.st_size;
+	return (unsigned char *) map;
+}
+
+static void
+add_segment ( unsigned int addr, unsigned int size, unsigned char *data, char *filename )
+{
+	struct segment *sp;
+
+	if ( segments.count >= MAX_SEGMENTS ) {
+	    printf ( "Too many segments in %s\n", filename );
+	    exit ( 100 );
+	}
+
+	sp = &segments.seg[segments.count++];
+	sp->addr = addr;
+	sp->size = size;
+	sp->data = data;
+	sp->filename = filename;
+}
+
+/* The whole file is one segment at the given base */
+int
+image_raw ( char *filename, unsigned int base )
+{
+	unsigned char *map;
+	unsigned int size;
+
+	map = map_file ( filename, &size );
+	add_segment ( base, size, map, filename );
+
+	return size;
+}
+
+/* The 8 byte header, then a segment header (8 bytes)
+ * in front of each segment.
+ */
+struct header {
+	unsigned char magic;
+	unsigned char count;
+	unsigned char flags1;
+	unsigned char flags2;
+	unsigned int entry;
+};
+
+struct seg_header {
+	unsigned int target;
+	unsigned int size;
+};
+
+/* Returns the number of segments found */
+int
+image_app ( char *filename )
+{
+	unsigned char *map;
+	unsigned int size;
+	unsigned int off;
+	struct header fheader;
+	struct seg_header sheader;
+	int i;
+
+	map = map_file ( filename, &size );
+
+	if ( size < sizeof(struct header) ) {
+	    printf ( "error reading header:  %s\n", filename );
+	    exit ( 100 );
+	}
+
+	memcpy ( &fheader, map, sizeof(struct header) );
+
+	if ( fheader.magic != IMAGE_MAGIC ) {
+	    printf ( "invalid header from: %s", filename );
+	    exit ( 100 );
+	}
+
+	segments.entry = fheader.entry;
+
+	off = sizeof(struct header);
+	for ( i=0; i<fheader.count; i++ ) {
+	    if ( off + sizeof(struct seg_header) > size ) {
+		printf ( "truncated segment header %d in %s\n", i, filename );
+		exit ( 100 );
+	    }
+	    memcpy ( &sheader, &map[off], sizeof(struct seg_header) );
+	    off += sizeof(struct seg_header);
+
+	    if ( sheader.size > size - off ) {
+		printf ( "truncated segment %d in %s\n", i, filename );
+		exit ( 100 );
+	    }
+
+	    add_segment ( sheader.target, sheader.size, &map[off], filename );
+	    off += sheader.size;
+	}
+
+	return fheader.count;
+}
+
+/* Every section the loader would load (with bytes in the file,
+ * so not .bss) is a segment.  If fn isn't NULL it gets called
+ * for each symbol with a name and an address.
+ * Returns the number of segments found.
+ */
+int
+image_elf ( char *filename, elf_sym_fn fn )
+{
+	unsigned char *map;
+	unsigned int size;
+	Elf32_Ehdr *hp;
+	Elf32_Shdr *shp;
+	Elf32_Shdr *strp;
+	Elf32_Sym *sym;
+	int nsec;
+	int nsym;
+	int count = 0;
+	int i, j;
+
+	map = map_file ( filename, &size );
+	hp = (Elf32_Ehdr *) map;
+
+	if ( size < sizeof(Elf32_Ehdr) || memcmp ( hp->e_ident, ELFMAG, SELFMAG ) != 0 ) {
+	    printf ( "not an ELF file: %s\n", filename );
+	    exit ( 100 );
+	}
+	if ( hp->e_ident[EI_CLASS] != ELFCLASS32 || hp->e_ident[EI_DATA] != ELFDATA2LSB ) {
+	    printf ( "not a 32 bit little endian ELF file: %s\n", filename );
+	    exit ( 100 );
+	}
+
+	nsec = hp->e_shnum;
+	if ( hp->e_shoff + nsec * sizeof(Elf32_Shdr) > size ) {
+	    printf ( "truncated section table in %s\n", filename );
+	    exit ( 100 );
+	}
+	shp = (Elf32_Shdr *) &map[hp->e_shoff];
+
+	segments.entry = hp->e_entry;
+
+	for ( i=0; i<nsec; i++ ) {
+	    if ( ! (shp[i].sh_flags & SHF_ALLOC) || shp[i].sh_type == SHT_NOBITS )
+		continue;
+	    if ( shp[i].sh_size == 0 )
+		continue;
+	    if ( shp[i].sh_offset + shp[i].sh_size > size ) {
+		printf ( "truncated section %d in %s\n", i, filename );
+		exit ( 100 );
+	    }
+	    add_segment ( shp[i].sh_addr, shp[i].sh_size, &map[shp[i].sh_offset], filename );
+	    count++;
+	}
+
+	if ( ! fn )
+	    return count;
+
+	for ( i=0; i<nsec; i++ ) {
+	    if ( shp[i].sh_type != SHT_SYMTAB || shp[i].sh_link >= nsec )
+		continue;
+	    strp = &shp[shp[i].sh_link];
+	    if ( shp[i].sh_offset + shp[i].sh_size > size || strp->sh_offset + strp->sh_size > size )
+		continue;
+	    sym = (Elf32_Sym *) &map[shp[i].sh_offset];
+	    nsym = shp[i].sh_size / sizeof(Elf32_Sym);
+	    for ( j=1; j<nsym; j++ ) {
+		if ( sym[j].st_name == 0 || sym[j].st_name >= strp->sh_size )
+		    continue;
+		if ( sym[j].st_shndx == SHN_UNDEF || sym[j].st_value == 0 )
+		    continue;
+		if ( ELF32_ST_TYPE(sym[j].st_info) == STT_SECTION || ELF32_ST_TYPE(sym[j].st_info) == STT_FILE )
+		    continue;
+		(*fn) ( sym[j].st_value, sym[j].st_size, ELF32_ST_TYPE(sym[j].st_info),
+			(char *) &map[strp->sh_offset + sym[j].st_name] );
+	    }
+	}
+
+	return count;
+}
+
+static int
+seg_compare ( const void *a, const void *b )
+{
+	const struct segment *sa = a;
+	const struct segment *sb = b;
+
+	if ( sa->addr < sb->addr )
+	    return -1;
+	if ( sa->addr > sb->addr )
+	    return 1;
+	return 0;
+}
+
+/* Call this once everything is loaded, we keep
+ * the table sorted by address so lookup can do
+ * a binary search.
+ */
+void
+image_finish ( void )
+{
+	qsort ( segments.seg, segments.count, sizeof(struct segment), seg_compare );
+}
+
+struct segment *
+image_lookup ( unsigned int addr )
+{
+	int lo, hi, mid;
+	struct segment *sp;
+
+	lo = 0;
+	hi = segments.count - 1;
+	while ( lo <= hi ) {
+	    mid = (lo + hi) / 2;
+	    sp = &segments.seg[mid];
+	    if ( addr < sp->addr )
+		hi = mid - 1;
+	    else if ( addr - sp->addr >= sp->size )
+		lo = mid + 1;
+	    else
+		return sp;
+	}
+
+	return NULL;
+}
+
+/* Pointer to len bytes at addr, or NULL if
+ * they are not all in one segment.
+ */
+unsigned char *
+image_ptr ( unsigned int addr, int len )
+{
+	struct segment *sp;
+	unsigned int off;
+
+	sp = image_lookup ( addr );
+	if ( ! sp )
+	    return NULL;
+
+	off = addr - sp->addr;
+	if ( len > sp->size - off )
+	    return NULL;
+
+	return &sp->data[off];
+}
+
+/* Returns 0 if the word is not there.
+ * The x86 is little endian like the Xtensa lx106
+ */
+int
+image_word ( unsigned int addr, unsigned int *val )
+{
+	unsigned char *p;
+
+	p = image_ptr ( addr, 4 );
+	if ( ! p )
+	    return 0;
+
+	memcpy ( val, p, 4 );
+	return 1;
+}
+
+void
+image_show ( void )
+{
+	struct segment *sp;
+	int i;
+
+	for ( i=0; i<segments.count; i++ ) {
+	    sp = &segments.seg[i];
+	    printf ( "%08x %08x %7d  %s\n", sp->addr, sp->addr + sp->size - 1, sp->size, sp->filename );
+	}
+}
+
+/* THE END */
@@ -0,0 +1,45 @@
+/* image.h
+ * Shared image access for my ESP8266 reverse engineering tools
+ */
+
+#define ROM_BASE  0x40000000
+#define TEXT_BASE 0x40100000
+#define FLASH_BASE 0x40240000
+
+/* The 0xE9 header in front of an application image */
+#define IMAGE_MAGIC	0xe9
+
+/* One contiguous piece of the address space,
+ * pointing into a memory mapped file.
+ */
+struct segment {
+	unsigned int addr;
+	unsigned int size;
+	unsigned char *data;
+	char *filename;
+};
+
+#define MAX_SEGMENTS	32
+
+struct segtab {
+	struct segment seg[MAX_SEGMENTS];
+	int count;
+	unsigned int entry;
+};
+
+extern struct segtab segments;
+
+/* addr, size, type (STT_FUNC and such), name */
+typedef void (*elf_sym_fn) ( unsigned int, unsigned int, int, char * );
+
+int image_raw ( char *, unsigned int );
+int image_app ( char * );
+int image_elf ( char *, elf_sym_fn );
+void image_finish ( void );
+
+struct segment *image_lookup ( unsigned int );
+unsigned char *image_ptr ( unsigned int, int );
+int image_word ( unsigned int, unsigned int * );
+void image_show ( void );
+
+/* THE END */
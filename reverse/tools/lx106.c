@@ -0,0 +1,685 @@
+/* lx106.c
+ * One of my ESP8266 reverse engineering tools
+ *
+ * A table driven decoder for the Xtensa lx106 instruction set
+ * (core plus the density ".n" instructions and the few options
+ * we see in the bootrom) so that my disassembler doesn't need to
+ * run objdump.
+ *
+ * The output is meant to be exactly what we used to get from
+ *  xtensa-esp32-elf-objdump -mxtensa -d -z
+ * since the rest of my scripts (and the boot.txt we have
+ * carefully annotated) expect that.  In particular:
+ *  - registers are a0 .. a15 (b0 .. b15, f0 .. f15)
+ *  - immediates between -255 and 255 are decimal, others hex
+ *  - targets (branches, jumps, calls, l32r) are 0x%08x
+ *  - something we can't decode is ".byte 0xNN" and 1 byte long
+ *
+ * Instructions are little endian.  In a 24 bit instruction
+ * the fields are:
+ *
+ *   op2 op1 r   s   t   op0
+ *   23  19  15  11  7   3   (top bit of each)
+ *
+ * The low nibble (op0) tells us the length, 8 through 13 are
+ * the 16 bit density instructions.
+ */
+#include <stdio.h>
+#include <string.h>
+
+#include "lx106.h"
+
+/* Operand formats */
+enum fmt {
+	F_NONE,		/* ret, nop, memw */
+	F_RRR,		/* ar, as, at */
+	F_RT,		/* ar, at */
+	F_RS,		/* ar, as */
+	F_TS,		/* at, as */
+	F_S,		/* as */
+	F_BOOL,		/* br, bs, bt */
+	F_BOOL2,	/* bt, bs */
+	F_MOVB,		/* ar, as, bt */
+	F_SEXT,		/* ar, as, t+7 */
+	F_SSAI,		/* sa */
+	F_SLLI,
+	F_SRAI,
+	F_SRLI,
+	F_EXTUI,
+	F_SR,		/* rsr.xxx at */
+	F_BREAK,	/* s, t */
+	F_IMM_S,	/* s */
+	F_RSIL,		/* at, s */
+	F_E,		/* l32e at, as, -64..-4 */
+	F_L32R,
+	F_LSAI,		/* at, as, imm8 * scale */
+	F_FLSI,		/* ft, as, imm8 * 4 */
+	F_CACHE,	/* as, imm8 * 4 */
+	F_MOVI,
+	F_ADDI,
+	F_ADDMI,
+	F_CALL,
+	F_J,
+	F_BZ,		/* as, label (12 bits) */
+	F_BI,		/* as, b4const, label */
+	F_BIU,		/* as, b4constu, label */
+	F_BB,		/* bs, label */
+	F_LOOP,		/* as, label (8 bits, unsigned) */
+	F_ENTRY,
+	F_B,		/* as, at, label */
+	F_BBI,		/* as, bit, label */
+	F_N_LS,		/* at, as, r * 4 */
+	F_N_ADD,	/* ar, as, at */
+	F_N_ADDI,
+	F_N_MOVI,
+	F_N_BZ,
+	F_N_MOV,	/* at, as */
+	F_N_S,		/* s */
+};
+
+#define B	LX_BRANCH
+#define J	LX_JUMP
+#define T	LX_TERM
+
+struct lx_op {
+	unsigned int mask;
+	unsigned int match;
+	char *name;
+	int fmt;
+	int flags;
+	int scale;
+};
+
+/* 24 bit instructions.
+ * The first match wins, so the more specific ones
+ * need to come first.
+ */
+static struct lx_op op24[] = {
+	/* QRST - op0 = 0 */
+	{ 0xffffff, 0x000000, "ill",	F_NONE,  LX_ILL },
+	{ 0xffffff, 0x000080, "ret",	F_NONE,  T },
+	{ 0xffffff, 0x000090, "retw",	F_NONE,  T },
+	{ 0xfff0ff, 0x0000a0, "jx",	F_S,	 T },
+	{ 0xfff0ff, 0x0000c0, "callx0",	F_S,	 LX_CALLX },
+	{ 0xfff0ff, 0x0000d0, "callx4",	F_S,	 LX_CALLX },
+	{ 0xfff0ff, 0x0000e0, "callx8",	F_S,	 LX_CALLX },
+	{ 0xfff0ff, 0x0000f0, "callx12", F_S,	 LX_CALLX },
+	{ 0xfff00f, 0x001000, "movsp",	F_TS },
+	{ 0xffffff, 0x002000, "isync",	F_NONE },
+	{ 0xffffff, 0x002010, "rsync",	F_NONE },
+	{ 0xffffff, 0x002020, "esync",	F_NONE },
+	{ 0xffffff, 0x002030, "dsync",	F_NONE },
+	{ 0xffffff, 0x002080, "excw",	F_NONE },
+	{ 0xffffff, 0x0020c0, "memw",	F_NONE },
+	{ 0xffffff, 0x0020d0, "extw",	F_NONE },
+	{ 0xffffff, 0x0020f0, "nop",	F_NONE },
+	{ 0xffffff, 0x003000, "rfe",	F_NONE,  T },
+	{ 0xffffff, 0x003100, "rfue",	F_NONE,  T },
+	{ 0xffffff, 0x003200, "rfde",	F_NONE,  T },
+	{ 0xffffff, 0x003400, "rfwo",	F_NONE,  T },
+	{ 0xffffff, 0x003500, "rfwu",	F_NONE,  T },
+	{ 0xfff0ff, 0x003010, "rfi",	F_IMM_S, T },
+	{ 0xfff00f, 0x004000, "break",	F_BREAK },
+	{ 0xffffff, 0x005000, "syscall", F_NONE },
+	{ 0xffffff, 0x005100, "simcall", F_NONE },
+	{ 0xfff00f, 0x006000, "rsil",	F_RSIL },
+	{ 0xfff0ff, 0x007000, "waiti",	F_IMM_S },
+	{ 0xfff00f, 0x008000, "any4",	F_BOOL2 },
+	{ 0xfff00f, 0x009000, "all4",	F_BOOL2 },
+	{ 0xfff00f, 0x00a000, "any8",	F_BOOL2 },
+	{ 0xfff00f, 0x00b000, "all8",	F_BOOL2 },
+	{ 0xff000f, 0x100000, "and",	F_RRR },
+	{ 0xff000f, 0x200000, "or",	F_RRR },
+	{ 0xff000f, 0x300000, "xor",	F_RRR },
+	{ 0xfff0ff, 0x400000, "ssr",	F_S },
+	{ 0xfff0ff, 0x401000, "ssl",	F_S },
+	{ 0xfff0ff, 0x402000, "ssa8l",	F_S },
+	{ 0xfff0ff, 0x403000, "ssa8b",	F_S },
+	{ 0xfff0ef, 0x404000, "ssai",	F_SSAI },
+	{ 0xfff00f, 0x406000, "rer",	F_TS },
+	{ 0xfff00f, 0x407000, "wer",	F_TS },
+	{ 0xfff00f, 0x40e000, "nsa",	F_TS },
+	{ 0xfff00f, 0x40f000, "nsau",	F_TS },
+	{ 0xfff00f, 0x503000, "ritlb0",	F_TS },
+	{ 0xfff0ff, 0x504000, "iitlb",	F_S },
+	{ 0xfff00f, 0x505000, "pitlb",	F_TS },
+	{ 0xfff00f, 0x506000, "witlb",	F_TS },
+	{ 0xfff00f, 0x507000, "ritlb1",	F_TS },
+	{ 0xfff00f, 0x50b000, "rdtlb0",	F_TS },
+	{ 0xfff0ff, 0x50c000, "idtlb",	F_S },
+	{ 0xfff00f, 0x50d000, "pdtlb",	F_TS },
+	{ 0xfff00f, 0x50e000, "wdtlb",	F_TS },
+	{ 0xfff00f, 0x50f000, "rdtlb1",	F_TS },
+	{ 0xff0f0f, 0x600000, "neg",	F_RT },
+	{ 0xff0f0f, 0x600100, "abs",	F_RT },
+	{ 0xff000f, 0x800000, "add",	F_RRR },
+	{ 0xff000f, 0x900000, "addx2",	F_RRR },
+	{ 0xff000f, 0xa00000, "addx4",	F_RRR },
+	{ 0xff000f, 0xb00000, "addx8",	F_RRR },
+	{ 0xff000f, 0xc00000, "sub",	F_RRR },
+	{ 0xff000f, 0xd00000, "subx2",	F_RRR },
+	{ 0xff000f, 0xe00000, "subx4",	F_RRR },
+	{ 0xff000f, 0xf00000, "subx8",	F_RRR },
+
+	{ 0xef000f, 0x010000, "slli",	F_SLLI },
+	{ 0xef000f, 0x210000, "srai",	F_SRAI },
+	{ 0xff000f, 0x410000, "srli",	F_SRLI },
+	{ 0xff000f, 0x610000, "xsr",	F_SR },
+	{ 0xff000f, 0x810000, "src",	F_RRR },
+	{ 0xff0f0f, 0x910000, "srl",	F_RT },
+	{ 0xff00ff, 0xa10000, "sll",	F_RS },
+	{ 0xff0f0f, 0xb10000, "sra",	F_RT },
+	{ 0xff000f, 0xc10000, "mul16u",	F_RRR },
+	{ 0xff000f, 0xd10000, "mul16s",	F_RRR },
+
+	{ 0xff000f, 0x020000, "andb",	F_BOOL },
+	{ 0xff000f, 0x120000, "andbc",	F_BOOL },
+	{ 0xff000f, 0x220000, "orb",	F_BOOL },
+	{ 0xff000f, 0x320000, "orbc",	F_BOOL },
+	{ 0xff000f, 0x420000, "xorb",	F_BOOL },
+	{ 0xff000f, 0x820000, "mull",	F_RRR },
+	{ 0xff000f, 0xa20000, "muluh",	F_RRR },
+	{ 0xff000f, 0xb20000, "mulsh",	F_RRR },
+	{ 0xff000f, 0xc20000, "quou",	F_RRR },
+	{ 0xff000f, 0xd20000, "quos",	F_RRR },
+	{ 0xff000f, 0xe20000, "remu",	F_RRR },
+	{ 0xff000f, 0xf20000, "rems",	F_RRR },
+
+	{ 0xff000f, 0x030000, "rsr",	F_SR },
+	{ 0xff000f, 0x130000, "wsr",	F_SR },
+	{ 0xff000f, 0x230000, "sext",	F_SEXT },
+	{ 0xff000f, 0x330000, "clamps",	F_SEXT },
+	{ 0xff000f, 0x430000, "min",	F_RRR },
+	{ 0xff000f, 0x530000, "max",	F_RRR },
+	{ 0xff000f, 0x630000, "minu",	F_RRR },
+	{ 0xff000f, 0x730000, "maxu",	F_RRR },
+	{ 0xff000f, 0x830000, "moveqz",	F_RRR },
+	{ 0xff000f, 0x930000, "movnez",	F_RRR },
+	{ 0xff000f, 0xa30000, "movltz",	F_RRR },
+	{ 0xff000f, 0xb30000, "movgez",	F_RRR },
+	{ 0xff000f, 0xc30000, "movf",	F_MOVB },
+	{ 0xff000f, 0xd30000, "movt",	F_MOVB },
+
+	{ 0x0e000f, 0x040000, "extui",	F_EXTUI },
+
+	{ 0xff000f, 0x090000, "l32e",	F_E },
+	{ 0xff000f, 0x490000, "s32e",	F_E },
+
+	/* L32R - op0 = 1 */
+	{ 0x00000f, 0x000001, "l32r",	F_L32R,  LX_L32R | LX_TARGET },
+
+	/* LSAI - op0 = 2 */
+	{ 0x00f00f, 0x000002, "l8ui",	F_LSAI,  0, 1 },
+	{ 0x00f00f, 0x001002, "l16ui",	F_LSAI,  0, 2 },
+	{ 0x00f00f, 0x002002, "l32i",	F_LSAI,  0, 4 },
+	{ 0x00f00f, 0x004002, "s8i",	F_LSAI,  0, 1 },
+	{ 0x00f00f, 0x005002, "s16i",	F_LSAI,  0, 2 },
+	{ 0x00f00f, 0x006002, "s32i",	F_LSAI,  0, 4 },
+	{ 0x00f0ff, 0x007002, "dpfr",	F_CACHE },
+	{ 0x00f0ff, 0x007012, "dpfw",	F_CACHE },
+	{ 0x00f0ff, 0x007022, "dpfro",	F_CACHE },
+	{ 0x00f0ff, 0x007032, "dpfwo",	F_CACHE },
+	{ 0x00f0ff, 0x007042, "dhwb",	F_CACHE },
+	{ 0x00f0ff, 0x007052, "dhwbi",	F_CACHE },
+	{ 0x00f0ff, 0x007062, "dhi",	F_CACHE },
+	{ 0x00f0ff, 0x007072, "dii",	F_CACHE },
+	{ 0x00f0ff, 0x0070c2, "ipf",	F_CACHE },
+	{ 0x00f0ff, 0x0070e2, "ihi",	F_CACHE },
+	{ 0x00f0ff, 0x0070f2, "iii",	F_CACHE },
+	{ 0x00f00f, 0x009002, "l16si",	F_LSAI,  0, 2 },
+	{ 0x00f00f, 0x00a002, "movi",	F_MOVI },
+	{ 0x00f00f, 0x00b002, "l32ai",	F_LSAI,  0, 4 },
+	{ 0x00f00f, 0x00c002, "addi",	F_ADDI },
+	{ 0x00f00f, 0x00d002, "addmi",	F_ADDMI },
+	{ 0x00f00f, 0x00e002, "s32c1i",	F_LSAI,  0, 4 },
+	{ 0x00f00f, 0x00f002, "s32ri",	F_LSAI,  0, 4 },
+
+	/* LSCI - op0 = 3 (floating point) */
+	{ 0x00f00f, 0x000003, "lsi",	F_FLSI },
+	{ 0x00f00f, 0x004003, "ssi",	F_FLSI },
+	{ 0x00f00f, 0x008003, "lsiu",	F_FLSI },
+	{ 0x00f00f, 0x00c003, "ssiu",	F_FLSI },
+
+	/* CALLN - op0 = 5 */
+	{ 0x00003f, 0x000005, "call0",	F_CALL,  LX_CALL | LX_CALL0 | LX_TARGET },
+	{ 0x00003f, 0x000015, "call4",	F_CALL,  LX_CALL | LX_TARGET },
+	{ 0x00003f, 0x000025, "call8",	F_CALL,  LX_CALL | LX_CALL8 | LX_TARGET },
+	{ 0x00003f, 0x000035, "call12",	F_CALL,  LX_CALL | LX_TARGET },
+
+	/* SI - op0 = 6 */
+	{ 0x00003f, 0x000006, "j",	F_J,	 J | T | LX_TARGET },
+	{ 0x0000ff, 0x000016, "beqz",	F_BZ,	 B | LX_TARGET },
+	{ 0x0000ff, 0x000056, "bnez",	F_BZ,	 B | LX_TARGET },
+	{ 0x0000ff, 0x000096, "bltz",	F_BZ,	 B | LX_TARGET },
+	{ 0x0000ff, 0x0000d6, "bgez",	F_BZ,	 B | LX_TARGET },
+	{ 0x0000ff, 0x000026, "beqi",	F_BI,	 B | LX_TARGET },
+	{ 0x0000ff, 0x000066, "bnei",	F_BI,	 B | LX_TARGET },
+	{ 0x0000ff, 0x0000a6, "blti",	F_BI,	 B | LX_TARGET },
+	{ 0x0000ff, 0x0000e6, "bgei",	F_BI,	 B | LX_TARGET },
+	{ 0x0000ff, 0x000036, "entry",	F_ENTRY },
+	{ 0x00f0ff, 0x000076, "bf",	F_BB,	 B | LX_TARGET },
+	{ 0x00f0ff, 0x001076, "bt",	F_BB,	 B | LX_TARGET },
+	/* espdis only ever treated loopnez as a branch */
+	{ 0x00f0ff, 0x008076, "loop",	F_LOOP,  LX_TARGET },
+	{ 0x00f0ff, 0x009076, "loopnez", F_LOOP, B | LX_TARGET },
+	{ 0x00f0ff, 0x00a076, "loopgtz", F_LOOP, LX_TARGET },
+	{ 0x0000ff, 0x0000b6, "bltui",	F_BIU,	 B | LX_TARGET },
+	{ 0x0000ff, 0x0000f6, "bgeui",	F_BIU,	 B | LX_TARGET },
+
+	/* B - op0 = 7 */
+	{ 0x00f00f, 0x000007, "bnone",	F_B,	 B | LX_TARGET },
+	{ 0x00f00f, 0x001007, "beq",	F_B,	 B | LX_TARGET },
+	{ 0x00f00f, 0x002007, "blt",	F_B,	 B | LX_TARGET },
+	{ 0x00f00f, 0x003007, "bltu",	F_B,	 B | LX_TARGET },
+	{ 0x00f00f, 0x004007, "ball",	F_B,	 B | LX_TARGET },
+	{ 0x00f00f, 0x005007, "bbc",	F_B,	 B | LX_TARGET },
+	{ 0x00e00f, 0x006007, "bbci",	F_BBI,	 B | LX_TARGET },
+	{ 0x00f00f, 0x008007, "bany",	F_B,	 B | LX_TARGET },
+	{ 0x00f00f, 0x009007, "bne",	F_B,	 B | LX_TARGET },
+	{ 0x00f00f, 0x00a007, "bge",	F_B,	 B | LX_TARGET },
+	{ 0x00f00f, 0x00b007, "bgeu",	F_B,	 B | LX_TARGET },
+	{ 0x00f00f, 0x00c007, "bnall",	F_B,	 B | LX_TARGET },
+	{ 0x00f00f, 0x00d007, "bbs",	F_B,	 B | LX_TARGET },
+	{ 0x00e00f, 0x00e007, "bbsi",	F_BBI,	 B | LX_TARGET },
+	{ 0 }
+};
+
+/* 16 bit density instructions */
+static struct lx_op op16[] = {
+	{ 0x000f, 0x0008, "l32i.n",	F_N_LS },
+	{ 0x000f, 0x0009, "s32i.n",	F_N_LS },
+	{ 0x000f, 0x000a, "add.n",	F_N_ADD },
+	{ 0x000f, 0x000b, "addi.n",	F_N_ADDI },
+	{ 0x008f, 0x000c, "movi.n",	F_N_MOVI },
+	{ 0x00cf, 0x008c, "beqz.n",	F_N_BZ,  B | LX_TARGET },
+	{ 0x00cf, 0x00cc, "bnez.n",	F_N_BZ,  B | LX_TARGET },
+	{ 0xf00f, 0x000d, "mov.n",	F_N_MOV },
+	{ 0xffff, 0xf00d, "ret.n",	F_NONE,  T },
+	{ 0xffff, 0xf01d, "retw.n",	F_NONE,  T },
+	{ 0xf0ff, 0xf02d, "break.n",	F_N_S },
+	{ 0xffff, 0xf03d, "nop.n",	F_NONE },
+	{ 0xffff, 0xf06d, "ill.n",	F_NONE,  LX_ILL },
+	{ 0 }
+};
+
+/* Special registers, for rsr, wsr and xsr */
+struct sreg {
+	int num;
+	char *name;
+};
+
+static struct sreg sregs[] = {
+	{ 0, "lbeg" },		{ 1, "lend" },		{ 2, "lcount" },
+	{ 3, "sar" },		{ 4, "br" },		{ 5, "litbase" },
+	{ 12, "scompare1" },	{ 16, "acclo" },	{ 17, "acchi" },
+	{ 32, "m0" },		{ 33, "m1" },		{ 34, "m2" },
+	{ 35, "m3" },		{ 72, "windowbase" },	{ 73, "windowstart" },
+	{ 83, "ptevaddr" },	{ 89, "mmid" },		{ 90, "rasid" },
+	{ 91, "itlbcfg" },	{ 92, "dtlbcfg" },	{ 96, "ibreakenable" },
+	{ 97, "memctl" },	{ 98, "cacheattr" },	{ 99, "atomctl" },
+	{ 104, "ddr" },		{ 128, "ibreaka0" },	{ 129, "ibreaka1" },
+	{ 144, "dbreaka0" },	{ 145, "dbreaka1" },	{ 160, "dbreakc0" },
+	{ 161, "dbreakc1" },	{ 176, "configid0" },	{ 177, "epc1" },
+	{ 178, "epc2" },	{ 179, "epc3" },	{ 180, "epc4" },
+	{ 181, "epc5" },	{ 182, "epc6" },	{ 183, "epc7" },
+	{ 192, "depc" },	{ 194, "eps2" },	{ 195, "eps3" },
+	{ 196, "eps4" },	{ 197, "eps5" },	{ 198, "eps6" },
+	{ 199, "eps7" },	{ 208, "configid1" },	{ 209, "excsave1" },
+	{ 210, "excsave2" },	{ 211, "excsave3" },	{ 212, "excsave4" },
+	{ 213, "excsave5" },	{ 214, "excsave6" },	{ 215, "excsave7" },
+	{ 224, "cpenable" },	{ 226, "intset" },	{ 227, "intclear" },
+	{ 228, "intenable" },	{ 230, "ps" },		{ 231, "vecbase" },
+	{ 232, "exccause" },	{ 233, "debugcause" },	{ 234, "ccount" },
+	{ 235, "prid" },	{ 236, "icount" },	{ 237, "icountlevel" },
+	{ 238, "excvaddr" },	{ 240, "ccompare0" },	{ 241, "ccompare1" },
+	{ 242, "ccompare2" },	{ 244, "misc0" },	{ 245, "misc1" },
+	{ 246, "misc2" },	{ 247, "misc3" },
+	{ -1, NULL }
+};
+
+static int b4const[] = {
+	-1, 1, 2, 3, 4, 5, 6, 7, 8, 10, 12, 16, 32, 64, 128, 256
+};
+
+static int b4constu[] = {
+	32768, 65536, 2, 3, 4, 5, 6, 7, 8, 10, 12, 16, 32, 64, 128, 256
+};
+
+/* We build mnemonics like "rsr.intenable" in here */
+static char sr_names[3][256][24];
+
+static char *
+sr_name ( char *op, int sr )
+{
+	struct sreg *sp;
+	int which;
+	char *name;
+
+	which = op[0] == 'r' ? 0 : op[0] == 'w' ? 1 : 2;
+	name = sr_names[which][sr];
+	if ( name[0] )
+	    return name;
+
+	for ( sp = sregs; sp->name; sp++ ) {
+	    if ( sp->num == sr )
+		break;
+	}
+
+	/* The same register reads as interrupt, is written as intset */
+	if ( sr == 226 && which == 0 )
+	    sprintf ( name, "%s.interrupt", op );
+	else if ( sp->name )
+	    sprintf ( name, "%s.%s", op, sp->name );
+	else
+	    return NULL;
+
+	return name;
+}
+
+static int
+sext ( unsigned int val, int bits )
+{
+	unsigned int sign = 1 << (bits-1);
+
+	val &= (1 << bits) - 1;
+	return (int) ((val ^ sign) - sign);
+}
+
+/* This is how objdump shows an immediate */
+static char *
+imm ( char *buf, int val )
+{
+	if ( val > -256 && val < 256 )
+	    sprintf ( buf, "%d", val );
+	else
+	    sprintf ( buf, "0x%x", (unsigned int) val );
+	return buf;
+}
+
+static void
+bogus ( struct lx_insn *ip, unsigned char *p )
+{
+	ip->size = 1;
+	ip->word = p[0];
+	ip->name = ".byte";
+	if ( p[0] )
+	    sprintf ( ip->ops, "0x%02x", p[0] );
+	else
+	    strcpy ( ip->ops, "0" );
+	ip->flags = 0;
+	ip->op = -1;
+}
+
+static struct lx_op *
+lookup ( struct lx_op *table, unsigned int word )
+{
+	struct lx_op *op;
+
+	for ( op = table; op->name; op++ )
+	    if ( (word & op->mask) == op->match )
+		return op;
+	return NULL;
+}
+
+/* Decode one instruction at addr from the bytes at p
+ * (avail of them are valid).  Returns the size.
+ */
+int
+lx_decode ( unsigned char *p, int avail, unsigned int addr, struct lx_insn *ip )
+{
+	struct lx_op *op;
+	unsigned int w;
+	int op0;
+	int r, s, t;
+	int val;
+	char ibuf[16];
+	char ibuf2[16];
+	char *name;
+
+	ip->addr = addr;
+	ip->target = 0;
+	ip->ops[0] = '\0';
+	ip->imm = 0;
+
+	if ( avail < 1 ) {
+	    ip->size = 0;
+	    return 0;
+	}
+
+	op0 = p[0] & 0xf;
+	if ( op0 >= 14 ) {
+	    bogus ( ip, p );
+	    return 1;
+	}
+
+	if ( op0 >= 8 ) {
+	    if ( avail < 2 ) {
+		bogus ( ip, p );
+		return 1;
+	    }
+	    ip->size = 2;
+	    w = p[0] | p[1] << 8;
+	    op = lookup ( op16, w );
+	    if ( op )
+		ip->op = op - op16;
+	} else {
+	    if ( avail < 3 ) {
+		bogus ( ip, p );
+		return 1;
+	    }
+	    ip->size = 3;
+	    w = p[0] | p[1] << 8 | p[2] << 16;
+	    op = lookup ( op24, w );
+	    if ( op )
+		ip->op = op - op24;
+	}
+
+	if ( ! op ) {
+	    bogus ( ip, p );
+	    return 1;
+	}
+
+	ip->word = w;
+	ip->name = op->name;
+	ip->flags = op->flags;
+
+	t = (w >> 4) & 0xf;
+	s = (w >> 8) & 0xf;
+	r = (w >> 12) & 0xf;
+	ip->r = r;
+	ip->s = s;
+	ip->t = t;
+
+	switch ( op->fmt ) {
+	    case F_NONE:
+		break;
+	    case F_RRR:
+	    case F_N_ADD:
+		sprintf ( ip->ops, "a%d, a%d, a%d", r, s, t );
+		break;
+	    case F_RT:
+		sprintf ( ip->ops, "a%d, a%d", r, t );
+		break;
+	    case F_RS:
+		sprintf ( ip->ops, "a%d, a%d", r, s );
+		break;
+	    case F_TS:
+	    case F_N_MOV:
+		sprintf ( ip->ops, "a%d, a%d", t, s );
+		break;
+	    case F_S:
+		sprintf ( ip->ops, "a%d", s );
+		break;
+	    case F_BOOL:
+		sprintf ( ip->ops, "b%d, b%d, b%d", r, s, t );
+		break;
+	    case F_BOOL2:
+		sprintf ( ip->ops, "b%d, b%d", t, s );
+		break;
+	    case F_MOVB:
+		sprintf ( ip->ops, "a%d, a%d, b%d", r, s, t );
+		break;
+	    case F_SEXT:
+		ip->imm = t + 7;
+		sprintf ( ip->ops, "a%d, a%d, %s", r, s, imm(ibuf,ip->imm) );
+		break;
+	    case F_SSAI:
+		ip->imm = s | (t & 1) << 4;
+		sprintf ( ip->ops, "%s", imm(ibuf,ip->imm) );
+		break;
+	    case F_SLLI:
+		ip->imm = 32 - (((w >> 20) & 1) << 4 | t);
+		sprintf ( ip->ops, "a%d, a%d, %s", r, s, imm(ibuf,ip->imm) );
+		break;
+	    case F_SRAI:
+		ip->imm = ((w >> 20) & 1) << 4 | s;
+		sprintf ( ip->ops, "a%d, a%d, %s", r, t, imm(ibuf,ip->imm) );
+		break;
+	    case F_SRLI:
+		ip->imm = s;
+		sprintf ( ip->ops, "a%d, a%d, %s", r, t, imm(ibuf,ip->imm) );
+		break;
+	    case F_EXTUI:
+		ip->imm = ((w >> 16) & 1) << 4 | s;
+		sprintf ( ip->ops, "a%d, a%d, %s, %s", r, t, imm(ibuf,ip->imm),
+			imm(ibuf2,((w >> 20) & 0xf) + 1) );
+		break;
+	    case F_SR:
+		ip->imm = (r << 4) | s;
+		name = sr_name ( op->name, ip->imm );
+		if ( name ) {
+		    ip->name = name;
+		    sprintf ( ip->ops, "a%d", t );
+		} else
+		    sprintf ( ip->ops, "a%d, %s", t, imm(ibuf,ip->imm) );
+		break;
+	    case F_BREAK:
+		sprintf ( ip->ops, "%s, %s", imm(ibuf,s), imm(ibuf2,t) );
+		break;
+	    case F_IMM_S:
+	    case F_N_S:
+		ip->imm = s;
+		sprintf ( ip->ops, "%s", imm(ibuf,s) );
+		break;
+	    case F_RSIL:
+		ip->imm = s;
+		sprintf ( ip->ops, "a%d, %s", t, imm(ibuf,s) );
+		break;
+	    case F_E:
+		ip->imm = (r << 2) - 64;
+		sprintf ( ip->ops, "a%d, a%d, %s", t, s, imm(ibuf,ip->imm) );
+		break;
+	    case F_L32R:
+		ip->target = ((addr + 3) & ~3) + ((0xffff0000 | (w >> 8)) << 2);
+		sprintf ( ip->ops, "a%d, 0x%08x", t, ip->target );
+		break;
+	    case F_LSAI:
+		ip->imm = (w >> 16) * op->scale;
+		sprintf ( ip->ops, "a%d, a%d, %s", t, s, imm(ibuf,ip->imm) );
+		break;
+	    case F_FLSI:
+		ip->imm = (w >> 16) * 4;
+		sprintf ( ip->ops, "f%d, a%d, %s", t, s, imm(ibuf,ip->imm) );
+		break;
+	    case F_CACHE:
+		ip->imm = (w >> 16) * 4;
+		sprintf ( ip->ops, "a%d, %s", s, imm(ibuf,ip->imm) );
+		break;
+	    case F_MOVI:
+		ip->imm = sext ( (s << 8) | (w >> 16), 12 );
+		sprintf ( ip->ops, "a%d, %s", t, imm(ibuf,ip->imm) );
+		break;
+	    case F_ADDI:
+		ip->imm = sext ( w >> 16, 8 );
+		sprintf ( ip->ops, "a%d, a%d, %s", t, s, imm(ibuf,ip->imm) );
+		break;
+	    case F_ADDMI:
+		ip->imm = sext ( w >> 16, 8 ) * 256;
+		sprintf ( ip->ops, "a%d, a%d, %s", t, s, imm(ibuf,ip->imm) );
+		break;
+	    case F_CALL:
+		ip->target = (addr & ~3) + sext ( w >> 6, 18 ) * 4 + 4;
+		sprintf ( ip->ops, "0x%08x", ip->target );
+		break;
+	    case F_J:
+		ip->target = addr + 4 + sext ( w >> 6, 18 );
+		sprintf ( ip->ops, "0x%08x", ip->target );
+		break;
+	    case F_BZ:
+		ip->target = addr + 4 + sext ( w >> 12, 12 );
+		sprintf ( ip->ops, "a%d, 0x%08x", s, ip->target );
+		break;
+	    case F_BI:
+		ip->imm = b4const[r];
+		ip->target = addr + 4 + sext ( w >> 16, 8 );
+		sprintf ( ip->ops, "a%d, %s, 0x%08x", s, imm(ibuf,ip->imm), ip->target );
+		break;
+	    case F_BIU:
+		ip->imm = b4constu[r];
+		ip->target = addr + 4 + sext ( w >> 16, 8 );
+		sprintf ( ip->ops, "a%d, %s, 0x%08x", s, imm(ibuf,ip->imm), ip->target );
+		break;
+	    case F_BB:
+		ip->target = addr + 4 + sext ( w >> 16, 8 );
+		sprintf ( ip->ops, "b%d, 0x%08x", s, ip->target );
+		break;
+	    case F_LOOP:
+		ip->target = addr + 4 + (w >> 16);
+		sprintf ( ip->ops, "a%d, 0x%08x", s, ip->target );
+		break;
+	    case F_ENTRY:
+		ip->imm = (w >> 12) << 3;
+		sprintf ( ip->ops, "a%d, %s", s, imm(ibuf,ip->imm) );
+		break;
+	    case F_B:
+		ip->target = addr + 4 + sext ( w >> 16, 8 );
+		sprintf ( ip->ops, "a%d, a%d, 0x%08x", s, t, ip->target );
+		break;
+	    case F_BBI:
+		ip->imm = (r & 1) << 4 | t;
+		ip->target = addr + 4 + sext ( w >> 16, 8 );
+		sprintf ( ip->ops, "a%d, %s, 0x%08x", s, imm(ibuf,ip->imm), ip->target );
+		break;
+	    case F_N_LS:
+		ip->imm = r * 4;
+		sprintf ( ip->ops, "a%d, a%d, %s", t, s, imm(ibuf,ip->imm) );
+		break;
+	    case F_N_ADDI:
+		ip->imm = t ? t : -1;
+		sprintf ( ip->ops, "a%d, a%d, %s", r, s, imm(ibuf,ip->imm) );
+		break;
+	    case F_N_MOVI:
+		val = (t & 7) << 4 | r;
+		if ( (t & 6) == 6 )
+		    val -= 128;
+		ip->imm = val;
+		sprintf ( ip->ops, "a%d, %s", s, imm(ibuf,val) );
+		break;
+	    case F_N_BZ:
+		ip->target = addr + 4 + ((t & 3) << 4 | r);
+		sprintf ( ip->ops, "a%d, 0x%08x", s, ip->target );
+		break;
+	}
+
+	return ip->size;
+}
+
+/* Format the way objdump does:
+ * 40000013:	46feff      	j	0x40000010
+ */
+void
+lx_line ( struct lx_insn *ip, char *buf )
+{
+	char bytes[16];
+	int i;
+
+	for ( i=0; i<ip->size; i++ )
+	    sprintf ( &bytes[i*2], "%02x", (ip->word >> (i*8)) & 0xff );
+
+	if ( ip->ops[0] )
+	    sprintf ( buf, "%08x:\t%-12s\t%s\t%s", ip->addr, bytes, ip->name, ip->ops );
+	else
+	    sprintf ( buf, "%08x:\t%-12s\t%s", ip->addr, bytes, ip->name );
+}
+
+/* THE END */
@@ -0,0 +1,34 @@
+/* lx106.h
+ * Instruction decoder for the Xtensa lx106 in the ESP8266
+ */
+
+/* What we know about one instruction */
+struct lx_insn {
+	unsigned int addr;
+	int size;		/* 2 or 3, 1 for .byte */
+	unsigned int word;	/* the raw bytes, little endian */
+	char *name;		/* mnemonic */
+	char ops[64];		/* operands, objdump style */
+	unsigned int target;	/* branch, jump, call or l32r */
+	int flags;
+	int op;			/* index into the opcode table, -1 if bogus */
+	int r, s, t;		/* register fields */
+	int imm;		/* immediate as printed */
+};
+
+/* These follow the tests espdis makes on the mnemonic */
+#define LX_BRANCH	0x0001
+#define LX_JUMP		0x0002
+#define LX_CALL		0x0004
+#define LX_CALL0	0x0008
+#define LX_CALL8	0x0010
+#define LX_L32R		0x0020
+#define LX_TERM		0x0040
+#define LX_ILL		0x0080
+#define LX_CALLX	0x0100
+#define LX_TARGET	0x0200	/* target field is valid */
+
+int lx_decode ( unsigned char *, int, unsigned int, struct lx_insn * );
+void lx_line ( struct lx_insn *, char * );
+
+/* THE END */
@@ -0,0 +1,554 @@
+/* lxcache.c
+ * One of my ESP8266 reverse engineering tools
+ *
+ * A cache for lxdis pass 2 (lxdis -C file).
+ *
+ * Pass 1 is cheap and needs the whole picture anyway (one hint
+ * can move the boundary of everything that follows it), so it
+ * always runs.  What we save is pass 2, one entry per region of
+ * the map (the same regions get_range hands out), holding the
+ * text we printed for it along with what that text depended on:
+ *
+ *  - the map from the start of the region to as far as pass 2
+ *    looked (it runs on past the end of a region at times),
+ *  - every name it looked up, and what it got.
+ *
+ * The whole cache is keyed on the rom image, so the bytes themselves
+ * don't need to be checked again.  A hint or symbol change shows up
+ * as a change to the map or to a name, and only the regions that see
+ * it are done over.
+ *
+ * With -u we also write a list of address ranges whose listing
+ * changed from what was in the cache, one range per line:
+ *
+ *   40001234 40001250
+ *
+ * which lxpatch uses to patch the merged listing (boot.txt)
+ * without doing the whole merge over.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image.h"
+#include "lx106.h"
+#include "lxdis.h"
+
+#define CACHE_MAGIC	"LXDC"
+#define CACHE_VERSION	1
+
+struct dep {
+	int table;
+	unsigned int addr;
+	unsigned long long hash;
+};
+
+struct centry {
+	unsigned int start;
+	unsigned int end;
+	unsigned int reach;
+	int type;
+	unsigned long long hash;
+	int ndeps;
+	struct dep *deps;
+	int len;
+	char *text;
+	unsigned int top;
+};
+
+struct ctab {
+	struct centry *list;
+	int count;
+	int max;
+};
+
+/* what we read in, and what we will write out */
+static struct ctab old_tab;
+static struct ctab new_tab;
+
+/* old entries by start address */
+static int *old_hash;
+static int old_hsize;
+
+static unsigned long long rom_key;
+static char *change_file;
+
+/* the region being printed now */
+static struct dep *cur_deps;
+static int cur_ndeps;
+static int cur_max;
+static char *cur_text;
+static size_t cur_len;
+
+/* ranges that changed, in order */
+struct range {
+	unsigned int lo;
+	unsigned int hi;
+};
+
+static struct range *changes;
+static int nchanges;
+static int max_changes;
+
+/* running max of top over new_tab */
+static unsigned int *max_top;
+static int max_top_size;
+
+static int hits;
+static int misses;
+
+/* FNV-1a, 64 bit */
+#define FNV_INIT	0xcbf29ce484222325ULL
+#define FNV_PRIME	0x100000001b3ULL
+
+static unsigned long long
+fnv ( unsigned long long h, void *buf, int len )
+{
+	unsigned char *p = buf;
+
+	while ( len-- ) {
+	    h ^= *p++;
+	    h *= FNV_PRIME;
+	}
+	return h;
+}
+
+static unsigned long long
+fnv_int ( unsigned long long h, unsigned int val )
+{
+	return fnv ( h, &val, sizeof(val) );
+}
+
+/* zero for "no name", which is also something to depend on */
+static unsigned long long
+name_hash ( char *name )
+{
+	if ( ! name )
+	    return 0;
+	return fnv ( FNV_INIT, name, strlen(name) ) | 1;
+}
+
+/* The map as pass 2 saw it for a region */
+static unsigned long long
+region_hash ( unsigned int start, unsigned int end, int type, unsigned int reach )
+{
+	unsigned long long h = FNV_INIT;
+	unsigned int lim;
+
+	h = fnv_int ( h, start );
+	h = fnv_int ( h, end );
+	h = fnv_int ( h, type );
+	h = fnv_int ( h, reach );
+
+	lim = reach;
+	if ( lim > rom_limit + 1 )
+	    lim = rom_limit + 1;
+	if ( start < lim )
+	    h = fnv ( h, &map[start - rom_base], lim - start );
+	return h;
+}
+
+/* Just past the last address in the text for a region,
+ * which can be past the end of the region (range2 runs on).
+ */
+static unsigned int
+text_top ( struct centry *ep )
+{
+	unsigned int top = ep->end;
+	unsigned int addr;
+	char *p, *end;
+	char *xp;
+
+	p = ep->text;
+	end = ep->text + ep->len;
+	while ( p < end ) {
+	    if ( end - p > 9 && p[8] == ':' ) {
+		addr = strtoul ( p, &xp, 16 );
+		if ( xp == p + 8 && addr + 1 > top )
+		    top = addr + 1;
+	    }
+	    p = memchr ( p, '\n', end - p );
+	    if ( ! p )
+		break;
+	    p++;
+	}
+	return top;
+}
+
+static struct centry *
+tab_add ( struct ctab *tp )
+{
+	if ( tp->count >= tp->max ) {
+	    tp->max = tp->max ? tp->max * 2 : 1024;
+	    tp->list = xrealloc ( tp->list, tp->max * sizeof(struct centry) );
+	}
+	return &tp->list[tp->count++];
+}
+
+static void
+old_rehash ( void )
+{
+	unsigned int h;
+	int i;
+
+	old_hsize = 1;
+	while ( old_hsize < old_tab.count * 2 )
+	    old_hsize *= 2;
+	old_hash = xrealloc ( NULL, old_hsize * sizeof(int) );
+	for ( i=0; i<old_hsize; i++ )
+	    old_hash[i] = -1;
+
+	for ( i=0; i<old_tab.count; i++ ) {
+	    h = (old_tab.list[i].start * 2654435761U) & (old_hsize - 1);
+	    while ( old_hash[h] >= 0 )
+		h = (h + 1) & (old_hsize - 1);
+	    old_hash[h] = i;
+	}
+}
+
+static struct centry *
+old_find ( unsigned int start )
+{
+	unsigned int h;
+
+	if ( ! old_tab.count )
+	    return NULL;
+
+	h = (start * 2654435761U) & (old_hsize - 1);
+	while ( old_hash[h] >= 0 ) {
+	    if ( old_tab.list[old_hash[h]].start == start )
+		return &old_tab.list[old_hash[h]];
+	    h = (h + 1) & (old_hsize - 1);
+	}
+	return NULL;
+}
+
+/* ------------------------------------------------------------ */
+
+static int
+get_val ( FILE *fp, void *buf, int size )
+{
+	return fread ( buf, size, 1, fp ) == 1;
+}
+
+static void
+put_val ( FILE *fp, void *buf, int size )
+{
+	fwrite ( buf, size, 1, fp );
+}
+
+static int
+read_entry ( FILE *fp, struct centry *ep )
+{
+	if ( ! get_val ( fp, &ep->start, sizeof(ep->start) ) )
+	    return 0;
+	if ( ! get_val ( fp, &ep->end, sizeof(ep->end) ) )
+	    return 0;
+	if ( ! get_val ( fp, &ep->reach, sizeof(ep->reach) ) )
+	    return 0;
+	if ( ! get_val ( fp, &ep->type, sizeof(ep->type) ) )
+	    return 0;
+	if ( ! get_val ( fp, &ep->hash, sizeof(ep->hash) ) )
+	    return 0;
+	if ( ! get_val ( fp, &ep->ndeps, sizeof(ep->ndeps) ) )
+	    return 0;
+	if ( ! get_val ( fp, &ep->len, sizeof(ep->len) ) )
+	    return 0;
+	if ( ep->ndeps < 0 || ep->len < 0 )
+	    return 0;
+
+	ep->deps = xrealloc ( NULL, ep->ndeps * sizeof(struct dep) + 1 );
+	if ( ep->ndeps && ! get_val ( fp, ep->deps, ep->ndeps * sizeof(struct dep) ) )
+	    return 0;
+	ep->text = xrealloc ( NULL, ep->len + 1 );
+	if ( ep->len && ! get_val ( fp, ep->text, ep->len ) )
+	    return 0;
+	ep->top = text_top ( ep );
+	return 1;
+}
+
+static void
+write_entry ( FILE *fp, struct centry *ep )
+{
+	put_val ( fp, &ep->start, sizeof(ep->start) );
+	put_val ( fp, &ep->end, sizeof(ep->end) );
+	put_val ( fp, &ep->reach, sizeof(ep->reach) );
+	put_val ( fp, &ep->type, sizeof(ep->type) );
+	put_val ( fp, &ep->hash, sizeof(ep->hash) );
+	put_val ( fp, &ep->ndeps, sizeof(ep->ndeps) );
+	put_val ( fp, &ep->len, sizeof(ep->len) );
+	put_val ( fp, ep->deps, ep->ndeps * sizeof(struct dep) );
+	put_val ( fp, ep->text, ep->len );
+}
+
+/* A missing or stale cache is not an error,
+ * we just end up doing everything.
+ */
+void
+cache_load ( char *file, char *changes_file )
+{
+	FILE *fp;
+	char magic[4];
+	int version;
+	unsigned long long key;
+	int count;
+	struct centry *ep;
+	int i;
+
+	change_file = changes_file;
+
+	rom_key = fnv_int ( FNV_INIT, CACHE_VERSION );
+	rom_key = fnv_int ( rom_key, rom_base );
+	rom_key = fnv_int ( rom_key, rom_size );
+	rom_key = fnv ( rom_key, image_ptr ( rom_base, rom_size ), rom_size );
+
+	fp = fopen ( file, "r" );
+	if ( ! fp )
+	    return;
+
+	if ( ! get_val ( fp, magic, 4 ) || memcmp ( magic, CACHE_MAGIC, 4 ) != 0 )
+	    goto stale;
+	if ( ! get_val ( fp, &version, sizeof(version) ) || version != CACHE_VERSION )
+	    goto stale;
+	if ( ! get_val ( fp, &key, sizeof(key) ) || key != rom_key )
+	    goto stale;
+	if ( ! get_val ( fp, &count, sizeof(count) ) || count < 0 )
+	    goto stale;
+
+	for ( i=0; i<count; i++ ) {
+	    ep = tab_add ( &old_tab );
+	    if ( ! read_entry ( fp, ep ) ) {
+		/* a short file, keep what we got */
+		old_tab.count--;
+		break;
+	    }
+	}
+	fclose ( fp );
+	old_rehash ();
+	return;
+
+stale:
+	fclose ( fp );
+}
+
+static void
+add_change ( unsigned int lo, unsigned int hi )
+{
+	struct range *rp;
+
+	/* pass 2 runs in order, so we only ever merge with the last one */
+	if ( nchanges ) {
+	    rp = &changes[nchanges-1];
+	    if ( lo <= rp->hi ) {
+		if ( hi > rp->hi )
+		    rp->hi = hi;
+		if ( lo < rp->lo )
+		    rp->lo = lo;
+		/* a range can grow back over the ones before it */
+		while ( nchanges > 1 && rp->lo <= changes[nchanges-2].hi ) {
+		    if ( rp->hi > changes[nchanges-2].hi )
+			changes[nchanges-2].hi = rp->hi;
+		    if ( rp->lo < changes[nchanges-2].lo )
+			changes[nchanges-2].lo = rp->lo;
+		    nchanges--;
+		    rp = &changes[nchanges-1];
+		}
+		return;
+	    }
+	}
+
+	if ( nchanges >= max_changes ) {
+	    max_changes = max_changes ? max_changes * 2 : 64;
+	    changes = xrealloc ( changes, max_changes * sizeof(struct range) );
+	}
+	changes[nchanges].lo = lo;
+	changes[nchanges].hi = hi;
+	nchanges++;
+}
+
+/* Keep the new entry, and if it is not what we had before,
+ * note the addresses involved (top covers what the old text
+ * for the region had).
+ */
+static void
+keep ( struct centry *ep, int changed, unsigned int top )
+{
+	struct centry *np;
+	unsigned int lo, hi;
+	unsigned int prev;
+	int i;
+
+	np = tab_add ( &new_tab );
+	*np = *ep;
+
+	i = new_tab.count - 1;
+	if ( i >= max_top_size ) {
+	    max_top_size = new_tab.max;
+	    max_top = xrealloc ( max_top, max_top_size * sizeof(unsigned int) );
+	}
+	prev = i ? max_top[i-1] : 0;
+	max_top[i] = ep->top > prev ? ep->top : prev;
+
+	if ( ! changed )
+	    return;
+
+	/* A region before this one may have run on into it
+	 * (range2 does that), its lines are mixed in with ours
+	 * in the listing, so it goes along with us.
+	 */
+	lo = ep->start;
+	hi = ep->top > top ? ep->top : top;
+	while ( i > 0 && max_top[i-1] > lo ) {
+	    i--;
+	    if ( new_tab.list[i].top > lo )
+		lo = new_tab.list[i].start;
+	}
+	add_change ( lo, hi );
+}
+
+/* Can we use what we had for this region ?
+ * If so, print it and say so.
+ */
+int
+cache_lookup ( unsigned int start, unsigned int end, int type )
+{
+	struct centry *ep;
+	int i;
+
+	ep = old_find ( start );
+	if ( ! ep || ep->end != end || ep->type != type ) {
+	    misses++;
+	    return 0;
+	}
+
+	if ( region_hash ( start, end, type, ep->reach ) != ep->hash ) {
+	    misses++;
+	    return 0;
+	}
+
+	for ( i=0; i<ep->ndeps; i++ ) {
+	    if ( name_hash ( dep_name ( ep->deps[i].table, ep->deps[i].addr ) ) != ep->deps[i].hash ) {
+		misses++;
+		return 0;
+	    }
+	}
+
+	fwrite ( ep->text, 1, ep->len, out );
+	keep ( ep, 0, 0 );
+	hits++;
+	return 1;
+}
+
+/* Send pass 2 output to memory for a while */
+void
+cache_begin ( void )
+{
+	cur_ndeps = 0;
+	cur_text = NULL;
+	cur_len = 0;
+	out = open_memstream ( &cur_text, &cur_len );
+	if ( ! out ) {
+	    printf ( "Cannot open memory stream\n" );
+	    exit ( 1 );
+	}
+}
+
+void
+cache_dep ( int table, unsigned int addr, char *name )
+{
+	/* mark_addr asks the same thing over and over */
+	if ( cur_ndeps && cur_deps[cur_ndeps-1].table == table &&
+		cur_deps[cur_ndeps-1].addr == addr )
+	    return;
+
+	if ( cur_ndeps >= cur_max ) {
+	    cur_max = cur_max ? cur_max * 2 : 256;
+	    cur_deps = xrealloc ( cur_deps, cur_max * sizeof(struct dep) );
+	}
+	cur_deps[cur_ndeps].table = table;
+	cur_deps[cur_ndeps].addr = addr;
+	cur_deps[cur_ndeps].hash = name_hash ( name );
+	cur_ndeps++;
+}
+
+void
+cache_end ( unsigned int start, unsigned int end, int type, unsigned int reach )
+{
+	struct centry e;
+	struct centry *ep;
+	int changed;
+
+	fclose ( out );
+	out = stdout;
+	fwrite ( cur_text, 1, cur_len, out );
+
+	e.start = start;
+	e.end = end;
+	e.reach = reach;
+	e.type = type;
+	e.hash = region_hash ( start, end, type, reach );
+	e.ndeps = cur_ndeps;
+	e.deps = xrealloc ( NULL, cur_ndeps * sizeof(struct dep) + 1 );
+	memcpy ( e.deps, cur_deps, cur_ndeps * sizeof(struct dep) );
+	e.len = cur_len;
+	e.text = cur_text;
+	e.top = text_top ( &e );
+
+	/* Same text as before is no change, as far as the
+	 * listing goes, even if what went into it did.
+	 */
+	ep = old_find ( start );
+	changed = 1;
+	if ( ep && ep->end == end && ep->len == e.len &&
+		memcmp ( ep->text, e.text, e.len ) == 0 )
+	    changed = 0;
+
+	/* what the old one printed has to go too */
+	keep ( &e, changed, ep ? ep->top : 0 );
+}
+
+static void
+save_changes ( void )
+{
+	FILE *fp;
+	int i;
+
+	fp = fopen ( change_file, "w" );
+	if ( ! fp ) {
+	    printf ( "Cannot open %s\n", change_file );
+	    exit ( 1 );
+	}
+
+	for ( i=0; i<nchanges; i++ )
+	    fprintf ( fp, "%08x %08x\n", changes[i].lo, changes[i].hi );
+	fclose ( fp );
+}
+
+void
+cache_save ( void )
+{
+	FILE *fp;
+	int version = CACHE_VERSION;
+	int i;
+
+	fp = fopen ( cache_file, "w" );
+	if ( ! fp ) {
+	    printf ( "Cannot open %s\n", cache_file );
+	    exit ( 1 );
+	}
+
+	fwrite ( CACHE_MAGIC, 4, 1, fp );
+	put_val ( fp, &version, sizeof(version) );
+	put_val ( fp, &rom_key, sizeof(rom_key) );
+	put_val ( fp, &new_tab.count, sizeof(new_tab.count) );
+	for ( i=0; i<new_tab.count; i++ )
+	    write_entry ( fp, &new_tab.list[i] );
+	fclose ( fp );
+
+	if ( change_file )
+	    save_changes ();
+
+	fprintf ( stderr, "lxdis cache: %d regions reused, %d done over\n", hits, misses );
+}
+
+/* THE END */
@@ -0,0 +1,200 @@
+/* lxcheck.c
+ * One of my ESP8266 reverse engineering tools
+ *
+ * Check the lx106 decoder (lx106.c) against a listing
+ * that objdump made.  The obvious one to use is the
+ * bootrom disassembly, boot.txt, which has about 20,000
+ * instructions in it, all disassembled by objdump,
+ * each line with the bytes, the mnemonic and the operands:
+ *
+ * 400000b5:       303074          extui   a3, a3, 0, 8	; comment
+ *
+ * My espdis rewrote call0 and l32r lines, so for those we
+ * pull the target address back out of the comment:
+ *
+ * 40000149:       052e00          call0   _start		; 0x4000042c
+ * 400000c0:       21f2ff          l32r    a2, [Vec_base]	; [0x40000000] 0x40000088
+ *
+ * There are a few lines in boot.txt that I edited by hand,
+ * use -x addr to skip them.
+ *
+ *   ./lxcheck -x 4000e299 ../bootrom/boot.txt
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "lx106.h"
+
+int verbose = 0;
+
+#define MAX_SKIP	32
+
+unsigned int skip[MAX_SKIP];
+int nskip = 0;
+
+static char *
+skip_white ( char *p )
+{
+	while ( *p == ' ' || *p == '\t' )
+	    p++;
+	return p;
+}
+
+static char *
+skip_word ( char *p )
+{
+	while ( *p && *p != ' ' && *p != '\t' )
+	    p++;
+	return p;
+}
+
+static int
+is_hex ( char *p, int n )
+{
+	int i;
+
+	for ( i=0; i<n; i++ )
+	    if ( ! isxdigit ( p[i] ) || isupper ( p[i] ) )
+		return 0;
+	return 1;
+}
+
+/* The target address in an espdis comment */
+static char *
+comment_target ( char *cp )
+{
+	static char buf[16];
+
+	if ( *cp != ';' )
+	    return NULL;
+	cp = skip_white ( cp + 1 );
+	if ( *cp == '[' ) {
+	    cp = strchr ( cp, ']' );
+	    if ( ! cp )
+		return NULL;
+	    cp = skip_white ( cp + 1 );
+	}
+	if ( strncmp ( cp, "0x", 2 ) != 0 || ! is_hex ( cp+2, 8 ) )
+	    return NULL;
+	memcpy ( buf, cp, 10 );
+	buf[10] = '\0';
+	return buf;
+}
+
+int
+main ( int argc, char **argv )
+{
+	FILE *fp;
+	char line[1024];
+	char expect[256];
+	char comment[1024];
+	char *p, *bp, *np, *op, *cp, *tp;
+	unsigned char bytes[3];
+	unsigned int addr;
+	int nbytes;
+	int i;
+	struct lx_insn insn;
+	int checked = 0;
+	int bad = 0;
+
+	argc--;
+	++argv;
+	while ( argc && **argv == '-' ) {
+	    if ( argv[0][1] == 'v' )
+		verbose = 1;
+	    if ( argv[0][1] == 'x' && argc > 1 && nskip < MAX_SKIP ) {
+		skip[nskip++] = strtoul ( argv[1], NULL, 16 );
+		argc--;
+		++argv;
+	    }
+	    argc--;
+	    ++argv;
+	}
+
+	if ( argc < 1 ) {
+	    printf ( "Usage: lxcheck [-v] [-x addr] listing\n" );
+	    exit ( 1 );
+	}
+
+	fp = fopen ( argv[0], "r" );
+	if ( ! fp ) {
+	    printf ( "Cannot open %s\n", argv[0] );
+	    exit ( 1 );
+	}
+
+	while ( fgets ( line, sizeof(line), fp ) ) {
+	    line[strcspn ( line, "\r\n" )] = '\0';
+
+	    if ( ! is_hex ( line, 8 ) || line[8] != ':' )
+		continue;
+	    addr = strtoul ( line, NULL, 16 );
+	    for ( i=0; i<nskip; i++ )
+		if ( skip[i] == addr )
+		    break;
+	    if ( i < nskip )
+		continue;
+
+	    bp = skip_white ( &line[9] );
+	    p = skip_word ( bp );
+	    nbytes = (p - bp) / 2;
+	    if ( (nbytes != 2 && nbytes != 3) || (p - bp) % 2 || ! is_hex ( bp, p - bp ) )
+		continue;
+	    for ( i=0; i<nbytes; i++ )
+		sscanf ( &bp[i*2], "%2hhx", &bytes[i] );
+
+	    np = skip_white ( p );
+	    if ( ! *np || *np == ';' )
+		continue;
+	    p = skip_word ( np );
+	    if ( *p )
+		*p++ = '\0';
+
+	    /* split off the comment */
+	    op = skip_white ( p );
+	    cp = strchr ( op, ';' );
+	    comment[0] = '\0';
+	    if ( cp ) {
+		strcpy ( comment, cp );
+		*cp = '\0';
+	    }
+	    p = op + strlen ( op );
+	    while ( p > op && (p[-1] == ' ' || p[-1] == '\t') )
+		*--p = '\0';
+
+	    if ( strncmp ( np, "call", 4 ) == 0 && strncmp ( np, "callx", 5 ) != 0 ) {
+		tp = comment_target ( comment );
+		if ( ! tp )
+		    continue;
+		strcpy ( expect, tp );
+	    } else if ( strcmp ( np, "l32r" ) == 0 ) {
+		tp = comment_target ( comment );
+		if ( ! tp )
+		    continue;
+		p = strchr ( op, ',' );
+		if ( ! p )
+		    continue;
+		*p = '\0';
+		sprintf ( expect, "%s, %s", op, tp );
+	    } else
+		strcpy ( expect, op );
+
+	    lx_decode ( bytes, nbytes, addr, &insn );
+	    checked++;
+
+	    if ( insn.size != nbytes || strcmp ( insn.name, np ) != 0 ||
+		    strcmp ( insn.ops, expect ) != 0 ) {
+		bad++;
+		printf ( "%08x: %s %s -- we get (%d) %s %s\n", addr, np, expect,
+			insn.size, insn.name, insn.ops );
+	    } else if ( verbose )
+		printf ( "%08x: %s %s OK\n", addr, np, expect );
+	}
+	fclose ( fp );
+
+	printf ( "%d instructions checked, %d differ\n", checked, bad );
+	return bad ? 1 : 0;
+}
+
+/* THE END */
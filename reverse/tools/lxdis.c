@@ -0,0 +1,1300 @@
+/* lxdis.c
+ * One of my ESP8266 reverse engineering tools
+ *
+ * This is my espdis ruby script (in reverse/bootrom) redone in C.
+ * espdis ran objdump for every few lines it disassembled (with a
+ * cache that got that down from 21 seconds to a couple),
+ * here we decode the instructions ourself (see lx106.c) right
+ * out of the memory mapped image.
+ *
+ * Everything else is done just the way espdis does it, so that
+ * we get the same new.dis, right down to the oddities.
+ *
+ * Pass 1 is a recursive descent from the entry points.
+ * We follow jumps, branches and calls, and mark every byte in
+ * a map as an instruction (I) or a literal for an l32r (L).
+ * The hints file can mark data (E, F, 4, D) and add symbols.
+ *
+ * Pass 2 walks the map in order and prints each region.
+ *
+ *  lxdis		- start at the reset vector
+ *  lxdis all		- use every symbol as an entry point
+ *  lxdis 40001234	- start at this address
+ *  lxdis name		- start at this symbol (or 0x40001234)
+ *
+ * Options:
+ *  -i file		- the rom image (bootrom.bin)
+ *  -s file		- more symbols, either "addr name" lines
+ *			  like calls.sy, or PROVIDE lines.
+ *  -j n		- decode with n threads first (see lxwork.c)
+ *  -x file		- write a cross reference file (see xref.c)
+ *  -a			- annotate labels and literals with
+ *			  what refers to them
+ *  -C file		- keep the listing for each region in this cache,
+ *			  and only redo the ones whose hints or symbols
+ *			  changed (see lxcache.c)
+ *  -u file		- with -C, write the address ranges whose listing
+ *			  changed (for lxpatch)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image.h"
+#include "lx106.h"
+#include "lxdis.h"
+#include "xref.h"
+
+#define ROM_SIZE	65536
+
+char *bin_file = "bootrom.bin";
+char *sym_file = "syms";
+char *iosym_file = "iosyms";
+char *hint_file = "hints";
+
+unsigned int rom_base = ROM_BASE;
+unsigned int rom_size = ROM_SIZE;
+unsigned int rom_limit;
+
+/* ------------------------------------------------------------ */
+/* Name tables.
+ * We need to keep the order things were added in, since
+ * that is the order "all" uses them as entry points, so there
+ * is a list in that order, along with a hash on the address.
+ * Adding a name for an address we already have just
+ * replaces the name (like a ruby hash).
+ */
+
+struct name {
+	unsigned int addr;
+	char *name;
+};
+
+struct names {
+	struct name *list;
+	int count;
+	int max;
+	int *hash;
+	int hsize;
+};
+
+struct names syms;	/* from the symbol files and hints */
+struct names calls;	/* call targets we have seen */
+
+int annotate = 0;
+char *xref_file = NULL;
+char *cache_file = NULL;
+char *change_file = NULL;
+
+void *
+xrealloc ( void *p, int size )
+{
+	p = realloc ( p, size );
+	if ( ! p ) {
+	    printf ( "Out of memory\n" );
+	    exit ( 1 );
+	}
+	return p;
+}
+
+static unsigned int
+hash_addr ( unsigned int addr, int hsize )
+{
+	return ((addr >> 2) * 2654435761u) & (hsize - 1);
+}
+
+static int
+names_find ( struct names *np, unsigned int addr )
+{
+	unsigned int h;
+	int i;
+
+	if ( ! np->hsize )
+	    return -1;
+
+	h = hash_addr ( addr, np->hsize );
+	while ( (i = np->hash[h]) >= 0 ) {
+	    if ( np->list[i].addr == addr )
+		return i;
+	    h = (h + 1) & (np->hsize - 1);
+	}
+	return -1;
+}
+
+static void
+names_rehash ( struct names *np )
+{
+	unsigned int h;
+	int i;
+
+	np->hsize = np->hsize ? np->hsize * 2 : 1024;
+	np->hash = xrealloc ( np->hash, np->hsize * sizeof(int) );
+	for ( i=0; i<np->hsize; i++ )
+	    np->hash[i] = -1;
+
+	for ( i=0; i<np->count; i++ ) {
+	    h = hash_addr ( np->list[i].addr, np->hsize );
+	    while ( np->hash[h] >= 0 )
+		h = (h + 1) & (np->hsize - 1);
+	    np->hash[h] = i;
+	}
+}
+
+static void
+names_set ( struct names *np, unsigned int addr, char *name )
+{
+	unsigned int h;
+	int i;
+
+	i = names_find ( np, addr );
+	if ( i >= 0 ) {
+	    np->list[i].name = name;
+	    return;
+	}
+
+	if ( np->count >= np->max ) {
+	    np->max = np->max ? np->max * 2 : 512;
+	    np->list = xrealloc ( np->list, np->max * sizeof(struct name) );
+	}
+	if ( (np->count + 1) * 2 > np->hsize )
+	    names_rehash ( np );
+
+	i = np->count++;
+	np->list[i].addr = addr;
+	np->list[i].name = name;
+
+	h = hash_addr ( addr, np->hsize );
+	while ( np->hash[h] >= 0 )
+	    h = (h + 1) & (np->hsize - 1);
+	np->hash[h] = i;
+}
+
+static char *
+names_get ( struct names *np, unsigned int addr )
+{
+	int i;
+
+	i = names_find ( np, addr );
+	return i < 0 ? NULL : np->list[i].name;
+}
+
+/* First address with this name */
+static int
+names_key ( struct names *np, char *name, unsigned int *addr )
+{
+	int i;
+
+	for ( i=0; i<np->count; i++ )
+	    if ( strcmp ( np->list[i].name, name ) == 0 ) {
+		*addr = np->list[i].addr;
+		return 1;
+	    }
+	return 0;
+}
+
+static char *
+sub_name ( unsigned int addr )
+{
+	char buf[32];
+
+	sprintf ( buf, "sub_%x", addr - rom_base );
+	return strdup ( buf );
+}
+
+/* Either the PROVIDE lines from an SDK linker script:
+ *  PROVIDE ( Cache_Read_Disable = 0x400047f0 );
+ * or the "addr name" lines of our .sy files:
+ *  400000a4 _ResetHandler
+ */
+static void
+load_syms ( char *file, char *prefix, int must )
+{
+	FILE *fp;
+	char line[256];
+	char w[6][64];
+	char name[128];
+	int nw;
+
+	fp = fopen ( file, "r" );
+	if ( ! fp ) {
+	    if ( must ) {
+		printf ( "Cannot open %s\n", file );
+		exit ( 1 );
+	    }
+	    return;
+	}
+
+	while ( fgets ( line, sizeof(line), fp ) ) {
+	    if ( strncmp ( line, "PROVIDE", 7 ) == 0 ) {
+		nw = sscanf ( line, "%63s %63s %63s %63s %63s", w[0], w[1], w[2], w[3], w[4] );
+		if ( nw < 5 )
+		    continue;
+		sprintf ( name, "%s%s", prefix, w[2] );
+		names_set ( &syms, strtoul ( w[4], NULL, 16 ), strdup ( name ) );
+		continue;
+	    }
+	    if ( line[0] == '#' || line[0] == ';' )
+		continue;
+	    nw = sscanf ( line, "%63s %63s", w[0], w[1] );
+	    if ( nw < 2 || strspn ( w[0], "0123456789abcdefABCDEFx" ) != strlen ( w[0] ) )
+		continue;
+	    names_set ( &syms, strtoul ( w[0], NULL, 16 ), strdup ( w[1] ) );
+	}
+
+	fclose ( fp );
+}
+
+/* ------------------------------------------------------------ */
+/* The map, one character for every byte in the rom:
+ *  X - nothing known yet
+ *  I - instruction
+ *  L - literal for an l32r
+ *  E - "data" from the hints file
+ *  F - "ldata" from the hints file
+ *  4 - "data4" from the hints file
+ *  D - "data1" from the hints file
+ */
+
+char *map;
+
+/* espdis kept the map in a ruby array, and a negative index
+ * into a ruby array counts back from the end.  This happens
+ * when an l32r near the start of the rom refers to a literal
+ * below it (at 0x3fffdaac say), which lands the "L" up near
+ * the end of the map.  We do the same to get the same output.
+ */
+static int
+map_index ( int index )
+{
+	if ( index < 0 )
+	    index += rom_size;
+	if ( index < 0 || index >= rom_size )
+	    return -1;
+	return index;
+}
+
+static int
+map_get ( int index )
+{
+	index = map_index ( index );
+	return index < 0 ? 0 : map[index];
+}
+
+static void
+claim ( int index, int size, int type )
+{
+	int i;
+
+	while ( size-- ) {
+	    i = map_index ( index++ );
+	    if ( i >= 0 )
+		map[i] = type;
+	}
+}
+
+static int
+good_addr ( unsigned int addr )
+{
+	return addr >= rom_base && addr <= rom_limit;
+}
+
+static int
+is_avail ( unsigned int addr )
+{
+	return map_get ( addr - rom_base ) == 'X';
+}
+
+/* sort of hackish sloppy version of the above */
+static int
+is_ok ( unsigned int addr )
+{
+	int m = map_get ( addr - rom_base );
+
+	return m == 'X' || m == 'I';
+}
+
+static void
+hint_range ( char *arg, int type )
+{
+	unsigned int a1, a2;
+	char *p;
+
+	p = strchr ( arg, ':' );
+	if ( ! p )
+	    return;
+	a1 = strtoul ( arg, NULL, 16 );
+	a2 = strtoul ( p+1, NULL, 16 );
+	if ( a2 >= a1 && good_addr ( a1 ) && good_addr ( a2 ) )
+	    claim ( a1 - rom_base, a2 - a1 + 1, type );
+}
+
+static void
+one_hint ( char *line )
+{
+	char cmd[64];
+	char arg[64];
+	char name[128];
+	unsigned int addr;
+	int nw;
+	char *p;
+
+	nw = sscanf ( line, "%63s %63s %127s", cmd, arg, name );
+	if ( nw < 2 )
+	    return;
+	for ( p = cmd; *p; p++ )
+	    if ( *p >= 'A' && *p <= 'Z' )
+		*p += 'a' - 'A';
+
+	if ( strcmp ( cmd, "data" ) == 0 )
+	    hint_range ( arg, 'E' );
+
+	/* like "data" but will be dumped without monkeying
+	 * with start/stop values and 4 bytes per line.
+	 */
+	if ( strcmp ( cmd, "ldata" ) == 0 )
+	    hint_range ( arg, 'F' );
+
+	/* single data byte "poison" marker */
+	if ( strcmp ( cmd, "data1" ) == 0 ) {
+	    addr = strtoul ( arg, NULL, 16 );
+	    if ( good_addr ( addr ) )
+		map[addr - rom_base] = 'D';
+	}
+
+	if ( strcmp ( cmd, "data4" ) == 0 )
+	    hint_range ( arg, '4' );
+
+	if ( strcmp ( cmd, "sym" ) == 0 && nw > 2 )
+	    names_set ( &syms, strtoul ( arg, NULL, 16 ), strdup ( name ) );
+
+	if ( strcmp ( cmd, "addr" ) == 0 ) {
+	    addr = strtoul ( arg, NULL, 16 );
+	    names_set ( &syms, addr, sub_name ( addr ) );
+	}
+}
+
+static void
+load_hints ( void )
+{
+	FILE *fp;
+	char line[256];
+
+	fp = fopen ( hint_file, "r" );
+	if ( ! fp )
+	    return;
+
+	while ( fgets ( line, sizeof(line), fp ) ) {
+	    if ( line[0] == '#' || line[0] == '\n' )
+		continue;
+	    one_hint ( line );
+	}
+	fclose ( fp );
+}
+
+/* ------------------------------------------------------------ */
+/* The image */
+
+/* Returns 0 if there is nothing there */
+int
+decode_at ( unsigned int addr, struct lx_insn *ip )
+{
+	struct segment *sp;
+	unsigned int off;
+
+	sp = image_lookup ( addr );
+	if ( ! sp )
+	    return 0;
+	off = addr - sp->addr;
+	return lx_decode ( &sp->data[off], sp->size - off, addr, ip );
+}
+
+/* Use what the worker threads decoded (-j) if we can */
+static void
+one_inst ( unsigned int addr, struct lx_insn *ip )
+{
+	struct lx_insn *cp;
+
+	cp = cached_insn ( addr );
+	if ( cp ) {
+	    *ip = *cp;
+	    return;
+	}
+
+	if ( ! decode_at ( addr, ip ) ) {
+	    printf ( "Trouble at 0x%08x\n", addr );
+	    exit ( 1 );
+	}
+}
+
+/* the 8266 is little endian, just like the x86 */
+static int
+fetch_long ( unsigned int addr, unsigned int *val )
+{
+	if ( addr < rom_base || addr + 3 > rom_limit )
+	    return 0;
+	return image_word ( addr, val );
+}
+
+static int
+fetch_byte ( unsigned int addr )
+{
+	unsigned char *p;
+
+	p = image_ptr ( addr, 1 );
+	return p ? *p : 0;
+}
+
+/* ------------------------------------------------------------ */
+/* Pass 1 */
+
+struct addr_list {
+	unsigned int *list;
+	int count;
+	int max;
+	int next;
+};
+
+struct addr_list cur_addr;
+struct addr_list new_addr;
+
+/* marks for the old list (everything we ever chased)
+ * and the new list (stamped with the current scan)
+ */
+char *old_mark;
+int *new_mark;
+int scan_stamp;
+
+static void
+list_add ( struct addr_list *lp, unsigned int addr )
+{
+	if ( lp->count >= lp->max ) {
+	    lp->max = lp->max ? lp->max * 2 : 1024;
+	    lp->list = xrealloc ( lp->list, lp->max * sizeof(unsigned int) );
+	}
+	lp->list[lp->count++] = addr;
+}
+
+static void
+add_addr ( unsigned int addr )
+{
+	int index;
+
+	if ( addr < rom_base )
+	    return;
+	/* Can happen if we are disassembling data regions */
+	if ( addr > rom_limit ) {
+	    printf ( "*** Refusing to follow call or branch to: %08x\n", addr );
+	    return;
+	}
+
+	index = addr - rom_base;
+	if ( new_mark[index] == scan_stamp )
+	    return;
+	if ( old_mark[index] )
+	    return;
+	new_mark[index] = scan_stamp;
+	list_add ( &new_addr, addr );
+}
+
+/* avoid adding the same name twice
+ * also this gives priority to names from the
+ * symbol table that have been preloaded.
+ */
+static void
+add_call ( unsigned int addr )
+{
+	char *name;
+
+	if ( names_get ( &calls, addr ) )
+	    return;
+
+	name = names_get ( &syms, addr );
+	if ( ! name )
+	    name = sub_name ( addr );
+	names_set ( &calls, addr, name );
+}
+
+static void
+range1 ( unsigned int addr )
+{
+	struct lx_insn i;
+
+	for ( ;; ) {
+	    if ( ! is_avail ( addr ) )
+		break;
+
+	    one_inst ( addr, &i );
+
+	    if ( i.flags & (LX_CALL0 | LX_CALL8) )
+		add_call ( i.target );
+
+	    if ( i.flags & LX_L32R )
+		claim ( i.target - rom_base, 4, 'L' );
+
+	    if ( i.flags & LX_ILL ) {
+		printf ( "*** Illegal instruction, ending range at: %08x\n", addr );
+		break;
+	    }
+
+	    /* This indicates we have "slid" into a section we
+	     * already disassembled.
+	     */
+	    if ( map_get ( addr - rom_base ) == 'I' )
+		break;
+
+	    claim ( addr - rom_base, i.size, 'I' );
+
+	    if ( i.flags & (LX_JUMP | LX_BRANCH | LX_CALL) )
+		add_addr ( i.target );
+
+	    addr += i.size;
+	    if ( i.flags & LX_TERM )
+		break;
+	}
+}
+
+void
+pass1 ( unsigned int addr )
+{
+	int i;
+	unsigned int t;
+
+	cur_addr.count = cur_addr.next = 0;
+	list_add ( &cur_addr, addr );
+
+	for ( ;; ) {
+	    if ( cur_addr.next >= cur_addr.count )
+		break;
+
+	    new_addr.count = 0;
+	    scan_stamp++;
+
+	    while ( cur_addr.next < cur_addr.count ) {
+		t = cur_addr.list[cur_addr.next++];
+		if ( good_addr ( t ) )
+		    old_mark[t - rom_base] = 1;
+		if ( ! is_avail ( t ) )
+		    continue;
+		range1 ( t );
+	    }
+
+	    /* We drop things that we saved as potential targets,
+	     * but apparently continued on to disassemble
+	     */
+	    cur_addr.count = cur_addr.next = 0;
+	    for ( i=0; i<new_addr.count; i++ ) {
+		if ( ! is_avail ( new_addr.list[i] ) )
+		    continue;
+		list_add ( &cur_addr, new_addr.list[i] );
+	    }
+	}
+}
+
+/* ------------------------------------------------------------ */
+/* Pass 2 */
+
+/* Where pass 2 prints, lxcache.c points this elsewhere at times */
+FILE *out;
+
+/* How far pass 2 looked for the region it is on */
+unsigned int reach;
+
+/* Names pass 2 looks up, the cache needs to know */
+static char *
+pass2_name ( struct names *np, unsigned int addr )
+{
+	char *name;
+
+	name = names_get ( np, addr );
+	if ( cache_file )
+	    cache_dep ( np == &calls ? DEP_CALLS : DEP_SYMS, addr, name );
+	return name;
+}
+
+/* For lxcache.c to check names it saw before */
+char *
+dep_name ( int table, unsigned int addr )
+{
+	return names_get ( table == DEP_CALLS ? &calls : &syms, addr );
+}
+
+/* With -a, list what refers to a label or a literal */
+#define MAX_SHOW	8
+
+static void
+show_refs ( unsigned int addr, char *lead )
+{
+	int first;
+	int n;
+	int i;
+
+	n = xref_to ( addr, &first );
+	if ( ! n )
+	    return;
+
+	fprintf ( out, "%s", lead );
+	for ( i=0; i<n && i<MAX_SHOW; i++ )
+	    fprintf ( out, " %08x", xrefs.list[first+i].from );
+	if ( n > MAX_SHOW )
+	    fprintf ( out, " (%d more)", n - MAX_SHOW );
+	fprintf ( out, "\n" );
+}
+
+/* print label if this address has a name */
+static void
+mark_addr ( unsigned int addr )
+{
+	char *name;
+
+	name = pass2_name ( &calls, addr );
+	if ( ! name )
+	    name = pass2_name ( &syms, addr );
+	if ( name ) {
+	    fprintf ( out, "\n  %s:\n", name );
+	    if ( annotate )
+		show_refs ( addr, "  ; from" );
+	}
+}
+
+/* To make the l32r disassembly more "readable" I decided to use
+ * this square bracket notation -- and put the more or less
+ * irrelevant address of the l32r value in the comment field
+ */
+static void
+print_l32r ( struct lx_insn *ip, char *line )
+{
+	char *b;
+	char *sym;
+	unsigned int val;
+
+	b = strstr ( line, ", " );
+	*b = '\0';
+	b += 2;
+
+	if ( ! fetch_long ( ip->target, &val ) ) {
+	    fprintf ( out, "%s, [----]\t; [----] %s\n", line, b );
+	    return;
+	}
+
+	sym = pass2_name ( &syms, val );
+	if ( sym )
+	    fprintf ( out, "%s, [%s]\t; [0x%08x] %s\n", line, sym, val, b );
+	else
+	    fprintf ( out, "%s, [0x%08x]\t; %s\n", line, val, b );
+}
+
+/* Rather than put name in comment, modify the instruction */
+static void
+print_call ( struct lx_insn *ip, char *line )
+{
+	char *name;
+	char bytes[8];
+	int i;
+
+	name = pass2_name ( &calls, ip->target );
+	if ( ! name ) {
+	    /* should never happen */
+	    fprintf ( out, "%s\t; ????\n", line );
+	    return;
+	}
+
+	for ( i=0; i<ip->size; i++ )
+	    sprintf ( &bytes[i*2], "%02x", (ip->word >> (i*8)) & 0xff );
+	fprintf ( out, "%08x:\t%s\t\t%s\t%s\t\t; %s\n", ip->addr, bytes, ip->name, name, ip->ops );
+}
+
+static void
+print_instr ( struct lx_insn *ip )
+{
+	char line[128];
+
+	/* print a nice label before known subroutines */
+	mark_addr ( ip->addr );
+
+	lx_line ( ip, line );
+
+	if ( ip->flags & (LX_CALL0 | LX_CALL8) ) {
+	    print_call ( ip, line );
+	    return;
+	}
+
+	if ( ip->flags & LX_L32R ) {
+	    print_l32r ( ip, line );
+	    return;
+	}
+
+	fprintf ( out, "%s\n", line );
+}
+
+/* Just display, following a linear thread of execution
+ * until it terminates.
+ */
+static unsigned int
+range2 ( unsigned int addr )
+{
+	struct lx_insn i;
+
+	for ( ;; ) {
+	    /* This test avoids runon disassembly that
+	     * goes outside of regions already delimited
+	     * in pass 1.
+	     */
+	    if ( addr + 1 > reach )
+		reach = addr + 1;
+	    if ( ! is_ok ( addr ) )
+		break;
+	    one_inst ( addr, &i );
+	    if ( addr + i.size > reach )
+		reach = addr + i.size;
+	    print_instr ( &i );
+	    if ( i.flags & LX_TERM )
+		fprintf ( out, "\n" );
+
+	    addr += i.size;
+	    if ( i.flags & LX_TERM )
+		break;
+	}
+	return addr;
+}
+
+static void
+dump_bytes ( unsigned int addr, int len )
+{
+	fprintf ( out, "%08x:\t", addr );
+	while ( len-- )
+	    fprintf ( out, "%02x", fetch_byte ( addr++ ) );
+	fprintf ( out, "\n" );
+}
+
+/* "ldata" in hints file */
+static void
+dump_ldata ( unsigned int addr, unsigned int xaddr )
+{
+	int len;
+	int misc_len;
+
+	if ( addr >= xaddr )
+	    return;
+	len = xaddr - addr;
+
+	misc_len = 4 - ( addr & 0x3 );
+	if ( misc_len > len )
+	    misc_len = len;
+	if ( misc_len < 4 ) {
+	    dump_bytes ( addr, misc_len );
+	    addr += misc_len;
+	}
+	if ( addr >= xaddr )
+	    return;
+
+	/* longs dumped this way are byte swapped */
+	while ( addr + 4 <= xaddr ) {
+	    dump_bytes ( addr, 4 );
+	    addr += 4;
+	}
+	if ( addr >= xaddr )
+	    return;
+
+	dump_bytes ( addr, xaddr - addr );
+}
+
+static void
+print_long ( unsigned int addr, char *tail )
+{
+	unsigned int val;
+
+	if ( fetch_long ( addr, &val ) )
+	    fprintf ( out, "%08x:\t%08x%s\n", addr, val, tail );
+	else
+	    fprintf ( out, "%08x:\t--------%s\n", addr, tail );
+}
+
+/* "data" in hints file */
+static void
+dump_data ( unsigned int addr, unsigned int xaddr )
+{
+	int len;
+	int misc_len;
+
+	if ( addr >= xaddr )
+	    return;
+	len = xaddr - addr;
+
+	misc_len = 4 - ( addr & 0x3 );
+	if ( misc_len > len )
+	    misc_len = len;
+	if ( misc_len < 4 ) {
+	    dump_bytes ( addr, misc_len );
+	    addr += misc_len;
+	}
+	if ( addr >= xaddr )
+	    return;
+
+	while ( addr + 4 <= xaddr ) {
+	    print_long ( addr, "" );
+	    addr += 4;
+	}
+	if ( addr >= xaddr )
+	    return;
+
+	dump_bytes ( addr, xaddr - addr );
+}
+
+/* This is the heart of Pass 2
+ * Use the map to delimit sections to
+ * disassemble in different ways.
+ */
+static int
+get_range ( unsigned int addr, unsigned int *xaddr )
+{
+	int index;
+	int t;
+
+	index = addr - rom_base;
+	if ( index >= rom_size )
+	    return 'Q';
+	if ( map[index] == 'L' ) {
+	    *xaddr = addr + 4;
+	    return 'L';
+	}
+
+	t = map[index];
+	for ( ;; ) {
+	    index++;
+	    if ( index >= rom_size )
+		break;
+	    if ( map[index] != t )
+		break;
+	}
+	*xaddr = rom_base + index;
+	return t;
+}
+
+/* Print one region of the map */
+static void
+region ( unsigned int addr, unsigned int xaddr, int type )
+{
+	unsigned int naddr;
+	int len;
+
+	if ( type == 'L' ) {
+	    print_long ( addr, "\t; l32r" );
+	    if ( annotate )
+		show_refs ( addr, "\t\t; from" );
+	} else if ( type == '4' ) {
+	    do {
+		print_long ( addr, "" );
+		addr += 4;
+	    } while ( addr < xaddr );
+	} else if ( type == 'I' ) {
+	    for ( ;; ) {
+		naddr = range2 ( addr );
+		if ( naddr >= xaddr )
+		    break;
+		addr = naddr;
+	    }
+	} else if ( type == 'E' ) {
+	    /* explicitly marked block of data ("data") */
+	    mark_addr ( addr );
+	    dump_data ( addr, xaddr );
+	} else if ( type == 'F' ) {
+	    /* explicitly marked block of data ("ldata") */
+	    mark_addr ( addr );
+	    dump_ldata ( addr, xaddr );
+	} else {
+	    /* an unknown block (X or D) */
+	    len = xaddr - addr;
+	    mark_addr ( addr );
+	    if ( len > 16 ) {
+		fprintf ( out, "%08x:%x\t\t\tunknown\t; (not disassembled)\n",
+		    addr, xaddr - 1 - rom_base );
+	    } else {
+		dump_bytes ( addr, len );
+	    }
+	}
+}
+
+/* With a cache (-C) we only print the regions that changed,
+ * the rest come out of the cache (see lxcache.c)
+ */
+void
+pass2 ( void )
+{
+	unsigned int addr;
+	unsigned int xaddr;
+	int type;
+
+	addr = rom_base;
+	for ( ;; ) {
+	    type = get_range ( addr, &xaddr );
+	    if ( type == 'Q' )
+		break;
+
+	    if ( ! cache_file ) {
+		region ( addr, xaddr, type );
+	    } else if ( ! cache_lookup ( addr, xaddr, type ) ) {
+		/* range2 can look past the end */
+		reach = xaddr;
+		cache_begin ();
+		region ( addr, xaddr, type );
+		cache_end ( addr, xaddr, type, reach );
+	    }
+	    addr = xaddr;
+	}
+}
+
+/* Cross references (-x and -a)
+ * We walk the code the same way pass 2 does, but rather than
+ * print each instruction, we note what it refers to.
+ */
+
+/* what the last l32r into each register loaded */
+static unsigned int reg_val[16];
+static unsigned int reg_ok;
+
+static char *
+ref_name ( unsigned int addr )
+{
+	char *name;
+
+	name = names_get ( &calls, addr );
+	if ( ! name )
+	    name = names_get ( &syms, addr );
+	return name;
+}
+
+/* Does this value look like an address? (rather than a constant)
+ *  3ff00000 - 3fffffff  dport, ram
+ *  40000000 - 4fffffff  rom, iram, flash
+ *  60000000 - 60001fff  io registers
+ */
+static int
+is_pointer ( unsigned int val )
+{
+	if ( val >= 0x3ff00000 && val < 0x50000000 )
+	    return 1;
+	if ( val >= 0x60000000 && val < 0x60002000 )
+	    return 1;
+	return 0;
+}
+
+/* Stores (and branches) name a register they only read */
+static int
+writes_reg ( struct lx_insn *ip )
+{
+	if ( ip->name[0] == 's' && ip->name[1] >= '0' && ip->name[1] <= '9' )
+	    return 0;
+	if ( ip->flags & LX_BRANCH )
+	    return 0;
+	return ip->ops[0] == 'a';
+}
+
+static void
+xref_insn ( struct lx_insn *ip )
+{
+	unsigned int val;
+	int reg;
+
+	if ( ip->flags & (LX_CALL0 | LX_CALL8) ) {
+	    xref_add ( XR_CALL, ip->addr, ip->target, 0, ref_name ( ip->target ) );
+	    reg_ok = 0;
+	    return;
+	}
+
+	/* The usual "l32r a0, [func]" then "callx0 a0" */
+	if ( ip->flags & LX_CALLX ) {
+	    reg = ip->s;
+	    if ( reg_ok & (1 << reg) )
+		xref_add ( XR_CALLX, ip->addr, reg_val[reg], 0, ref_name ( reg_val[reg] ) );
+	    reg_ok = 0;
+	    return;
+	}
+
+	if ( ip->flags & LX_L32R ) {
+	    reg = ip->t;
+	    if ( ! fetch_long ( ip->target, &val ) ) {
+		xref_add ( XR_L32R, ip->addr, ip->target, 0, NULL );
+		reg_ok &= ~(1 << reg);
+		return;
+	    }
+	    xref_add ( XR_L32R, ip->addr, ip->target, val, names_get ( &syms, val ) );
+	    if ( good_addr ( val ) && map[val - rom_base] == 'I' )
+		xref_add ( XR_CODE, ip->addr, val, 0, ref_name ( val ) );
+	    else if ( is_pointer ( val ) )
+		xref_add ( XR_DATA, ip->addr, val, 0, names_get ( &syms, val ) );
+	    reg_val[reg] = val;
+	    reg_ok |= 1 << reg;
+	    return;
+	}
+
+	if ( writes_reg ( ip ) ) {
+	    reg = atoi ( &ip->ops[1] );
+	    if ( reg >= 0 && reg < 16 )
+		reg_ok &= ~(1 << reg);
+	}
+}
+
+/* Just like range2 */
+static unsigned int
+xref_range ( unsigned int addr )
+{
+	struct lx_insn i;
+
+	reg_ok = 0;
+	for ( ;; ) {
+	    if ( ! is_ok ( addr ) )
+		break;
+	    one_inst ( addr, &i );
+	    xref_insn ( &i );
+
+	    addr += i.size;
+	    if ( i.flags & LX_TERM )
+		break;
+	}
+	return addr;
+}
+
+void
+xref_build ( void )
+{
+	unsigned int addr;
+	unsigned int xaddr;
+	unsigned int naddr;
+	int type;
+
+	addr = rom_base;
+	for ( ;; ) {
+	    type = get_range ( addr, &xaddr );
+	    if ( type == 'Q' )
+		break;
+	    if ( type == 'I' ) {
+		for ( ;; ) {
+		    naddr = xref_range ( addr );
+		    if ( naddr >= xaddr )
+			break;
+		    addr = naddr;
+		}
+	    }
+	    addr = xaddr;
+	}
+
+	xref_sort ();
+}
+
+static void
+xref_save ( char *file )
+{
+	FILE *fp;
+
+	fp = fopen ( file, "w" );
+	if ( ! fp ) {
+	    printf ( "Cannot create %s\n", file );
+	    exit ( 1 );
+	}
+	xref_write ( fp );
+	fclose ( fp );
+}
+
+/* ------------------------------------------------------------ */
+
+void
+summary ( void )
+{
+	int count = 0;
+	int i;
+
+	for ( i=0; i<rom_size; i++ )
+	    if ( map[i] != 'X' )
+		count++;
+
+	printf ( "\n; disassembled %d bytes of %d\n", count, rom_size );
+}
+
+/* ------------------------------------------------------------ */
+
+/* Every symbol in the rom is an entry point */
+int
+entry_points ( unsigned int *list )
+{
+	int n = 0;
+	int i;
+
+	for ( i=0; i<syms.count; i++ )
+	    if ( good_addr ( syms.list[i].addr ) )
+		list[n++] = syms.list[i].addr;
+	return n;
+}
+
+void
+everything ( void )
+{
+	unsigned int addr;
+	int i;
+
+	for ( i=0; i<syms.count; i++ ) {
+	    addr = syms.list[i].addr;
+	    if ( ! good_addr ( addr ) )
+		continue;
+	    if ( ! is_avail ( addr ) )
+		continue;
+	    pass1 ( addr );
+	}
+}
+
+static void
+init ( void )
+{
+	int size;
+
+	rom_limit = rom_base + rom_size - 1;
+
+	size = image_raw ( bin_file, rom_base );
+	image_finish ();
+	if ( size != rom_size ) {
+	    printf ( "Something is wrong with binary file\n" );
+	    exit ( 1 );
+	}
+
+	map = xrealloc ( NULL, rom_size );
+	memset ( map, 'X', rom_size );
+	old_mark = xrealloc ( NULL, rom_size );
+	memset ( old_mark, 0, rom_size );
+	new_mark = xrealloc ( NULL, rom_size * sizeof(int) );
+	memset ( new_mark, 0, rom_size * sizeof(int) );
+	scan_stamp = 0;
+
+	syms.count = calls.count = 0;
+	cur_addr.count = new_addr.count = 0;
+}
+
+/* pass 2, and the cross references if they were asked for */
+static void
+listing ( void )
+{
+	if ( annotate || xref_file )
+	    xref_build ();
+	pass2 ();
+	if ( xref_file )
+	    xref_save ( xref_file );
+	if ( cache_file )
+	    cache_save ();
+}
+
+static void
+usage ( void )
+{
+	printf ( "Usage: lxdis [-i image] [-s symfile] [-j threads] [-x xref] [-a] [-C cache [-u changes]] [all|addr|name]\n" );
+	exit ( 1 );
+}
+
+#define MAX_SYMFILES	8
+
+int
+main ( int argc, char **argv )
+{
+	char *name = NULL;
+	char *extra[MAX_SYMFILES];
+	int nextra = 0;
+	unsigned int addr;
+	unsigned int *entries;
+	int nentries;
+	int nthreads = 0;
+	int i;
+
+	argc--;
+	++argv;
+	while ( argc > 0 && argv[0][0] == '-' ) {
+	    if ( argv[0][1] == 'a' ) {
+		annotate = 1;
+		argc--;
+		++argv;
+		continue;
+	    }
+	    if ( argc < 2 )
+		usage ();
+	    if ( argv[0][1] == 'i' )
+		bin_file = argv[1];
+	    else if ( argv[0][1] == 's' && nextra < MAX_SYMFILES )
+		extra[nextra++] = argv[1];
+	    else if ( argv[0][1] == 'j' )
+		nthreads = atoi ( argv[1] );
+	    else if ( argv[0][1] == 'x' )
+		xref_file = argv[1];
+	    else if ( argv[0][1] == 'C' )
+		cache_file = argv[1];
+	    else if ( argv[0][1] == 'u' )
+		change_file = argv[1];
+	    else
+		usage ();
+	    argc -= 2;
+	    argv += 2;
+	}
+	if ( argc > 0 )
+	    name = argv[0];
+
+	init ();
+
+	load_syms ( sym_file, "", 0 );
+	load_syms ( iosym_file, "IO:", 0 );
+	for ( i=0; i<nextra; i++ )
+	    load_syms ( extra[i], "", 1 );
+	load_hints ();
+
+	/* the -a references are not something the cache knows about */
+	out = stdout;
+	if ( annotate )
+	    cache_file = NULL;
+	if ( cache_file )
+	    cache_load ( cache_file, change_file );
+
+	/* This is the usual thing */
+	if ( name && strcmp ( name, "all" ) == 0 ) {
+	    if ( nthreads > 0 ) {
+		entries = xrealloc ( NULL, (syms.count + 1) * sizeof(unsigned int) );
+		nentries = entry_points ( entries );
+		predecode ( entries, nentries, nthreads );
+	    }
+	    everything ();
+	    listing ();
+	    summary ();
+	    return 0;
+	}
+
+	/* Start at hex address (no leading 0x) */
+	if ( name && strncmp ( name, "40", 2 ) == 0 ) {
+	    addr = strtoul ( name, NULL, 16 );
+	    printf ( "  sub_%x:\n", addr - rom_base );
+	    if ( nthreads > 0 )
+		predecode ( &addr, 1, nthreads );
+	    pass1 ( addr );
+	    listing ();
+	    return 0;
+	}
+
+	/* Start at given symbol */
+	if ( name ) {
+	    if ( strncmp ( name, "0x", 2 ) == 0 )
+		addr = strtoul ( name, NULL, 16 );
+	    else if ( ! names_key ( &syms, name, &addr ) ) {
+		printf ( "Sorry, no such symbol\n" );
+		exit ( 1 );
+	    }
+	    if ( nthreads > 0 )
+		predecode ( &addr, 1, nthreads );
+	    pass1 ( addr );
+	    listing ();
+	    return 0;
+	}
+
+	/* default - start at chip reset */
+	addr = 0x400000a4;
+	if ( nthreads > 0 )
+	    predecode ( &addr, 1, nthreads );
+	pass1 ( addr );
+	listing ();
+	summary ();
+
+	return 0;
+}
+
+/* THE END */
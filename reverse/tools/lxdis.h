@@ -0,0 +1,36 @@
+/* lxdis.h
+ * Things shared by the pieces of lxdis
+ */
+
+extern unsigned int rom_base;
+extern unsigned int rom_size;
+extern unsigned int rom_limit;
+
+extern char *map;
+
+void *xrealloc ( void *, int );
+int decode_at ( unsigned int, struct lx_insn * );
+
+extern FILE *out;
+extern unsigned int reach;
+extern char *cache_file;
+
+/* which names a region looked up */
+#define DEP_CALLS	1
+#define DEP_SYMS	2
+
+char *dep_name ( int, unsigned int );
+
+/* lxwork.c */
+void predecode ( unsigned int *, int, int );
+struct lx_insn *cached_insn ( unsigned int );
+
+/* lxcache.c */
+void cache_load ( char *, char * );
+void cache_save ( void );
+int cache_lookup ( unsigned int, unsigned int, int );
+void cache_begin ( void );
+void cache_end ( unsigned int, unsigned int, int, unsigned int );
+void cache_dep ( int, unsigned int, char * );
+
+/* THE END */
@@ -0,0 +1,943 @@
+/* lxgraph.c
+ * One of my ESP8266 reverse engineering tools
+ *
+ * Basic blocks and a call graph for the bootrom or an application image.
+ *
+ * We start at the symbols we know about (and the reset vector
+ * or the image entry point) and follow the code just like lxdis
+ * does pass 1, using the lx106 decoder.  Every call target
+ * becomes a function, every branch target starts a basic block.
+ * A jump to the start of another function is taken as a tail call.
+ * So is a callx0 through a register that an l32r just loaded.
+ *
+ * For each function we then find its blocks (following branches
+ * and jumps, but not calls), what it calls, how many bytes of
+ * code it has, whether it is a leaf, and how big a stack frame
+ * it makes.  The frame is the "addi a1, a1, -N", plus an addmi
+ * right before or after it for frames over 128 bytes, or a
+ * "movi aN, N" and "sub a1, a1, aN" (what the bootrom uses).
+ * A tail call counts as a call, so a function that makes
+ * one is not a leaf and has it in its calls column.
+ *
+ * Calls out of an application image into the rom show up as
+ * "external" functions (no size).
+ *
+ *  lxgraph			- function table for bootrom.bin
+ *  lxgraph -aprod		- prod-0x00000.bin and prod-0x40000.bin
+ *  lxgraph -s calls.sy		- more symbols (.sy or PROVIDE lines)
+ *  lxgraph -g			- call graph in DOT form
+ *  lxgraph -c name		- basic blocks of one function in DOT form
+ *  lxgraph -r name		- everything name calls, all the way down
+ *  lxgraph -b file		- write the call graph in binary form (below)
+ *
+ * The binary form is little endian 32 bit words:
+ *   "LXCG" 1 nfunc nedge
+ *   nfunc times:  addr size frame flags first count
+ *   nedge times:  index of the function called
+ * The calls made by function i are edges first .. first+count-1.
+ * Flags are 1 for a leaf, 2 for external.
+ * The functions are in address order.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image.h"
+#include "lx106.h"
+
+#define ROM_BINFILE	"bootrom.bin"
+#define SYM_FILE	"syms"
+
+#define RESET_VECTOR	0x400000a4
+
+static void *
+xrealloc ( void *p, int size )
+{
+	p = realloc ( p, size );
+	if ( ! p ) {
+	    printf ( "Out of memory\n" );
+	    exit ( 1 );
+	}
+	return p;
+}
+
+/* ------------------------------------------------------------ */
+/* Address to index hash, used for instructions, blocks and functions */
+
+struct amap {
+	unsigned int *key;
+	int *val;
+	int count;
+	int size;
+};
+
+static unsigned int
+hash_addr ( unsigned int addr, int size )
+{
+	return ((addr >> 1) * 2654435761u) & (size - 1);
+}
+
+static int
+amap_get ( struct amap *mp, unsigned int addr )
+{
+	unsigned int h;
+
+	if ( ! mp->size )
+	    return -1;
+
+	h = hash_addr ( addr, mp->size );
+	while ( mp->val[h] >= 0 ) {
+	    if ( mp->key[h] == addr )
+		return mp->val[h];
+	    h = (h + 1) & (mp->size - 1);
+	}
+	return -1;
+}
+
+static void amap_put ( struct amap *, unsigned int, int );
+
+static void
+amap_grow ( struct amap *mp )
+{
+	struct amap old = *mp;
+	int i;
+
+	mp->size = mp->size ? mp->size * 2 : 4096;
+	mp->key = xrealloc ( NULL, mp->size * sizeof(unsigned int) );
+	mp->val = xrealloc ( NULL, mp->size * sizeof(int) );
+	mp->count = 0;
+	for ( i=0; i<mp->size; i++ )
+	    mp->val[i] = -1;
+
+	for ( i=0; i<old.size; i++ )
+	    if ( old.val[i] >= 0 )
+		amap_put ( mp, old.key[i], old.val[i] );
+	free ( old.key );
+	free ( old.val );
+}
+
+static void
+amap_put ( struct amap *mp, unsigned int addr, int val )
+{
+	unsigned int h;
+
+	if ( (mp->count + 1) * 2 > mp->size )
+	    amap_grow ( mp );
+
+	h = hash_addr ( addr, mp->size );
+	while ( mp->val[h] >= 0 ) {
+	    if ( mp->key[h] == addr ) {
+		mp->val[h] = val;
+		return;
+	    }
+	    h = (h + 1) & (mp->size - 1);
+	}
+	mp->key[h] = addr;
+	mp->val[h] = val;
+	mp->count++;
+}
+
+/* ------------------------------------------------------------ */
+/* Symbols */
+
+struct sym {
+	unsigned int addr;
+	char *name;
+};
+
+struct sym *syms;
+int nsyms;
+int max_syms;
+
+static void
+add_sym ( unsigned int addr, char *name )
+{
+	if ( nsyms >= max_syms ) {
+	    max_syms = max_syms ? max_syms * 2 : 1024;
+	    syms = xrealloc ( syms, max_syms * sizeof(struct sym) );
+	}
+	syms[nsyms].addr = addr;
+	syms[nsyms].name = strdup ( name );
+	nsyms++;
+}
+
+/* The same two formats lxdis takes */
+static void
+load_syms ( char *file, int must )
+{
+	FILE *fp;
+	char line[256];
+	char w[5][64];
+	int nw;
+
+	fp = fopen ( file, "r" );
+	if ( ! fp ) {
+	    if ( must ) {
+		printf ( "Cannot open %s\n", file );
+		exit ( 1 );
+	    }
+	    return;
+	}
+
+	while ( fgets ( line, sizeof(line), fp ) ) {
+	    if ( strncmp ( line, "PROVIDE", 7 ) == 0 ) {
+		nw = sscanf ( line, "%63s %63s %63s %63s %63s", w[0], w[1], w[2], w[3], w[4] );
+		if ( nw == 5 )
+		    add_sym ( strtoul ( w[4], NULL, 16 ), w[2] );
+		continue;
+	    }
+	    if ( line[0] == '#' || line[0] == ';' )
+		continue;
+	    nw = sscanf ( line, "%63s %63s", w[0], w[1] );
+	    if ( nw < 2 || strspn ( w[0], "0123456789abcdefABCDEFx" ) != strlen ( w[0] ) )
+		continue;
+	    add_sym ( strtoul ( w[0], NULL, 16 ), w[1] );
+	}
+
+	fclose ( fp );
+}
+
+static char *
+sym_name ( unsigned int addr )
+{
+	int i;
+
+	/* the last one loaded wins */
+	for ( i=nsyms-1; i>=0; i-- )
+	    if ( syms[i].addr == addr )
+		return syms[i].name;
+	return NULL;
+}
+
+static int
+sym_addr ( char *name, unsigned int *addr )
+{
+	int i;
+
+	for ( i=0; i<nsyms; i++ ) {
+	    if ( strcmp ( syms[i].name, name ) == 0 ) {
+		*addr = syms[i].addr;
+		return 1;
+	    }
+	}
+	return 0;
+}
+
+/* ------------------------------------------------------------ */
+/* Pass 1 - find all the code */
+
+/* What we keep for each instruction */
+struct insn {
+	unsigned int addr;
+	unsigned int target;
+	int flags;
+	short size;
+	short frame;		/* stack drop, this and the one before */
+	char leader;		/* starts a basic block */
+};
+
+struct insn *insns;
+int ninsns;
+int max_insns;
+struct amap insn_map;
+
+/* function entry points, in the order found */
+unsigned int *entries;
+int nentries;
+int max_entries;
+struct amap entry_map;
+
+/* addresses still to trace */
+unsigned int *work;
+int nwork;
+int max_work;
+
+/* Code is up at 0x40000000 and above, an application
+ * image has data segments down around 0x3ffe8000
+ */
+static int
+is_code ( unsigned int addr )
+{
+	return addr >= ROM_BASE && image_lookup ( addr ) != NULL;
+}
+
+static void
+add_work ( unsigned int addr )
+{
+	if ( nwork >= max_work ) {
+	    max_work = max_work ? max_work * 2 : 1024;
+	    work = xrealloc ( work, max_work * sizeof(unsigned int) );
+	}
+	work[nwork++] = addr;
+}
+
+static void
+add_entry ( unsigned int addr )
+{
+	if ( amap_get ( &entry_map, addr ) >= 0 )
+	    return;
+	if ( nentries >= max_entries ) {
+	    max_entries = max_entries ? max_entries * 2 : 1024;
+	    entries = xrealloc ( entries, max_entries * sizeof(unsigned int) );
+	}
+	amap_put ( &entry_map, addr, nentries );
+	entries[nentries++] = addr;
+
+	if ( is_code ( addr ) )
+	    add_work ( addr );
+}
+
+static void
+set_leader ( unsigned int addr )
+{
+	int i;
+
+	i = amap_get ( &insn_map, addr );
+	if ( i >= 0 )
+	    insns[i].leader = 1;
+}
+
+static int
+decode ( unsigned int addr, struct lx_insn *ip )
+{
+	struct segment *sp;
+	unsigned int off;
+
+	sp = image_lookup ( addr );
+	if ( ! sp )
+	    return 0;
+	off = addr - sp->addr;
+	return lx_decode ( &sp->data[off], sp->size - off, addr, ip );
+}
+
+/* Stores (and branches) name a register they only read */
+static int
+writes_reg ( struct lx_insn *ip )
+{
+	if ( ip->name[0] == 's' && ip->name[1] >= '0' && ip->name[1] <= '9' )
+	    return 0;
+	if ( ip->flags & LX_BRANCH )
+	    return 0;
+	return ip->ops[0] == 'a';
+}
+
+/* Follow one thread of execution */
+static void
+trace ( unsigned int addr )
+{
+	struct lx_insn i;
+	struct insn *np;
+	unsigned int reg_val[16];
+	unsigned int reg_ok = 0;
+	unsigned int movi_val[16];
+	unsigned int movi_ok = 0;
+	unsigned int val;
+	int last_frame = 0;
+	int reg;
+
+	for ( ;; ) {
+	    if ( amap_get ( &insn_map, addr ) >= 0 )
+		break;
+	    if ( ! decode ( addr, &i ) )
+		break;
+	    if ( i.flags & LX_ILL )
+		break;
+
+	    if ( ninsns >= max_insns ) {
+		max_insns = max_insns ? max_insns * 2 : 16384;
+		insns = xrealloc ( insns, max_insns * sizeof(struct insn) );
+	    }
+	    np = &insns[ninsns];
+	    amap_put ( &insn_map, addr, ninsns++ );
+
+	    np->addr = addr;
+	    np->size = i.size;
+	    np->flags = i.flags;
+	    np->target = i.target;
+	    np->leader = 0;
+	    np->frame = 0;
+
+	    /* addmi and addi together make one frame */
+	    if ( (strcmp ( i.name, "addi" ) == 0 || strcmp ( i.name, "addmi" ) == 0) &&
+		    i.t == 1 && i.s == 1 && i.imm < 0 )
+		np->frame = last_frame - i.imm;
+	    else if ( strcmp ( i.name, "sub" ) == 0 && i.r == 1 && i.s == 1 &&
+		    (movi_ok & (1 << i.t)) && (int) movi_val[i.t] > 0 )
+		np->frame = last_frame + movi_val[i.t];
+	    last_frame = np->frame;
+
+	    if ( i.flags & (LX_CALL0 | LX_CALL8) )
+		add_entry ( i.target );
+
+	    /* l32r a0, [func] then callx0 a0 */
+	    if ( i.flags & LX_L32R ) {
+		reg = i.t;
+		if ( image_word ( i.target, &val ) ) {
+		    reg_val[reg] = val;
+		    reg_ok |= 1 << reg;
+		} else
+		    reg_ok &= ~(1 << reg);
+	    } else if ( i.flags & LX_CALLX ) {
+		if ( reg_ok & (1 << i.s) ) {
+		    np->target = reg_val[i.s];
+		    np->flags |= LX_TARGET;
+		    add_entry ( np->target );
+		} else
+		    np->flags &= ~LX_TARGET;
+		reg_ok = 0;
+	    } else if ( i.flags & LX_CALL ) {
+		reg_ok = 0;
+	    } else if ( writes_reg ( &i ) ) {
+		reg = atoi ( &i.ops[1] );
+		if ( reg >= 0 && reg < 16 )
+		    reg_ok &= ~(1 << reg);
+	    }
+
+	    /* movi aN, N for a "sub a1, a1, aN" */
+	    if ( strcmp ( i.name, "movi" ) == 0 ) {
+		movi_val[i.t] = i.imm;
+		movi_ok |= 1 << i.t;
+	    } else if ( i.flags & (LX_CALL | LX_CALLX) ) {
+		movi_ok = 0;
+	    } else if ( writes_reg ( &i ) ) {
+		reg = atoi ( &i.ops[1] );
+		if ( reg >= 0 && reg < 16 )
+		    movi_ok &= ~(1 << reg);
+	    }
+
+	    if ( i.flags & (LX_JUMP | LX_BRANCH) )
+		add_work ( i.target );
+
+	    addr += i.size;
+	    if ( i.flags & LX_TERM )
+		break;
+	}
+}
+
+static void
+pass1 ( void )
+{
+	unsigned int addr;
+
+	while ( nwork > 0 ) {
+	    addr = work[--nwork];
+	    trace ( addr );
+	}
+}
+
+/* ------------------------------------------------------------ */
+/* Basic blocks */
+
+struct block {
+	unsigned int addr;
+	unsigned int end;	/* just past the last instruction */
+	int last;		/* index of the last instruction */
+	unsigned int succ[2];
+	int nsucc;
+};
+
+struct block *blocks;
+int nblocks;
+struct amap block_map;
+
+static int
+insn_compare ( const void *a, const void *b )
+{
+	const struct insn *ia = a;
+	const struct insn *ib = b;
+
+	return ia->addr < ib->addr ? -1 : ia->addr > ib->addr;
+}
+
+static int
+is_entry ( unsigned int addr )
+{
+	return amap_get ( &entry_map, addr ) >= 0;
+}
+
+/* A block ends at a branch, jump, return and so on, or
+ * when the next instruction starts a block, or isn't there.
+ */
+static void
+find_blocks ( void )
+{
+	struct insn *np;
+	struct block *bp;
+	int i;
+
+	for ( i=0; i<ninsns; i++ ) {
+	    np = &insns[i];
+	    if ( np->flags & (LX_JUMP | LX_BRANCH) )
+		set_leader ( np->target );
+	    if ( np->flags & (LX_BRANCH | LX_CALL | LX_CALLX) )
+		set_leader ( np->addr + np->size );
+	}
+	for ( i=0; i<nentries; i++ )
+	    set_leader ( entries[i] );
+
+	/* sort, and rebuild the hash to match */
+	qsort ( insns, ninsns, sizeof(struct insn), insn_compare );
+	insn_map.count = 0;
+	for ( i=0; i<insn_map.size; i++ )
+	    insn_map.val[i] = -1;
+	for ( i=0; i<ninsns; i++ )
+	    amap_put ( &insn_map, insns[i].addr, i );
+
+	blocks = xrealloc ( NULL, (ninsns + 1) * sizeof(struct block) );
+	nblocks = 0;
+	bp = NULL;
+
+	for ( i=0; i<ninsns; i++ ) {
+	    np = &insns[i];
+	    if ( ! bp || np->leader || np->addr != bp->end ) {
+		bp = &blocks[nblocks];
+		amap_put ( &block_map, np->addr, nblocks++ );
+		bp->addr = np->addr;
+		bp->nsucc = 0;
+	    }
+	    bp->end = np->addr + np->size;
+	    bp->last = i;
+
+	    if ( np->flags & (LX_JUMP | LX_BRANCH | LX_TERM | LX_CALL | LX_CALLX) ) {
+		if ( (np->flags & (LX_JUMP | LX_BRANCH)) && ! is_entry ( np->target ) )
+		    bp->succ[bp->nsucc++] = np->target;
+		if ( ! (np->flags & (LX_JUMP | LX_TERM)) )
+		    bp->succ[bp->nsucc++] = bp->end;
+		bp = NULL;
+		continue;
+	    }
+
+	    /* falls into the next block */
+	    if ( i + 1 < ninsns && insns[i+1].leader && insns[i+1].addr == bp->end )
+		bp->succ[bp->nsucc++] = bp->end;
+	}
+}
+
+/* ------------------------------------------------------------ */
+/* Functions */
+
+struct func {
+	unsigned int addr;
+	char *name;
+	int size;
+	int nblocks;
+	int frame;
+	int leaf;
+	int external;
+	int first;		/* into edges */
+	int ncalls;
+};
+
+struct func *funcs;
+int nfuncs;
+struct amap func_map;
+
+int *edges;
+int nedges;
+int max_edges;
+
+/* scratch for the walk through one function */
+int *block_stamp;
+int *func_stamp;
+int *stack;
+
+static int
+addr_compare ( const void *a, const void *b )
+{
+	unsigned int aa = *(const unsigned int *) a;
+	unsigned int bb = *(const unsigned int *) b;
+
+	return aa < bb ? -1 : aa > bb;
+}
+
+static void
+add_edge ( struct func *fp, int stamp, unsigned int target )
+{
+	int callee;
+
+	callee = amap_get ( &func_map, target );
+	if ( callee < 0 || func_stamp[callee] == stamp )
+	    return;
+	func_stamp[callee] = stamp;
+
+	if ( nedges >= max_edges ) {
+	    max_edges = max_edges ? max_edges * 2 : 4096;
+	    edges = xrealloc ( edges, max_edges * sizeof(int) );
+	}
+	edges[nedges++] = callee;
+	fp->ncalls++;
+}
+
+/* Walk the blocks of function f */
+static void
+walk_func ( int f )
+{
+	struct func *fp = &funcs[f];
+	struct block *bp;
+	struct insn *np;
+	int stamp = f + 1;
+	int sp = 0;
+	int b, i, s;
+
+	fp->first = nedges;
+	b = amap_get ( &block_map, fp->addr );
+	if ( b < 0 ) {
+	    fp->external = 1;
+	    return;
+	}
+
+	block_stamp[b] = stamp;
+	stack[sp++] = b;
+	while ( sp > 0 ) {
+	    bp = &blocks[stack[--sp]];
+	    fp->nblocks++;
+	    fp->size += bp->end - bp->addr;
+
+	    for ( i = bp->last; i >= 0 && insns[i].addr >= bp->addr; i-- ) {
+		np = &insns[i];
+		if ( np->frame > fp->frame )
+		    fp->frame = np->frame;
+		if ( np->flags & (LX_CALL | LX_CALLX) ) {
+		    fp->leaf = 0;
+		    if ( np->flags & LX_TARGET )
+			add_edge ( fp, stamp, np->target );
+		}
+		/* tail call, but a jump back to our own start
+		 * (the "j ." the vectors sit in) is just a loop.
+		 */
+		if ( (np->flags & (LX_JUMP | LX_BRANCH)) && is_entry ( np->target ) &&
+			np->target != fp->addr ) {
+		    fp->leaf = 0;
+		    add_edge ( fp, stamp, np->target );
+		}
+	    }
+
+	    for ( s=0; s<bp->nsucc; s++ ) {
+		b = amap_get ( &block_map, bp->succ[s] );
+		if ( b < 0 || block_stamp[b] == stamp )
+		    continue;
+		block_stamp[b] = stamp;
+		stack[sp++] = b;
+	    }
+	}
+}
+
+static void
+find_funcs ( void )
+{
+	unsigned int *sorted;
+	char buf[32];
+	char *name;
+	int i;
+
+	sorted = xrealloc ( NULL, nentries * sizeof(unsigned int) );
+	memcpy ( sorted, entries, nentries * sizeof(unsigned int) );
+	qsort ( sorted, nentries, sizeof(unsigned int), addr_compare );
+
+	nfuncs = nentries;
+	funcs = xrealloc ( NULL, nfuncs * sizeof(struct func) );
+	memset ( funcs, 0, nfuncs * sizeof(struct func) );
+	for ( i=0; i<nfuncs; i++ ) {
+	    funcs[i].addr = sorted[i];
+	    funcs[i].leaf = 1;
+	    name = sym_name ( sorted[i] );
+	    if ( ! name ) {
+		sprintf ( buf, "sub_%08x", sorted[i] );
+		name = strdup ( buf );
+	    }
+	    funcs[i].name = name;
+	    amap_put ( &func_map, sorted[i], i );
+	}
+	free ( sorted );
+
+	block_stamp = xrealloc ( NULL, (nblocks + 1) * sizeof(int) );
+	memset ( block_stamp, 0, (nblocks + 1) * sizeof(int) );
+	stack = xrealloc ( NULL, (nblocks + 1) * sizeof(int) );
+	func_stamp = xrealloc ( NULL, nfuncs * sizeof(int) );
+	memset ( func_stamp, 0, nfuncs * sizeof(int) );
+
+	for ( i=0; i<nfuncs; i++ )
+	    walk_func ( i );
+}
+
+/* ------------------------------------------------------------ */
+/* Output */
+
+static void
+show_table ( void )
+{
+	struct func *fp;
+	int i;
+
+	printf ( "; %d instructions, %d blocks, %d functions, %d calls\n",
+	    ninsns, nblocks, nfuncs, nedges );
+	printf ( ";  addr     size blocks frame calls\n" );
+	for ( i=0; i<nfuncs; i++ ) {
+	    fp = &funcs[i];
+	    if ( fp->external ) {
+		printf ( "%08x        -    -     -     -  %s (external)\n", fp->addr, fp->name );
+		continue;
+	    }
+	    printf ( "%08x %8d %4d %5d %5d  %s%s\n", fp->addr, fp->size, fp->nblocks,
+		fp->frame, fp->ncalls, fp->name, fp->leaf ? " (leaf)" : "" );
+	}
+}
+
+static void
+show_dot ( void )
+{
+	struct func *fp;
+	int i, e;
+
+	printf ( "digraph calls {\n" );
+	printf ( "\tnode [shape=box];\n" );
+	for ( i=0; i<nfuncs; i++ ) {
+	    fp = &funcs[i];
+	    if ( fp->external )
+		printf ( "\t\"%s\" [style=dashed];\n", fp->name );
+	    else
+		printf ( "\t\"%s\" [label=\"%s\\n%d bytes\"];\n", fp->name, fp->name, fp->size );
+	}
+	for ( i=0; i<nfuncs; i++ ) {
+	    fp = &funcs[i];
+	    for ( e=0; e<fp->ncalls; e++ )
+		printf ( "\t\"%s\" -> \"%s\";\n", fp->name, funcs[edges[fp->first+e]].name );
+	}
+	printf ( "}\n" );
+}
+
+static int
+find_func ( char *name )
+{
+	unsigned int addr;
+	int f;
+
+	if ( ! sym_addr ( name, &addr ) )
+	    addr = strtoul ( name, NULL, 16 );
+	f = amap_get ( &func_map, addr );
+	if ( f < 0 ) {
+	    printf ( "Sorry, no such function: %s\n", name );
+	    exit ( 1 );
+	}
+	return f;
+}
+
+/* The blocks of one function */
+static void
+show_cfg ( char *name )
+{
+	struct func *fp;
+	struct block *bp;
+	int stamp;
+	int sp = 0;
+	int b, s, t;
+
+	fp = &funcs[find_func ( name )];
+	b = amap_get ( &block_map, fp->addr );
+
+	printf ( "digraph \"%s\" {\n", fp->name );
+	printf ( "\tnode [shape=box];\n" );
+	if ( b < 0 ) {
+	    printf ( "}\n" );
+	    return;
+	}
+
+	stamp = nfuncs + 1;
+	block_stamp[b] = stamp;
+	stack[sp++] = b;
+	while ( sp > 0 ) {
+	    bp = &blocks[stack[--sp]];
+	    printf ( "\t\"%08x\" [label=\"%08x\\n%d bytes\"];\n", bp->addr, bp->addr, bp->end - bp->addr );
+	    for ( s=0; s<bp->nsucc; s++ ) {
+		t = amap_get ( &block_map, bp->succ[s] );
+		if ( t < 0 )
+		    continue;
+		printf ( "\t\"%08x\" -> \"%08x\";\n", bp->addr, bp->succ[s] );
+		if ( block_stamp[t] == stamp )
+		    continue;
+		block_stamp[t] = stamp;
+		stack[sp++] = t;
+	    }
+	}
+	printf ( "}\n" );
+}
+
+/* Everything a function calls, and what they call ... */
+static void
+show_reach ( char *name )
+{
+	int *depth;
+	int *queue;
+	int head, tail;
+	struct func *fp;
+	int f, e, c;
+
+	depth = xrealloc ( NULL, nfuncs * sizeof(int) );
+	queue = xrealloc ( NULL, nfuncs * sizeof(int) );
+	for ( f=0; f<nfuncs; f++ )
+	    depth[f] = -1;
+
+	f = find_func ( name );
+	depth[f] = 0;
+	head = tail = 0;
+	queue[tail++] = f;
+	while ( head < tail ) {
+	    f = queue[head++];
+	    fp = &funcs[f];
+	    printf ( "%2d %08x %s%s\n", depth[f], fp->addr, fp->name,
+		fp->external ? " (external)" : "" );
+	    for ( e=0; e<fp->ncalls; e++ ) {
+		c = edges[fp->first+e];
+		if ( depth[c] >= 0 )
+		    continue;
+		depth[c] = depth[f] + 1;
+		queue[tail++] = c;
+	    }
+	}
+
+	free ( depth );
+	free ( queue );
+}
+
+static void
+put_word ( FILE *fp, unsigned int val )
+{
+	unsigned char b[4];
+
+	b[0] = val;
+	b[1] = val >> 8;
+	b[2] = val >> 16;
+	b[3] = val >> 24;
+	fwrite ( b, 1, 4, fp );
+}
+
+static void
+write_binary ( char *file )
+{
+	FILE *fp;
+	struct func *xp;
+	int i;
+
+	fp = fopen ( file, "wb" );
+	if ( ! fp ) {
+	    printf ( "Cannot create %s\n", file );
+	    exit ( 1 );
+	}
+
+	fwrite ( "LXCG", 1, 4, fp );
+	put_word ( fp, 1 );
+	put_word ( fp, nfuncs );
+	put_word ( fp, nedges );
+	for ( i=0; i<nfuncs; i++ ) {
+	    xp = &funcs[i];
+	    put_word ( fp, xp->addr );
+	    put_word ( fp, xp->size );
+	    put_word ( fp, xp->frame );
+	    put_word ( fp, (xp->leaf ? 1 : 0) | (xp->external ? 2 : 0) );
+	    put_word ( fp, xp->first );
+	    put_word ( fp, xp->ncalls );
+	}
+	for ( i=0; i<nedges; i++ )
+	    put_word ( fp, edges[i] );
+
+	fclose ( fp );
+}
+
+/* ------------------------------------------------------------ */
+
+#define MAX_SYMFILES	8
+
+static void
+usage ( void )
+{
+	printf ( "Usage: lxgraph [-aapp] [-s symfile] [-g] [-c func] [-r func] [-b file] [addr ...]\n" );
+	exit ( 1 );
+}
+
+int
+main ( int argc, char **argv )
+{
+	char *prefix = NULL;
+	char *extra[MAX_SYMFILES];
+	int nextra = 0;
+	char *cfg_name = NULL;
+	char *reach_name = NULL;
+	char *bin_name = NULL;
+	int dot = 0;
+	char fname[128];
+	char *ap;
+	int i;
+
+	argc--;
+	++argv;
+	while ( argc > 0 && argv[0][0] == '-' ) {
+	    ap = argv[0];
+	    if ( ap[1] == 'a' )
+		prefix = &ap[2];
+	    else if ( ap[1] == 'g' )
+		dot = 1;
+	    else if ( argc < 2 )
+		usage ();
+	    else {
+		if ( ap[1] == 's' && nextra < MAX_SYMFILES )
+		    extra[nextra++] = argv[1];
+		else if ( ap[1] == 'c' )
+		    cfg_name = argv[1];
+		else if ( ap[1] == 'r' )
+		    reach_name = argv[1];
+		else if ( ap[1] == 'b' )
+		    bin_name = argv[1];
+		else
+		    usage ();
+		argc--;
+		++argv;
+	    }
+	    argc--;
+	    ++argv;
+	}
+
+	if ( prefix ) {
+	    snprintf ( fname, sizeof(fname), "%s-0x00000.bin", prefix );
+	    image_app ( strdup ( fname ) );
+	    snprintf ( fname, sizeof(fname), "%s-0x40000.bin", prefix );
+	    image_raw ( strdup ( fname ), FLASH_BASE );
+	} else {
+	    image_raw ( ROM_BINFILE, ROM_BASE );
+	    load_syms ( SYM_FILE, 0 );
+	}
+	image_finish ();
+
+	for ( i=0; i<nextra; i++ )
+	    load_syms ( extra[i], 1 );
+
+	/* every symbol that lands on code is an entry point */
+	if ( prefix )
+	    add_entry ( segments.entry );
+	else
+	    add_entry ( RESET_VECTOR );
+	for ( i=0; i<nsyms; i++ )
+	    if ( is_code ( syms[i].addr ) )
+		add_entry ( syms[i].addr );
+	for ( i=0; i<argc; i++ )
+	    add_entry ( strtoul ( argv[i], NULL, 16 ) );
+
+	pass1 ();
+	find_blocks ();
+	find_funcs ();
+
+	if ( bin_name )
+	    write_binary ( bin_name );
+
+	if ( cfg_name )
+	    show_cfg ( cfg_name );
+	else if ( reach_name )
+	    show_reach ( reach_name );
+	else if ( dot )
+	    show_dot ();
+	else if ( ! bin_name )
+	    show_table ();
+
+	return 0;
+}
+
+/* THE END */
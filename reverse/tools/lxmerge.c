@@ -0,0 +1,392 @@
+/* lxmerge.c
+ * One of my ESP8266 reverse engineering tools
+ *
+ * merge_dis in C.
+ * Carry the hand annotation in the old disassembly (boot_OLD.txt)
+ * over to a new listing from lxdis (new.dis).
+ *
+ *   lxmerge [-o orphans] [-e end] boot_OLD.txt new.dis >boot_NEW.txt
+ *
+ * merge_dis walks both files side by side.  Here we read the old
+ * file into a list of "units" (an instruction line along with the
+ * comments, section headers and such in front of it) and hash them
+ * by address, then go through the new listing once.  For each new
+ * line we look up the old unit at the same address and put out:
+ *
+ *	- the chatter in front of any old units we passed over,
+ *	- the chatter in front of the old unit,
+ *	- the chatter lxdis put in front of the new line (labels),
+ *	- the new line, with the old comment tacked on.
+ *
+ * The output is what merge_dis gives, tabs and all.  As in merge_dis,
+ * the comment from an old line whose address went away ends up on the
+ * next line.  Those are the "orphans", and we list them (in the -o
+ * file, or on stderr) so they can be looked at.
+ *
+ * As in merge_dis, old style labels ("40000000 <_Rom_start>:"),
+ * the "***" lines from lxdis and comments on l32r lines
+ * (lxdis has better ones now) are left out.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* merge_dis stops here, the end of the rom has been done by hand */
+#define END_ADDRESS	0x4000e326
+
+/* An instruction line and what was in front of it */
+struct unit {
+	unsigned int addr;
+	int first;
+	int line;
+	char *comment;
+	int next;
+	int done;
+};
+
+static char **lines;
+static int nlines;
+static int max_lines;
+
+static struct unit *units;
+static int nunits;
+static int max_units;
+
+/* old units by address, chained on next */
+static int *hash;
+static int hsize;
+
+static int old_next;
+
+static FILE *orphan_fp;
+static int norphans;
+
+static void *
+xrealloc ( void *p, int size )
+{
+	p = realloc ( p, size );
+	if ( ! p ) {
+	    printf ( "Out of memory\n" );
+	    exit ( 1 );
+	}
+	return p;
+}
+
+/* merge_dis looks for /^4000....:/ */
+static int
+is_dis ( char *s )
+{
+	int i;
+
+	if ( strncmp ( s, "4000", 4 ) != 0 )
+	    return 0;
+	for ( i=4; i<8; i++ )
+	    if ( s[i] == '\0' )
+		return 0;
+	return s[8] == ':';
+}
+
+/* The opcode is the third word */
+static int
+is_l32r ( char *s )
+{
+	char buf[128];
+	char *w;
+	int n = 0;
+
+	strncpy ( buf, s, sizeof(buf) - 1 );
+	buf[sizeof(buf)-1] = '\0';
+	for ( w = strtok ( buf, " \t" ); w; w = strtok ( NULL, " \t" ) )
+	    if ( ++n == 3 )
+		return strcmp ( w, "l32r" ) == 0;
+	return 0;
+}
+
+static char *
+get_line ( FILE *fp )
+{
+	static char *buf = NULL;
+	static size_t size = 0;
+	int len;
+
+	len = getline ( &buf, &size, fp );
+	if ( len < 0 )
+	    return NULL;
+	if ( len > 0 && buf[len-1] == '\n' )
+	    buf[--len] = '\0';
+	return buf;
+}
+
+/* ------------------------------------------------------------ */
+
+static unsigned int
+hash_addr ( unsigned int addr )
+{
+	return (addr * 2654435761U) & (hsize - 1);
+}
+
+static void
+read_old ( char *file )
+{
+	FILE *fp;
+	char *buf;
+	char *c;
+	struct unit *up;
+	int first = 0;
+	int i, h, *lp;
+
+	fp = fopen ( file, "r" );
+	if ( ! fp ) {
+	    printf ( "Cannot open %s\n", file );
+	    exit ( 1 );
+	}
+
+	while ( (buf = get_line ( fp )) ) {
+	    if ( nlines >= max_lines ) {
+		max_lines = max_lines ? max_lines * 2 : 32768;
+		lines = xrealloc ( lines, max_lines * sizeof(char *) );
+	    }
+	    lines[nlines] = strdup ( buf );
+
+	    if ( is_dis ( buf ) ) {
+		if ( nunits >= max_units ) {
+		    max_units = max_units ? max_units * 2 : 16384;
+		    units = xrealloc ( units, max_units * sizeof(struct unit) );
+		}
+		up = &units[nunits++];
+		up->addr = strtoul ( buf, NULL, 16 );
+		up->first = first;
+		up->line = nlines;
+		c = strchr ( lines[nlines], ';' );
+		up->comment = c;
+		up->next = -1;
+		up->done = 0;
+		first = nlines + 1;
+	    }
+	    nlines++;
+	}
+	fclose ( fp );
+
+	hsize = 1;
+	while ( hsize < nunits * 2 )
+	    hsize *= 2;
+	hash = xrealloc ( NULL, hsize * sizeof(int) );
+	for ( i=0; i<hsize; i++ )
+	    hash[i] = -1;
+
+	/* chain the units at an address in file order */
+	for ( i=0; i<nunits; i++ ) {
+	    h = hash_addr ( units[i].addr );
+	    while ( hash[h] >= 0 && units[hash[h]].addr != units[i].addr )
+		h = (h + 1) & (hsize - 1);
+	    lp = &hash[h];
+	    while ( *lp >= 0 )
+		lp = &units[*lp].next;
+	    *lp = i;
+	}
+}
+
+/* The first old unit at this address we haven't used */
+static int
+old_lookup ( unsigned int addr )
+{
+	int h;
+	int i;
+
+	h = hash_addr ( addr );
+	while ( hash[h] >= 0 && units[hash[h]].addr != addr )
+	    h = (h + 1) & (hsize - 1);
+
+	for ( i = hash[h]; i >= 0; i = units[i].next )
+	    if ( ! units[i].done )
+		return i;
+	return -1;
+}
+
+/* ------------------------------------------------------------ */
+
+static void
+orphan ( struct unit *up, char *what, unsigned int addr )
+{
+	FILE *fp = orphan_fp ? orphan_fp : stderr;
+
+	if ( addr )
+	    fprintf ( fp, "%08x: %s %08x\t%s\n", up->addr, what, addr, up->comment );
+	else
+	    fprintf ( fp, "%08x: %s\t%s\n", up->addr, what, up->comment );
+	norphans++;
+}
+
+/* Put out the chatter in front of an old unit, and
+ * hand back its comment (if it has one) for the new line.
+ */
+static char *
+old_unit ( int u, char *comment, unsigned int addr, int is_l )
+{
+	struct unit *up = &units[u];
+	int i;
+
+	for ( i=up->first; i<up->line; i++ )
+	    if ( ! strstr ( lines[i], ">:" ) )
+		printf ( "%s\n", lines[i] );
+	up->done = 1;
+
+	if ( is_l || ! up->comment )
+	    return comment;
+
+	/* the comment was on an address that isn't there now */
+	if ( up->addr != addr )
+	    orphan ( up, "moved to", addr );
+	return up->comment;
+}
+
+/* merge_dis line_out, which is smart about tabs */
+static void
+line_out ( char *raw, char *old )
+{
+	char *c;
+	int len;
+
+	c = strchr ( raw, ';' );
+	len = c ? c - raw : strlen ( raw );
+	while ( c && len > 0 && raw[len-1] == ' ' )
+	    len--;
+
+	fwrite ( raw, 1, len, stdout );
+	if ( c || old ) {
+	    if ( len < 40 )
+		putchar ( '\t' );
+	    if ( len < 48 )
+		putchar ( '\t' );
+	    if ( len < 56 )
+		putchar ( '\t' );
+	    putchar ( '\t' );
+	    if ( c && old )
+		printf ( "%s -%s", c, old + 1 );
+	    else
+		printf ( "%s", c ? c : old );
+	}
+	putchar ( '\n' );
+}
+
+static void
+merge ( char *file, unsigned int end_address )
+{
+	FILE *fp;
+	char *buf;
+	char **chat = NULL;
+	int nchat = 0;
+	int max_chat = 0;
+	unsigned int addr;
+	char *comment;
+	int is_l;
+	int u;
+	int i;
+
+	fp = fopen ( file, "r" );
+	if ( ! fp ) {
+	    printf ( "Cannot open %s\n", file );
+	    exit ( 1 );
+	}
+
+	while ( (buf = get_line ( fp )) ) {
+	    if ( ! is_dis ( buf ) ) {
+		if ( strncmp ( buf, "***", 3 ) == 0 )
+		    continue;
+		if ( nchat >= max_chat ) {
+		    max_chat = max_chat ? max_chat * 2 : 64;
+		    chat = xrealloc ( chat, max_chat * sizeof(char *) );
+		}
+		chat[nchat++] = strdup ( buf );
+		continue;
+	    }
+
+	    addr = strtoul ( buf, NULL, 16 );
+	    if ( addr > end_address )
+		break;
+	    is_l = is_l32r ( buf );
+	    comment = NULL;
+
+	    /* Everything in the old file up to the unit at this
+	     * address, or if there isn't one, everything before
+	     * this address.
+	     */
+	    u = old_lookup ( addr );
+	    if ( u >= 0 ) {
+		for ( ; old_next <= u; old_next++ )
+		    if ( ! units[old_next].done )
+			comment = old_unit ( old_next, comment, addr, is_l );
+	    } else {
+		for ( ; old_next < nunits; old_next++ ) {
+		    if ( units[old_next].done )
+			continue;
+		    if ( units[old_next].addr >= addr )
+			break;
+		    comment = old_unit ( old_next, comment, addr, is_l );
+		}
+	    }
+
+	    for ( i=0; i<nchat; i++ ) {
+		printf ( "%s\n", chat[i] );
+		free ( chat[i] );
+	    }
+	    nchat = 0;
+
+	    line_out ( buf, comment );
+	}
+	fclose ( fp );
+
+	/* and what never found a home */
+	for ( u=old_next; u<nunits; u++ )
+	    if ( ! units[u].done && units[u].comment && units[u].addr <= end_address )
+		orphan ( &units[u], "dropped", 0 );
+}
+
+static void
+usage ( void )
+{
+	printf ( "Usage: lxmerge [-o orphans] [-e end] old new\n" );
+	exit ( 1 );
+}
+
+int
+main ( int argc, char **argv )
+{
+	char *orphan_file = NULL;
+	unsigned int end_address = END_ADDRESS;
+
+	argc--;
+	argv++;
+
+	while ( argc > 1 && argv[0][0] == '-' ) {
+	    if ( argv[0][1] == 'o' )
+		orphan_file = argv[1];
+	    else if ( argv[0][1] == 'e' )
+		end_address = strtoul ( argv[1], NULL, 16 );
+	    else
+		usage ();
+	    argc -= 2;
+	    argv += 2;
+	}
+	if ( argc != 2 )
+	    usage ();
+
+	if ( orphan_file ) {
+	    orphan_fp = fopen ( orphan_file, "w" );
+	    if ( ! orphan_fp ) {
+		printf ( "Cannot open %s\n", orphan_file );
+		exit ( 1 );
+	    }
+	}
+
+	read_old ( argv[0] );
+	merge ( argv[1], end_address );
+
+	if ( orphan_fp )
+	    fclose ( orphan_fp );
+	if ( norphans )
+	    fprintf ( stderr, "lxmerge: %d orphans\n", norphans );
+	return 0;
+}
+
+/* THE END */
@@ -0,0 +1,713 @@
+/* lxpatch.c
+ * One of my ESP8266 reverse engineering tools
+ *
+ * Patch a merged listing (what merge_dis made, boot.txt) with
+ * a new listing, but only where lxdis says something changed.
+ *
+ *   lxdis -C cache -u changes all | expand >new.dis
+ *   lxpatch [-o orphans] boot_NEW.txt new.dis changes >boot_PATCH.txt
+ *
+ * The changes file has one address range per line (lo hi).
+ * Everything outside those ranges is copied as is.  Inside them
+ * we take the lines from new.dis and carry over the hand annotations
+ * from the merged file, the way merge_dis does:
+ *
+ *  - a comment on an instruction goes back on the instruction
+ *    at the same address (after our own comment if there is one),
+ *  - lines between instructions that we didn't generate (not
+ *    blank lines or labels) go back in front of the instruction
+ *    at the same address, or the next one if it went away.
+ *
+ * Comments whose address went away are reported in the orphans
+ * file (or on stderr).  A lot of blank lines can pile up,
+ * run cleanup on the result if that bothers you.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/* One instruction line, and the lines just before it */
+struct unit {
+	int first;
+	int line;
+	unsigned int addr;
+};
+
+struct text {
+	char **line;
+	int count;
+	int max;
+	struct unit *unit;
+	int nunit;
+	int maxunit;
+	int tail;
+};
+
+struct range {
+	unsigned int lo;
+	unsigned int hi;
+};
+
+/* hand annotation pulled out of a block of the merged file,
+ * for chatter, unit is which time we saw the address.
+ */
+struct note {
+	unsigned int addr;
+	int unit;
+	int seq;
+	char *text;
+	int used;
+};
+
+static struct text merged;
+static struct text new;
+
+static struct range *ranges;
+static int nranges;
+
+static struct note *notes;
+static int nnotes;
+static int max_notes;
+
+static struct note *chat;
+static int nchat;
+static int max_chat;
+
+static FILE *orphan_fp;
+static int norphans;
+
+static void *
+xrealloc ( void *p, int size )
+{
+	p = realloc ( p, size );
+	if ( ! p ) {
+	    printf ( "Out of memory\n" );
+	    exit ( 1 );
+	}
+	return p;
+}
+
+static int
+is_addr_line ( char *s, unsigned int *addr )
+{
+	int i;
+
+	for ( i=0; i<8; i++ )
+	    if ( ! isxdigit ( s[i] ) )
+		return 0;
+	if ( s[8] != ':' )
+	    return 0;
+	*addr = strtoul ( s, NULL, 16 );
+	return 1;
+}
+
+static void
+read_text ( char *file, struct text *tp )
+{
+	FILE *fp;
+	char *buf = NULL;
+	size_t size = 0;
+	int len;
+	unsigned int addr;
+	int first = 0;
+	struct unit *up;
+
+	fp = fopen ( file, "r" );
+	if ( ! fp ) {
+	    printf ( "Cannot open %s\n", file );
+	    exit ( 1 );
+	}
+
+	while ( (len = getline ( &buf, &size, fp )) >= 0 ) {
+	    if ( len > 0 && buf[len-1] == '\n' )
+		buf[--len] = '\0';
+	    if ( tp->count >= tp->max ) {
+		tp->max = tp->max ? tp->max * 2 : 4096;
+		tp->line = xrealloc ( tp->line, tp->max * sizeof(char *) );
+	    }
+	    tp->line[tp->count] = strdup ( buf );
+
+	    if ( is_addr_line ( buf, &addr ) ) {
+		if ( tp->nunit >= tp->maxunit ) {
+		    tp->maxunit = tp->maxunit ? tp->maxunit * 2 : 4096;
+		    tp->unit = xrealloc ( tp->unit, tp->maxunit * sizeof(struct unit) );
+		}
+		up = &tp->unit[tp->nunit++];
+		up->first = first;
+		up->line = tp->count;
+		up->addr = addr;
+		first = tp->count + 1;
+	    }
+	    tp->count++;
+	}
+	tp->tail = first;
+
+	free ( buf );
+	fclose ( fp );
+}
+
+static void
+read_ranges ( char *file )
+{
+	FILE *fp;
+	char buf[128];
+	unsigned int lo, hi;
+	int max = 0;
+
+	fp = fopen ( file, "r" );
+	if ( ! fp ) {
+	    printf ( "Cannot open %s\n", file );
+	    exit ( 1 );
+	}
+
+	while ( fgets ( buf, sizeof(buf), fp ) ) {
+	    if ( sscanf ( buf, "%x %x", &lo, &hi ) != 2 )
+		continue;
+	    if ( nranges >= max ) {
+		max = max ? max * 2 : 64;
+		ranges = xrealloc ( ranges, max * sizeof(struct range) );
+	    }
+	    ranges[nranges].lo = lo;
+	    ranges[nranges].hi = hi;
+	    nranges++;
+	}
+	fclose ( fp );
+}
+
+/* ranges are in order and don't overlap */
+static int
+find_range ( unsigned int addr )
+{
+	int lo = 0;
+	int hi = nranges - 1;
+	int mid;
+
+	while ( lo <= hi ) {
+	    mid = (lo + hi) / 2;
+	    if ( addr < ranges[mid].lo )
+		hi = mid - 1;
+	    else if ( addr >= ranges[mid].hi )
+		lo = mid + 1;
+	    else
+		return mid;
+	}
+	return -1;
+}
+
+static int
+in_range ( unsigned int addr, int r )
+{
+	return addr >= ranges[r].lo && addr < ranges[r].hi;
+}
+
+/* ------------------------------------------------------------ */
+
+/* The third word, the opcode */
+static int
+opcode_is ( char *line, char *op )
+{
+	char buf[128];
+	char *w;
+	int n = 0;
+
+	strncpy ( buf, line, sizeof(buf) - 1 );
+	buf[sizeof(buf)-1] = '\0';
+	for ( w = strtok ( buf, " \t" ); w; w = strtok ( NULL, " \t" ) ) {
+	    if ( ++n == 3 )
+		return strncmp ( w, op, strlen(op) ) == 0;
+	}
+	return 0;
+}
+
+/* lxdis puts comments on some lines itself, merge_dis put
+ * the hand comment after them with " -" in place of the ";".
+ */
+static int
+own_comment ( char *line, char *comment )
+{
+	if ( strncmp ( comment, "; l32r", 6 ) == 0 )
+	    return 1;
+	if ( strncmp ( comment, "; (not disassembled)", 20 ) == 0 )
+	    return 1;
+	if ( strncmp ( comment, "; ????", 6 ) == 0 )
+	    return 1;
+	if ( opcode_is ( line, "call" ) && ! opcode_is ( line, "callx" ) )
+	    return 1;
+	return 0;
+}
+
+/* The hand written part of a comment, if any */
+static char *
+hand_comment ( char *line )
+{
+	char *c;
+	char *p;
+	char *rv;
+
+	c = strchr ( line, ';' );
+	if ( ! c )
+	    return NULL;
+
+	/* merge_dis never put anything on these */
+	if ( opcode_is ( line, "l32r" ) )
+	    return NULL;
+
+	if ( ! own_comment ( line, c ) )
+	    return strdup ( c );
+
+	p = strstr ( c, " -" );
+	if ( ! p )
+	    return NULL;
+	rv = strdup ( p + 1 );
+	rv[0] = ';';
+	return rv;
+}
+
+/* blank lines and labels are ours, so are "***" lines */
+static int
+is_generated ( char *line )
+{
+	int len;
+
+	if ( line[0] == '\0' )
+	    return 1;
+	if ( strncmp ( line, "***", 3 ) == 0 )
+	    return 1;
+
+	/* "  name:" */
+	len = strlen ( line );
+	if ( len > 3 && strncmp ( line, "  ", 2 ) == 0 && line[len-1] == ':' &&
+		! strpbrk ( line + 2, " \t" ) )
+	    return 1;
+	return 0;
+}
+
+static void
+add_note ( unsigned int addr, char *text )
+{
+	if ( nnotes >= max_notes ) {
+	    max_notes = max_notes ? max_notes * 2 : 1024;
+	    notes = xrealloc ( notes, max_notes * sizeof(struct note) );
+	}
+	notes[nnotes].addr = addr;
+	notes[nnotes].seq = nnotes;
+	notes[nnotes].text = text;
+	notes[nnotes].used = 0;
+	nnotes++;
+}
+
+static void
+add_chat ( unsigned int addr, int unit, char *text )
+{
+	if ( nchat >= max_chat ) {
+	    max_chat = max_chat ? max_chat * 2 : 256;
+	    chat = xrealloc ( chat, max_chat * sizeof(struct note) );
+	}
+	chat[nchat].addr = addr;
+	chat[nchat].unit = unit;
+	chat[nchat].seq = nchat;
+	chat[nchat].text = text;
+	chat[nchat].used = 0;
+	nchat++;
+}
+
+static int
+note_compare ( const void *a, const void *b )
+{
+	const struct note *na = a;
+	const struct note *nb = b;
+
+	if ( na->addr != nb->addr )
+	    return na->addr < nb->addr ? -1 : 1;
+	return na->seq - nb->seq;
+}
+
+/* first note for this address */
+static struct note *
+find_note ( unsigned int addr )
+{
+	int lo = 0;
+	int hi = nnotes - 1;
+	int mid;
+	int found = -1;
+
+	while ( lo <= hi ) {
+	    mid = (lo + hi) / 2;
+	    if ( notes[mid].addr < addr )
+		lo = mid + 1;
+	    else {
+		if ( notes[mid].addr == addr )
+		    found = mid;
+		hi = mid - 1;
+	    }
+	}
+	return found < 0 ? NULL : &notes[found];
+}
+
+/* ------------------------------------------------------------ */
+
+/* What merge_dis does with a new line and a hand comment */
+static void
+line_out ( char *raw, char *hand )
+{
+	char *c;
+	char *comment = NULL;
+	int len;
+
+	c = strchr ( raw, ';' );
+	len = c ? c - raw : strlen ( raw );
+	while ( c && len > 0 && raw[len-1] == ' ' )
+	    len--;
+
+	if ( c && hand ) {
+	    comment = xrealloc ( NULL, strlen(c) + strlen(hand) + 2 );
+	    sprintf ( comment, "%s -%s", c, hand + 1 );
+	} else if ( c )
+	    comment = strdup ( c );
+	else if ( hand )
+	    comment = strdup ( hand );
+
+	fwrite ( raw, 1, len, stdout );
+	if ( comment ) {
+	    if ( len < 40 )
+		putchar ( '\t' );
+	    if ( len < 48 )
+		putchar ( '\t' );
+	    if ( len < 56 )
+		putchar ( '\t' );
+	    printf ( "\t%s", comment );
+	    free ( comment );
+	}
+	putchar ( '\n' );
+}
+
+static void
+orphan ( unsigned int addr, char *what, char *text )
+{
+	FILE *fp = orphan_fp ? orphan_fp : stderr;
+
+	fprintf ( fp, "%08x: %s %s\n", addr, what, text );
+	norphans++;
+}
+
+/* An address can show up twice (range2 runs on into the
+ * next region), so we keep count of how many times we have
+ * seen each one in a block, in both files.
+ */
+struct count {
+	unsigned int addr;
+	int m;
+	int n;
+};
+
+static struct count *counts;
+static int csize;
+
+static void
+count_reset ( int need )
+{
+	int i;
+
+	if ( csize < need * 2 ) {
+	    while ( csize < need * 2 )
+		csize = csize ? csize * 2 : 1024;
+	    counts = xrealloc ( counts, csize * sizeof(struct count) );
+	}
+	for ( i=0; i<csize; i++ )
+	    counts[i].addr = 0;
+}
+
+/* (address 0 is never in a listing) */
+static struct count *
+count_get ( unsigned int addr )
+{
+	unsigned int h;
+
+	h = (addr * 2654435761U) & (csize - 1);
+	while ( counts[h].addr && counts[h].addr != addr )
+	    h = (h + 1) & (csize - 1);
+	if ( ! counts[h].addr ) {
+	    counts[h].addr = addr;
+	    counts[h].m = 0;
+	    counts[h].n = 0;
+	}
+	return &counts[h];
+}
+
+/* chatter sorted by address and which time we saw it */
+static int *chat_index;
+
+static int
+chat_compare ( const void *a, const void *b )
+{
+	const struct note *ca = &chat[*(const int *)a];
+	const struct note *cb = &chat[*(const int *)b];
+
+	if ( ca->addr != cb->addr )
+	    return ca->addr < cb->addr ? -1 : 1;
+	if ( ca->unit != cb->unit )
+	    return ca->unit - cb->unit;
+	return ca->seq - cb->seq;
+}
+
+/* hand chatter goes out ahead of the line it was in front of */
+static void
+chat_here ( unsigned int addr, int occ, int nfound )
+{
+	struct note *cp;
+	int lo = 0;
+	int hi = nfound - 1;
+	int mid;
+	int found = nfound;
+
+	while ( lo <= hi ) {
+	    mid = (lo + hi) / 2;
+	    cp = &chat[chat_index[mid]];
+	    if ( cp->addr < addr || (cp->addr == addr && cp->unit < occ) )
+		lo = mid + 1;
+	    else {
+		found = mid;
+		hi = mid - 1;
+	    }
+	}
+
+	for ( ; found < nfound; found++ ) {
+	    cp = &chat[chat_index[found]];
+	    if ( cp->addr != addr || cp->unit != occ )
+		break;
+	    printf ( "%s\n", cp->text );
+	}
+}
+
+/* or in front of the next one after it, if that address is gone */
+static int
+chat_moved ( int ci, int nlim, unsigned int addr )
+{
+	for ( ; ci < nlim; ci++ ) {
+	    if ( chat[ci].used )
+		continue;
+	    if ( chat[ci].addr >= addr )
+		break;
+	    orphan ( chat[ci].addr, "moved", chat[ci].text );
+	    printf ( "%s\n", chat[ci].text );
+	}
+	return ci;
+}
+
+/* One run of the merged file that falls in range r,
+ * from unit mu on (through the chatter in front of
+ * the unit after it).  Returns the next unit.
+ * If the block before this one took care of the chatter
+ * in front of unit mu, done is set.
+ */
+static int
+patch_block ( int mu, int r, int *nu_p, int done )
+{
+	struct unit *up;
+	struct unit *nup;
+	struct note *np;
+	struct count *cp;
+	char *hand;
+	int nu, nend;
+	int end;
+	int nblock;
+	int nfound;
+	int ci;
+	int i;
+
+	nnotes = 0;
+	nchat = 0;
+
+	/* find the same run in the new listing */
+	nu = *nu_p;
+	while ( nu < new.nunit && ! in_range ( new.unit[nu].addr, r ) )
+	    nu++;
+	for ( nend = nu; nend < new.nunit && in_range ( new.unit[nend].addr, r ); nend++ )
+	    ;
+	for ( end = mu; end < merged.nunit && in_range ( merged.unit[end].addr, r ); end++ )
+	    ;
+
+	count_reset ( (end - mu) + (nend - nu) + 1 );
+	for ( i=nu; i<nend; i++ )
+	    count_get ( new.unit[i].addr )->n++;
+
+	/* gather up the hand work, chatter is marked used
+	 * if its line is still there.
+	 */
+	for ( i=mu; i<end; i++ ) {
+	    up = &merged.unit[i];
+	    cp = count_get ( up->addr );
+	    for ( ci = (i == mu && done) ? up->line : up->first; ci<up->line; ci++ )
+		if ( ! is_generated ( merged.line[ci] ) ) {
+		    add_chat ( up->addr, cp->m, merged.line[ci] );
+		    chat[nchat-1].used = cp->m < cp->n;
+		}
+	    cp->m++;
+	    hand = hand_comment ( merged.line[up->line] );
+	    if ( hand )
+		add_note ( up->addr, hand );
+	}
+	nblock = nchat;
+	if ( end < merged.nunit ) {
+	    up = &merged.unit[end];
+	    for ( ci=up->first; ci<up->line; ci++ )
+		if ( ! is_generated ( merged.line[ci] ) )
+		    add_chat ( up->addr, 0, merged.line[ci] );
+	}
+	qsort ( notes, nnotes, sizeof(struct note), note_compare );
+
+	chat_index = xrealloc ( chat_index, (nblock + 1) * sizeof(int) );
+	nfound = 0;
+	for ( i=0; i<nblock; i++ )
+	    if ( chat[i].used )
+		chat_index[nfound++] = i;
+	qsort ( chat_index, nfound, sizeof(int), chat_compare );
+
+	/* out it goes */
+	count_reset ( nend - nu + 1 );
+	ci = 0;
+	for ( ; nu < nend; nu++ ) {
+	    nup = &new.unit[nu];
+	    cp = count_get ( nup->addr );
+	    ci = chat_moved ( ci, nblock, nup->addr );
+	    chat_here ( nup->addr, cp->n++, nfound );
+	    if ( done ) {
+		done = 0;
+		i = nup->line;
+	    } else
+		i = nup->first;
+	    for ( ; i<nup->line; i++ )
+		if ( strncmp ( new.line[i], "***", 3 ) != 0 )
+		    printf ( "%s\n", new.line[i] );
+
+	    hand = NULL;
+	    np = find_note ( nup->addr );
+	    if ( np && ! opcode_is ( new.line[nup->line], "l32r" ) ) {
+		hand = np->text;
+		/* there can be more than one line at an address */
+		for ( i = np - notes; i < nnotes && notes[i].addr == nup->addr; i++ )
+		    notes[i].used = 1;
+	    }
+	    line_out ( new.line[nup->line], hand );
+	}
+
+	/* and what comes before the next instruction */
+	ci = chat_moved ( ci, nblock, 0xffffffff );
+	if ( end < merged.nunit ) {
+	    for ( i=nblock; i<nchat; i++ )
+		printf ( "%s\n", chat[i].text );
+	    if ( nu < new.nunit ) {
+		nup = &new.unit[nu];
+		for ( i=nup->first; i<nup->line; i++ )
+		    if ( strncmp ( new.line[i], "***", 3 ) != 0 )
+			printf ( "%s\n", new.line[i] );
+	    }
+	}
+
+	for ( i=0; i<nnotes; i++ )
+	    if ( ! notes[i].used )
+		orphan ( notes[i].addr, "comment", notes[i].text );
+
+	*nu_p = nu;
+	return end;
+}
+
+#define SUMMARY		"; disassembled "
+
+static char *
+summary ( void )
+{
+	int i;
+
+	for ( i=new.tail; i<new.count; i++ )
+	    if ( strncmp ( new.line[i], SUMMARY, strlen(SUMMARY) ) == 0 )
+		return new.line[i];
+	return "";
+}
+
+static void
+patch ( void )
+{
+	struct unit *up;
+	int mu = 0;
+	int nu = 0;
+	int chatter_done = 0;
+	int r;
+	int i;
+
+	while ( mu < merged.nunit ) {
+	    up = &merged.unit[mu];
+	    r = find_range ( up->addr );
+	    if ( r < 0 ) {
+		if ( ! chatter_done )
+		    for ( i=up->first; i<up->line; i++ )
+			printf ( "%s\n", merged.line[i] );
+		printf ( "%s\n", merged.line[up->line] );
+		chatter_done = 0;
+		mu++;
+		continue;
+	    }
+	    mu = patch_block ( mu, r, &nu, chatter_done );
+	    chatter_done = 1;
+	}
+
+	/* whatever is after the last instruction, but the
+	 * summary line has to come from the new listing.
+	 */
+	for ( i=merged.tail; i<merged.count; i++ ) {
+	    if ( strncmp ( merged.line[i], SUMMARY, strlen(SUMMARY) ) == 0 )
+		printf ( "%s\n", summary () );
+	    else
+		printf ( "%s\n", merged.line[i] );
+	}
+}
+
+static void
+usage ( void )
+{
+	printf ( "Usage: lxpatch [-o orphans] merged new changes\n" );
+	exit ( 1 );
+}
+
+int
+main ( int argc, char **argv )
+{
+	char *orphan_file = NULL;
+
+	argc--;
+	argv++;
+
+	while ( argc > 1 && argv[0][0] == '-' ) {
+	    if ( argv[0][1] == 'o' )
+		orphan_file = argv[1];
+	    else
+		usage ();
+	    argc -= 2;
+	    argv += 2;
+	}
+	if ( argc != 3 )
+	    usage ();
+
+	read_text ( argv[0], &merged );
+	read_text ( argv[1], &new );
+	read_ranges ( argv[2] );
+
+	if ( orphan_file ) {
+	    orphan_fp = fopen ( orphan_file, "w" );
+	    if ( ! orphan_fp ) {
+		printf ( "Cannot open %s\n", orphan_file );
+		exit ( 1 );
+	    }
+	}
+
+	patch ();
+
+	if ( orphan_fp )
+	    fclose ( orphan_fp );
+	if ( norphans )
+	    fprintf ( stderr, "lxpatch: %d orphans\n", norphans );
+	return 0;
+}
+
+/* THE END */
@@ -0,0 +1,186 @@
+/* lxref.c
+ * One of my ESP8266 reverse engineering tools
+ *
+ * Answer questions from the cross reference file lxdis writes
+ *  (lxdis -x xrefs all)
+ *
+ *  lxref xrefs 4000042c	- what refers to 4000042c
+ *  lxref xrefs _start		- what refers to _start
+ *  lxref -f xrefs 40000149	- what the instruction at 40000149 refers to
+ *  lxref -c calls.sy xrefs	- call targets that calls.sy doesn't know,
+ *				  in .sy form (what call_check did).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xref.h"
+
+static void
+show ( struct xref *xp )
+{
+	printf ( "%c %08x %08x ", xp->type, xp->from, xp->to );
+	if ( xp->type == XR_L32R )
+	    printf ( "%08x", xp->val );
+	else
+	    printf ( "-" );
+	printf ( " %s\n", xp->name ? xp->name : "-" );
+}
+
+/* A hex address (with or without 0x) or a name */
+static int
+lookup ( char *arg, unsigned int *addr )
+{
+	char *end;
+	int i;
+
+	*addr = strtoul ( arg, &end, 16 );
+	if ( *end == '\0' )
+	    return 1;
+
+	for ( i=0; i<xrefs.count; i++ ) {
+	    if ( xrefs.list[i].name && strcmp ( xrefs.list[i].name, arg ) == 0 ) {
+		*addr = xrefs.list[i].to;
+		return 1;
+	    }
+	}
+	return 0;
+}
+
+static void
+refs_to ( char *arg )
+{
+	unsigned int addr;
+	int first;
+	int i, n;
+
+	if ( ! lookup ( arg, &addr ) ) {
+	    printf ( "Sorry, no such symbol: %s\n", arg );
+	    return;
+	}
+
+	n = xref_to ( addr, &first );
+	for ( i=0; i<n; i++ )
+	    show ( &xrefs.list[first+i] );
+}
+
+static void
+refs_from ( char *arg )
+{
+	unsigned int addr;
+	int first;
+	int i, n;
+
+	addr = strtoul ( arg, NULL, 16 );
+	n = xref_from ( addr, &first );
+	for ( i=0; i<n; i++ )
+	    show ( &xrefs.list[xrefs.from[first+i]] );
+}
+
+static int
+sy_compare ( const void *a, const void *b )
+{
+	unsigned int aa = *(const unsigned int *) a;
+	unsigned int bb = *(const unsigned int *) b;
+
+	return aa < bb ? -1 : aa > bb;
+}
+
+/* Call targets in the rom that are not in the .sy file */
+static void
+new_calls ( char *sy_file )
+{
+	FILE *fp;
+	char line[256];
+	unsigned int *known = NULL;
+	int nknown = 0;
+	int max = 0;
+	unsigned int addr;
+	unsigned int last;
+	struct xref *xp;
+	int i;
+
+	fp = fopen ( sy_file, "r" );
+	if ( ! fp ) {
+	    printf ( "Cannot open %s\n", sy_file );
+	    exit ( 1 );
+	}
+	while ( fgets ( line, sizeof(line), fp ) ) {
+	    if ( sscanf ( line, "%x", &addr ) != 1 )
+		continue;
+	    if ( nknown >= max ) {
+		max = max ? max * 2 : 1024;
+		known = realloc ( known, max * sizeof(unsigned int) );
+	    }
+	    known[nknown++] = addr;
+	}
+	fclose ( fp );
+	qsort ( known, nknown, sizeof(unsigned int), sy_compare );
+
+	/* the list is sorted by target, so each one comes up once */
+	last = 0;
+	for ( i=0; i<xrefs.count; i++ ) {
+	    xp = &xrefs.list[i];
+	    if ( xp->type != XR_CALL || xp->to == last )
+		continue;
+	    last = xp->to;
+	    if ( (xp->to >> 16) != 0x4000 )
+		continue;
+	    if ( bsearch ( &xp->to, known, nknown, sizeof(unsigned int), sy_compare ) )
+		continue;
+	    printf ( "%08x sub_%x\n", xp->to, xp->to & 0xffff );
+	}
+}
+
+static void
+usage ( void )
+{
+	printf ( "Usage: lxref xrefs addr|name ...\n" );
+	printf ( "       lxref -f xrefs addr ...\n" );
+	printf ( "       lxref -c symfile xrefs\n" );
+	exit ( 1 );
+}
+
+int
+main ( int argc, char **argv )
+{
+	int from = 0;
+	char *sy_file = NULL;
+	int i;
+
+	argc--;
+	++argv;
+	while ( argc > 0 && argv[0][0] == '-' ) {
+	    if ( argv[0][1] == 'f' )
+		from = 1;
+	    else if ( argv[0][1] == 'c' && argc > 1 ) {
+		sy_file = argv[1];
+		argc--;
+		++argv;
+	    } else
+		usage ();
+	    argc--;
+	    ++argv;
+	}
+
+	if ( argc < 1 )
+	    usage ();
+
+	xref_read ( argv[0] );
+
+	if ( sy_file ) {
+	    new_calls ( sy_file );
+	    return 0;
+	}
+
+	for ( i=1; i<argc; i++ ) {
+	    if ( from )
+		refs_from ( argv[i] );
+	    else
+		refs_to ( argv[i] );
+	}
+
+	return 0;
+}
+
+/* THE END */
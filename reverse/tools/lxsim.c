@@ -0,0 +1,2357 @@
+/* lxsim.c
+ * One of my ESP8266 reverse engineering tools
+ *
+ * An instruction set simulator for the lx106, so we can find out
+ * what a piece of code costs without putting it on a board.
+ * It uses the same decoder as lxdis (lx106.c), and the same image
+ * handling (image.c), so it runs the real bootrom.bin and our own
+ * code, either as an ELF file or as the two .bin images.
+ *
+ * The lx106 is the "call0" Xtensa: no register windows, no
+ * zero overhead loops, no divide, no floating point.  We do the
+ * core instructions, the density (.n) ones, the multiplies, and
+ * the special registers the ROM and the SDK use.  Anything else
+ * stops the simulation and says where.
+ *
+ * Besides the cpu we have:
+ *  - ccount and ccompare0 (interrupt 6)
+ *  - the FRC1 timer at 0x60000600 (interrupt 9, edge or level)
+ *  - GPIO 0 to 15 at 0x60000300, with inputs played from a
+ *    file (-g) and every change of a pin written out (-G)
+ *  - the UART 0 and 1 fifos, what goes there we print
+ *  - level 1 interrupts, through vecbase just like the chip,
+ *    so with the ROM at 0x40000000 they go through its vector
+ *    and _xtos_l1int_handler to what ets_isr_attach set up.
+ * Other peripheral registers just hold what was written.
+ * GPIO interrupts and the NMI are not there.
+ *
+ * The timing model.  Every instruction is one cycle, then:
+ *  - a taken branch, a jump, call or return costs 2 more,
+ *    the pipeline has to refill from the new address.
+ *  - a load whose result the next instruction uses costs 1 more.
+ *  - anything in flash goes through the cache (32K, direct
+ *    mapped, 32 byte lines), a miss costs -m cycles (80).
+ *  - a peripheral register costs -w cycles more (4).
+ *  - taking an interrupt costs 3.
+ *  - waiti sleeps until the next interrupt.
+ * The first two are what the 5 stage Xtensa pipeline does,
+ * the flash and peripheral costs are guesses that -m and -w
+ * let you set to what a board shows.  Either way the count is
+ * the same every run, so a change in the code shows up.
+ *
+ * We don't run the boot code (the ROM or the SDK startup), but
+ * we do the two things from it that the rest of the ROM needs:
+ * copy the ROM data to dram (from _rom_store_table, this is the
+ * exception table and the interrupt masks) and set the cpu
+ * frequency (80 at 0x3fffc704, for ets_delay_us).
+ *
+ * Every cycle goes to the function it was spent in (the symbol
+ * at or before pc), and to every function on the call stack for
+ * the "total" column.  We count calls, cache misses, and how
+ * many of each instruction (the same mnemonics as opcodes.freq).
+ *
+ *  lxsim -e dht_tt -g dht.wave -c "dht_sensor 12 =4 =4"
+ *  lxsim -aprod -c "user_init"
+ *  lxsim -e pulses -W 0x60000608=0xc4 -W 0x60000600=500
+ *	-c "ets_isr_attach 9 pulse 0" -c "ets_isr_unmask 0x200" -c "ets_delay_us 1000"
+ *
+ * Options:
+ *  -r file		- the ROM (bootrom.bin if there is one here)
+ *  -e file		- an ELF file
+ *  -a app		- app-0x00000.bin and app-0x40000.bin
+ *  -s file		- more symbols (.sy or PROVIDE lines), we read syms if it is here
+ *  -c "func args"	- call func (as many as you like, one after the other)
+ *			  an argument is a number, a symbol, or =N for a
+ *			  pointer to N bytes of zeros (shown after the call)
+ *  -l cycles		- give up on a call after this many (1000000000)
+ *  -W addr=val		- write a word before we start (as many as you like)
+ *  -g file		- gpio inputs, see load_wave() below
+ *  -G file		- write "cycle gpio level" for each change of a pin
+ *  -m			- instruction mix of each function
+ *  -f file		- the whole instruction mix, in the form of opcodes.freq
+ *  -n count		- functions to list (20)
+ *  -b func=cycles	- exit 1 if a call of func takes more than this
+ *  -M cycles		- cost of a flash cache miss
+ *  -w cycles		- cost of a peripheral register
+ *  -q			- don't print what goes to the uart
+ *  -t			- trace every instruction
+ * With no -c we start at the entry point (or the ROM reset vector).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "image.h"
+#include "lx106.h"
+
+#define ROM_BINFILE	"bootrom.bin"
+#define SYM_FILE	"syms"
+
+#define RESET_VECTOR	0x400000a4
+#define CLOCK_MHZ	80
+
+/* a0 for the calls we make, there is nothing at this address */
+#define HALT_ADDR	0x400ffffc
+
+#define STACK_TOP	0x3ffffff0
+#define SCRATCH_BASE	0x3fffe000
+
+/* The ROM copies its data to dram from this table,
+ * then the cpu frequency gets set.
+ */
+#define ROM_STORE_TABLE	0x4000e328
+#define ROM_CPU_FREQ	0x3fffc704
+
+#define NEVER		(~0ULL)
+
+static void *
+xrealloc ( void *p, int size )
+{
+	p = realloc ( p, size );
+	if ( ! p ) {
+	    printf ( "Out of memory\n" );
+	    exit ( 1 );
+	}
+	return p;
+}
+
+/* ------------------------------------------------------------ */
+/* Memory, in 64K pages */
+
+enum mtype { M_NONE, M_DRAM, M_IRAM, M_ROM, M_FLASH, M_IO };
+
+#define NPAGES		0x10000
+#define PAGE_SIZE	0x10000
+
+static unsigned char *page[NPAGES];
+static unsigned int page_avail[NPAGES];	/* bytes to the end of the region */
+static char page_type[NPAGES];
+
+struct region {
+	unsigned int addr;
+	unsigned int size;
+	int type;
+};
+
+/* dram is really 0x3ffe8000 and up */
+static struct region regions[] = {
+	{ 0x3ffe0000, 0x20000, M_DRAM },
+	{ 0x3ff00000, 0x10000, M_IO },
+	{ 0x40100000, 0x10000, M_IRAM },
+	{ 0x40200000, 0x100000, M_FLASH },
+	{ 0x60000000, 0x10000, M_IO },
+	{ 0, 0, 0 }
+};
+
+static void
+add_region ( unsigned int addr, unsigned int size, int type )
+{
+	unsigned char *mem;
+	unsigned int off;
+
+	mem = calloc ( size, 1 );
+	if ( ! mem ) {
+	    printf ( "Out of memory\n" );
+	    exit ( 1 );
+	}
+	for ( off=0; off<size; off += PAGE_SIZE ) {
+	    page[(addr + off) >> 16] = &mem[off];
+	    page_avail[(addr + off) >> 16] = size - off;
+	    page_type[(addr + off) >> 16] = type;
+	}
+}
+
+/* Copy what image.c loaded into our memory */
+static void
+load_memory ( int have_rom )
+{
+	struct region *rp;
+	struct segment *sp;
+	unsigned int pg;
+	unsigned int off;
+	int i;
+
+	for ( rp = regions; rp->size; rp++ )
+	    add_region ( rp->addr, rp->size, rp->type );
+	if ( have_rom )
+	    add_region ( ROM_BASE, PAGE_SIZE, M_ROM );
+
+	for ( i=0; i<segments.count; i++ ) {
+	    sp = &segments.seg[i];
+	    pg = sp->addr >> 16;
+	    off = sp->addr & (PAGE_SIZE - 1);
+	    if ( page_type[pg] == M_NONE || page_type[pg] == M_IO || sp->size > page_avail[pg] - off ) {
+		printf ( "%s: %08x .. %08x is not memory we have\n", sp->filename,
+			sp->addr, sp->addr + sp->size - 1 );
+		exit ( 1 );
+	    }
+	    memcpy ( &page[pg][off], sp->data, sp->size );
+	}
+}
+
+/* Each entry is start, end, and where it comes from in the ROM,
+ * all zeros is the end.
+ */
+static void
+rom_store ( void )
+{
+	unsigned int *tp;
+	unsigned int start, end, from;
+
+	for ( tp = (unsigned int *) &page[ROM_BASE >> 16][ROM_STORE_TABLE & 0xffff]; tp[0]; tp += 3 ) {
+	    start = tp[0];
+	    end = tp[1];
+	    from = tp[2];
+	    if ( end <= start )
+		continue;
+	    if ( page_type[start >> 16] != M_DRAM || (from >> 16) != (ROM_BASE >> 16) ) {
+		printf ( "The ROM store table is not what we expect, is this the right ROM?\n" );
+		exit ( 1 );
+	    }
+	    memcpy ( &page[start >> 16][start & 0xffff], &page[from >> 16][from & 0xffff], end - start );
+	}
+}
+
+/* ------------------------------------------------------------ */
+/* Symbols and functions */
+
+struct func {
+	unsigned int addr;
+	char *name;
+	unsigned long long self;	/* cycles spent right here */
+	unsigned long long total;	/* and in everything it called */
+	unsigned long long insns;
+	unsigned long long misses;
+	unsigned long calls;
+	int active;			/* times it is on the call stack */
+	unsigned int *mix;		/* count of each mnemonic */
+	int order;			/* as loaded, the first one wins */
+};
+
+struct func *funcs;
+int nfuncs;
+int max_funcs;
+
+/* Only code counts */
+static int
+is_text ( unsigned int addr )
+{
+	return addr >= ROM_BASE && addr < 0x40300000;
+}
+
+static void
+add_func ( unsigned int addr, char *name )
+{
+	if ( ! is_text ( addr ) )
+	    return;
+	if ( nfuncs >= max_funcs ) {
+	    max_funcs = max_funcs ? max_funcs * 2 : 1024;
+	    funcs = xrealloc ( funcs, max_funcs * sizeof(struct func) );
+	}
+	memset ( &funcs[nfuncs], 0, sizeof(struct func) );
+	funcs[nfuncs].addr = addr;
+	funcs[nfuncs].name = strdup ( name );
+	funcs[nfuncs].order = nfuncs;
+	nfuncs++;
+}
+
+/* Functions, and the absolute ones the ROM provides,
+ * not every label the linker script made.
+ */
+static void
+elf_sym ( unsigned int addr, unsigned int size, int type, char *name )
+{
+	if ( type == 2 || addr < TEXT_BASE )	/* STT_FUNC */
+	    add_func ( addr, name );
+}
+
+/* The same two formats lxdis takes */
+static void
+load_syms ( char *file, int must )
+{
+	FILE *fp;
+	char line[256];
+	char w[5][64];
+	int nw;
+
+	fp = fopen ( file, "r" );
+	if ( ! fp ) {
+	    if ( must ) {
+		printf ( "Cannot open %s\n", file );
+		exit ( 1 );
+	    }
+	    return;
+	}
+
+	while ( fgets ( line, sizeof(line), fp ) ) {
+	    if ( strncmp ( line, "PROVIDE", 7 ) == 0 ) {
+		nw = sscanf ( line, "%63s %63s %63s %63s %63s", w[0], w[1], w[2], w[3], w[4] );
+		if ( nw == 5 )
+		    add_func ( strtoul ( w[4], NULL, 16 ), w[2] );
+		continue;
+	    }
+	    if ( line[0] == '#' || line[0] == ';' )
+		continue;
+	    nw = sscanf ( line, "%63s %63s", w[0], w[1] );
+	    if ( nw < 2 || strspn ( w[0], "0123456789abcdefABCDEFx" ) != strlen ( w[0] ) )
+		continue;
+	    add_func ( strtoul ( w[0], NULL, 16 ), w[1] );
+	}
+
+	fclose ( fp );
+}
+
+static int
+func_compare ( const void *a, const void *b )
+{
+	const struct func *fa = a;
+	const struct func *fb = b;
+
+	if ( fa->addr != fb->addr )
+	    return fa->addr < fb->addr ? -1 : 1;
+	return fa->order - fb->order;
+}
+
+/* Sorted by address, one per address.  funcs[0] is for
+ * code before the first symbol.
+ */
+static void
+finish_funcs ( void )
+{
+	int i, n;
+
+	add_func ( ROM_BASE, "(no symbol)" );
+	funcs[nfuncs-1].addr = 0;
+	qsort ( funcs, nfuncs, sizeof(struct func), func_compare );
+
+	n = 0;
+	for ( i=0; i<nfuncs; i++ ) {
+	    if ( n && funcs[i].addr == funcs[n-1].addr ) {
+		free ( funcs[i].name );
+		continue;
+	    }
+	    funcs[n++] = funcs[i];
+	}
+	nfuncs = n;
+}
+
+/* The last one at or before addr */
+static int
+func_at ( unsigned int addr )
+{
+	int lo, hi, mid;
+
+	lo = 0;
+	hi = nfuncs - 1;
+	while ( lo < hi ) {
+	    mid = (lo + hi + 1) / 2;
+	    if ( funcs[mid].addr <= addr )
+		lo = mid;
+	    else
+		hi = mid - 1;
+	}
+	return lo;
+}
+
+static int
+find_func ( char *name, unsigned int *addr )
+{
+	int i;
+
+	for ( i=1; i<nfuncs; i++ ) {
+	    if ( strcmp ( funcs[i].name, name ) == 0 ) {
+		*addr = funcs[i].addr;
+		return 1;
+	    }
+	}
+	return 0;
+}
+
+/* ------------------------------------------------------------ */
+/* What we run: each decoded instruction boiled down */
+
+enum kind {
+	K_NONE,		/* not decoded yet */
+	K_BAD,		/* can't decode it */
+	K_UNIMP,	/* not on the lx106, or not here */
+	K_ILL, K_BREAK, K_SYSCALL,
+	K_NOP,
+	K_ADD, K_ADDX2, K_ADDX4, K_ADDX8,
+	K_SUB, K_SUBX2, K_SUBX4, K_SUBX8,
+	K_AND, K_OR, K_XOR, K_NEG, K_ABS,
+	K_MIN, K_MAX, K_MINU, K_MAXU,
+	K_MOVEQZ, K_MOVNEZ, K_MOVLTZ, K_MOVGEZ,
+	K_SEXT, K_CLAMPS, K_NSA, K_NSAU,
+	K_MUL16U, K_MUL16S, K_MULL, K_MULUH, K_MULSH,
+	K_SSR, K_SSL, K_SSA8L, K_SSA8B, K_SSAI,
+	K_SRC, K_SRL, K_SLL, K_SRA,
+	K_SLLI, K_SRAI, K_SRLI, K_EXTUI,
+	K_RSR, K_WSR, K_XSR, K_RSIL, K_WAITI,
+	K_RFE, K_RFI,
+	K_L32R, K_L8UI, K_L16UI, K_L16SI, K_L32I,
+	K_S8I, K_S16I, K_S32I, K_S32C1I,
+	K_MOVI, K_ADDI, K_MOV,
+	K_MOVI_N, K_ADD_N, K_ADDI_N,
+	K_CALL0, K_CALLX0, K_J, K_JX, K_RET,
+	K_BEQZ, K_BNEZ, K_BLTZ, K_BGEZ,
+	K_BEQI, K_BNEI, K_BLTI, K_BGEI, K_BLTUI, K_BGEUI,
+	K_BNONE, K_BEQ, K_BLT, K_BLTU, K_BALL, K_BBC,
+	K_BANY, K_BNE, K_BGE, K_BGEU, K_BNALL, K_BBS,
+	K_BBCI, K_BBSI,
+};
+
+/* Registers an instruction reads, by field */
+#define U_R	0x01
+#define U_S	0x02
+#define U_T	0x04
+#define U_A0	0x08
+#define U_LOAD	0x10	/* at is a load result */
+
+struct xop {
+	char *name;
+	int kind;
+	int uses;
+};
+
+static struct xop xops[] = {
+	{ "ill",	K_ILL },
+	{ "ill.n",	K_ILL },
+	{ "break",	K_BREAK },
+	{ "break.n",	K_BREAK },
+	{ "syscall",	K_SYSCALL },
+	{ "nop",	K_NOP },
+	{ "nop.n",	K_NOP },
+	{ "memw",	K_NOP },
+	{ "isync",	K_NOP },
+	{ "rsync",	K_NOP },
+	{ "esync",	K_NOP },
+	{ "dsync",	K_NOP },
+	{ "extw",	K_NOP },
+	{ "excw",	K_NOP },
+
+	{ "add",	K_ADD,	 U_S | U_T },
+	{ "add.n",	K_ADD_N, U_S | U_T },
+	{ "addx2",	K_ADDX2, U_S | U_T },
+	{ "addx4",	K_ADDX4, U_S | U_T },
+	{ "addx8",	K_ADDX8, U_S | U_T },
+	{ "sub",	K_SUB,	 U_S | U_T },
+	{ "subx2",	K_SUBX2, U_S | U_T },
+	{ "subx4",	K_SUBX4, U_S | U_T },
+	{ "subx8",	K_SUBX8, U_S | U_T },
+	{ "and",	K_AND,	 U_S | U_T },
+	{ "or",		K_OR,	 U_S | U_T },
+	{ "xor",	K_XOR,	 U_S | U_T },
+	{ "neg",	K_NEG,	 U_T },
+	{ "abs",	K_ABS,	 U_T },
+	{ "min",	K_MIN,	 U_S | U_T },
+	{ "max",	K_MAX,	 U_S | U_T },
+	{ "minu",	K_MINU,	 U_S | U_T },
+	{ "maxu",	K_MAXU,	 U_S | U_T },
+	{ "moveqz",	K_MOVEQZ, U_R | U_S | U_T },
+	{ "movnez",	K_MOVNEZ, U_R | U_S | U_T },
+	{ "movltz",	K_MOVLTZ, U_R | U_S | U_T },
+	{ "movgez",	K_MOVGEZ, U_R | U_S | U_T },
+	{ "sext",	K_SEXT,	 U_S },
+	{ "clamps",	K_CLAMPS, U_S },
+	{ "nsa",	K_NSA,	 U_S },
+	{ "nsau",	K_NSAU,	 U_S },
+	{ "mul16u",	K_MUL16U, U_S | U_T },
+	{ "mul16s",	K_MUL16S, U_S | U_T },
+	{ "mull",	K_MULL,	 U_S | U_T },
+	{ "muluh",	K_MULUH, U_S | U_T },
+	{ "mulsh",	K_MULSH, U_S | U_T },
+
+	{ "ssr",	K_SSR,	 U_S },
+	{ "ssl",	K_SSL,	 U_S },
+	{ "ssa8l",	K_SSA8L, U_S },
+	{ "ssa8b",	K_SSA8B, U_S },
+	{ "ssai",	K_SSAI },
+	{ "src",	K_SRC,	 U_S | U_T },
+	{ "srl",	K_SRL,	 U_T },
+	{ "sll",	K_SLL,	 U_S },
+	{ "sra",	K_SRA,	 U_T },
+	{ "slli",	K_SLLI,	 U_S },
+	{ "srai",	K_SRAI,	 U_T },
+	{ "srli",	K_SRLI,	 U_T },
+	{ "extui",	K_EXTUI, U_T },
+
+	{ "rsr",	K_RSR },
+	{ "wsr",	K_WSR,	 U_T },
+	{ "xsr",	K_XSR,	 U_T },
+	{ "rsil",	K_RSIL },
+	{ "waiti",	K_WAITI },
+	{ "rfe",	K_RFE },
+	{ "rfi",	K_RFI },
+
+	{ "l32r",	K_L32R,	 U_LOAD },
+	{ "l8ui",	K_L8UI,	 U_S | U_LOAD },
+	{ "l16ui",	K_L16UI, U_S | U_LOAD },
+	{ "l16si",	K_L16SI, U_S | U_LOAD },
+	{ "l32i",	K_L32I,	 U_S | U_LOAD },
+	{ "l32ai",	K_L32I,	 U_S | U_LOAD },
+	{ "l32i.n",	K_L32I,	 U_S | U_LOAD },
+	{ "s8i",	K_S8I,	 U_S | U_T },
+	{ "s16i",	K_S16I,	 U_S | U_T },
+	{ "s32i",	K_S32I,	 U_S | U_T },
+	{ "s32ri",	K_S32I,	 U_S | U_T },
+	{ "s32i.n",	K_S32I,	 U_S | U_T },
+	{ "s32c1i",	K_S32C1I, U_S | U_T | U_LOAD },
+
+	{ "movi",	K_MOVI },
+	{ "movi.n",	K_MOVI_N },
+	{ "addi",	K_ADDI,	 U_S },
+	{ "addmi",	K_ADDI,	 U_S },
+	{ "addi.n",	K_ADDI_N, U_S },
+	{ "mov.n",	K_MOV,	 U_S },
+
+	{ "call0",	K_CALL0 },
+	{ "callx0",	K_CALLX0, U_S },
+	{ "j",		K_J },
+	{ "jx",		K_JX,	 U_S },
+	{ "ret",	K_RET,	 U_A0 },
+	{ "ret.n",	K_RET,	 U_A0 },
+
+	{ "beqz",	K_BEQZ,	 U_S },
+	{ "beqz.n",	K_BEQZ,	 U_S },
+	{ "bnez",	K_BNEZ,	 U_S },
+	{ "bnez.n",	K_BNEZ,	 U_S },
+	{ "bltz",	K_BLTZ,	 U_S },
+	{ "bgez",	K_BGEZ,	 U_S },
+	{ "beqi",	K_BEQI,	 U_S },
+	{ "bnei",	K_BNEI,	 U_S },
+	{ "blti",	K_BLTI,	 U_S },
+	{ "bgei",	K_BGEI,	 U_S },
+	{ "bltui",	K_BLTUI, U_S },
+	{ "bgeui",	K_BGEUI, U_S },
+	{ "bnone",	K_BNONE, U_S | U_T },
+	{ "beq",	K_BEQ,	 U_S | U_T },
+	{ "blt",	K_BLT,	 U_S | U_T },
+	{ "bltu",	K_BLTU,	 U_S | U_T },
+	{ "ball",	K_BALL,	 U_S | U_T },
+	{ "bbc",	K_BBC,	 U_S | U_T },
+	{ "bany",	K_BANY,	 U_S | U_T },
+	{ "bne",	K_BNE,	 U_S | U_T },
+	{ "bge",	K_BGE,	 U_S | U_T },
+	{ "bgeu",	K_BGEU,	 U_S | U_T },
+	{ "bnall",	K_BNALL, U_S | U_T },
+	{ "bbs",	K_BBS,	 U_S | U_T },
+	{ "bbci",	K_BBCI,	 U_S },
+	{ "bbsi",	K_BBSI,	 U_S },
+	{ NULL }
+};
+
+/* One of these for every byte of code we have run */
+struct dinsn {
+	unsigned char kind;
+	unsigned char size;
+	unsigned char r, s, t;
+	unsigned char load;		/* register a load writes, plus 1 */
+	unsigned short uses;		/* registers it reads */
+	unsigned short mnem;		/* for the mix */
+	int imm;
+	unsigned int target;		/* or the extui mask */
+	int func;
+};
+
+static struct dinsn *dcache[NPAGES];
+
+/* Mnemonics as the decoder gives them, rsr.ccount and such */
+#define MAX_MNEM	256
+
+static char *mnems[MAX_MNEM];
+static int nmnems;
+
+static int
+mnem_index ( char *name )
+{
+	int i;
+
+	for ( i=0; i<nmnems; i++ )
+	    if ( strcmp ( mnems[i], name ) == 0 )
+		return i;
+	if ( nmnems >= MAX_MNEM ) {
+	    printf ( "Too many mnemonics\n" );
+	    exit ( 1 );
+	}
+	mnems[nmnems] = strdup ( name );
+	return nmnems++;
+}
+
+static struct xop *
+find_xop ( char *name )
+{
+	struct xop *xp;
+	char base[8];
+
+	/* rsr.ccount is rsr */
+	if ( name[3] == '.' && (name[0] == 'r' || name[0] == 'w' || name[0] == 'x') && name[1] == 's' ) {
+	    memcpy ( base, name, 3 );
+	    base[3] = '\0';
+	    name = base;
+	}
+
+	for ( xp = xops; xp->name; xp++ )
+	    if ( strcmp ( xp->name, name ) == 0 )
+		return xp;
+	return NULL;
+}
+
+static void
+predecode ( unsigned int pc, struct dinsn *dp )
+{
+	struct lx_insn i;
+	struct xop *xp;
+	unsigned int pg = pc >> 16;
+	unsigned int off = pc & (PAGE_SIZE - 1);
+	int uses;
+
+	lx_decode ( &page[pg][off], page_avail[pg] - off, pc, &i );
+
+	dp->size = i.size;
+	dp->r = i.r;
+	dp->s = i.s;
+	dp->t = i.t;
+	dp->imm = i.imm;
+	dp->target = i.target;
+	dp->load = 0;
+	dp->uses = 0;
+	dp->mnem = mnem_index ( i.name );
+	dp->func = func_at ( pc );
+	if ( ! funcs[dp->func].mix )
+	    funcs[dp->func].mix = calloc ( MAX_MNEM, sizeof(unsigned int) );
+
+	if ( i.op < 0 ) {
+	    dp->kind = K_BAD;
+	    return;
+	}
+
+	xp = find_xop ( i.name );
+	if ( ! xp ) {
+	    dp->kind = K_UNIMP;
+	    return;
+	}
+	dp->kind = xp->kind;
+
+	/* these put the result somewhere else */
+	if ( dp->kind == K_MOVI_N || dp->kind == K_ADDI_N )
+	    dp->r = dp->kind == K_ADDI_N ? i.r : i.s;
+	if ( dp->kind == K_EXTUI )
+	    dp->target = (2u << ((i.word >> 20) & 0xf)) - 1;
+
+	uses = 0;
+	if ( xp->uses & U_R )
+	    uses |= 1 << i.r;
+	if ( xp->uses & U_S )
+	    uses |= 1 << i.s;
+	if ( xp->uses & U_T )
+	    uses |= 1 << i.t;
+	if ( xp->uses & U_A0 )
+	    uses |= 1;
+	dp->uses = uses;
+	if ( xp->uses & U_LOAD )
+	    dp->load = i.t + 1;
+}
+
+/* A store into iram might change code we decoded */
+static void
+code_changed ( unsigned int addr, int size )
+{
+	struct dinsn *dc = dcache[addr >> 16];
+	int off = addr & (PAGE_SIZE - 1);
+	int i;
+
+	for ( i = off - 2; i < off + size; i++ )
+	    if ( i >= 0 && i < PAGE_SIZE )
+		dc[i].kind = K_NONE;
+}
+
+/* ------------------------------------------------------------ */
+/* The cpu */
+
+/* special registers */
+#define SR_SCOMPARE1	12
+#define SR_SAR		3
+#define SR_EPC1		177
+#define SR_EPS2		194
+#define SR_INTERRUPT	226	/* intset when written */
+#define SR_INTCLEAR	227
+#define SR_INTENABLE	228
+#define SR_PS		230
+#define SR_VECBASE	231
+#define SR_EXCCAUSE	232
+#define SR_CCOUNT	234
+#define SR_CCOMPARE0	240
+
+#define PS_INTLEVEL	0x0f
+#define PS_EXCM		0x10
+#define PS_UM		0x20
+
+#define INT_CCOMPARE0	6
+#define INT_FRC1	9
+#define INT_NMI		14
+
+#define EXC_LEVEL1	4
+
+struct cpu {
+	unsigned int a[16];
+	unsigned int pc;
+	unsigned int sr[256];
+	unsigned long long cycles;
+	unsigned int ccount_adj;	/* ccount is cycles + this */
+	int extra;			/* cycles the memory system added */
+	int stall;			/* cycles to charge the next instruction */
+	int irq_check;			/* something that matters to interrupts changed */
+	int stop;
+	char why[128];
+} cpu;
+
+enum stop { S_RUN, S_RETURN, S_LIMIT, S_FAULT };
+
+static int miss_cost = 80;
+static int io_cost = 4;
+static int quiet;
+static int tracing;
+
+static unsigned long long limit = NEVER;
+static unsigned long long next_event = NEVER;
+static unsigned long long wave_next = NEVER;
+
+static unsigned long long interrupts;
+static unsigned long long irq_cycles;
+static unsigned long long misses;
+
+static void
+fault ( char *msg, unsigned int addr )
+{
+	if ( cpu.stop )
+	    return;
+	cpu.stop = S_FAULT;
+	snprintf ( cpu.why, sizeof(cpu.why), msg, addr );
+}
+
+/* ------------------------------------------------------------ */
+/* The flash cache */
+
+#define CACHE_LINE	32
+#define CACHE_LINES	(32768 / CACHE_LINE)
+
+static unsigned int cache_tag[CACHE_LINES];	/* line number + 1 */
+
+static void
+cache ( unsigned int addr, int size )
+{
+	unsigned int line;
+	unsigned int last = (addr + size - 1) / CACHE_LINE;
+
+	for ( line = addr / CACHE_LINE; line <= last; line++ ) {
+	    if ( cache_tag[line & (CACHE_LINES-1)] == line + 1 )
+		continue;
+	    cache_tag[line & (CACHE_LINES-1)] = line + 1;
+	    cpu.extra += miss_cost;
+	    misses++;
+	    funcs[func_at ( cpu.pc )].misses++;
+	}
+}
+
+/* ------------------------------------------------------------ */
+/* Peripherals */
+
+#define UART0_FIFO	0x60000000
+#define UART1_FIFO	0x60000f00
+
+#define GPIO_OUT	0x60000300
+#define GPIO_OUT_W1TS	0x60000304
+#define GPIO_OUT_W1TC	0x60000308
+#define GPIO_ENABLE	0x6000030c
+#define GPIO_ENABLE_W1TS 0x60000310
+#define GPIO_ENABLE_W1TC 0x60000314
+#define GPIO_IN		0x60000318
+
+#define FRC1_LOAD	0x60000600
+#define FRC1_COUNT	0x60000604
+#define FRC1_CTRL	0x60000608
+#define FRC1_INT	0x6000060c
+
+#define DPORT_EDGE_INT	0x3ff00004	/* bit 1 is the FRC1 edge interrupt */
+
+#define FRC1_ENABLE	0x80
+#define FRC1_AUTOLOAD	0x40
+#define FRC1_LEVEL	0x01
+
+static unsigned int gpio_out;
+static unsigned int gpio_enable;
+static unsigned int gpio_wave = 0xffff;	/* what drives the inputs, pulled up */
+static unsigned int gpio_last;
+static FILE *gpio_trace;
+
+static unsigned int frc1_load;
+static unsigned int frc1_ctrl;
+static unsigned int frc1_count;		/* when stopped */
+static unsigned long long frc1_start;
+static unsigned long long frc1_next = NEVER;
+
+static unsigned long long ccmp_next = NEVER;
+
+static void wave_poke ( void );
+static void wave_run ( void );
+static void schedule ( void );
+
+static unsigned int
+io_reg ( unsigned int addr )
+{
+	unsigned int val;
+
+	memcpy ( &val, &page[addr >> 16][addr & 0xfffc], 4 );
+	return val;
+}
+
+static unsigned int
+gpio_in ( void )
+{
+	return ((gpio_out & gpio_enable) | (gpio_wave & ~gpio_enable)) & 0xffff;
+}
+
+/* Called after anything that might move a pin */
+static void
+gpio_changed ( void )
+{
+	unsigned int in = gpio_in ();
+	unsigned int diff = in ^ gpio_last;
+	int i;
+
+	gpio_last = in;
+	if ( gpio_trace && diff ) {
+	    for ( i=0; i<16; i++ )
+		if ( diff & (1 << i) )
+		    fprintf ( gpio_trace, "%llu %d %d\n", cpu.cycles, i, (in >> i) & 1 );
+	}
+	wave_poke ();
+}
+
+static int
+frc1_div ( void )
+{
+	static int div[] = { 1, 16, 256, 256 };
+
+	return div[(frc1_ctrl >> 2) & 3];
+}
+
+static void
+frc1_schedule ( void )
+{
+	if ( (frc1_ctrl & FRC1_ENABLE) && frc1_load )
+	    frc1_next = frc1_start + (unsigned long long) frc1_load * frc1_div ();
+	else
+	    frc1_next = NEVER;
+	schedule ();
+}
+
+static unsigned int
+frc1_read_count ( void )
+{
+	unsigned long long ticks;
+
+	if ( frc1_next == NEVER )
+	    return frc1_count;
+	ticks = (cpu.cycles - frc1_start) / frc1_div ();
+	return frc1_load - ticks;
+}
+
+static void
+frc1_fire ( void )
+{
+	if ( (frc1_ctrl & FRC1_LEVEL) || (io_reg ( DPORT_EDGE_INT ) & 2) ) {
+	    cpu.sr[SR_INTERRUPT] |= 1 << INT_FRC1;
+	    cpu.irq_check = 1;
+	}
+	if ( frc1_ctrl & FRC1_AUTOLOAD ) {
+	    frc1_start = frc1_next;
+	} else {
+	    frc1_count = 0;
+	    frc1_ctrl &= ~FRC1_ENABLE;
+	}
+	frc1_schedule ();
+}
+
+static unsigned int
+io_read ( unsigned int addr )
+{
+	cpu.extra += io_cost;
+
+	switch ( addr & ~3 ) {
+	    case GPIO_OUT:
+		return gpio_out;
+	    case GPIO_ENABLE:
+		return gpio_enable;
+	    case GPIO_IN:
+		return gpio_in ();
+	    case FRC1_LOAD:
+		return frc1_load;
+	    case FRC1_COUNT:
+		return frc1_read_count ();
+	    case FRC1_CTRL:
+		return frc1_ctrl;
+	}
+	return io_reg ( addr );
+}
+
+static void
+io_write ( unsigned int addr, unsigned int val )
+{
+	cpu.extra += io_cost;
+
+	switch ( addr & ~3 ) {
+	    case UART0_FIFO:
+	    case UART1_FIFO:
+		if ( ! quiet ) {
+		    putchar ( val & 0xff );
+		    fflush ( stdout );
+		}
+		return;
+	    case GPIO_OUT:
+		gpio_out = val;
+		gpio_changed ();
+		return;
+	    case GPIO_OUT_W1TS:
+		gpio_out |= val;
+		gpio_changed ();
+		return;
+	    case GPIO_OUT_W1TC:
+		gpio_out &= ~val;
+		gpio_changed ();
+		return;
+	    case GPIO_ENABLE:
+		gpio_enable = val;
+		gpio_changed ();
+		return;
+	    case GPIO_ENABLE_W1TS:
+		gpio_enable |= val;
+		gpio_changed ();
+		return;
+	    case GPIO_ENABLE_W1TC:
+		gpio_enable &= ~val;
+		gpio_changed ();
+		return;
+	    case FRC1_LOAD:
+		frc1_load = val & 0x7fffff;
+		frc1_count = frc1_load;
+		frc1_start = cpu.cycles;
+		frc1_schedule ();
+		return;
+	    case FRC1_CTRL:
+		if ( (val & FRC1_ENABLE) && ! (frc1_ctrl & FRC1_ENABLE) )
+		    frc1_start = cpu.cycles;
+		if ( ! (val & FRC1_ENABLE) && (frc1_ctrl & FRC1_ENABLE) )
+		    frc1_count = frc1_read_count ();
+		frc1_ctrl = val & 0xff;
+		frc1_schedule ();
+		return;
+	    case FRC1_INT:
+		cpu.sr[SR_INTERRUPT] &= ~(1 << INT_FRC1);
+		cpu.irq_check = 1;
+		return;
+	}
+	memcpy ( &page[addr >> 16][addr & 0xfffc], &val, 4 );
+}
+
+/* ------------------------------------------------------------ */
+/* Loads and stores */
+
+static unsigned int
+load ( unsigned int addr, int size )
+{
+	unsigned int pg = addr >> 16;
+	unsigned char *p = &page[pg][addr & (PAGE_SIZE - 1)];
+	unsigned int val;
+
+	if ( addr & (size - 1) ) {
+	    fault ( "unaligned load from %08x", addr );
+	    return 0;
+	}
+
+	switch ( page_type[pg] ) {
+	    case M_FLASH:
+		cache ( addr, size );
+		/* Fall through */
+	    case M_IRAM:
+		if ( size != 4 ) {
+		    fault ( "load from %08x is not 32 bits, the lx106 would take an exception", addr );
+		    return 0;
+		}
+		/* Fall through */
+	    case M_DRAM:
+	    case M_ROM:
+		if ( size == 4 ) {
+		    memcpy ( &val, p, 4 );
+		    return val;
+		}
+		if ( size == 2 )
+		    return p[0] | p[1] << 8;
+		return p[0];
+	    case M_IO:
+		val = io_read ( addr );
+		if ( size == 4 )
+		    return val;
+		val >>= (addr & 3) * 8;
+		return size == 2 ? val & 0xffff : val & 0xff;
+	}
+
+	fault ( "load from %08x, there is nothing there", addr );
+	return 0;
+}
+
+static void
+store ( unsigned int addr, int size, unsigned int val )
+{
+	unsigned int pg = addr >> 16;
+	unsigned char *p = &page[pg][addr & (PAGE_SIZE - 1)];
+
+	if ( addr & (size - 1) ) {
+	    fault ( "unaligned store to %08x", addr );
+	    return;
+	}
+
+	switch ( page_type[pg] ) {
+	    case M_IRAM:
+		if ( size != 4 ) {
+		    fault ( "store to %08x is not 32 bits, the lx106 would take an exception", addr );
+		    return;
+		}
+		if ( dcache[pg] )
+		    code_changed ( addr, size );
+		/* Fall through */
+	    case M_DRAM:
+		if ( size == 4 )
+		    memcpy ( p, &val, 4 );
+		else if ( size == 2 ) {
+		    p[0] = val;
+		    p[1] = val >> 8;
+		} else
+		    p[0] = val;
+		return;
+	    case M_IO:
+		/* narrow stores to peripherals are rare, do the whole word */
+		if ( size != 4 )
+		    val = (io_reg ( addr ) & ~(((1u << (size * 8)) - 1) << (addr & 3) * 8))
+			| (val << (addr & 3) * 8);
+		io_write ( addr, val );
+		return;
+	    case M_ROM:
+	    case M_FLASH:
+		fault ( "store to %08x, it is read only", addr );
+		return;
+	}
+
+	fault ( "store to %08x, there is nothing there", addr );
+}
+
+/* ------------------------------------------------------------ */
+/* Interrupts, timers and gpio inputs */
+
+static void
+schedule ( void )
+{
+	unsigned long long next = limit;
+
+	if ( frc1_next < next )
+	    next = frc1_next;
+	if ( ccmp_next < next )
+	    next = ccmp_next;
+	if ( wave_next < next )
+	    next = wave_next;
+	next_event = next;
+}
+
+static void
+ccompare_schedule ( void )
+{
+	unsigned int ccount = cpu.cycles + cpu.ccount_adj;
+	unsigned int delta = cpu.sr[SR_CCOMPARE0] - ccount;
+
+	ccmp_next = cpu.cycles + (delta ? delta : 0x100000000ULL);
+	schedule ();
+}
+
+static unsigned int
+sr_read ( int sr )
+{
+	if ( sr == SR_CCOUNT )
+	    return cpu.cycles + cpu.ccount_adj;
+	return cpu.sr[sr];
+}
+
+static void
+sr_write ( int sr, unsigned int val )
+{
+	switch ( sr ) {
+	    case SR_INTERRUPT:
+		cpu.sr[SR_INTERRUPT] |= val;
+		break;
+	    case SR_INTCLEAR:
+		cpu.sr[SR_INTERRUPT] &= ~val;
+		break;
+	    case SR_CCOUNT:
+		cpu.ccount_adj = val - cpu.cycles;
+		ccompare_schedule ();
+		break;
+	    case SR_CCOMPARE0:
+		cpu.sr[sr] = val;
+		cpu.sr[SR_INTERRUPT] &= ~(1 << INT_CCOMPARE0);
+		ccompare_schedule ();
+		break;
+	    case SR_SAR:
+		cpu.sr[sr] = val & 0x3f;
+		break;
+	    default:
+		cpu.sr[sr] = val;
+		break;
+	}
+	cpu.irq_check = 1;
+}
+
+static void
+events ( void )
+{
+	unsigned long long now = cpu.cycles;
+
+	if ( now >= limit && ! cpu.stop ) {
+	    cpu.stop = S_LIMIT;
+	    sprintf ( cpu.why, "gave up after %llu cycles", limit );
+	}
+	while ( frc1_next <= now )
+	    frc1_fire ();
+	if ( ccmp_next <= now ) {
+	    cpu.sr[SR_INTERRUPT] |= 1 << INT_CCOMPARE0;
+	    cpu.irq_check = 1;
+	    ccmp_next += 0x100000000ULL;
+	}
+	if ( wave_next <= now )
+	    wave_run ();
+	schedule ();
+}
+
+/* ------------------------------------------------------------ */
+/* The call stack, for the total column */
+
+struct frame {
+	int func;
+	int irq;
+	unsigned int ret;
+	unsigned long long start;
+};
+
+#define MAX_FRAMES	1024
+
+static struct frame frames[MAX_FRAMES];
+static int nframes;
+static int deep;
+
+static void
+push_frame ( int func, unsigned int ret, int irq )
+{
+	struct frame *fp;
+
+	if ( nframes >= MAX_FRAMES ) {
+	    deep++;
+	    return;
+	}
+	fp = &frames[nframes++];
+	fp->func = func;
+	fp->irq = irq;
+	fp->ret = ret;
+	fp->start = cpu.cycles;
+	funcs[func].active++;
+}
+
+static void
+pop_frame ( void )
+{
+	struct frame *fp = &frames[--nframes];
+	struct func *f;
+
+	if ( fp->irq )
+	    irq_cycles += cpu.cycles - fp->start;
+	f = &funcs[fp->func];
+	if ( --f->active == 0 )
+	    f->total += cpu.cycles - fp->start;
+}
+
+/* We are going to addr, pop back to where that was the return.
+ * A return we don't know about (a tail call, longjmp) leaves
+ * the stack alone.
+ */
+static void
+returning ( unsigned int addr )
+{
+	int i;
+
+	for ( i = nframes - 1; i >= 0; i-- ) {
+	    if ( frames[i].ret == addr ) {
+		while ( nframes > i )
+		    pop_frame ();
+		return;
+	    }
+	}
+}
+
+static void
+take_irq ( void )
+{
+	unsigned int pending;
+	unsigned int vec;
+	int func;
+
+	cpu.irq_check = 0;
+	pending = cpu.sr[SR_INTERRUPT] & cpu.sr[SR_INTENABLE] & ~(1 << INT_NMI);
+	if ( ! pending || (cpu.sr[SR_PS] & PS_EXCM) || (cpu.sr[SR_PS] & PS_INTLEVEL) >= 1 )
+	    return;
+
+	cpu.sr[SR_EPC1] = cpu.pc;
+	cpu.sr[SR_EXCCAUSE] = EXC_LEVEL1;
+	cpu.sr[SR_PS] |= PS_EXCM;
+	vec = cpu.sr[SR_VECBASE] + ((cpu.sr[SR_PS] & PS_UM) ? 0x50 : 0x30);
+	func = func_at ( vec );
+	if ( funcs[func].addr == vec )
+	    funcs[func].calls++;
+	push_frame ( func, cpu.pc, 1 );
+	cpu.pc = vec;
+	cpu.stall += 3;
+	interrupts++;
+}
+
+/* waiti: nothing happens until an interrupt */
+static void
+sleep_irq ( void )
+{
+	unsigned long long start = cpu.cycles;
+
+	for ( ;; ) {
+	    cpu.irq_check = 0;
+	    if ( cpu.sr[SR_INTERRUPT] & cpu.sr[SR_INTENABLE] & ~(1 << INT_NMI) )
+		break;
+	    if ( next_event == NEVER || next_event >= limit ) {
+		fault ( "waiti at %08x, and nothing will wake it up", cpu.pc );
+		break;
+	    }
+	    cpu.cycles = next_event;
+	    events ();
+	}
+	cpu.stall += cpu.cycles - start;
+	cpu.cycles = start;
+}
+
+/* ------------------------------------------------------------ */
+/* GPIO inputs from a file.
+ * Each line is "us gpio level", that many microseconds after
+ * the line before, or "wait gpio state" where state is input
+ * or output (until the code makes the pin one), or 0 or 1 (until
+ * the pin reads that).  A wait is for the pin to go that way, if
+ * it already is, we wait for it to change and come back.  Times
+ * after a wait start when it was over.  # starts a comment.
+ * For a DHT22:
+ *
+ *	wait 12 input
+ *	30 12 0
+ *	80 12 1
+ *	...
+ */
+
+#define W_AT		0
+#define W_WAIT		1
+
+#define C_LOW		0
+#define C_HIGH		1
+#define C_INPUT		2
+#define C_OUTPUT	3
+
+struct wave {
+	int type;
+	unsigned long long delay;	/* cycles */
+	int gpio;
+	int level;			/* or the condition */
+};
+
+static struct wave *waves;
+static int nwaves;
+static int wave_i;
+static unsigned long long wave_base;
+static int wave_armed;		/* the wait was not true yet */
+static int wave_busy;
+
+static void
+load_wave ( char *file )
+{
+	FILE *fp;
+	char line[256];
+	char w[3][64];
+	int max = 0;
+	int nw;
+	struct wave *wp;
+
+	fp = fopen ( file, "r" );
+	if ( ! fp ) {
+	    printf ( "Cannot open %s\n", file );
+	    exit ( 1 );
+	}
+
+	while ( fgets ( line, sizeof(line), fp ) ) {
+	    if ( strchr ( line, '#' ) )
+		*strchr ( line, '#' ) = '\0';
+	    nw = sscanf ( line, "%63s %63s %63s", w[0], w[1], w[2] );
+	    if ( nw <= 0 )
+		continue;
+	    if ( nw != 3 ) {
+		printf ( "%s: what is this: %s", file, line );
+		exit ( 1 );
+	    }
+
+	    if ( nwaves >= max ) {
+		max = max ? max * 2 : 64;
+		waves = xrealloc ( waves, max * sizeof(struct wave) );
+	    }
+	    wp = &waves[nwaves++];
+	    wp->gpio = atoi ( w[1] );
+	    if ( strcmp ( w[0], "wait" ) == 0 ) {
+		wp->type = W_WAIT;
+		wp->delay = 0;
+		if ( strcmp ( w[2], "input" ) == 0 )
+		    wp->level = C_INPUT;
+		else if ( strcmp ( w[2], "output" ) == 0 )
+		    wp->level = C_OUTPUT;
+		else
+		    wp->level = atoi ( w[2] ) ? C_HIGH : C_LOW;
+	    } else {
+		wp->type = W_AT;
+		wp->delay = atof ( w[0] ) * CLOCK_MHZ + 0.5;
+		wp->level = atoi ( w[2] );
+	    }
+	    if ( wp->gpio < 0 || wp->gpio > 15 ) {
+		printf ( "%s: gpio %d, we only have 0 to 15\n", file, wp->gpio );
+		exit ( 1 );
+	    }
+	}
+
+	fclose ( fp );
+	wave_run ();
+}
+
+static int
+wave_cond ( struct wave *wp )
+{
+	int bit = 1 << wp->gpio;
+
+	switch ( wp->level ) {
+	    case C_INPUT:
+		return ! (gpio_enable & bit);
+	    case C_OUTPUT:
+		return (gpio_enable & bit) != 0;
+	    case C_HIGH:
+		return (gpio_in () & bit) != 0;
+	}
+	return ! (gpio_in () & bit);
+}
+
+/* Do everything that is due */
+static void
+wave_run ( void )
+{
+	struct wave *wp;
+
+	while ( wave_i < nwaves ) {
+	    wp = &waves[wave_i];
+	    if ( wp->type == W_WAIT ) {
+		if ( ! wave_cond ( wp ) )
+		    wave_armed = 1;
+		if ( ! wave_armed || ! wave_cond ( wp ) ) {
+		    wave_next = NEVER;
+		    return;
+		}
+		wave_armed = 0;
+		wave_base = cpu.cycles;
+		wave_i++;
+		continue;
+	    }
+	    if ( wave_base + wp->delay > cpu.cycles ) {
+		wave_next = wave_base + wp->delay;
+		return;
+	    }
+	    wave_base += wp->delay;
+	    if ( wp->level )
+		gpio_wave |= 1 << wp->gpio;
+	    else
+		gpio_wave &= ~(1 << wp->gpio);
+	    wave_i++;
+	    wave_busy = 1;
+	    gpio_changed ();
+	    wave_busy = 0;
+	}
+	wave_next = NEVER;
+}
+
+/* The code did something to the pins, maybe a wait is over */
+static void
+wave_poke ( void )
+{
+	if ( ! wave_busy && wave_i < nwaves && waves[wave_i].type == W_WAIT ) {
+	    wave_run ();
+	    schedule ();
+	}
+}
+
+/* ------------------------------------------------------------ */
+/* Running */
+
+#define A(x)	cpu.a[x]
+
+static int
+nsau ( unsigned int x )
+{
+	int n = 0;
+
+	if ( ! x )
+	    return 32;
+	while ( ! (x & 0x80000000) ) {
+	    x <<= 1;
+	    n++;
+	}
+	return n;
+}
+
+static unsigned int
+sext ( unsigned int val, int bit )
+{
+	unsigned int sign = 1u << bit;
+
+	val &= (sign << 1) - 1;
+	return (val ^ sign) - sign;
+}
+
+static void
+trace_insn ( unsigned int pc )
+{
+	struct lx_insn i;
+	unsigned int pg = pc >> 16;
+	unsigned int off = pc & (PAGE_SIZE - 1);
+	char buf[128];
+
+	lx_decode ( &page[pg][off], page_avail[pg] - off, pc, &i );
+	lx_line ( &i, buf );
+	printf ( "%10llu  %-20s %s\n", cpu.cycles, funcs[func_at ( pc )].name, buf );
+}
+
+/* Run until we return to HALT_ADDR, or something stops us */
+static void
+run ( void )
+{
+	struct dinsn *dp;
+	struct func *fp;
+	unsigned int pc, npc;
+	unsigned int pg;
+	unsigned int tmp;
+	int cost;
+	int loaded = 0;		/* register the last instruction loaded, plus 1 */
+	int taken;
+	int back;		/* a return, after we count its cycles */
+
+	while ( ! cpu.stop ) {
+	    if ( cpu.cycles >= next_event )
+		events ();
+	    if ( cpu.irq_check )
+		take_irq ();
+	    if ( cpu.stop )
+		break;
+
+	    pc = cpu.pc;
+	    if ( pc == HALT_ADDR ) {
+		cpu.stop = S_RETURN;
+		break;
+	    }
+
+	    pg = pc >> 16;
+	    if ( page_type[pg] != M_IRAM && page_type[pg] != M_ROM && page_type[pg] != M_FLASH ) {
+		fault ( "no code at %08x", pc );
+		break;
+	    }
+	    if ( ! dcache[pg] )
+		dcache[pg] = calloc ( PAGE_SIZE, sizeof(struct dinsn) );
+	    dp = &dcache[pg][pc & (PAGE_SIZE - 1)];
+	    if ( dp->kind == K_NONE )
+		predecode ( pc, dp );
+	    if ( tracing )
+		trace_insn ( pc );
+
+	    cost = 1 + cpu.stall;
+	    cpu.stall = 0;
+	    cpu.extra = 0;
+	    if ( loaded && (dp->uses & (1 << (loaded - 1))) )
+		cost++;
+	    loaded = dp->load;
+	    if ( page_type[pg] == M_FLASH )
+		cache ( pc, dp->size );
+
+	    npc = pc + dp->size;
+	    taken = 0;
+	    back = 0;
+
+	    switch ( dp->kind ) {
+		case K_BAD:
+		    fault ( "can't decode the instruction at %08x", pc );
+		    break;
+		case K_UNIMP:
+		    fault ( "the lx106 doesn't do the instruction at %08x (or we don't)", pc );
+		    break;
+		case K_ILL:
+		    fault ( "illegal instruction at %08x", pc );
+		    break;
+		case K_BREAK:
+		    fault ( "break at %08x", pc );
+		    break;
+		case K_SYSCALL:
+		    fault ( "syscall at %08x", pc );
+		    break;
+		case K_NOP:
+		    break;
+
+		case K_ADD:
+		case K_ADD_N:
+		    A(dp->r) = A(dp->s) + A(dp->t);
+		    break;
+		case K_ADDX2:
+		    A(dp->r) = (A(dp->s) << 1) + A(dp->t);
+		    break;
+		case K_ADDX4:
+		    A(dp->r) = (A(dp->s) << 2) + A(dp->t);
+		    break;
+		case K_ADDX8:
+		    A(dp->r) = (A(dp->s) << 3) + A(dp->t);
+		    break;
+		case K_SUB:
+		    A(dp->r) = A(dp->s) - A(dp->t);
+		    break;
+		case K_SUBX2:
+		    A(dp->r) = (A(dp->s) << 1) - A(dp->t);
+		    break;
+		case K_SUBX4:
+		    A(dp->r) = (A(dp->s) << 2) - A(dp->t);
+		    break;
+		case K_SUBX8:
+		    A(dp->r) = (A(dp->s) << 3) - A(dp->t);
+		    break;
+		case K_AND:
+		    A(dp->r) = A(dp->s) & A(dp->t);
+		    break;
+		case K_OR:
+		    A(dp->r) = A(dp->s) | A(dp->t);
+		    break;
+		case K_XOR:
+		    A(dp->r) = A(dp->s) ^ A(dp->t);
+		    break;
+		case K_NEG:
+		    A(dp->r) = - A(dp->t);
+		    break;
+		case K_ABS:
+		    A(dp->r) = (int) A(dp->t) < 0 ? - A(dp->t) : A(dp->t);
+		    break;
+		case K_MIN:
+		    A(dp->r) = (int) A(dp->s) < (int) A(dp->t) ? A(dp->s) : A(dp->t);
+		    break;
+		case K_MAX:
+		    A(dp->r) = (int) A(dp->s) > (int) A(dp->t) ? A(dp->s) : A(dp->t);
+		    break;
+		case K_MINU:
+		    A(dp->r) = A(dp->s) < A(dp->t) ? A(dp->s) : A(dp->t);
+		    break;
+		case K_MAXU:
+		    A(dp->r) = A(dp->s) > A(dp->t) ? A(dp->s) : A(dp->t);
+		    break;
+		case K_MOVEQZ:
+		    if ( A(dp->t) == 0 )
+			A(dp->r) = A(dp->s);
+		    break;
+		case K_MOVNEZ:
+		    if ( A(dp->t) != 0 )
+			A(dp->r) = A(dp->s);
+		    break;
+		case K_MOVLTZ:
+		    if ( (int) A(dp->t) < 0 )
+			A(dp->r) = A(dp->s);
+		    break;
+		case K_MOVGEZ:
+		    if ( (int) A(dp->t) >= 0 )
+			A(dp->r) = A(dp->s);
+		    break;
+		case K_SEXT:
+		    A(dp->r) = sext ( A(dp->s), dp->imm );
+		    break;
+		case K_CLAMPS:
+		    tmp = sext ( A(dp->s), dp->imm );
+		    if ( tmp != A(dp->s) )
+			tmp = (int) A(dp->s) < 0 ? - (1u << dp->imm) : (1u << dp->imm) - 1;
+		    A(dp->r) = tmp;
+		    break;
+		case K_NSA:
+		    tmp = A(dp->s);
+		    tmp ^= (int) tmp >> 31;
+		    A(dp->t) = tmp ? nsau ( tmp ) - 1 : 31;
+		    break;
+		case K_NSAU:
+		    A(dp->t) = nsau ( A(dp->s) );
+		    break;
+		case K_MUL16U:
+		    A(dp->r) = (A(dp->s) & 0xffff) * (A(dp->t) & 0xffff);
+		    break;
+		case K_MUL16S:
+		    A(dp->r) = (short) A(dp->s) * (short) A(dp->t);
+		    break;
+		case K_MULL:
+		    A(dp->r) = A(dp->s) * A(dp->t);
+		    break;
+		case K_MULUH:
+		    A(dp->r) = ((unsigned long long) A(dp->s) * A(dp->t)) >> 32;
+		    break;
+		case K_MULSH:
+		    A(dp->r) = ((long long) (int) A(dp->s) * (int) A(dp->t)) >> 32;
+		    break;
+
+		case K_SSR:
+		    cpu.sr[SR_SAR] = A(dp->s) & 31;
+		    break;
+		case K_SSL:
+		    cpu.sr[SR_SAR] = 32 - (A(dp->s) & 31);
+		    break;
+		case K_SSA8L:
+		    cpu.sr[SR_SAR] = (A(dp->s) & 3) * 8;
+		    break;
+		case K_SSA8B:
+		    cpu.sr[SR_SAR] = 32 - (A(dp->s) & 3) * 8;
+		    break;
+		case K_SSAI:
+		    cpu.sr[SR_SAR] = dp->imm;
+		    break;
+		case K_SRC:
+		    A(dp->r) = (((unsigned long long) A(dp->s) << 32) | A(dp->t)) >> cpu.sr[SR_SAR];
+		    break;
+		case K_SRL:
+		    A(dp->r) = (unsigned long long) A(dp->t) >> cpu.sr[SR_SAR];
+		    break;
+		case K_SLL:
+		    A(dp->r) = ((unsigned long long) A(dp->s) << 32) >> cpu.sr[SR_SAR];
+		    break;
+		case K_SRA:
+		    A(dp->r) = (long long) (int) A(dp->t) >> cpu.sr[SR_SAR];
+		    break;
+		case K_SLLI:
+		    A(dp->r) = (unsigned long long) A(dp->s) << dp->imm;
+		    break;
+		case K_SRAI:
+		    A(dp->r) = (int) A(dp->t) >> dp->imm;
+		    break;
+		case K_SRLI:
+		    A(dp->r) = A(dp->t) >> dp->imm;
+		    break;
+		case K_EXTUI:
+		    A(dp->r) = (A(dp->t) >> dp->imm) & dp->target;
+		    break;
+
+		case K_RSR:
+		    A(dp->t) = sr_read ( dp->imm );
+		    break;
+		case K_WSR:
+		    sr_write ( dp->imm, A(dp->t) );
+		    break;
+		case K_XSR:
+		    tmp = sr_read ( dp->imm );
+		    sr_write ( dp->imm, A(dp->t) );
+		    A(dp->t) = tmp;
+		    break;
+		case K_RSIL:
+		    A(dp->t) = cpu.sr[SR_PS];
+		    cpu.sr[SR_PS] = (cpu.sr[SR_PS] & ~PS_INTLEVEL) | dp->imm;
+		    cpu.irq_check = 1;
+		    break;
+		case K_WAITI:
+		    cpu.sr[SR_PS] = (cpu.sr[SR_PS] & ~PS_INTLEVEL) | dp->imm;
+		    sleep_irq ();
+		    break;
+		case K_RFE:
+		    cpu.sr[SR_PS] &= ~PS_EXCM;
+		    npc = cpu.sr[SR_EPC1];
+		    back = 1;
+		    cpu.irq_check = 1;
+		    taken = 1;
+		    break;
+		case K_RFI:
+		    if ( dp->imm < 2 || dp->imm > 7 ) {
+			fault ( "rfi at %08x, with a level we don't have", pc );
+			break;
+		    }
+		    cpu.sr[SR_PS] = cpu.sr[SR_EPS2 + dp->imm - 2];
+		    npc = cpu.sr[SR_EPC1 + dp->imm - 1];
+		    back = 1;
+		    cpu.irq_check = 1;
+		    taken = 1;
+		    break;
+
+		case K_L32R:
+		    A(dp->t) = load ( dp->target, 4 );
+		    break;
+		case K_L8UI:
+		    A(dp->t) = load ( A(dp->s) + dp->imm, 1 );
+		    break;
+		case K_L16UI:
+		    A(dp->t) = load ( A(dp->s) + dp->imm, 2 );
+		    break;
+		case K_L16SI:
+		    A(dp->t) = sext ( load ( A(dp->s) + dp->imm, 2 ), 15 );
+		    break;
+		case K_L32I:
+		    A(dp->t) = load ( A(dp->s) + dp->imm, 4 );
+		    break;
+		case K_S8I:
+		    store ( A(dp->s) + dp->imm, 1, A(dp->t) );
+		    break;
+		case K_S16I:
+		    store ( A(dp->s) + dp->imm, 2, A(dp->t) );
+		    break;
+		case K_S32I:
+		    store ( A(dp->s) + dp->imm, 4, A(dp->t) );
+		    break;
+		case K_S32C1I:
+		    tmp = load ( A(dp->s) + dp->imm, 4 );
+		    if ( tmp == cpu.sr[SR_SCOMPARE1] )
+			store ( A(dp->s) + dp->imm, 4, A(dp->t) );
+		    A(dp->t) = tmp;
+		    break;
+
+		case K_MOVI:
+		    A(dp->t) = dp->imm;
+		    break;
+		case K_MOVI_N:
+		    A(dp->r) = dp->imm;
+		    break;
+		case K_ADDI:
+		    A(dp->t) = A(dp->s) + dp->imm;
+		    break;
+		case K_ADDI_N:
+		    A(dp->r) = A(dp->s) + dp->imm;
+		    break;
+		case K_MOV:
+		    A(dp->t) = A(dp->s);
+		    break;
+
+		case K_CALL0:
+		    A(0) = npc;
+		    npc = dp->target;
+		    taken = 2;
+		    break;
+		case K_CALLX0:
+		    tmp = A(dp->s);
+		    A(0) = npc;
+		    npc = tmp;
+		    taken = 2;
+		    break;
+		case K_J:
+		    npc = dp->target;
+		    taken = 1;
+		    break;
+		case K_JX:
+		    npc = A(dp->s);
+		    taken = 1;
+		    break;
+		case K_RET:
+		    npc = A(0);
+		    back = 1;
+		    taken = 1;
+		    break;
+
+		case K_BEQZ:
+		    taken = A(dp->s) == 0;
+		    break;
+		case K_BNEZ:
+		    taken = A(dp->s) != 0;
+		    break;
+		case K_BLTZ:
+		    taken = (int) A(dp->s) < 0;
+		    break;
+		case K_BGEZ:
+		    taken = (int) A(dp->s) >= 0;
+		    break;
+		case K_BEQI:
+		    taken = A(dp->s) == (unsigned int) dp->imm;
+		    break;
+		case K_BNEI:
+		    taken = A(dp->s) != (unsigned int) dp->imm;
+		    break;
+		case K_BLTI:
+		    taken = (int) A(dp->s) < dp->imm;
+		    break;
+		case K_BGEI:
+		    taken = (int) A(dp->s) >= dp->imm;
+		    break;
+		case K_BLTUI:
+		    taken = A(dp->s) < (unsigned int) dp->imm;
+		    break;
+		case K_BGEUI:
+		    taken = A(dp->s) >= (unsigned int) dp->imm;
+		    break;
+		case K_BNONE:
+		    taken = (A(dp->s) & A(dp->t)) == 0;
+		    break;
+		case K_BEQ:
+		    taken = A(dp->s) == A(dp->t);
+		    break;
+		case K_BLT:
+		    taken = (int) A(dp->s) < (int) A(dp->t);
+		    break;
+		case K_BLTU:
+		    taken = A(dp->s) < A(dp->t);
+		    break;
+		case K_BALL:
+		    taken = (~A(dp->s) & A(dp->t)) == 0;
+		    break;
+		case K_BBC:
+		    taken = ! ((A(dp->s) >> (A(dp->t) & 31)) & 1);
+		    break;
+		case K_BANY:
+		    taken = (A(dp->s) & A(dp->t)) != 0;
+		    break;
+		case K_BNE:
+		    taken = A(dp->s) != A(dp->t);
+		    break;
+		case K_BGE:
+		    taken = (int) A(dp->s) >= (int) A(dp->t);
+		    break;
+		case K_BGEU:
+		    taken = A(dp->s) >= A(dp->t);
+		    break;
+		case K_BNALL:
+		    taken = (~A(dp->s) & A(dp->t)) != 0;
+		    break;
+		case K_BBS:
+		    taken = (A(dp->s) >> (A(dp->t) & 31)) & 1;
+		    break;
+		case K_BBCI:
+		    taken = ! ((A(dp->s) >> dp->imm) & 1);
+		    break;
+		case K_BBSI:
+		    taken = (A(dp->s) >> dp->imm) & 1;
+		    break;
+	    }
+
+	    if ( taken ) {
+		/* a branch goes to its target, the others set npc */
+		if ( dp->kind >= K_BEQZ )
+		    npc = dp->target;
+		cost += 2;
+	    }
+
+	    cost += cpu.extra;
+	    cpu.cycles += cost;
+	    fp = &funcs[dp->func];
+	    fp->self += cost;
+	    fp->insns++;
+	    fp->mix[dp->mnem]++;
+
+	    if ( cpu.stop == S_FAULT ) {
+		cpu.pc = pc;
+		break;
+	    }
+
+	    /* the cycles of the call itself go to the caller,
+	     * those of the return to the callee.
+	     */
+	    if ( back )
+		returning ( npc );
+	    if ( taken == 2 ) {
+		tmp = func_at ( npc );
+		if ( funcs[tmp].addr == npc )
+		    funcs[tmp].calls++;
+		push_frame ( tmp, pc + dp->size, 0 );
+	    }
+	    cpu.pc = npc;
+	}
+}
+
+/* ------------------------------------------------------------ */
+/* Calls we make, from -c */
+
+#define MAX_ARGS	6
+#define MAX_CALLS	32
+
+struct call {
+	char *text;
+	char *name;
+	unsigned int addr;
+	int nargs;
+	unsigned int args[MAX_ARGS];
+	int bufsize[MAX_ARGS];		/* =N arguments */
+	unsigned long long cycles;
+	unsigned int result;
+	int stop;
+};
+
+static struct call calls[MAX_CALLS];
+static int ncalls;
+
+static unsigned int scratch = SCRATCH_BASE;
+
+static unsigned int
+lookup ( char *name )
+{
+	unsigned int addr;
+	char *end;
+
+	addr = strtoul ( name, &end, 0 );
+	if ( *end == '\0' )
+	    return addr;
+	if ( find_func ( name, &addr ) )
+	    return addr;
+	printf ( "No symbol %s\n", name );
+	exit ( 1 );
+}
+
+static void
+parse_call ( struct call *cp )
+{
+	char *words[MAX_ARGS + 2];
+	char *buf = strdup ( cp->text );
+	char *p;
+	int n = 0;
+	int i;
+
+	for ( p = strtok ( buf, " \t" ); p; p = strtok ( NULL, " \t" ) ) {
+	    if ( n >= MAX_ARGS + 1 ) {
+		printf ( "Only %d arguments: %s\n", MAX_ARGS, cp->text );
+		exit ( 1 );
+	    }
+	    words[n++] = p;
+	}
+	if ( n == 0 ) {
+	    printf ( "Call what?\n" );
+	    exit ( 1 );
+	}
+
+	cp->name = words[0];
+	cp->addr = lookup ( words[0] );
+	cp->nargs = n - 1;
+	for ( i=0; i<cp->nargs; i++ ) {
+	    if ( words[i+1][0] == '=' ) {
+		cp->bufsize[i] = (atoi ( &words[i+1][1] ) + 3) & ~3;
+		cp->args[i] = scratch;
+		scratch += cp->bufsize[i];
+	    } else
+		cp->args[i] = lookup ( words[i+1] );
+	}
+}
+
+static void
+start ( unsigned int addr )
+{
+	memset ( cpu.a, 0, sizeof(cpu.a) );
+	cpu.a[0] = HALT_ADDR;
+	cpu.a[1] = STACK_TOP;
+	cpu.pc = addr;
+	cpu.stop = S_RUN;
+	cpu.why[0] = '\0';
+	cpu.irq_check = 1;
+	nframes = 0;
+	push_frame ( func_at ( addr ), HALT_ADDR, 0 );
+	if ( funcs[func_at ( addr )].addr == addr )
+	    funcs[func_at ( addr )].calls++;
+}
+
+/* whatever is still on the stack gets its total */
+static void
+finish ( void )
+{
+	while ( nframes > 0 )
+	    pop_frame ();
+}
+
+static void
+do_call ( struct call *cp, unsigned long long max )
+{
+	unsigned long long t = cpu.cycles;
+	int i;
+
+	start ( cp->addr );
+	for ( i=0; i<cp->nargs; i++ )
+	    cpu.a[2+i] = cp->args[i];
+	cpu.sr[SR_PS] = PS_UM;
+
+	limit = cpu.cycles + max;
+	schedule ();
+	run ();
+	finish ();
+
+	cp->cycles = cpu.cycles - t;
+	cp->result = cpu.a[2];
+	cp->stop = cpu.stop;
+}
+
+static void
+show_call ( struct call *cp )
+{
+	unsigned int val;
+	int i, j;
+
+	printf ( "%s (", cp->name );
+	for ( i=0; i<cp->nargs; i++ ) {
+	    if ( cp->bufsize[i] )
+		printf ( "%s =%d", i ? "," : "", cp->bufsize[i] );
+	    else
+		printf ( "%s 0x%x", i ? "," : "", cp->args[i] );
+	}
+	if ( cp->stop == S_RETURN )
+	    printf ( " ) = 0x%x, %llu cycles (%.1f us)\n", cp->result, cp->cycles, (double) cp->cycles / CLOCK_MHZ );
+	else
+	    printf ( " ) %s, %llu cycles\n", cpu.why, cp->cycles );
+
+	for ( i=0; i<cp->nargs; i++ ) {
+	    if ( ! cp->bufsize[i] )
+		continue;
+	    printf ( "    =%d at %08x:", cp->bufsize[i], cp->args[i] );
+	    for ( j=0; j<cp->bufsize[i]; j += 4 ) {
+		memcpy ( &val, &page[(cp->args[i] + j) >> 16][(cp->args[i] + j) & (PAGE_SIZE - 1)], 4 );
+		printf ( " %08x", val );
+	    }
+	    printf ( "\n" );
+	}
+}
+
+/* ------------------------------------------------------------ */
+/* The report */
+
+static int
+total_compare ( const void *a, const void *b )
+{
+	const struct func *fa = *(const struct func **) a;
+	const struct func *fb = *(const struct func **) b;
+
+	if ( fa->total != fb->total )
+	    return fa->total < fb->total ? 1 : -1;
+	if ( fa->self != fb->self )
+	    return fa->self < fb->self ? 1 : -1;
+	return fa->addr < fb->addr ? -1 : 1;
+}
+
+struct mix {
+	int mnem;
+	unsigned long long count;
+};
+
+static int
+mix_compare ( const void *a, const void *b )
+{
+	const struct mix *ma = a;
+	const struct mix *mb = b;
+
+	if ( ma->count != mb->count )
+	    return ma->count < mb->count ? 1 : -1;
+	return strcmp ( mnems[ma->mnem], mnems[mb->mnem] );
+}
+
+/* counts of each mnemonic, the most first */
+static int
+get_mix ( struct func *fp, struct mix *mix )
+{
+	int i, n = 0;
+
+	for ( i=0; i<nmnems; i++ ) {
+	    if ( fp ) {
+		if ( ! fp->mix || ! fp->mix[i] )
+		    continue;
+		mix[n].count = fp->mix[i];
+	    } else {
+		int f;
+
+		mix[n].count = 0;
+		for ( f=0; f<nfuncs; f++ )
+		    if ( funcs[f].mix )
+			mix[n].count += funcs[f].mix[i];
+		if ( ! mix[n].count )
+		    continue;
+	    }
+	    mix[n].mnem = i;
+	    n++;
+	}
+	qsort ( mix, n, sizeof(struct mix), mix_compare );
+	return n;
+}
+
+#define MIX_SHOW	8
+
+static void
+show_report ( int nshow, int show_mix )
+{
+	struct func **list;
+	struct func *fp;
+	struct mix mix[MAX_MNEM];
+	unsigned long long insns = 0;
+	int nlist = 0;
+	int i, j, n;
+
+	list = xrealloc ( NULL, nfuncs * sizeof(struct func *) );
+	for ( i=0; i<nfuncs; i++ ) {
+	    insns += funcs[i].insns;
+	    if ( funcs[i].insns )
+		list[nlist++] = &funcs[i];
+	}
+	qsort ( list, nlist, sizeof(struct func *), total_compare );
+
+	printf ( "\n%llu cycles (%.1f us), %llu instructions, %llu cache misses, %llu interrupts (%llu cycles)\n",
+		cpu.cycles, (double) cpu.cycles / CLOCK_MHZ, insns, misses, interrupts, irq_cycles );
+	if ( deep )
+	    printf ( "The call stack went more than %d deep %d times\n", MAX_FRAMES, deep );
+
+	printf ( "\n%-8s %-32s %7s %11s %11s %11s %7s %10s\n", "addr", "function", "calls", "self", "total", "insns", "misses", "per call" );
+	for ( i=0; i<nlist && i<nshow; i++ ) {
+	    fp = list[i];
+	    printf ( "%08x %-32s %7lu %11llu %11llu %11llu %7llu", fp->addr, fp->name, fp->calls, fp->self, fp->total, fp->insns, fp->misses );
+	    if ( fp->calls )
+		printf ( " %10llu", fp->total / fp->calls );
+	    printf ( "\n" );
+	}
+
+	if ( ! show_mix )
+	    return;
+
+	printf ( "\n" );
+	for ( i=0; i<nlist && i<nshow; i++ ) {
+	    fp = list[i];
+	    n = get_mix ( fp, mix );
+	    printf ( "%-32s", fp->name );
+	    for ( j=0; j<n && j<MIX_SHOW; j++ )
+		printf ( " %s %.0f%%", mnems[mix[j].mnem], 100.0 * mix[j].count / fp->insns );
+	    printf ( "\n" );
+	}
+}
+
+/* Like opcodes.freq, but what ran, not what is there */
+static void
+write_freq ( char *file )
+{
+	struct mix mix[MAX_MNEM];
+	FILE *fp;
+	int i, n;
+
+	fp = fopen ( file, "w" );
+	if ( ! fp ) {
+	    printf ( "Cannot create %s\n", file );
+	    exit ( 1 );
+	}
+	n = get_mix ( NULL, mix );
+	for ( i=0; i<n; i++ )
+	    fprintf ( fp, "%04llu  %s\n", mix[i].count, mnems[mix[i].mnem] );
+	fclose ( fp );
+}
+
+/* ------------------------------------------------------------ */
+
+#define MAX_SYMFILES	8
+#define MAX_POKES	32
+#define MAX_BUDGETS	16
+
+static void
+usage ( void )
+{
+	printf ( "Usage: lxsim [-r rom] [-e elf] [-aapp] [-s symfile] [-c \"func args\"] [-l cycles]\n" );
+	printf ( "             [-W addr=val] [-g wave] [-G trace] [-m] [-f freqfile] [-n count]\n" );
+	printf ( "             [-b func=cycles] [-M miss] [-w wait] [-q] [-t]\n" );
+	exit ( 1 );
+}
+
+int
+main ( int argc, char **argv )
+{
+	char *rom_file = NULL;
+	char *elf_file = NULL;
+	char *prefix = NULL;
+	char *extra[MAX_SYMFILES];
+	int nextra = 0;
+	char *pokes[MAX_POKES];
+	int npokes = 0;
+	char *budgets[MAX_BUDGETS];
+	int nbudgets = 0;
+	char *wave_file = NULL;
+	char *trace_file = NULL;
+	char *freq_file = NULL;
+	unsigned long long max = 1000000000ULL;
+	int nshow = 20;
+	int show_mix = 0;
+	int have_rom;
+	char fname[128];
+	unsigned int addr, val;
+	unsigned long long budget;
+	char *ap, *p;
+	FILE *fp;
+	int rv = 0;
+	int i, j;
+
+	argc--;
+	++argv;
+	while ( argc > 0 && argv[0][0] == '-' ) {
+	    ap = argv[0];
+	    if ( ap[1] == 'a' )
+		prefix = &ap[2];
+	    else if ( ap[1] == 'm' )
+		show_mix = 1;
+	    else if ( ap[1] == 'q' )
+		quiet = 1;
+	    else if ( ap[1] == 't' )
+		tracing = 1;
+	    else if ( argc < 2 )
+		usage ();
+	    else {
+		if ( ap[1] == 'r' )
+		    rom_file = argv[1];
+		else if ( ap[1] == 'e' )
+		    elf_file = argv[1];
+		else if ( ap[1] == 's' && nextra < MAX_SYMFILES )
+		    extra[nextra++] = argv[1];
+		else if ( ap[1] == 'c' && ncalls < MAX_CALLS )
+		    calls[ncalls++].text = argv[1];
+		else if ( ap[1] == 'l' )
+		    max = strtoull ( argv[1], NULL, 0 );
+		else if ( ap[1] == 'W' && npokes < MAX_POKES )
+		    pokes[npokes++] = argv[1];
+		else if ( ap[1] == 'g' )
+		    wave_file = argv[1];
+		else if ( ap[1] == 'G' )
+		    trace_file = argv[1];
+		else if ( ap[1] == 'f' )
+		    freq_file = argv[1];
+		else if ( ap[1] == 'n' )
+		    nshow = atoi ( argv[1] );
+		else if ( ap[1] == 'b' && nbudgets < MAX_BUDGETS )
+		    budgets[nbudgets++] = argv[1];
+		else if ( ap[1] == 'M' )
+		    miss_cost = atoi ( argv[1] );
+		else if ( ap[1] == 'w' )
+		    io_cost = atoi ( argv[1] );
+		else
+		    usage ();
+		argc--;
+		++argv;
+	    }
+	    argc--;
+	    ++argv;
+	}
+	if ( argc > 0 )
+	    usage ();
+
+	/* The ROM if we have one, it isn't in git */
+	if ( ! rom_file ) {
+	    fp = fopen ( ROM_BINFILE, "r" );
+	    if ( fp ) {
+		fclose ( fp );
+		rom_file = ROM_BINFILE;
+	    }
+	}
+	have_rom = rom_file != NULL;
+	if ( have_rom )
+	    image_raw ( rom_file, ROM_BASE );
+
+	if ( elf_file )
+	    image_elf ( elf_file, elf_sym );
+	else if ( prefix ) {
+	    snprintf ( fname, sizeof(fname), "%s-0x00000.bin", prefix );
+	    image_app ( strdup ( fname ) );
+	    snprintf ( fname, sizeof(fname), "%s-0x40000.bin", prefix );
+	    image_raw ( strdup ( fname ), FLASH_BASE );
+	} else if ( ! have_rom ) {
+	    printf ( "Nothing to run, no %s here\n", ROM_BINFILE );
+	    exit ( 1 );
+	}
+	image_finish ();
+	load_memory ( have_rom );
+
+	for ( i=0; i<nextra; i++ )
+	    load_syms ( extra[i], 1 );
+	load_syms ( SYM_FILE, 0 );
+	finish_funcs ();
+
+	/* what the ROM startup would have done */
+	if ( have_rom )
+	    rom_store ();
+	cpu.sr[SR_VECBASE] = ROM_BASE;
+	cpu.sr[SR_PS] = PS_UM;
+	val = CLOCK_MHZ;
+	memcpy ( &page[ROM_CPU_FREQ >> 16][ROM_CPU_FREQ & 0xffff], &val, 4 );
+	ccompare_schedule ();
+
+	if ( trace_file ) {
+	    gpio_trace = fopen ( trace_file, "w" );
+	    if ( ! gpio_trace ) {
+		printf ( "Cannot create %s\n", trace_file );
+		exit ( 1 );
+	    }
+	}
+	gpio_last = gpio_in ();
+	if ( wave_file )
+	    load_wave ( wave_file );
+
+	for ( i=0; i<npokes; i++ ) {
+	    p = strchr ( pokes[i], '=' );
+	    if ( ! p )
+		usage ();
+	    *p++ = '\0';
+	    addr = lookup ( pokes[i] );
+	    store ( addr, 4, lookup ( p ) );
+	    if ( cpu.stop ) {
+		printf ( "-W %s: %s\n", pokes[i], cpu.why );
+		exit ( 1 );
+	    }
+	}
+	cpu.extra = 0;
+
+	for ( i=0; i<ncalls; i++ )
+	    parse_call ( &calls[i] );
+
+	if ( ncalls == 0 ) {
+	    calls[0].name = "entry";
+	    calls[0].addr = prefix || elf_file ? segments.entry : RESET_VECTOR;
+	    ncalls = 1;
+	}
+
+	for ( i=0; i<ncalls; i++ ) {
+	    do_call ( &calls[i], max );
+	    if ( ! quiet && calls[i].stop != S_RETURN )
+		fflush ( stdout );
+	    show_call ( &calls[i] );
+	    if ( calls[i].stop != S_RETURN ) {
+		rv = 2;
+		break;
+	    }
+	}
+
+	if ( gpio_trace )
+	    fclose ( gpio_trace );
+
+	show_report ( nshow, show_mix );
+	if ( freq_file )
+	    write_freq ( freq_file );
+
+	/* func=cycles, the most one call may take */
+	for ( i=0; i<nbudgets; i++ ) {
+	    p = strchr ( budgets[i], '=' );
+	    if ( ! p )
+		usage ();
+	    *p++ = '\0';
+	    budget = strtoull ( p, NULL, 0 );
+	    for ( j=1; j<nfuncs; j++ )
+		if ( strcmp ( funcs[j].name, budgets[i] ) == 0 )
+		    break;
+	    if ( j == nfuncs || ! funcs[j].calls ) {
+		printf ( "over budget: %s never ran\n", budgets[i] );
+		rv = rv ? rv : 1;
+	    } else if ( funcs[j].total / funcs[j].calls > budget ) {
+		printf ( "over budget: %s %llu > %llu cycles\n", budgets[i], funcs[j].total / funcs[j].calls, budget );
+		rv = rv ? rv : 1;
+	    }
+	}
+
+	return rv;
+}
+
+/* THE END */
@@ -0,0 +1,291 @@
+/* lxwork.c
+ * One of my ESP8266 reverse engineering tools
+ *
+ * Decode with a bunch of threads before lxdis does its passes.
+ *
+ * Pass 1 in lxdis has to go in the order espdis did (which
+ * entry point claims a byte first decides what new.dis looks
+ * like), so we don't touch it.  What we can do in parallel is
+ * the tracing and decoding.  Each entry point's flow can be
+ * followed on its own, so we put them on a work list and let
+ * a pool of threads chase them, decoding every instruction
+ * they reach into a cache.  Pass 1 and pass 2 then just pick
+ * decoded instructions out of the cache.
+ *
+ * Each thread has its own deque of addresses to chase.  It
+ * pushes the targets it finds onto the bottom of its own deque
+ * and takes work from there too; when it runs dry it steals
+ * from the top of somebody else's.
+ *
+ * To keep two threads from decoding the same code, there is
+ * a bitmap with one bit for each byte of the rom.  A thread
+ * sets the bit for an instruction with an atomic OR before it
+ * decodes it.  If the bit was already set, somebody else has
+ * that instruction (and whatever follows it), and the thread
+ * drops that path.
+ *
+ * Since the cache holds exactly what decode_at() would give
+ * us, the listing comes out the same with any number of
+ * threads (or none).
+ *
+ * What it buys is another matter.  On the bootrom (the only image
+ * lxdis takes, so there is no bigger one to try), on a box with
+ * one cpu, best of 5 runs of "lxdis all":
+ *
+ *	no -j		17 ms
+ *	-j 1/2/4/8	18 ms each
+ *
+ * LXWORK_STATS=1 says the pre-decode itself takes 8 to 11 ms
+ * for 21285 instructions with any -j (setting up the cache is
+ * well under a ms of that), and the passes after it save a bit
+ * less than that.  So it doesn't scale here, and it is a loss
+ * with one cpu.  It is kept as an option for trying on a machine
+ * with more cpus, not turned on by default.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+
+#include "image.h"
+#include "lx106.h"
+#include "lxdis.h"
+
+struct deque {
+	unsigned int *items;
+	int head;		/* thieves take from here */
+	int tail;		/* the owner pushes and pops here */
+	int max;
+	pthread_mutex_t lock;
+};
+
+struct worker {
+	pthread_t thread;
+	int id;
+	struct deque dq;
+	int decoded;
+	int stolen;
+};
+
+static struct worker *workers;
+static int nworkers;
+
+/* addresses pushed but not yet chased */
+static atomic_int pending;
+
+static atomic_uint *owned;
+
+static struct lx_insn *icache;
+static unsigned char *icache_ok;
+
+static void
+dq_push ( struct deque *dp, unsigned int addr )
+{
+	pthread_mutex_lock ( &dp->lock );
+	if ( dp->tail >= dp->max ) {
+	    /* slide down, or grow */
+	    if ( dp->head > 0 ) {
+		memmove ( dp->items, &dp->items[dp->head],
+		    (dp->tail - dp->head) * sizeof(unsigned int) );
+		dp->tail -= dp->head;
+		dp->head = 0;
+	    }
+	    if ( dp->tail >= dp->max ) {
+		dp->max = dp->max ? dp->max * 2 : 256;
+		dp->items = xrealloc ( dp->items, dp->max * sizeof(unsigned int) );
+	    }
+	}
+	dp->items[dp->tail++] = addr;
+	pthread_mutex_unlock ( &dp->lock );
+}
+
+static int
+dq_pop ( struct deque *dp, unsigned int *addr )
+{
+	int rv = 0;
+
+	pthread_mutex_lock ( &dp->lock );
+	if ( dp->tail > dp->head ) {
+	    *addr = dp->items[--dp->tail];
+	    rv = 1;
+	}
+	pthread_mutex_unlock ( &dp->lock );
+	return rv;
+}
+
+static int
+dq_steal ( struct deque *dp, unsigned int *addr )
+{
+	int rv = 0;
+
+	pthread_mutex_lock ( &dp->lock );
+	if ( dp->tail > dp->head ) {
+	    *addr = dp->items[dp->head++];
+	    rv = 1;
+	}
+	pthread_mutex_unlock ( &dp->lock );
+	return rv;
+}
+
+static void
+push ( struct worker *wp, unsigned int addr )
+{
+	if ( addr < rom_base || addr > rom_limit )
+	    return;
+	atomic_fetch_add ( &pending, 1 );
+	dq_push ( &wp->dq, addr );
+}
+
+/* Returns 1 if we got the instruction starting here */
+static int
+take ( unsigned int index )
+{
+	unsigned int bit = 1u << (index & 31);
+
+	return ! (atomic_fetch_or ( &owned[index >> 5], bit ) & bit);
+}
+
+/* Follow one thread of execution, the same way pass 1 does.
+ * We don't go into anything the hints file claimed.
+ */
+static void
+chase ( struct worker *wp, unsigned int addr )
+{
+	struct lx_insn *ip;
+	unsigned int index;
+
+	for ( ;; ) {
+	    if ( addr < rom_base || addr > rom_limit )
+		break;
+	    index = addr - rom_base;
+	    if ( map[index] != 'X' )
+		break;
+	    if ( ! take ( index ) )
+		break;
+
+	    ip = &icache[index];
+	    if ( ! decode_at ( addr, ip ) )
+		break;
+	    icache_ok[index] = 1;
+	    wp->decoded++;
+
+	    if ( ip->flags & LX_ILL )
+		break;
+	    if ( ip->flags & (LX_JUMP | LX_BRANCH | LX_CALL) )
+		push ( wp, ip->target );
+
+	    addr += ip->size;
+	    if ( ip->flags & LX_TERM )
+		break;
+	}
+}
+
+static int
+find_work ( struct worker *wp, unsigned int *addr )
+{
+	int i;
+
+	if ( dq_pop ( &wp->dq, addr ) )
+	    return 1;
+
+	for ( i=1; i<nworkers; i++ ) {
+	    if ( dq_steal ( &workers[(wp->id + i) % nworkers].dq, addr ) ) {
+		wp->stolen++;
+		return 1;
+	    }
+	}
+	return 0;
+}
+
+static void *
+work ( void *arg )
+{
+	struct worker *wp = arg;
+	unsigned int addr;
+
+	for ( ;; ) {
+	    if ( find_work ( wp, &addr ) ) {
+		chase ( wp, addr );
+		atomic_fetch_sub ( &pending, 1 );
+		continue;
+	    }
+	    if ( atomic_load ( &pending ) == 0 )
+		break;
+	    sched_yield ();
+	}
+
+	return NULL;
+}
+
+/* Decode everything we can reach from these entry points,
+ * using nthreads threads.
+ */
+void
+predecode ( unsigned int *entries, int count, int nthreads )
+{
+	struct timespec t0, t1;
+	int nbits;
+	int i;
+
+	clock_gettime ( CLOCK_MONOTONIC, &t0 );
+
+	icache = xrealloc ( NULL, rom_size * sizeof(struct lx_insn) );
+	icache_ok = xrealloc ( NULL, rom_size );
+	memset ( icache_ok, 0, rom_size );
+
+	nbits = (rom_size + 31) / 32;
+	owned = xrealloc ( NULL, nbits * sizeof(atomic_uint) );
+	for ( i=0; i<nbits; i++ )
+	    atomic_init ( &owned[i], 0 );
+
+	nworkers = nthreads;
+	workers = xrealloc ( NULL, nworkers * sizeof(struct worker) );
+	memset ( workers, 0, nworkers * sizeof(struct worker) );
+	atomic_init ( &pending, 0 );
+
+	/* deal the entry points out round robin */
+	for ( i=0; i<nworkers; i++ ) {
+	    workers[i].id = i;
+	    pthread_mutex_init ( &workers[i].dq.lock, NULL );
+	}
+	for ( i=0; i<count; i++ )
+	    push ( &workers[i % nworkers], entries[i] );
+
+	for ( i=0; i<nworkers; i++ )
+	    pthread_create ( &workers[i].thread, NULL, work, &workers[i] );
+	for ( i=0; i<nworkers; i++ )
+	    pthread_join ( workers[i].thread, NULL );
+
+	clock_gettime ( CLOCK_MONOTONIC, &t1 );
+
+	if ( getenv ( "LXWORK_STATS" ) ) {
+	    for ( i=0; i<nworkers; i++ )
+		fprintf ( stderr, "thread %d: decoded %d, stole %d\n",
+		    i, workers[i].decoded, workers[i].stolen );
+	    fprintf ( stderr, "predecode: %d threads, %.2f ms\n", nworkers,
+		(t1.tv_sec - t0.tv_sec) * 1000.0 + (t1.tv_nsec - t0.tv_nsec) / 1000000.0 );
+	}
+
+	for ( i=0; i<nworkers; i++ ) {
+	    pthread_mutex_destroy ( &workers[i].dq.lock );
+	    free ( workers[i].dq.items );
+	}
+	free ( workers );
+	free ( (void *) owned );
+}
+
+struct lx_insn *
+cached_insn ( unsigned int addr )
+{
+	unsigned int index;
+
+	if ( ! icache_ok || addr < rom_base || addr > rom_limit )
+	    return NULL;
+	index = addr - rom_base;
+	return icache_ok[index] ? &icache[index] : NULL;
+}
+
+/* THE END */
@@ -4,12 +4,36 @@
  * Tom Trebisky  9-5-2014
  *
  * Subverted for ESP8266 bootrom disassembly 1-20-2016
- * 
+ *
  * Interestingly it works with almost no changes, and with big-endian
  * values for the most part, and the machine type set to m68k.
  * A side effect of this that I like is that memory is dumped
  * in true byte order, rather than byte swapping the 24 bit
  * ESP8266 xtensa op-codes.
+ *
+ * Reworked since then:
+ *  - the image handling from image.c, so we can wrap any number
+ *    of raw segments (file@addr) or every segment of an
+ *    application image (the 0xE9 header).
+ *  - the base and entry no longer need to be hand edited.
+ *  - symbol and string tables grow as needed, and the symbols
+ *    are sorted and duplicates dropped.
+ *  - a hints file (like the one in reverse/bootrom) splits
+ *    each segment into .text and .rodata sections.
+ *  - -x gives a real little endian Xtensa ELF file.
+ *
+ *  wrap bootrom.bin bootrom.elf [calls.sy]	- what it always did
+ *  wrap -a prod-0x00000.bin -r prod-0x40000.bin@40240000 prod.elf
+ *  wrap -h hints -s syms bootrom.bin bootsym.elf calls.sy
+ *
+ * Options:
+ *  -b base		- address for the bin file (40000000)
+ *  -e entry		- entry point (400000a4, or from the image header)
+ *  -a			- the bin file is an application image
+ *  -r file@addr	- another raw segment (as many as you like)
+ *  -s file		- another symbol file (as many as you like)
+ *  -h file		- hints file
+ *  -x			- little endian Xtensa rather than big endian m68k
  */
 #include <stdio.h>
 #include <unistd.h>
@@ -22,11 +46,7 @@
 
 #include <elf.h>
 
-#define PGSIZE 8192	/* 0x2000 */
-
-/* Mightyframe ROM is 27256 (32K, 4 pages) */
-/* esp8266 is 64k (65536) */
-#define MAX_ROMSIZE 65536
+#include "image.h"
 
 #ifdef notdef
 /* S80_boot_72-01231.BIN */
@@ -41,14 +61,11 @@ unsigned int entry = 0x00fc0082;
 /* now we get the image and elf names from the command line */
 char *rom_image;
 char *elf_image;
-char *sym_file;
 
-/* These must be hand edited */
-unsigned int rombase = 0x40000000;
+unsigned int rombase = ROM_BASE;
 unsigned int entry = 0x400000a4;
 
-char buf[MAX_ROMSIZE];
-int romsize;
+int big_endian = 1;
 
 int offset;
 
@@ -61,97 +78,213 @@ struct string {
 struct string seg_strings;
 struct string sym_strings;
 
-#define MAX_SYM	400
+/* Symbols, as we read them in */
+struct sym {
+	unsigned int addr;
+	char *name;
+	int order;
+	int str;		/* in sym_strings */
+};
 
 struct symtab {
-	Elf32_Sym sym[MAX_SYM];
+	struct sym *sym;
 	int count;
-	int size;
 	int limit;
 };
 
 struct symtab syms;
 
+/* Ranges the hints file calls data */
+struct range {
+	unsigned int start;
+	unsigned int end;	/* one past */
+};
+
+struct range *data_ranges;
+int ndata;
+int max_data;
+
+/* Each segment, cut up by the hints into one or more sections */
+struct section {
+	unsigned int addr;
+	unsigned int size;
+	unsigned char *data;
+	int name;		/* in seg_strings */
+	int flags;
+	int offset;		/* in the file */
+};
+
+struct section *sections;
+int nsect;
+int max_sect;
+
 /* --------------------------------------------- */
 
 void init_string ( struct string * );
 int add_string ( struct string *, char * );
-void add_char ( struct string *, int );
 int mk_string ( struct string *, int );
 void finish_string ( struct string * );
 
 void mk_shdr_null ( int );
-void mk_shdr_t ( int, int );
+void mk_shdr_t ( int, struct section * );
 void mk_shdr_g ( int, int );
 void mk_shdr_s ( int, int, int );
-void mk_shdr_sy ( int, int, int, int );
+void mk_shdr_sy ( int, int, int, int, int );
 
-int load_syms ( char * );
-void init_symbol ( void );
+void load_syms ( char * );
+void load_hints ( char * );
 void add_symbol ( char *, unsigned int );
-void finish_symbol ( void );
+int finish_symbol ( void );
 int mk_symbol ( int );
 
+void mk_sections ( void );
+int mk_phdr ( int );
+
 char gnu_extra[] = "GCC: (GNU) 4.7.2";
 int gnusize;
 
-int mk_phdr ( int );
+/* All the headers are written in the target byte order */
+static unsigned int
+e32 ( unsigned int val )
+{
+	return big_endian ? htonl ( val ) : val;
+}
+
+static unsigned short
+e16 ( unsigned short val )
+{
+	return big_endian ? htons ( val ) : val;
+}
+
+static void *
+xrealloc ( void *p, int size )
+{
+	p = realloc ( p, size );
+	if ( ! p ) {
+	    fprintf ( stderr, "Out of memory\n" );
+	    exit ( 1 );
+	}
+	return p;
+}
+
+static void
+usage ( void )
+{
+	fprintf ( stderr, "Usage: wrap [-x] [-a] [-b base] [-e entry] [-r file@addr] [-s symfile] [-h hints] bin elf [symfile]\n" );
+	exit ( 1 );
+}
+
+#define MAX_FILES	16
 
 /*
  * Here is what an elf file looks like:
  *
  *  Elf header (52 bytes)
- *  Elf phdr (32 bytes) "program header"
- *  zero padding to get to 8k (8192) boundary
- *  Section 0 - null (not actually present)
- *  Section 1 - binary image
- *  Section 2 - gnu extra string
- *  Section 3 - section string table
- *  Section 4 - maybe symbol table
- *  Section 5 - maybe symbol table strings
- *  ELF segment headers
+ *  Elf phdr (32 bytes) "program header", one per segment
+ *  The image, one section after another, 4 byte aligned
+ *  gnu extra string
+ *  section string table
+ *  maybe symbol table
+ *  maybe symbol table strings
+ *  ELF section headers:
+ *   Section 0 - null (not actually present)
+ *   Section 1 .. n - the image
+ *   Section n+1 - gnu extra string
+ *   Section n+2 - section string table
+ *   Section n+3 - maybe symbol table
+ *   Section n+4 - maybe symbol table strings
  */
 
 int main ( int argc, char **argv )
 {
 	Elf32_Ehdr hdr;
-	int rom, of;
+	int of;
 	int shnum;
 	int ph_off;
 	int sh_off;
-	char pad[PGSIZE];
+	char pad[8];
 	int npad;
 	int s_index;
 	int g_index;
-	int t_index;
 	int sy_index;
 	int sys_index;
 	int st_size;
 	int sym_size;
 	int syst_size;
 	int nsy;
+	int nlocal;
+	int is_app = 0;
+	int got_entry = 0;
+	char *raw[MAX_FILES];
+	int nraw = 0;
+	char *symfiles[MAX_FILES];
+	int nsymfiles = 0;
+	char *hint_file = NULL;
+	char *p;
+	int i;
 
-	/* Extra argument is symbol file */
-	sym_file = NULL;
-	if ( argc == 4 ) {
-	    sym_file = argv[3];
+	argc--;
+	++argv;
+	while ( argc > 0 && argv[0][0] == '-' ) {
+	    if ( argv[0][1] == 'a' )
+		is_app = 1;
+	    else if ( argv[0][1] == 'x' )
+		big_endian = 0;
+	    else if ( argc < 2 )
+		usage ();
+	    else {
+		if ( argv[0][1] == 'b' )
+		    rombase = strtoul ( argv[1], NULL, 16 );
+		else if ( argv[0][1] == 'e' ) {
+		    entry = strtoul ( argv[1], NULL, 16 );
+		    got_entry = 1;
+		} else if ( argv[0][1] == 'r' && nraw < MAX_FILES )
+		    raw[nraw++] = argv[1];
+		else if ( argv[0][1] == 's' && nsymfiles < MAX_FILES )
+		    symfiles[nsymfiles++] = argv[1];
+		else if ( argv[0][1] == 'h' )
+		    hint_file = argv[1];
+		else
+		    usage ();
+		argc--;
+		++argv;
+	    }
 	    argc--;
+	    ++argv;
 	}
 
-	if ( argc != 3 ) {
-	    fprintf ( stderr, "Usage: wrap bin elf\n" );
-	    exit ( 1 );
+	/* Extra argument is symbol file */
+	if ( argc == 3 && nsymfiles < MAX_FILES ) {
+	    symfiles[nsymfiles++] = argv[2];
+	    argc--;
 	}
 
-	rom_image = argv[1];
-	elf_image = argv[2];
+	if ( argc != 2 )
+	    usage ();
+
+	rom_image = argv[0];
+	elf_image = argv[1];
 
 	printf ( "Reading image: %s\n", rom_image );
-	rom = open ( rom_image, O_RDONLY );
-	if ( rom < 0 ) {
-	    fprintf ( stderr, "Cannot access file: %s\n", rom_image );
-	    exit ( 1 );
+	if ( is_app ) {
+	    printf ( " ... %d segments\n", image_app ( rom_image ) );
+	    if ( ! got_entry )
+		entry = segments.entry;
+	} else
+	    printf ( " ... %d bytes read\n", image_raw ( rom_image, rombase ) );
+
+	for ( i=0; i<nraw; i++ ) {
+	    p = strchr ( raw[i], '@' );
+	    if ( ! p )
+		usage ();
+	    *p++ = '\0';
+	    printf ( "Reading image: %s\n", raw[i] );
+	    printf ( " ... %d bytes read\n", image_raw ( raw[i], strtoul ( p, NULL, 16 ) ) );
 	}
+	image_finish ();
+
+	if ( hint_file )
+	    load_hints ( hint_file );
 
 	of = creat ( elf_image, 0664 );
 	if ( of < 0 ) {
@@ -159,110 +292,132 @@ int main ( int argc, char **argv )
 	    exit ( 1 );
 	}
 
-	romsize = read ( rom, buf, MAX_ROMSIZE );
-	printf ( " ... %d bytes read\n", romsize );
-	close ( rom );
-
 	gnusize = strlen(gnu_extra) + 1;
 
-	shnum = 4;	/* We have 4 sections in our section table */
-	if ( sym_file ) {
-	    shnum += 2;	/* includes symtab and strings */
-	    nsy = load_syms ( sym_file );
-	    printf ( "%d symbols loaded\n", nsy );
-	}
-
-	/* program table immediately follows elf header */
-	ph_off = sizeof(hdr);
-
 	/* build string table now */
 	init_string ( &seg_strings );
 	add_string ( &seg_strings, "" );
 	s_index = add_string ( &seg_strings, ".shstrtab" );
-	t_index = add_string ( &seg_strings, ".text" );
-	if ( sym_file ) {
+	g_index = add_string ( &seg_strings, ".comment" );
+	mk_sections ();
+
+	/* null, the image, gnu, strings */
+	shnum = 1 + nsect + 2;
+
+	for ( i=0; i<nsymfiles; i++ )
+	    load_syms ( symfiles[i] );
+
+	nsy = syms.count;
+	if ( nsy ) {
+	    printf ( "%d symbols loaded\n", nsy );
+	    nsy = finish_symbol ();
+	    printf ( "%d symbols after dropping duplicates\n", nsy );
 	    sy_index = add_string ( &seg_strings, ".symtab" );
 	    sys_index = add_string ( &seg_strings, ".strtab" );
+	    shnum += 2;	/* includes symtab and strings */
 	}
 	finish_string ( &seg_strings );
 
-	/* May need to add a pad byte to string table so
-	 * that segment headers get even alignment.
-	 */
-	sh_off = PGSIZE + romsize + gnusize + seg_strings.off;
-	if ( sym_file ) {
-	    sh_off += syms.size + sym_strings.off;
+	/* program table immediately follows elf header */
+	ph_off = sizeof(hdr);
+
+	/* Lay out the file, the image sections first */
+	offset = ph_off + segments.count * sizeof(Elf32_Phdr);
+	for ( i=0; i<nsect; i++ ) {
+	    offset = (offset + 3) & ~3;
+	    sections[i].offset = offset;
+	    offset += sections[i].size;
 	}
+	offset += gnusize + seg_strings.off;
+	if ( nsy ) {
+	    offset = (offset + 3) & ~3;
+	    offset += (nsy + 1) * sizeof(Elf32_Sym) + sym_strings.off;
+	}
+	sh_off = (offset + 3) & ~3;
 
 	/* Fill in the elf file header (52 bytes) */
-	strncpy ( hdr.e_ident, "-ELF", 4 );
+	memset ( &hdr, 0, sizeof(hdr) );
 	hdr.e_ident[0] = 0x7F;
+	hdr.e_ident[1] = 'E';
+	hdr.e_ident[2] = 'L';
+	hdr.e_ident[3] = 'F';
 	/* note there are 16 bytes in the ident array */
 
 	hdr.e_ident[4] = 1;	/* 32 bit addresses */
-	hdr.e_ident[5] = 2;	/* big endian */
+	hdr.e_ident[5] = big_endian ? 2 : 1;
 	hdr.e_ident[6] = 1;	/* elf version 1 */
 	hdr.e_ident[7] = 0;	/* target OS - System V */
+	/* the rest are unused */
 
-	hdr.e_ident[8] = 0;	/* ABI version */
-	hdr.e_ident[9] = 0;	/* - unused */
-	hdr.e_ident[10] = 0;	/* - unused */
-	hdr.e_ident[11] = 0;	/* - unused */
-
-	hdr.e_ident[12] = 0;	/* - unused */
-	hdr.e_ident[13] = 0;	/* - unused */
-	hdr.e_ident[14] = 0;	/* - unused */
-	hdr.e_ident[15] = 0;	/* - unused */
-
-	hdr.e_type = ntohs(2);
+	hdr.e_type = e16(2);
 
 	/* XXX - how do we control 68010 versus 68020 disassembly ? */
-	hdr.e_machine = ntohs(4);	/* mc680x0 */
+	if ( big_endian ) {
+	    hdr.e_machine = e16(4);	/* mc680x0 */
+	    hdr.e_flags = e32 ( 0x01000000 );
+	} else {
+	    hdr.e_machine = e16(94);	/* Xtensa */
+	    hdr.e_flags = e32 ( 0x00000300 );
+	}
 
-	hdr.e_version = ntohl(1);
-	hdr.e_entry = ntohl ( entry );
-	hdr.e_phoff = ntohl ( ph_off );
-	hdr.e_shoff = ntohl ( sh_off );
-	hdr.e_flags = ntohl ( 0x01000000 );
-	hdr.e_ehsize = ntohs ( 52 );
-	hdr.e_phentsize = ntohs ( 0x20 );
-	hdr.e_phnum = ntohs ( 1 );
-	hdr.e_shentsize = ntohs ( 40 );
+	hdr.e_version = e32(1);
+	hdr.e_entry = e32 ( entry );
+	hdr.e_phoff = e32 ( ph_off );
+	hdr.e_shoff = e32 ( sh_off );
+	hdr.e_ehsize = e16 ( 52 );
+	hdr.e_phentsize = e16 ( sizeof(Elf32_Phdr) );
+	hdr.e_phnum = e16 ( segments.count );
+	hdr.e_shentsize = e16 ( sizeof(Elf32_Shdr) );
 
-	hdr.e_shnum = ntohs ( shnum );		/* size of our section table */
-	hdr.e_shstrndx = ntohs ( 3 );
+	hdr.e_shnum = e16 ( shnum );		/* size of our section table */
+	hdr.e_shstrndx = e16 ( nsect + 2 );
 
 	write ( of, &hdr, sizeof(hdr) );	/* Write file header */
 
-	memset ( pad, 0, PGSIZE );
-	npad = PGSIZE - sizeof(hdr);
-
-	npad -= mk_phdr ( of );			/* Write program header */
+	offset = sizeof(hdr);
+	offset += mk_phdr ( of );		/* Write program headers */
 
-	write ( of, pad, npad );		/* Write pad to page boundary */
-
-	/* The ROM image !!! */
-	write ( of, buf, romsize );		/* Write ROM image */
+	/* The image !!! */
+	memset ( pad, 0, sizeof(pad) );
+	for ( i=0; i<nsect; i++ ) {
+	    npad = sections[i].offset - offset;
+	    write ( of, pad, npad );
+	    write ( of, sections[i].data, sections[i].size );
+	    offset = sections[i].offset + sections[i].size;
+	}
 
 	/* The gnu signature */
 	write ( of, gnu_extra, gnusize );	/* Write Gnu signature */
 
 	/* write segment string table */
 	st_size = mk_string ( &seg_strings, of );	/* Write Segment String table */
+	offset += gnusize + st_size;
 
-	if ( sym_file ) {
+	sym_size = syst_size = 0;
+	if ( nsy ) {
+	    npad = ((offset + 3) & ~3) - offset;
+	    write ( of, pad, npad );
+	    offset += npad;
 	    sym_size = mk_symbol ( of );			/* Write Symbol table */
 	    syst_size = mk_string ( &sym_strings, of );		/* Write Symbol String table */
+	    offset += sym_size + syst_size;
 	}
 
-	offset = PGSIZE;
+	npad = sh_off - offset;
+	write ( of, pad, npad );
+
+	offset = sections[nsect-1].offset + sections[nsect-1].size;
 	mk_shdr_null ( of );			/* section header (start with null) */
-	mk_shdr_t ( of, t_index );		/* section header for ROM image */
-	mk_shdr_g ( of, g_index );		/* XXX - section header for gnu */
+	for ( i=0; i<nsect; i++ )
+	    mk_shdr_t ( of, &sections[i] );	/* section headers for the image */
+	mk_shdr_g ( of, g_index );		/* section header for gnu */
 	mk_shdr_s ( of, s_index, st_size );	/* section header for string table */
 
-	if ( sym_file ) {
-	    mk_shdr_sy ( of, sy_index, sym_size, shnum-1 );	/* section header for symbol table */
+	if ( nsy ) {
+	    offset = (offset + 3) & ~3;
+	    /* all our symbols are global, so only the null one is local */
+	    nlocal = 1;
+	    mk_shdr_sy ( of, sy_index, sym_size, shnum-1, nlocal );	/* section header for symbol table */
 	    mk_shdr_s ( of, sys_index, syst_size );	/* section header for string table */
 	}
 
@@ -270,59 +425,210 @@ int main ( int argc, char **argv )
 	exit ( 0 );
 }
 
+/* --------------------------------------------- */
+
+static int
+is_data ( unsigned int addr )
+{
+	int i;
+
+	for ( i=0; i<ndata; i++ )
+	    if ( addr >= data_ranges[i].start && addr < data_ranges[i].end )
+		return 1;
+	return 0;
+}
+
+/* one copy of each name in the section string table */
+static int
+section_name ( char *name )
+{
+	static char *names[3];
+	static int index[3];
+	int i;
+
+	for ( i=0; i<3 && names[i]; i++ )
+	    if ( strcmp ( names[i], name ) == 0 )
+		return index[i];
+	names[i] = name;
+	index[i] = add_string ( &seg_strings, name );
+	return index[i];
+}
+
+static void
+add_section ( struct segment *sp, unsigned int addr, unsigned int end, int data )
+{
+	struct section *xp;
+	char *name;
+
+	if ( nsect >= max_sect ) {
+	    max_sect = max_sect ? max_sect * 2 : 16;
+	    sections = xrealloc ( sections, max_sect * sizeof(struct section) );
+	}
+	xp = &sections[nsect++];
+	xp->addr = addr;
+	xp->size = end - addr;
+	xp->data = &sp->data[addr - sp->addr];
+
+	/* ram is always data, never code */
+	if ( sp->addr < ROM_BASE ) {
+	    name = ".data";
+	    xp->flags = SHF_ALLOC | SHF_WRITE;
+	} else if ( data ) {
+	    name = ".rodata";
+	    xp->flags = SHF_ALLOC;
+	} else {
+	    name = ".text";
+	    xp->flags = SHF_ALLOC | SHF_EXECINSTR;
+	}
+	xp->name = section_name ( name );
+}
+
+/* Split each segment where the hints switch between code and data */
+void
+mk_sections ( void )
+{
+	struct segment *sp;
+	unsigned int addr;
+	unsigned int start;
+	int data;
+	int i;
+
+	for ( i=0; i<segments.count; i++ ) {
+	    sp = &segments.seg[i];
+	    start = sp->addr;
+	    data = is_data ( start );
+	    for ( addr = start; addr < sp->addr + sp->size; addr++ ) {
+		if ( is_data ( addr ) == data )
+		    continue;
+		add_section ( sp, start, addr, data );
+		start = addr;
+		data = ! data;
+	    }
+	    add_section ( sp, start, addr, data );
+	}
+}
+
+/* Which section is this address in (0 if none) */
+static int
+find_section ( unsigned int addr )
+{
+	int i;
+
+	for ( i=0; i<nsect; i++ )
+	    if ( addr >= sections[i].addr && addr - sections[i].addr < sections[i].size )
+		return i + 1;
+	return 0;
+}
+
+static void
+add_data ( unsigned int start, unsigned int end )
+{
+	if ( ndata >= max_data ) {
+	    max_data = max_data ? max_data * 2 : 64;
+	    data_ranges = xrealloc ( data_ranges, max_data * sizeof(struct range) );
+	}
+	data_ranges[ndata].start = start;
+	data_ranges[ndata].end = end;
+	ndata++;
+}
+
 #define MAXLINE	256
 
-int
-load_syms ( char *file )
+/* The hints file lxdis (and espdis) use:
+ *  data 0x40001eec:0x40001eff
+ *  ldata, data4 the same, data1 is a single byte
+ *  sym 0x40000000 Vec_base
+ * The data lines give us our .rodata
+ * The sym lines get added to our symbols, ahead of any
+ * symbol files, so they win (just like in lxdis).
+ */
+void
+load_hints ( char *file )
 {
 	FILE *fp;
 	char line[MAXLINE];
-	int n = 0;
-	char val[9];
+	char cmd[64];
+	char arg[64];
 	char name[MAXLINE];
-	unsigned int addr;
+	unsigned int a1, a2;
+	char *p;
+	int nw;
 
 	fp = fopen ( file, "r" );
 	if ( fp == NULL ) {
-	    fprintf ( stderr, "Cannot read symbol file: %s\n", file );
+	    fprintf ( stderr, "Cannot read hints file: %s\n", file );
 	    exit ( 1 );
 	}
 
-	init_symbol ();
-
 	while ( fgets ( line, MAXLINE, fp ) != NULL ) {
-	    line[strlen(line)-1] = '\0';	/* nuke newline */
-
-	    strncpy ( val, line, 8 );
-	    val[8] = '\0';
-	    addr = strtol ( val, NULL, 16 );
-	    strcpy ( name, &line[9] );
-	    add_symbol ( name, addr );
-	    n++;
+	    if ( line[0] == '#' )
+		continue;
+	    nw = sscanf ( line, "%63s %63s %255s", cmd, arg, name );
+	    if ( nw < 2 )
+		continue;
+	    a1 = strtoul ( arg, NULL, 16 );
+	    if ( strcmp ( cmd, "data" ) == 0 || strcmp ( cmd, "ldata" ) == 0 ||
+		    strcmp ( cmd, "data4" ) == 0 ) {
+		p = strchr ( arg, ':' );
+		if ( ! p )
+		    continue;
+		a2 = strtoul ( p+1, NULL, 16 );
+		if ( a2 >= a1 )
+		    add_data ( a1, a2 + 1 );
+	    }
+	    if ( strcmp ( cmd, "data1" ) == 0 )
+		add_data ( a1, a1 + 1 );
+	    if ( strcmp ( cmd, "sym" ) == 0 && nw > 2 )
+		add_symbol ( name, a1 );
 	}
 
-	finish_symbol ();
+	fclose ( fp );
+}
 
-	return n;
+/* Either our .sy files:
+ *  400000a4 _ResetHandler
+ * or the PROVIDE lines from an SDK linker script:
+ *  PROVIDE ( Cache_Read_Disable = 0x400047f0 );
+ */
+void
+load_syms ( char *file )
+{
+	FILE *fp;
+	char line[MAXLINE];
+	char w[5][MAXLINE];
+	int nw;
+
+	fp = fopen ( file, "r" );
+	if ( fp == NULL ) {
+	    fprintf ( stderr, "Cannot read symbol file: %s\n", file );
+	    exit ( 1 );
+	}
+
+	while ( fgets ( line, MAXLINE, fp ) != NULL ) {
+	    if ( strncmp ( line, "PROVIDE", 7 ) == 0 ) {
+		nw = sscanf ( line, "%255s %255s %255s %255s %255s", w[0], w[1], w[2], w[3], w[4] );
+		if ( nw < 5 )
+		    continue;
+		add_symbol ( w[2], strtoul ( w[4], NULL, 16 ) );
+		continue;
+	    }
+	    if ( line[0] == '#' || line[0] == ';' )
+		continue;
+	    nw = sscanf ( line, "%255s %255s", w[0], w[1] );
+	    if ( nw < 2 || strspn ( w[0], "0123456789abcdefABCDEFx" ) != strlen ( w[0] ) )
+		continue;
+	    add_symbol ( w[1], strtoul ( w[0], NULL, 16 ) );
+	}
+
+	fclose ( fp );
 }
 
 void swap_shdr ( int *a, int count )
 {
 	int i;
 
-	/*
-	printf ( "int is %d bytes, %d of em\n", sizeof(int), count );
-	*/
-
-	for ( i=0; i<count; i++ ) {
-	    /*
-	    printf ( "preswap %d: %08x\n", i, a[i] );
-	    */
-	    a[i] = ntohl ( a[i] );
-	    /*
-	    printf ( "post    %d: %08x\n", i, a[i] );
-	    */
-	}
+	for ( i=0; i<count; i++ )
+	    a[i] = e32 ( a[i] );
 }
 
 void
@@ -336,20 +642,19 @@ mk_shdr_null ( int of )
 }
 
 void
-mk_shdr_t ( int of, int t_index )
+mk_shdr_t ( int of, struct section *xp )
 {
 	Elf32_Shdr shdr;
 
-	shdr.sh_name = t_index;
+	shdr.sh_name = xp->name;
 	shdr.sh_type = SHT_PROGBITS;
-	shdr.sh_flags = 6;
-	shdr.sh_addr = rombase;
-	shdr.sh_offset = offset;
-	shdr.sh_size = romsize;
-	offset += romsize;
+	shdr.sh_flags = xp->flags;
+	shdr.sh_addr = xp->addr;
+	shdr.sh_offset = xp->offset;
+	shdr.sh_size = xp->size;
 	shdr.sh_link = 0;
 	shdr.sh_info = 0;
-	shdr.sh_addralign = 4;
+	shdr.sh_addralign = 1;
 	shdr.sh_entsize = 0;
 
 	swap_shdr ( (int *)&shdr, sizeof(shdr) / sizeof(int) );
@@ -384,7 +689,6 @@ void
 mk_shdr_s ( int of, int s_index, int size )
 {
 	Elf32_Shdr shdr;
-	int n;
 
 	shdr.sh_name = s_index;
 	shdr.sh_type = SHT_STRTAB;
@@ -398,24 +702,15 @@ mk_shdr_s ( int of, int s_index, int size )
 	shdr.sh_addralign = 1;
 	shdr.sh_entsize = 0;
 
-	/*
-	printf ( "type: %08x\n", shdr.sh_type );
-	printf ( "sizeof name thingie = %d\n", sizeof(shdr.sh_name) );
-	*/
 	swap_shdr ( (int *)&shdr, sizeof(shdr) / sizeof(int) );
-	/*
-	printf ( "type: %08x\n", shdr.sh_type );
-	printf ( "s type: %08x\n", shdr.sh_type );
-	*/
 
-	n = write ( of, &shdr, sizeof(shdr) );
+	write ( of, &shdr, sizeof(shdr) );
 }
 
 void
-mk_shdr_sy ( int of, int s_index, int size, int string_index )
+mk_shdr_sy ( int of, int s_index, int size, int string_index, int nlocal )
 {
 	Elf32_Shdr shdr;
-	int n;
 
 	shdr.sh_name = s_index;
 	shdr.sh_type = SHT_SYMTAB;
@@ -425,88 +720,138 @@ mk_shdr_sy ( int of, int s_index, int size, int string_index )
 	shdr.sh_size = size;
 	offset += size;
 	shdr.sh_link = string_index;
-	shdr.sh_info = 0;
-	shdr.sh_addralign = 1;
+	shdr.sh_info = nlocal;
+	shdr.sh_addralign = 4;
 	shdr.sh_entsize = sizeof(Elf32_Sym);
 
 	swap_shdr ( (int *)&shdr, sizeof(shdr) / sizeof(int) );
 
-	n = write ( of, &shdr, sizeof(shdr) );
+	write ( of, &shdr, sizeof(shdr) );
 }
 
+/* One program header for each segment */
 int
 mk_phdr ( int of )
 {
 	Elf32_Phdr phdr;
+	struct segment *sp;
+	int size = 0;
+	int i, s;
+
+	for ( i=0; i<segments.count; i++ ) {
+	    sp = &segments.seg[i];
+
+	    /* the first section in this segment */
+	    s = find_section ( sp->addr ) - 1;
+
+	    phdr.p_type = e32 ( PT_LOAD );
+	    phdr.p_offset = e32 ( sections[s].offset );
+	    phdr.p_vaddr = e32 ( sp->addr );
+	    phdr.p_paddr = e32 ( sp->addr );
+	    phdr.p_filesz = e32 ( sp->size );
+	    phdr.p_memsz = e32 ( sp->size );
+	    phdr.p_flags = e32 ( sp->addr < ROM_BASE ? PF_R | PF_W : PF_R | PF_X );
+	    phdr.p_align = e32 ( 1 );
+
+	    write ( of, &phdr, sizeof(phdr) );
+	    size += sizeof(phdr);
+	}
 
-	phdr.p_type = ntohl ( 1 );
-	phdr.p_offset = ntohl ( 0x2000 );
-	phdr.p_vaddr = ntohl ( rombase );
-	phdr.p_paddr = ntohl ( rombase );
-	phdr.p_filesz = ntohl ( romsize );
-	phdr.p_memsz = ntohl ( romsize );
-	phdr.p_flags = ntohl ( 5 );
-	phdr.p_align = ntohl ( 0x2000 );
-
-	write ( of, &phdr, sizeof(phdr) );
-
-	return sizeof(phdr);
+	return size;
 }
 
 /* ------------------------------------- */
 
-/* symbol table always starts with this */
-void add_null ( void )
+void add_symbol ( char *name, unsigned int addr )
 {
-	Elf32_Sym *sp;
-	int ix;
-	int info;
+	struct sym *sp;
 
-	sp = &syms.sym[syms.count++];
-	syms.size += sizeof ( *sp );
+	if ( syms.count >= syms.limit ) {
+	    syms.limit = syms.limit ? syms.limit * 2 : 1024;
+	    syms.sym = xrealloc ( syms.sym, syms.limit * sizeof(struct sym) );
+	}
 
-	sp->st_name = 0;
-	sp->st_value = 0;
-	sp->st_info = 0;
-	sp->st_shndx = SHN_UNDEF;
+	sp = &syms.sym[syms.count];
+	sp->addr = addr;
+	sp->name = strdup ( name );
+	sp->order = syms.count++;
 }
 
-void init_symbol ( void )
+/* By address, and the first one loaded comes first */
+static int
+sym_compare ( const void *a, const void *b )
 {
-	init_string ( &sym_strings );
-	syms.count = 0;
-	syms.size = 0;
-	syms.limit = MAX_SYM;
-	memset ( (char *) &syms, 0, sizeof ( struct symtab) );
-	add_null ();
+	const struct sym *sa = a;
+	const struct sym *sb = b;
+
+	if ( sa->addr != sb->addr )
+	    return sa->addr < sb->addr ? -1 : 1;
+	return sa->order - sb->order;
 }
 
-void add_symbol ( char *name, unsigned int addr )
+/* Sort, and keep just the first name for each address,
+ * just like gendis and call_check do.
+ * Returns how many are left.
+ */
+int finish_symbol ( void )
 {
-	Elf32_Sym *sp;
-	int ix;
-	int info;
-
-	sp = &syms.sym[syms.count++];
-	syms.size += sizeof ( *sp );
-
-	ix = add_string ( &sym_strings, name );
-	sp->st_name = ntohl ( ix );
-	sp->st_value = ntohl ( addr );
-	info = ELF32_ST_INFO ( STB_GLOBAL, STT_FUNC );
-	sp->st_info = info;
-	sp->st_shndx = ntohs ( 1 );	/* rom image section */
+	int i, n;
+
+	qsort ( syms.sym, syms.count, sizeof(struct sym), sym_compare );
+
+	n = 0;
+	for ( i=0; i<syms.count; i++ ) {
+	    if ( n > 0 && syms.sym[n-1].addr == syms.sym[i].addr )
+		continue;
+	    syms.sym[n++] = syms.sym[i];
+	}
+	syms.count = n;
+
+	init_string ( &sym_strings );
+	add_string ( &sym_strings, "" );
+	for ( i=0; i<n; i++ )
+	    syms.sym[i].str = add_string ( &sym_strings, syms.sym[i].name );
+	finish_string ( &sym_strings );
+
+	return n;
 }
 
 int mk_symbol ( int of )
 {
-	write ( of, syms.sym, syms.size );
-	return syms.size;
-}
+	Elf32_Sym esym;
+	struct sym *sp;
+	int size = 0;
+	int sect;
+	int type;
+	int i;
 
-void finish_symbol ( void )
-{
-	finish_string ( &sym_strings );
+	/* symbol table always starts with this */
+	memset ( &esym, 0, sizeof(esym) );
+	write ( of, &esym, sizeof(esym) );
+	size += sizeof(esym);
+
+	for ( i=0; i<syms.count; i++ ) {
+	    sp = &syms.sym[i];
+	    sect = find_section ( sp->addr );
+	    if ( ! sect )
+		type = STT_NOTYPE;
+	    else if ( sections[sect-1].flags & SHF_EXECINSTR )
+		type = STT_FUNC;
+	    else
+		type = STT_OBJECT;
+
+	    esym.st_name = e32 ( sp->str );
+	    esym.st_value = e32 ( sp->addr );
+	    esym.st_size = 0;
+	    esym.st_info = ELF32_ST_INFO ( STB_GLOBAL, type );
+	    esym.st_other = 0;
+	    esym.st_shndx = e16 ( sect ? sect : SHN_ABS );
+
+	    write ( of, &esym, sizeof(esym) );
+	    size += sizeof(esym);
+	}
+
+	return size;
 }
 
 /* ------------------------------------- */
@@ -514,17 +859,23 @@ void finish_symbol ( void )
 void
 init_string ( struct string *sp )
 {
-	sp->buf = malloc ( PGSIZE );
-	sp->limit = PGSIZE;
+	sp->limit = 8192;
+	sp->buf = xrealloc ( NULL, sp->limit );
 	sp->off = 0;
 }
 
 int add_string ( struct string *sp, char *s )
 {
 	int rv = sp->off;
+	int len = strlen(s) + 1;
+
+	while ( sp->off + len > sp->limit ) {
+	    sp->limit *= 2;
+	    sp->buf = xrealloc ( sp->buf, sp->limit );
+	}
 
 	strcpy ( &sp->buf[sp->off], s );
-	sp->off += strlen(s) + 1;
+	sp->off += len;
 
 	/* return offset of string just stored */
 	return rv;
@@ -0,0 +1,199 @@
+/* xref.c
+ * One of my ESP8266 reverse engineering tools
+ *
+ * A cross reference index.  lxdis fills it in as it walks
+ * the disassembled code (every l32r, the literal it loads,
+ * every call and so on) and writes it out as a text file,
+ * one reference per line:
+ *
+ *  type  from      to        value     name
+ *  L     400000c0  40000000  40000088  -
+ *  C     40000149  4000042c  -         _start
+ *
+ * lxref reads that file back in and answers questions about it.
+ *
+ * We keep the list sorted by target (so "who refers to this"
+ * is a binary search) along with an index sorted by source
+ * (so "what does this refer to" is too).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xref.h"
+
+struct xref_tab xrefs;
+
+static void *
+xr_realloc ( void *p, int size )
+{
+	p = realloc ( p, size );
+	if ( ! p ) {
+	    printf ( "Out of memory\n" );
+	    exit ( 1 );
+	}
+	return p;
+}
+
+void
+xref_add ( int type, unsigned int from, unsigned int to, unsigned int val, char *name )
+{
+	struct xref *xp;
+
+	if ( xrefs.count >= xrefs.max ) {
+	    xrefs.max = xrefs.max ? xrefs.max * 2 : 4096;
+	    xrefs.list = xr_realloc ( xrefs.list, xrefs.max * sizeof(struct xref) );
+	}
+
+	xp = &xrefs.list[xrefs.count++];
+	xp->type = type;
+	xp->from = from;
+	xp->to = to;
+	xp->val = val;
+	xp->name = name;
+}
+
+static int
+to_compare ( const void *a, const void *b )
+{
+	const struct xref *xa = a;
+	const struct xref *xb = b;
+
+	if ( xa->to != xb->to )
+	    return xa->to < xb->to ? -1 : 1;
+	if ( xa->from != xb->from )
+	    return xa->from < xb->from ? -1 : 1;
+	return xa->type - xb->type;
+}
+
+static int
+from_compare ( const void *a, const void *b )
+{
+	const struct xref *xa = &xrefs.list[*(const int *)a];
+	const struct xref *xb = &xrefs.list[*(const int *)b];
+
+	if ( xa->from != xb->from )
+	    return xa->from < xb->from ? -1 : 1;
+	if ( xa->to != xb->to )
+	    return xa->to < xb->to ? -1 : 1;
+	return xa->type - xb->type;
+}
+
+/* Call this once everything has been added */
+void
+xref_sort ( void )
+{
+	int i;
+
+	qsort ( xrefs.list, xrefs.count, sizeof(struct xref), to_compare );
+
+	xrefs.from = xr_realloc ( xrefs.from, (xrefs.count + 1) * sizeof(int) );
+	for ( i=0; i<xrefs.count; i++ )
+	    xrefs.from[i] = i;
+	qsort ( xrefs.from, xrefs.count, sizeof(int), from_compare );
+}
+
+/* Everything that refers to addr.
+ * Returns the count, and these are list[*first] onward.
+ */
+int
+xref_to ( unsigned int addr, int *first )
+{
+	int lo, hi, mid;
+	int n;
+
+	lo = 0;
+	hi = xrefs.count;
+	while ( lo < hi ) {
+	    mid = (lo + hi) / 2;
+	    if ( xrefs.list[mid].to < addr )
+		lo = mid + 1;
+	    else
+		hi = mid;
+	}
+
+	*first = lo;
+	for ( n = 0; lo + n < xrefs.count; n++ )
+	    if ( xrefs.list[lo+n].to != addr )
+		break;
+	return n;
+}
+
+/* Everything the instruction at addr refers to.
+ * Returns the count, these are list[from[*first]] onward.
+ */
+int
+xref_from ( unsigned int addr, int *first )
+{
+	int lo, hi, mid;
+	int n;
+
+	lo = 0;
+	hi = xrefs.count;
+	while ( lo < hi ) {
+	    mid = (lo + hi) / 2;
+	    if ( xrefs.list[xrefs.from[mid]].from < addr )
+		lo = mid + 1;
+	    else
+		hi = mid;
+	}
+
+	*first = lo;
+	for ( n = 0; lo + n < xrefs.count; n++ )
+	    if ( xrefs.list[xrefs.from[lo+n]].from != addr )
+		break;
+	return n;
+}
+
+void
+xref_write ( FILE *fp )
+{
+	struct xref *xp;
+	int i;
+
+	fprintf ( fp, "# type from to value name\n" );
+	for ( i=0; i<xrefs.count; i++ ) {
+	    xp = &xrefs.list[i];
+	    fprintf ( fp, "%c %08x %08x ", xp->type, xp->from, xp->to );
+	    if ( xp->type == XR_L32R )
+		fprintf ( fp, "%08x", xp->val );
+	    else
+		fprintf ( fp, "-" );
+	    fprintf ( fp, " %s\n", xp->name ? xp->name : "-" );
+	}
+}
+
+/* Returns the number of references read */
+int
+xref_read ( char *file )
+{
+	FILE *fp;
+	char line[256];
+	char type[8], from[16], to[16], val[16], name[128];
+	int nw;
+	int n = 0;
+
+	fp = fopen ( file, "r" );
+	if ( ! fp ) {
+	    printf ( "Cannot open %s\n", file );
+	    exit ( 1 );
+	}
+
+	while ( fgets ( line, sizeof(line), fp ) ) {
+	    if ( line[0] == '#' )
+		continue;
+	    nw = sscanf ( line, "%7s %15s %15s %15s %127s", type, from, to, val, name );
+	    if ( nw < 3 )
+		continue;
+	    xref_add ( type[0], strtoul ( from, NULL, 16 ), strtoul ( to, NULL, 16 ),
+		nw > 3 && val[0] != '-' ? strtoul ( val, NULL, 16 ) : 0,
+		nw > 4 && strcmp ( name, "-" ) != 0 ? strdup ( name ) : NULL );
+	    n++;
+	}
+	fclose ( fp );
+
+	xref_sort ();
+	return n;
+}
+
+/* THE END */
@@ -0,0 +1,37 @@
+/* xref.h
+ * Cross reference index for lxdis and lxref
+ */
+
+/* One reference from an instruction */
+struct xref {
+	unsigned int from;	/* the instruction */
+	unsigned int to;	/* what it refers to */
+	unsigned int val;	/* literal value (l32r only) */
+	int type;
+	char *name;		/* name of "to", or NULL */
+};
+
+/* the types */
+#define XR_L32R		'L'	/* l32r, to is the literal */
+#define XR_CALL		'C'	/* call0 (or call8) */
+#define XR_CALLX	'X'	/* callx0 through a register set by l32r */
+#define XR_DATA		'D'	/* l32r literal that points at data */
+#define XR_CODE		'P'	/* l32r literal that points at code */
+
+struct xref_tab {
+	struct xref *list;	/* sorted by to, then from */
+	int *from;		/* indexes into list, sorted by from */
+	int count;
+	int max;
+};
+
+extern struct xref_tab xrefs;
+
+void xref_add ( int, unsigned int, unsigned int, unsigned int, char * );
+void xref_sort ( void );
+int xref_to ( unsigned int, int * );
+int xref_from ( unsigned int, int * );
+void xref_write ( FILE * );
+int xref_read ( char * );
+
+/* THE END */